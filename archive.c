@@ -0,0 +1,431 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assembler.h"
+
+
+/* The archive entry name and its index (the table is written sorted by the names) */
+typedef struct ARCHIVE_SORTED_ENTRY {
+    const char *name;
+    unsigned long index;
+} ARCHIVE_SORTED_ENTRY;
+
+
+/**
+ * This function writes unsigned number as archive field (ARCHIVE_FIELD_SIZE bytes, little endian)
+ * @param field The buffer to write to (with at least ARCHIVE_FIELD_SIZE bytes)
+ * @param value The number
+ */
+static void write_archive_field(unsigned char *field, unsigned long value) {
+    /* For loop counter */
+    int i;
+
+    for (i = 0; i < ARCHIVE_FIELD_SIZE; i++) {
+        field[i] = (unsigned char) (value % 256);
+        value /= 256;
+    }
+}
+
+/**
+ * This function reads unsigned number from archive field (ARCHIVE_FIELD_SIZE bytes, little endian)
+ * @param field The field bytes
+ * @return The number
+ */
+static unsigned long read_archive_field(const unsigned char *field) {
+    /* For loop counter */
+    int i;
+
+    unsigned long value = 0;
+
+    for (i = ARCHIVE_FIELD_SIZE - 1; i >= 0; i--) value = value * 256 + field[i];
+
+    return value;
+}
+
+/**
+ * This function writes bytes to the archive file
+ * If it fails to write them (e.g. the disk is full) it exits the program
+ * @param archive The archive writer
+ * @param data The bytes
+ * @param length The number of bytes
+ */
+static void write_archive_bytes(ARCHIVE_WRITER *archive, const void *data, unsigned long length) {
+    if (fwrite(data, 1, length, archive->file) != length) {
+        printf("CRITICAL: Failed to write archive file.\n");
+        exit(1);
+    }
+}
+
+/**
+ * This function moves the archive file position
+ * If it fails to move it exits the program
+ * @param archive The archive writer
+ * @param offset The offset from the file start
+ */
+static void seek_archive_writer(ARCHIVE_WRITER *archive, unsigned long offset) {
+    if (fseek(archive->file, (long) offset, SEEK_SET) != 0) {
+        printf("CRITICAL: Failed to write archive file.\n");
+        exit(1);
+    }
+}
+
+/**
+ * This function creates new archive for known number of entries
+ * The blobs are written while we add the entries, and the header and the table when we close the archive
+ * If it fails to create the file it exits the program
+ * @param path The archive path
+ * @param entries_count The number of entries (one for each source)
+ * @return The archive writer
+ */
+ARCHIVE_WRITER *create_archive_writer(const char *path, unsigned long entries_count) {
+    ARCHIVE_WRITER *archive = malloc(sizeof(ARCHIVE_WRITER));
+    if (archive == NULL) {
+        printf("CRITICAL: Failed to allocate archive.\n");
+        exit(1);
+    }
+
+    archive->file = fopen(path, "wb");
+    if (archive->file == NULL) {
+        perror("CRITICAL: Failed to create archive file!");
+        exit(1);
+    }
+
+    /* Empty entries are all zeros (e.g. source which failed) */
+    archive->table = calloc(entries_count > 0 ? entries_count : 1, ARCHIVE_ENTRY_SIZE);
+    if (archive->table == NULL) {
+        printf("CRITICAL: Failed to allocate archive table.\n");
+        exit(1);
+    }
+
+    /* The entries which weren't added have the empty name in offset 0 */
+    archive->name_offsets = calloc(entries_count > 0 ? entries_count : 1, sizeof(int));
+    if (archive->name_offsets == NULL) {
+        printf("CRITICAL: Failed to allocate archive names.\n");
+        exit(1);
+    }
+    init_output_buffer(&archive->names);
+    append_to_output_buffer(&archive->names, "", 1);
+
+    archive->entries_count = entries_count;
+    archive->next_entry = 0;
+
+    /* The blobs start after the header and the table */
+    archive->offset = ARCHIVE_HEADER_SIZE + entries_count * ARCHIVE_ENTRY_SIZE;
+    seek_archive_writer(archive, archive->offset);
+
+    return archive;
+}
+
+/**
+ * This function writes one blob of the archive entry, and updates its offset and length fields
+ * If it fails to write the blob it exits the program
+ * @param archive The archive writer
+ * @param fields The entry offset and length fields
+ * @param data The blob data
+ * @param length The blob length
+ */
+static void write_archive_blob(ARCHIVE_WRITER *archive, unsigned char *fields, const char *data, unsigned long length) {
+    if (length == 0) return;
+
+    write_archive_bytes(archive, data, length);
+
+    write_archive_field(fields, archive->offset);
+    write_archive_field(fields + ARCHIVE_FIELD_SIZE, length);
+    archive->offset += length;
+}
+
+/**
+ * This function adds the next entry to the archive
+ * If it fails to write the blobs it exits the program
+ * @param archive The archive writer
+ * @param name The entry name (the outputs name of the source)
+ * @param members The members of the entry (object, entries and externals, null or empty if they don't exist)
+ */
+void add_archive_entry(ARCHIVE_WRITER *archive, const char *name, OUTPUT_BUFFER *members) {
+    /* For loop counter */
+    int i;
+
+    /* The entry fields inside the table */
+    unsigned char *fields;
+
+    /* We already added all the entries */
+    if (archive->next_entry >= archive->entries_count) return;
+
+    /* The name is kept for sorting the table */
+    archive->name_offsets[archive->next_entry] = archive->names.length;
+    append_to_output_buffer(&archive->names, name, (int) strlen(name) + 1);
+
+    fields = archive->table + archive->next_entry++ * ARCHIVE_ENTRY_SIZE;
+
+    write_archive_blob(archive, fields, name, strlen(name));
+
+    if (members == NULL) return;
+
+    for (i = 0; i < ARCHIVE_MEMBERS_COUNT; i++) {
+        write_archive_blob(archive, fields + (i + 1) * 2 * ARCHIVE_FIELD_SIZE, members[i].data, members[i].length);
+    }
+}
+
+/**
+ * This function compares two archive entries by their names (and by their indexes if the names are the same)
+ * @param first The first entry
+ * @param second The second entry
+ * @return Negative, zero or positive number (like strcmp)
+ */
+static int compare_sorted_entries(const void *first, const void *second) {
+    const ARCHIVE_SORTED_ENTRY *first_entry = first;
+    const ARCHIVE_SORTED_ENTRY *second_entry = second;
+
+    int result = strcmp(first_entry->name, second_entry->name);
+    if (result != 0) return result;
+
+    return first_entry->index < second_entry->index ? -1 : first_entry->index > second_entry->index;
+}
+
+/**
+ * This function writes the archive header and table, and closes the archive
+ * The table is sorted by the entries names, so the reader finds entry with binary search
+ * If it fails to write the file it exits the program
+ * @param archive The archive writer
+ */
+void close_archive_writer(ARCHIVE_WRITER *archive) {
+    /* For loop counter */
+    unsigned long i;
+
+    /* The header bytes */
+    unsigned char header[ARCHIVE_HEADER_SIZE];
+
+    ARCHIVE_SORTED_ENTRY *sorted_entries = malloc((archive->entries_count > 0 ? archive->entries_count : 1) *
+                                                  sizeof(ARCHIVE_SORTED_ENTRY));
+    if (sorted_entries == NULL) {
+        printf("CRITICAL: Failed to allocate archive table.\n");
+        exit(1);
+    }
+
+    for (i = 0; i < archive->entries_count; i++) {
+        sorted_entries[i].name = archive->names.data + archive->name_offsets[i];
+        sorted_entries[i].index = i;
+    }
+    qsort(sorted_entries, archive->entries_count, sizeof(ARCHIVE_SORTED_ENTRY), compare_sorted_entries);
+
+    memcpy(header, ARCHIVE_MAGIC, ARCHIVE_MAGIC_SIZE);
+    write_archive_field(header + ARCHIVE_MAGIC_SIZE, archive->entries_count);
+
+    seek_archive_writer(archive, 0);
+    write_archive_bytes(archive, header, ARCHIVE_HEADER_SIZE);
+    for (i = 0; i < archive->entries_count; i++) {
+        write_archive_bytes(archive, archive->table + sorted_entries[i].index * ARCHIVE_ENTRY_SIZE, ARCHIVE_ENTRY_SIZE);
+    }
+
+    /* The buffered bytes are written when the file is closed */
+    if (fclose(archive->file) != 0) {
+        printf("CRITICAL: Failed to write archive file.\n");
+        exit(1);
+    }
+    free(sorted_entries);
+    free_output_buffer(&archive->names);
+    free(archive->name_offsets);
+    free(archive->table);
+    free(archive);
+}
+
+/**
+ * This function checks that all the blobs of the table are inside the archive file
+ * @param archive The archive reader
+ * @param file_length The archive file length
+ * @return Are all the blobs inside the file
+ */
+static boolean archive_blobs_fit(ARCHIVE_READER *archive, unsigned long file_length) {
+    /* For loop counters */
+    unsigned long i;
+    int member;
+
+    unsigned long offset, length;
+
+    for (i = 0; i < archive->entries_count; i++) {
+        for (member = ARCHIVE_MEMBER_NAME; member < ARCHIVE_MEMBERS_COUNT; member++) {
+            get_archive_blob(archive, i, member, &offset, &length);
+            if (offset > file_length || length > file_length - offset) return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ * This function opens archive for reading (it reads the header and the table)
+ * The entries count and the blobs are checked against the file length (so broken archive isn't read outside it)
+ * @param path The archive path
+ * @return The archive reader, or null if we can't open the file or it is not an archive
+ */
+ARCHIVE_READER *open_archive_reader(const char *path) {
+    /* The header bytes */
+    unsigned char header[ARCHIVE_HEADER_SIZE];
+
+    ARCHIVE_READER *archive;
+    unsigned long entries_count;
+    long file_length;
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return NULL;
+
+    if (fseek(file, 0, SEEK_END) != 0 || (file_length = ftell(file)) < ARCHIVE_HEADER_SIZE ||
+        fseek(file, 0, SEEK_SET) != 0 || fread(header, 1, ARCHIVE_HEADER_SIZE, file) != ARCHIVE_HEADER_SIZE ||
+        memcmp(header, ARCHIVE_MAGIC, ARCHIVE_MAGIC_SIZE) != 0) {
+        fclose(file);
+        return NULL;
+    }
+
+    /* The table must fit the file (so its size doesn't overflow) */
+    entries_count = read_archive_field(header + ARCHIVE_MAGIC_SIZE);
+    if (entries_count > (unsigned long) (file_length - ARCHIVE_HEADER_SIZE) / ARCHIVE_ENTRY_SIZE) {
+        fclose(file);
+        return NULL;
+    }
+
+    archive = malloc(sizeof(ARCHIVE_READER));
+    if (archive == NULL) {
+        printf("CRITICAL: Failed to allocate archive.\n");
+        exit(1);
+    }
+
+    archive->file = file;
+    archive->entries_count = entries_count;
+    archive->table = malloc(entries_count > 0 ? entries_count * ARCHIVE_ENTRY_SIZE : 1);
+    if (archive->table == NULL) {
+        printf("CRITICAL: Failed to allocate archive table.\n");
+        exit(1);
+    }
+
+    if (fread(archive->table, ARCHIVE_ENTRY_SIZE, entries_count, file) != entries_count ||
+        !archive_blobs_fit(archive, (unsigned long) file_length)) {
+        close_archive_reader(archive);
+        return NULL;
+    }
+
+    return archive;
+}
+
+/**
+ * This function gets the offset and length of archive blob
+ * @param archive The archive reader
+ * @param index The entry index
+ * @param member The member index (ARCHIVE_MEMBER_NAME for the entry name)
+ * @param offset The blob offset to update
+ * @param length The blob length to update (0 if the member doesn't exist)
+ */
+void get_archive_blob(ARCHIVE_READER *archive, unsigned long index, int member, unsigned long *offset,
+                      unsigned long *length) {
+    /* The blob fields inside the table (the name is before the members) */
+    const unsigned char *fields = archive->table + index * ARCHIVE_ENTRY_SIZE + (member + 1) * 2 * ARCHIVE_FIELD_SIZE;
+
+    *offset = read_archive_field(fields);
+    *length = read_archive_field(fields + ARCHIVE_FIELD_SIZE);
+}
+
+/**
+ * This function reads the name of archive entry
+ * @param archive The archive reader
+ * @param index The entry index
+ * @return The new entry name (or null if the archive is broken)
+ */
+char *read_archive_entry_name(ARCHIVE_READER *archive, unsigned long index) {
+    /* The name blob */
+    unsigned long offset, length;
+
+    char *name;
+
+    get_archive_blob(archive, index, ARCHIVE_MEMBER_NAME, &offset, &length);
+
+    /* +1 for \0 */
+    name = malloc(length + 1);
+    if (name == NULL) {
+        printf("CRITICAL: Failed to allocate archive entry name.\n");
+        exit(1);
+    }
+
+    if (fseek(archive->file, (long) offset, SEEK_SET) != 0 || fread(name, 1, length, archive->file) != length) {
+        free(name);
+        return NULL;
+    }
+    name[length] = END_OF_STRING;
+
+    return name;
+}
+
+/**
+ * This function finds archive member by its file name (entry name and extension, e.g. input.ob)
+ * The table is sorted by the entries names, so it reads only the names of the binary search (the first entry is
+ * found if some entries have the same name)
+ * @param archive The archive reader
+ * @param member_name The member file name
+ * @param offset The member offset to update
+ * @param length The member length to update
+ * @return The status code (ERROR if there is no such member)
+ */
+STATUS_CODE find_archive_member(ARCHIVE_READER *archive, const char *member_name, unsigned long *offset,
+                                unsigned long *length) {
+    /* The extensions of the members (in the members order) */
+    const char *extensions[ARCHIVE_MEMBERS_COUNT];
+
+    /* The extension inside the member name, and the entry name length */
+    const char *extension = strrchr(member_name, '.');
+    int name_length;
+
+    /* For loop counter */
+    int member;
+
+    /* The binary search range (the entry is in [low, high)), and the middle entry */
+    unsigned long low = 0, high = archive->entries_count, middle;
+
+    /* The current entry name, how it compares to the searched name, and is the entry in high the searched one */
+    char *name;
+    int result;
+    boolean found = FALSE;
+
+    extensions[ARCHIVE_MEMBER_OBJECT] = OBJECT_FILE_EXTENSION;
+    extensions[ARCHIVE_MEMBER_ENTRIES] = ENTRY_FILE_EXTENSION;
+    extensions[ARCHIVE_MEMBER_EXTERNALS] = EXTERNAL_FILE_EXTENSION;
+
+    if (extension == NULL) return ERROR;
+    name_length = extension - member_name;
+
+    for (member = 0; member < ARCHIVE_MEMBERS_COUNT && strcmp(extension, extensions[member]) != 0; member++);
+    if (member == ARCHIVE_MEMBERS_COUNT) return ERROR;
+
+    /* Find the first entry which isn't before the name */
+    while (low < high) {
+        middle = low + (high - low) / 2;
+        name = read_archive_entry_name(archive, middle);
+        if (name == NULL) return ERROR;
+
+        result = strncmp(name, member_name, name_length);
+        if (result == 0 && name[name_length] != END_OF_STRING) result = 1;
+        free(name);
+
+        if (result < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+            found = result == 0;
+        }
+    }
+
+    if (!found) return ERROR;
+
+    get_archive_blob(archive, high, member, offset, length);
+
+    /* The entry doesn't have this member (e.g. no entries, or the source failed) */
+    return *length > 0 ? OK : ERROR;
+}
+
+/**
+ * This function closes the archive reader
+ * @param archive The archive reader
+ */
+void close_archive_reader(ARCHIVE_READER *archive) {
+    fclose(archive->file);
+    free(archive->table);
+    free(archive);
+}
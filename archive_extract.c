@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "assembler.h"
+
+
+/**
+ * This function prints all the members of the archive (file name and length)
+ * @param archive The archive reader
+ * @return The status code (ERROR if the archive is broken)
+ */
+static STATUS_CODE list_archive_members(ARCHIVE_READER *archive) {
+    /* The extensions of the members (in the members order) */
+    const char *extensions[ARCHIVE_MEMBERS_COUNT];
+
+    /* For loop counters */
+    unsigned long i;
+    int member;
+
+    /* The current entry name and member blob */
+    char *name;
+    unsigned long offset, length;
+
+    extensions[ARCHIVE_MEMBER_OBJECT] = OBJECT_FILE_EXTENSION;
+    extensions[ARCHIVE_MEMBER_ENTRIES] = ENTRY_FILE_EXTENSION;
+    extensions[ARCHIVE_MEMBER_EXTERNALS] = EXTERNAL_FILE_EXTENSION;
+
+    for (i = 0; i < archive->entries_count; i++) {
+        name = read_archive_entry_name(archive, i);
+        if (name == NULL) return ERROR;
+
+        for (member = 0; member < ARCHIVE_MEMBERS_COUNT; member++) {
+            get_archive_blob(archive, i, member, &offset, &length);
+            if (length > 0) printf("%s%s\t%lu\n", name, extensions[member], length);
+        }
+
+        free(name);
+    }
+
+    return OK;
+}
+
+/**
+ * This function copies the archive member to the output stream
+ * @param archive The archive reader
+ * @param offset The member offset
+ * @param length The member length
+ * @param output The output stream
+ * @return The status code (ERROR if the archive is broken or the output write fails)
+ */
+static STATUS_CODE copy_archive_member(ARCHIVE_READER *archive, unsigned long offset, unsigned long length,
+                                       FILE *output) {
+    /* The current part of the member */
+    char buffer[ARCHIVE_COPY_BUFFER_SIZE];
+    unsigned long part_length;
+
+    if (fseek(archive->file, (long) offset, SEEK_SET) != 0) return ERROR;
+
+    while (length > 0) {
+        part_length = length < sizeof(buffer) ? length : sizeof(buffer);
+        if (fread(buffer, 1, part_length, archive->file) != part_length) return ERROR;
+        if (fwrite(buffer, 1, part_length, output) != part_length) return ERROR;
+        length -= part_length;
+    }
+
+    return OK;
+}
+
+/**
+ * The archive extract tool
+ * archive_extract <archive> - prints all the members of the archive (sorted by the entries names)
+ * archive_extract <archive> <member> [output file] - writes the member (e.g. input.ob) to the file, or to stdout
+ */
+int main(int argc, char **argv) {
+    ARCHIVE_READER *archive;
+
+    /* The member blob */
+    unsigned long offset, length;
+
+    /* Where to write the member */
+    FILE *output = stdout;
+
+    STATUS_CODE status_code;
+
+    if (argc < 2 || argc > 4) {
+        fprintf(stderr, "Usage: %s <archive> [<member> [output file]] \n", argv[0]);
+        return 1;
+    }
+
+    archive = open_archive_reader(argv[1]);
+    if (archive == NULL) {
+        fprintf(stderr, "CRITICAL: Unable to open archive %s \n", argv[1]);
+        return 1;
+    }
+
+    if (argc == 2) {
+        status_code = list_archive_members(archive);
+        if (status_code != OK) fprintf(stderr, "CRITICAL: Broken archive %s \n", argv[1]);
+    } else if (find_archive_member(archive, argv[2], &offset, &length) != OK) {
+        fprintf(stderr, "ERROR: Archive member was not found (%s) \n", argv[2]);
+        status_code = ERROR;
+    } else {
+        if (argc == 4) {
+            output = fopen(argv[3], "wb");
+            if (output == NULL) {
+                fprintf(stderr, "CRITICAL: Unable to open file %s \n", argv[3]);
+                close_archive_reader(archive);
+                return 1;
+            }
+        }
+
+        status_code = copy_archive_member(archive, offset, length, output);
+        if (status_code != OK) fprintf(stderr, "CRITICAL: Failed to copy archive member %s \n", argv[2]);
+
+        /* The buffered part of the member is written only when the output is closed (or flushed) */
+        if ((output != stdout ? fclose(output) : fflush(output)) != 0 && status_code == OK) {
+            fprintf(stderr, "CRITICAL: Failed to write archive member %s \n", argv[2]);
+            status_code = ERROR;
+        }
+    }
+
+    close_archive_reader(archive);
+
+    return status_code == OK ? 0 : 1;
+}
@@ -2,7 +2,18 @@
 #include <stdlib.h>
 #include "assembler.h"
 
-int main(int argc, char **argv) {
+/**
+ * This function assemblies one source, prints its diagnostics and writes its outputs
+ * @param options The command line options
+ * @param index The input index
+ * @param source The source content if we already have it (null to read the file)
+ * @param batch_io The batch io to write the files with (null to write them here)
+ * @param archive The outputs archive (in archive mode)
+ * @param diagnostics_output Where to print the diagnostics
+ * @return The status code of the assembly
+ */
+static STATUS_CODE assemble_input(ASSEMBLER_OPTIONS *options, int index, BATCH_SOURCE *source, BATCH_IO *batch_io,
+                                  ARCHIVE_WRITER *archive, FILE *diagnostics_output) {
     /* All the assemblers status code */
     int pre_assembler_status_code, first_assembler_status_code, second_assembler_status_code;
 
@@ -10,55 +21,169 @@ int main(int argc, char **argv) {
     ASSEMBLER_TABLES *assembler_tables;
     char *output_file_name_with_extension;
 
+    /* The program image (with --run), and its profile and line table (with --profile) */
+    OBJECT_IMAGE image;
+    EMULATOR_PROFILE profile;
+    LINE_TABLE line_table;
+
+    /* If the assembly was successfully */
+    STATUS_CODE status_code = OK;
+
+    /* Assembler filename, and the outputs name (in the outputs directory) */
+    char *filename = options->inputs[index].filename;
+    char *output_name = options->inputs[index].output_name;
+
+    output_file_name_with_extension = add_suffix_to_string(output_name, PRE_ASSEMBLER_FILE_EXTENSION);
+
+    /* Init all assembler tables (each file collects its own diagnostics and prints them once in the end) */
+    assembler_tables = create_assembler_tables(options);
+
+    /* Run pre assembler */
+    pre_assembler_status_code = pre_assembler(filename, output_name, source, batch_io, assembler_tables);
+    if (pre_assembler_status_code != OK) {
+        write_diagnostics(assembler_tables->diagnostics, diagnostics_output);
+        fprintf(diagnostics_output, "WARNING: Pre-assembler failed. Skipping to next file...\n");
+        free_assembler_tables(assembler_tables);
+        if (archive != NULL) write_assembler_archive_entry(output_name, NULL, archive);
+        if (!options->check_only && options->output_mode == OUTPUT_FILES) remove(output_file_name_with_extension);
+        free(output_file_name_with_extension);
+        return ERROR;
+    }
+
+    /* Run main assemblers */
+    first_assembler_status_code = first_assembler(assembler_tables);
+
+    /* No need to resolve the symbols if we already stopped this file */
+    second_assembler_status_code = diagnostics_limit_reached(assembler_tables->diagnostics)
+                                       ? ERROR
+                                       : second_assembler(assembler_tables);
+
+    /* Print all the file diagnostics (in line order) */
+    write_diagnostics(assembler_tables->diagnostics, diagnostics_output);
+
+    if (first_assembler_status_code != OK || second_assembler_status_code != OK) {
+        status_code = ERROR;
+        fprintf(diagnostics_output, "WARNING: Assembler failed. Skipping to next file...\n");
+        if (archive != NULL) write_assembler_archive_entry(output_name, NULL, archive);
+    }
+    else if (!options->check_only) {
+        /* If assembler was successfully write the outputs (files, archive or stdout) */
+        if (options->output_mode == OUTPUT_FILES) {
+            write_assembler_files(output_name, assembler_tables, batch_io);
+        } else if (archive != NULL) {
+            write_assembler_archive_entry(output_name, assembler_tables, archive);
+        } else {
+            write_assembler_stream(filename, assembler_tables, options->output_mode == OUTPUT_BUNDLE, stdout);
+        }
+
+        /* Run the program from the assembler tables (without reading the outputs again) */
+        if (options->run) {
+            build_object_image(assembler_tables, &image);
+            status_code = run_object_image(filename, &image, options->jit, options->profile ? &profile : NULL, stdin,
+                                           stdout, diagnostics_output);
+            free_object_image(&image);
+
+            /* The profile is written even if the program failed (it shows where the commands ran) */
+            if (options->profile) {
+                build_line_table(assembler_tables, &line_table);
+                if (write_profile_files(output_name, &profile, &line_table) != OK) status_code = ERROR;
+                free_line_table(&line_table);
+            }
+        }
+    }
+
+    free_assembler_tables(assembler_tables);
+    free(output_file_name_with_extension);
+
+    return status_code;
+}
+
+int main(int argc, char **argv) {
     /* For loop var */
     int i;
 
     /* If all assemblies was successfully */
     STATUS_CODE status_code = OK;
 
-    if (argc < 2) {
+    /* The command line options and files */
+    ASSEMBLER_OPTIONS options;
+
+    /* Where to print the diagnostics (stderr if the outputs go to stdout) */
+    FILE *diagnostics_output;
+
+    /* All the outputs archive (in archive mode) */
+    ARCHIVE_WRITER *archive = NULL;
+
+    /* Reads the next sources and writes the outputs in the background (with --async-io) */
+    BATCH_IO *batch_io = NULL;
+
+    /* Keeps the sources content, and finds the sources which changed (with --watch) */
+    WATCHER *watcher = NULL;
+
+    /* The source content (null to read the file in the pre assembler) */
+    BATCH_SOURCE *source;
+
+    parse_assembler_options(argc, argv, &options);
+    diagnostics_output = options.output_mode == OUTPUT_STDOUT || options.output_mode == OUTPUT_BUNDLE ? stderr
+                                                                                                      : stdout;
+
+    /* The commands tables are shared by all the files */
+    init_commands_tables();
+
+    /* The language server gets the sources from the editor (and not from the command line) */
+    if (options.language_server) {
+        status_code = run_language_server(stdin, stdout);
+        free_assembler_options(&options);
+        return status_code;
+    }
+
+    if (options.inputs_count < 1) {
         fprintf(stderr, "CRITICAL: Found 0 file to assembly \n");
         exit(1);
     }
 
-    for (i = 1; i < argc; i++) {
-        /* Assembler filename */
-        char *filename = argv[i];
-
-        output_file_name_with_extension = add_suffix_to_string(filename, PRE_ASSEMBLER_FILE_EXTENSION);
-
-        /* Init all assembler tables */
-        assembler_tables = malloc(sizeof(ASSEMBLER_TABLES));
-        assembler_tables->command_binary_line = NULL;
-        assembler_tables->instruction_binary_line = NULL;
-        assembler_tables->external_instruction = NULL;
-        assembler_tables->entry_instruction = NULL;
-        assembler_tables->symbol_table = NULL;
-
-        /* Run pre assembler */
-        pre_assembler_status_code = pre_assembler(filename, assembler_tables);
-        if (pre_assembler_status_code != OK) {
-            printf("WARNING: Pre-assembler failed. Skipping to next file...\n");
-            status_code = ERROR;
-            free_macros(assembler_tables->macro);
-            remove(output_file_name_with_extension);
-            continue;
-        }
+    /* Each source has one entry in the archive (even if it fails) */
+    if (options.output_mode == OUTPUT_ARCHIVE && !options.check_only) {
+        archive = create_archive_writer(options.archive_path, options.inputs_count);
+    }
 
-        /* Run main assemblers */
-        first_assembler_status_code = first_assembler(filename, assembler_tables);
-        second_assembler_status_code = second_assembler(assembler_tables);
-        if (first_assembler_status_code != OK || second_assembler_status_code != OK) {
-            status_code = ERROR;
-            printf("WARNING: Assembler failed. Skipping to next file...\n");
-        }
-        else {
-            /* If assembler was successfully write the output files */
-            write_assembler_files(filename, assembler_tables);
+    /* The watcher already reads the sources (before the first assembly, so we don't miss any change) */
+    if (options.watch) {
+        watcher = create_watcher(options.inputs, options.inputs_count);
+    } else if (options.async_io) {
+        batch_io = create_batch_io(options.inputs, options.inputs_count, BATCH_IO_DEPTH);
+    }
+
+    for (i = 0; i < options.inputs_count; i++) {
+        /* The batch io already reads the source (unless it is stdin) */
+        source = watcher != NULL ? get_watched_source(watcher, i)
+                                 : batch_io != NULL ? wait_batch_source(batch_io, i) : NULL;
+
+        if (assemble_input(&options, i, source, batch_io, archive, diagnostics_output) != OK) status_code = ERROR;
+
+        if (batch_io != NULL) release_batch_source(batch_io, i);
+    }
+
+    /* Wait for the last outputs */
+    if (batch_io != NULL) finish_batch_io(batch_io);
+    if (archive != NULL) close_archive_writer(archive);
+
+    /* Assembly each source again when it changes (the commands tables stay from the first assembly) */
+    if (watcher != NULL) {
+        /* Show the diagnostics (and the stdout outputs) right away */
+        fflush(stdout);
+
+        while ((i = wait_watched_source(watcher)) >= 0) {
+            if (assemble_input(&options, i, get_watched_source(watcher, i), NULL, NULL, diagnostics_output) != OK) {
+                status_code = ERROR;
+            }
+            fflush(stdout);
         }
 
-        free_assembler_tables(assembler_tables);
+        close_watcher(watcher);
     }
 
+    free_assembler_options(&options);
+
     return status_code;
 }
@@ -6,6 +6,7 @@
 #define OBJECT_FILE_EXTENSION ".ob"
 #define ENTRY_FILE_EXTENSION ".ent"
 #define EXTERNAL_FILE_EXTENSION ".ext"
+#define BINARY_OBJECT_FILE_EXTENSION ".bo"
 
 /* Global Consts */
 #define MACRO_NAME "mcro"
@@ -15,6 +16,8 @@
 #define SYMBOL_SUFFIX ':'
 #define END_OF_STRING '\0'
 #define ADDRESS_SIZE 10
+/* All the bits of one word */
+#define ADDRESS_MASK ((1U << ADDRESS_SIZE) - 1)
 #define STRING_SYMBOL '"'
 #define POSITIVE_NUMBER_SYMBOL '+'
 #define NEGATIVE_NUMBER_SYMBOL '-'
@@ -52,6 +55,26 @@
 #define STRING_INSTRUCTION_NAME "string"
 #define DATA_INSTRUCTION_NAME "data"
 
+/* Chars classes (each char can be in many classes) */
+#define CHAR_CLASSES_SIZE 256
+#define CHAR_CLASS_SPACE 0x01
+#define CHAR_CLASS_DIGIT 0x02
+#define CHAR_CLASS_ALPHA 0x04
+#define CHAR_CLASS_SIGN 0x08
+#define CHAR_CLASS_END_OF_LINE 0x10
+
+/**
+ * Array contains the class of each char (The index is the char as unsigned char)
+ */
+extern const unsigned char char_classes[CHAR_CLASSES_SIZE];
+
+/* Check the char class with one lookup (unlike ctype.h it doesn't depend on the locale) */
+#define IS_CHAR_CLASS(c, classes) (char_classes[(unsigned char) (c)] & (classes))
+#define IS_SPACE_CHAR(c) IS_CHAR_CLASS(c, CHAR_CLASS_SPACE)
+#define IS_DIGIT_CHAR(c) IS_CHAR_CLASS(c, CHAR_CLASS_DIGIT)
+#define IS_ALPHA_CHAR(c) IS_CHAR_CLASS(c, CHAR_CLASS_ALPHA)
+#define IS_ALNUM_CHAR(c) IS_CHAR_CLASS(c, CHAR_CLASS_DIGIT | CHAR_CLASS_ALPHA)
+
 /* Boolean definition */
 typedef int boolean;
 #define TRUE 1
@@ -77,9 +100,212 @@ typedef enum STATUS_CODE {
     ERROR = 1
 } STATUS_CODE;
 
+/* Part of string (e.g. symbol inside the line), so we don't have to copy it */
+typedef struct TOKEN_SLICE {
+    char *start;
+    int length;
+} TOKEN_SLICE;
+
+/* Diagnostics */
+
+/* All diagnostics messages (each one has format in diagnostics.c) */
+typedef enum DIAGNOSTIC_CODE {
+    /* Files */
+    DIAGNOSTIC_SOURCE_FILE_NOT_FOUND,
+    DIAGNOSTIC_OUTPUT_FILE_OPEN_FAILED,
+
+    /* Pre assembler */
+    DIAGNOSTIC_LINE_TOO_LONG,
+    DIAGNOSTIC_MACRO_END_SPAM,
+    DIAGNOSTIC_MACRO_NAME_MISSING,
+    DIAGNOSTIC_MACRO_DUPLICATE,
+    DIAGNOSTIC_MACRO_SPAM,
+    DIAGNOSTIC_MACRO_NAME_START,
+    DIAGNOSTIC_MACRO_NAME_CHARS,
+    DIAGNOSTIC_MACRO_NAME_IS_COMMAND,
+    DIAGNOSTIC_MACRO_NAME_IS_INSTRUCTION,
+
+    /* Symbols */
+    DIAGNOSTIC_LABEL_TOO_LONG,
+    DIAGNOSTIC_LABEL_DUPLICATE,
+    DIAGNOSTIC_LABEL_IS_MACRO,
+    DIAGNOSTIC_DATA_LABEL_DUPLICATE,
+    DIAGNOSTIC_SYMBOL_EMPTY,
+    DIAGNOSTIC_SYMBOL_START,
+    DIAGNOSTIC_SYMBOL_TOO_LONG,
+    DIAGNOSTIC_WORD_START,
+    DIAGNOSTIC_WORD_NOT_FOUND,
+
+    /* Entries and externals */
+    DIAGNOSTIC_ENTRY_WITH_LABEL,
+    DIAGNOSTIC_ENTRY_DUPLICATE,
+    DIAGNOSTIC_EXTERNAL_WITH_LABEL,
+    DIAGNOSTIC_EXTERNAL_DUPLICATE,
+
+    /* Lines */
+    DIAGNOSTIC_UNKNOWN_INSTRUCTION,
+    DIAGNOSTIC_UNKNOWN_COMMAND,
+    DIAGNOSTIC_UNEXPECTED_PARAMS,
+
+    /* Commands operands */
+    DIAGNOSTIC_OPERAND_MISSING_COMMA,
+    DIAGNOSTIC_SECOND_OPERAND_INVALID,
+    DIAGNOSTIC_OPERANDS_COUNT,
+    DIAGNOSTIC_SOURCE_OPERAND_TYPE,
+    DIAGNOSTIC_DES_OPERAND_TYPE,
+    DIAGNOSTIC_REGISTRY_NUMBER,
+    DIAGNOSTIC_MAT_OPERAND_SYNTAX,
+
+    /* Instructions params */
+    DIAGNOSTIC_MAT_DEFINITION_SYNTAX,
+    DIAGNOSTIC_NUMBER_START,
+    DIAGNOSTIC_MAT_TOO_MANY_PARAMS,
+    DIAGNOSTIC_STRING_MISSING,
+    DIAGNOSTIC_STRING_NOT_CLOSED,
+    DIAGNOSTIC_NUMBER_EXPECTED,
+    DIAGNOSTIC_NUMBER_RANGE,
+    DIAGNOSTIC_NUMBER_AFTER_COMMA,
+    DIAGNOSTIC_NUMBER_MISSING_COMMA,
+
+    /* Second assembler */
+    DIAGNOSTIC_ENTRY_SYMBOL_NOT_FOUND,
+    DIAGNOSTIC_SYMBOL_NOT_FOUND,
+
+    NUMBER_OF_DIAGNOSTIC_CODES
+} DIAGNOSTIC_CODE;
+
+typedef enum {
+    DIAGNOSTIC_ERROR,
+    DIAGNOSTIC_WARNING
+} DIAGNOSTIC_SEVERITY;
+
+/* Max length of number inside diagnostic message (sign and digits) */
+#define DIAGNOSTIC_NUMBER_MAX_LENGTH 11
+
+/* Which arguments the diagnostic message format expects */
+typedef enum {
+    DIAGNOSTIC_ARGUMENT_NONE,
+    DIAGNOSTIC_ARGUMENT_TEXT,
+    DIAGNOSTIC_ARGUMENT_NUMBERS,
+    DIAGNOSTIC_ARGUMENT_FILE
+} DIAGNOSTIC_ARGUMENT;
+
+/* One structured diagnostic, it is formatted only when we write the diagnostics */
+typedef struct DIAGNOSTIC {
+    DIAGNOSTIC_CODE code;
+    int line_number;
+    int numbers[2];
+    char *text;
+    struct DIAGNOSTIC *next;
+} DIAGNOSTIC;
+
+/* Per file diagnostics sink (records are kept in line order) */
+typedef struct DIAGNOSTICS {
+    DIAGNOSTIC *head;
+    DIAGNOSTIC *tail;
+    int error_count;
+    /* Stop the file after this number of errors (0 means no limit) */
+    int max_errors;
+} DIAGNOSTICS;
+
+/**
+ * Init empty diagnostics sink (e.g. sink which is part of another struct)
+ * @param diagnostics The diagnostics sink
+ */
+void init_diagnostics(DIAGNOSTICS *diagnostics);
+
+/**
+ * Create new empty diagnostics sink
+ * @return The new diagnostics sink
+ */
+DIAGNOSTICS *create_diagnostics(void);
+
+/**
+ * Report new diagnostic with optional text argument
+ * The text is copied, so it can point to the current line buffer
+ * @param diagnostics The diagnostics sink
+ * @param code The diagnostic code
+ * @param line_number The line number of the diagnostic (0 if it is about the whole file)
+ * @param text The text argument of the message (Can be null)
+ */
+void report_diagnostic(DIAGNOSTICS *diagnostics, DIAGNOSTIC_CODE code, int line_number, const char *text);
+
+/**
+ * Report new diagnostic with numbers arguments
+ * @param diagnostics The diagnostics sink
+ * @param code The diagnostic code
+ * @param line_number The line number of the diagnostic
+ * @param first The first number of the message
+ * @param second The second number of the message (Ignored if the message has only one)
+ */
+void report_diagnostic_numbers(DIAGNOSTICS *diagnostics, DIAGNOSTIC_CODE code, int line_number, int first,
+                               int second);
+
+/**
+ * Report new diagnostic with text argument which is part of string (e.g. operand inside the line)
+ * @param diagnostics The diagnostics sink
+ * @param code The diagnostic code
+ * @param line_number The line number of the diagnostic
+ * @param text The text argument of the message
+ */
+void report_diagnostic_slice(DIAGNOSTICS *diagnostics, DIAGNOSTIC_CODE code, int line_number, TOKEN_SLICE text);
+
+/**
+ * Report again all the diagnostics of another sink in a new line
+ * It is used for errors which were found before we know the actual line number (e.g. lexed macro lines)
+ * @param diagnostics The diagnostics sink
+ * @param source The sink with the diagnostics to report
+ * @param line_number The line number of the new diagnostics
+ */
+void copy_diagnostics(DIAGNOSTICS *diagnostics, const DIAGNOSTICS *source, int line_number);
+
+/**
+ * Get the severity of the diagnostic code (e.g. for callers which handle the structured diagnostics)
+ * @param code The diagnostic code
+ * @return The diagnostic severity
+ */
+DIAGNOSTIC_SEVERITY get_diagnostic_severity(DIAGNOSTIC_CODE code);
+
+/**
+ * Format one diagnostic message (without the end of line)
+ * @param diagnostic The diagnostic
+ * @param line_number The line number in the message (e.g. the line in the source and not in the .am file)
+ * @return The new message
+ */
+char *format_diagnostic(const DIAGNOSTIC *diagnostic, int line_number);
+
+/**
+ * Check if the file already has the maximum number of errors
+ * The passes check it after each line, so they can stop the file early
+ * @param diagnostics The diagnostics sink
+ * @return Should we stop processing this file
+ */
+boolean diagnostics_limit_reached(DIAGNOSTICS *diagnostics);
+
+/**
+ * Format all the diagnostics (in line order) to the output stream
+ * @param diagnostics The diagnostics sink
+ * @param output The output stream (e.g. stdout)
+ */
+void write_diagnostics(DIAGNOSTICS *diagnostics, FILE *output);
+
+/**
+ * This function frees all the records of the diagnostics sink
+ * The sink itself stays empty and can be used again
+ * @param diagnostics The diagnostics sink
+ */
+void clear_diagnostics(DIAGNOSTICS *diagnostics);
+
+/**
+ * This function frees the diagnostics sink and all its records
+ * @param diagnostics The diagnostics sink
+ */
+void free_diagnostics(DIAGNOSTICS *diagnostics);
+
 /* Macros Tables */
 typedef struct MACRO_CONTENT {
-    char *content;
+    /* The line is lexed once, when the macro is defined */
+    struct LEXED_LINE *line;
     struct MACRO_CONTENT *next;
 } MACRO_CONTENT;
 
@@ -91,7 +317,41 @@ typedef struct MACRO {
 } MACRO;
 
 
+/* Text which grows while we write to it (e.g. the object file image) */
+#define OUTPUT_BUFFER_DEFAULT_CAPACITY 256
+/* We compare the existing output file with the new content in parts of this size */
+#define OUTPUT_COMPARE_BUFFER_SIZE 4096
+
+typedef struct OUTPUT_BUFFER {
+    /* The text (always ends with \0, NULL until we write to it) */
+    char *data;
+    int length;
+    int capacity;
+} OUTPUT_BUFFER;
+
+
 /* Global Utils */
+/**
+ * Init empty output buffer
+ * @param buffer The output buffer
+ */
+void init_output_buffer(OUTPUT_BUFFER *buffer);
+
+/**
+ * Append text to the end of the output buffer (the buffer grows if it needs)
+ * @param buffer The output buffer
+ * @param text The text to append (doesn't have to end with \0)
+ * @param length The text length
+ */
+void append_to_output_buffer(OUTPUT_BUFFER *buffer, const char *text, int length);
+
+/**
+ * This function frees the output buffer text
+ * The buffer itself stays empty and can be used again
+ * @param buffer The output buffer
+ */
+void free_output_buffer(OUTPUT_BUFFER *buffer);
+
 /**
  * This function get string, and new string ti append
  * It return new string contains the two words together
@@ -117,12 +377,30 @@ void trim_newline(char *str);
 char *decimal_to_binary(int decimal, int length);
 
 /**
- * This function coppy all chars from string until it arrive to none digit
+ * This function writes the decimal number as binary into existing buffer (without \0)
+ * It is used to write many words one after another (e.g. all the .data numbers)
+ * @param binary The buffer to write to (with at least length chars)
+ * @param decimal The decimal number to convert to binary
+ * @param length The binary length
+ */
+void write_binary(char *binary, int decimal, int length);
+
+/**
+ * This function finds all chars from string until it arrive to none digit
  * It also updates the string params with the next address
- * @param str_ptr The pointer to string to copy from
- * @return The new number as int
+ * @param str_ptr The pointer to string to search in
+ * @return The number slice inside the string (empty slice if we don't find number)
  */
-char *copy_next_number(char **str_ptr);
+TOKEN_SLICE copy_next_number(char **str_ptr);
+
+/**
+ * This function converts number slice (from copy_next_number) to int, and checks it fits in one word
+ * It stops as soon as the number is out of range, so long numbers can't overflow
+ * @param number The number slice (optional +/- and digits)
+ * @param out_number The int value to update (only if it is in range)
+ * @return The status code (ERROR if the number is out of range)
+ */
+STATUS_CODE parse_number(TOKEN_SLICE number, int *out_number);
 
 /**
  * Calculate the mat size (row * col)
@@ -151,28 +429,21 @@ STATUS_CODE get_mat_registries(char **mat_ptr, int *r1_out, int *r2_out);
  * @param instruction_params The instruction params
  * @param out_member Pointer to int which we want to update the integre value
  * @param line_number The instrunction line in the assembler file
+ * @param diagnostics The diagnostics sink
  * @return Pointer to the number value
  */
-STATUS_CODE get_next_number_from_instruction_params(char **instruction_params, int *out_member, int line_number);
+STATUS_CODE get_next_number_from_instruction_params(char **instruction_params, int *out_member, int line_number,
+                                                    DIAGNOSTICS *diagnostics);
 
 /**
  * This function extract the current symbol from the string
- * If the symbol name is invalid, it will return null
+ * If the symbol name is invalid, it will return empty slice
  * @param string_ptr Pointer to the string which contains the symbol
  * @param line_number The line number of the symbol
- * @return The symbol string
- */
-char *get_current_symbol(char **string_ptr, int line_number);
-
-/**
- * Extract the current command operand
- * We search until we arrive to end / empty char / comma
- * If the string is empty it will return null
- * @param str_ptr Pointer ot operands string
- * @return String contains only the operand itself
+ * @param diagnostics The diagnostics sink
+ * @return The symbol slice inside the string
  */
-char *get_next_command_operand(char **str_ptr);
-
+TOKEN_SLICE get_current_symbol(char **string_ptr, int line_number, DIAGNOSTICS *diagnostics);
 
 /* instruction */
 #define NUMBER_OF_COMMANDS 16
@@ -202,10 +473,19 @@ typedef struct COMMAND_BINARY_LINE {
     struct COMMAND_BINARY_LINE *next;
 } COMMAND_BINARY_LINE;
 
+/* Data words, one node holds all the words of a line, and they can be repeated (e.g. the zeros of big mat) */
 typedef struct INSTRUCTION_BINARY_LINE {
     int address;
+
+    /* All the words machine codes one after another (ADDRESS_SIZE chars each) */
     char *machine_code;
 
+    /* Number of words in the machine code */
+    int words_count;
+
+    /* Number of times the words are repeated (the words are in address, address + 1, ...) */
+    int repeat_count;
+
     struct INSTRUCTION_BINARY_LINE *next;
 } INSTRUCTION_BINARY_LINE;
 
@@ -226,6 +506,18 @@ typedef struct EXTERNAL_INSTRUCTION {
     struct EXTERNAL_INSTRUCTION *next;
 } EXTERNAL_INSTRUCTION;
 
+/* Where the assembler writes the output files */
+typedef enum {
+    /* The .am, .ob, .ent and .ext files (next to the source file) */
+    OUTPUT_FILES,
+    /* Only the .ob content to the stdout */
+    OUTPUT_STDOUT,
+    /* The .ob, .ent and .ext contents to the stdout, each one after a frame header */
+    OUTPUT_BUNDLE,
+    /* The .ob, .ent and .ext contents of all the sources in one archive file */
+    OUTPUT_ARCHIVE
+} OUTPUT_MODE;
+
 typedef struct ASSEMBLER_TABLES {
     MACRO *macro;
     SYMBOL_TABLE *symbol_table;
@@ -233,6 +525,28 @@ typedef struct ASSEMBLER_TABLES {
     INSTRUCTION_BINARY_LINE *instruction_binary_line;
     EXTERNAL_INSTRUCTION *external_instruction;
     ENTRY_INSTRUCTION *entry_instruction;
+    DIAGNOSTICS *diagnostics;
+
+    /* The expanded source lines (the first assembler reads them instead of the .am file) */
+    struct LEXED_SOURCE *lexed_source;
+
+    /* Check mode only validates the source (no machine codes and no output files) */
+    boolean check_only;
+
+    /* Number of threads to lex the source lines with */
+    int jobs;
+
+    /* Where to write the output files (The .am file is written only with the other files) */
+    OUTPUT_MODE output_mode;
+
+    /* Don't write output file which already has the same content (so its modification time stays) */
+    boolean write_if_changed;
+
+    /* Write the outputs as one binary object (.bo) instead of the base4 text outputs */
+    boolean binary_object;
+
+    /* Write the line table (.lin) with the outputs */
+    boolean line_table;
 
     int ic;
     int dc;
@@ -254,6 +568,7 @@ INSTRUCTION_BINARY_LINE *create_instruction_binary_line(int address, char *machi
 /* Macros */
 /**
  * Add new content line to existing macro
+ * The line is lexed here, so every use of the macro shares the same lexed line
  * @param current_macro The macro to add the new line to
  * @param content The new line content
  */
@@ -342,6 +657,16 @@ EXTERNAL_INSTRUCTION *create_external_instruction(char *name, int address);
  */
 void free_macros(MACRO *head);
 
+/* The options are defined with the command line options */
+struct ASSEMBLER_OPTIONS;
+
+/**
+ * This function creates new empty assembler tables for one source
+ * @param options The options of the assembly (max errors, check mode and jobs)
+ * @return The new assembler tables
+ */
+ASSEMBLER_TABLES *create_assembler_tables(const struct ASSEMBLER_OPTIONS *options);
+
 /**
  * This functions frees all assembler tables
  * @param assembler_tables The assembler tables to free its address
@@ -373,67 +698,313 @@ typedef struct {
  */
 extern const COMMAND_INFO commands[NUMBER_OF_COMMANDS];
 
+/* Number of real operands types (SIMPLE, SYMBOL, MAT, REGISTRY) */
+#define OPERAND_TYPES_COUNT 4
+
+/* The operand type bit in the allowed operands bitmask */
+#define OPERAND_TYPE_BIT(type) (1U << (type))
+
+/**
+ * Bitmask of the allowed operands types for each command number and operand order
+ * It is built from the commands array (in init_commands_tables)
+ */
+extern unsigned int allowed_operands_masks[NUMBER_OF_COMMANDS][2];
+
+/**
+ * The first word of each command number, source operand type and destination operand type
+ * It is built from the commands array (in init_commands_tables)
+ */
+extern char command_first_words[NUMBER_OF_COMMANDS][OPERAND_TYPES_COUNT][OPERAND_TYPES_COUNT][ADDRESS_SIZE + 1];
+
+/* Number of different words (each word has ADDRESS_SIZE bits) */
+#define WORDS_COUNT (1 << ADDRESS_SIZE)
+
+/* The command of first word (the reverse of command_first_words) */
+typedef struct {
+    /* The command (null if the word is not first word of valid command) */
+    const COMMAND_INFO *command_info;
+    /* The operands types (UNDEFINED if the command doesn't have this operand) */
+    OPERAND_TYPE source_operand_type;
+    OPERAND_TYPE des_operand_type;
+    /* Number of words of the command (the first word and the operands words) */
+    int words_count;
+} COMMAND_DECODE;
+
+/**
+ * The command of each first word (invalid first words have null command)
+ * It is built from the commands array (in init_commands_tables)
+ */
+extern COMMAND_DECODE command_decodes[WORDS_COUNT];
+
+/**
+ * Build the allowed operands bitmasks, the commands first words and the commands decodes from the commands array
+ * It should be called before we assembly any file (the tables are built only in the first call)
+ */
+void init_commands_tables(void);
+
 /**
  * Find the command details
  * If it doesn't find command with this name, it will return null
  * @param name The command name
+ * @param length The name length (the name doesn't have to end with \0)
  * @return The command info
  */
-const COMMAND_INFO *get_command_info_by_name(const char *name);
+const COMMAND_INFO *get_command_info_by_name(const char *name, int length);
+
+/* Lexer */
+#define LEXED_SOURCE_DEFAULT_CAPACITY 64
+/* Number of lists in the lexed lines cache (lines with the same text are lexed once) */
+#define LEXED_CACHE_SIZE 1024
+/* Max threads to lex the source lines with */
+#define MAX_LEX_JOBS 64
+/* Smaller sources are lexed without threads (it is faster than creating them) */
+#define MIN_LEX_CHUNK_LINES 512
+
+/* All lines kinds */
+typedef enum {
+    /* Only for the pre assembler classification */
+    LINE_MACRO_START,
+    LINE_MACRO_END,
+    LINE_STATEMENT,
+
+    /* Statements kinds */
+    LINE_EMPTY,
+    LINE_COMMAND,
+    LINE_DATA,
+    LINE_STRING,
+    LINE_MAT,
+    LINE_ENTRY,
+    LINE_EXTERN,
+    /* We failed before we know what the line is (e.g. unknown command) */
+    LINE_INVALID
+} LINE_KIND;
+
+/* Where in the line the lexer stopped with error (the first assembler reports it in the same order as its checks) */
+typedef enum {
+    LEX_STAGE_NONE,
+    LEX_STAGE_FIRST_WORD,
+    LEX_STAGE_LABEL,
+    LEX_STAGE_SECOND_WORD,
+    LEX_STAGE_BODY,
+    LEX_STAGE_TRAILING
+} LEX_STAGE;
+
+/* One command operand with its parsed values */
+typedef struct {
+    OPERAND_TYPE type;
+    /* The number (SIMPLE), the registry (REGISTRY) or the first mat registry (MAT) */
+    int value;
+    /* The second mat registry (MAT) */
+    int second_value;
+    /* The symbol name (SYMBOL / MAT) */
+    char *symbol;
+    /* The operand extra word (SIMPLE / REGISTRY / MAT registries), symbol words are known in the second assembler */
+    int word;
+} LEXED_OPERAND;
+
+/* One command operand as the operand decoder finds it in the line (before we save it in the lexed line) */
+typedef struct {
+    /* The whole operand text (empty if there is no operand) */
+    TOKEN_SLICE text;
+    /* The symbol name inside the text (SYMBOL / MAT) */
+    TOKEN_SLICE symbol;
+    /* Are the mat registries valid (MAT) */
+    STATUS_CODE mat_status;
+    /* The operand type and values (without the symbol name) */
+    LEXED_OPERAND operand;
+} DECODED_OPERAND;
+
+/* One source line after the lexer */
+typedef struct LEXED_LINE {
+    LINE_KIND kind;
+    /* The line itself (all tokens are parsed from it) */
+    char *text;
+    /* The label without ':' (null if the line doesn't define label) */
+    char *label;
+
+    /* LINE_COMMAND: the command and its operands (in the line order) */
+    const COMMAND_INFO *command_info;
+    LEXED_OPERAND operands[2];
+    int operands_count;
+
+    /* LINE_DATA / LINE_MAT: the parsed numbers */
+    int *numbers;
+    int numbers_count;
+    int mat_size;
+
+    /* LINE_STRING: the string chars inside the text */
+    char *string_start;
+    int string_length;
+
+    /* LINE_ENTRY / LINE_EXTERN: the symbol name */
+    char *symbol;
+
+    /* Copy of the text where all the line names (label, symbols) end with \0 (null if there are no names) */
+    char *names;
+
+    /* The errors we found (their line numbers are set when the first assembler reports them) */
+    LEX_STAGE error_stage;
+    DIAGNOSTICS errors;
+
+    /* The line key hash, and the next line in the same cache list (only for lines in the lexed source cache) */
+    unsigned long hash;
+    struct LEXED_LINE *next_cached;
+} LEXED_LINE;
+
+/* All the expanded source lines (index + 1 is the line number in the .am file) */
+typedef struct LEXED_SOURCE {
+    LEXED_LINE **lines;
+    int count;
+    int capacity;
+
+    /* The source line number of each line (macro lines have the line of the macro call) */
+    int *source_line_numbers;
+
+    /* The macro of each line (null if the line is not macro line) */
+    MACRO **macros;
+
+    /* All the lines the source owns, each one once (the same line can be many times in the lines) */
+    LEXED_LINE **owned_lines;
+    int owned_count;
+    int owned_capacity;
+    /* The owned lines before this index are already lexed */
+    int lexed_count;
+
+    /* The owned lines by their key hash */
+    LEXED_LINE *cache[LEXED_CACHE_SIZE];
+} LEXED_SOURCE;
+
+/* Part of the owned lines which one thread lexes */
+typedef struct LEX_CHUNK {
+    LEXED_LINE **lines;
+    int count;
+} LEX_CHUNK;
+
+/**
+ * This function classify the line by its first word
+ * It only detects the macros definitions lines (mcro / mcroend), all other lines are statements
+ * It updates the line pointer to be after the leading spaces and the macro keyword (if exists)
+ * @param line_ptr Pointer to the line
+ * @return The line kind (LINE_MACRO_START / LINE_MACRO_END / LINE_STATEMENT)
+ */
+LINE_KIND classify_line(char **line_ptr);
+
+/**
+ * Create new lexed line from the line text
+ * The text is copied, so it can be the current line buffer
+ * @param text The line text (without the end of line)
+ * @return The new lexed line
+ */
+LEXED_LINE *create_lexed_line(const char *text);
+
+/**
+ * This function frees the lexed line and all its tokens
+ * @param lexed_line The lexed line
+ */
+void free_lexed_line(LEXED_LINE *lexed_line);
+
+/**
+ * Create new empty lexed source
+ * @return The new lexed source
+ */
+LEXED_SOURCE *create_lexed_source(void);
+
+/**
+ * Add line to the end of the lexed source
+ * Macros lines can be added many times (they are owned by the macro)
+ * @param lexed_source The lexed source
+ * @param lexed_line The line to add
+ * @param source_line_number The line number in the source (before the macros were expanded)
+ * @param macro The macro which the line came from (null if it is not macro line)
+ */
+void add_lexed_line(LEXED_SOURCE *lexed_source, LEXED_LINE *lexed_line, int source_line_number, MACRO *macro);
+
+/**
+ * Remove all the lines from the lexed source, but keep the lines it owns
+ * So the next source (e.g. the same source after an edit) lexes only its new lines
+ * @param lexed_source The lexed source
+ */
+void reuse_lexed_source(LEXED_SOURCE *lexed_source);
+
+/**
+ * Find the line of this text in the lexed source cache, or create it and save it in the cache
+ * The key is the text without its leading spaces (they don't change the lexed line)
+ * New lines are not lexed yet, they are lexed all together in lex_source_lines
+ * @param lexed_source The lexed source
+ * @param text The line text (without the end of line)
+ * @return The line (owned by the lexed source)
+ */
+LEXED_LINE *get_cached_lexed_line(LEXED_SOURCE *lexed_source, const char *text);
+
+/**
+ * Lex all the lines the lexed source owns (lines which are already lexed are not lexed again)
+ * Each line is lexed only by itself, so big sources are split to chunks which are lexed in threads
+ * @param lexed_source The lexed source
+ * @param jobs The max number of threads (1 means we lex without threads)
+ */
+void lex_source_lines(LEXED_SOURCE *lexed_source, int jobs);
+
+/**
+ * This function frees the lexed source and all the lines it owns
+ * Macros lines are not freed here (they are freed with the macros)
+ * @param lexed_source The lexed source
+ */
+void free_lexed_source(LEXED_SOURCE *lexed_source);
 
 /* Assembler */
 /* First Assembler functions */
 /**
- * This function calculate command (such as mov) operands
- * It clculate all operands machine codes
- * @param operands_ptr Pointer to operands string
- * @param command_info The current command details
+ * This function calculate the command (such as mov) machine codes from the lexed line
+ * It calculates the command word and all operands machine codes
+ * @param lexed_line The lexed command line
  * @param ic The ic counter (It also updates it)
  * @param line_number The command line number
- * @return All operands machine codes
+ * @param encode Should we build the machine codes strings (FALSE only counts the words)
+ * @return All command machine codes
  */
-COMMAND_BINARY_LINE *get_command_operands_machine_codes(char **operands_ptr, const COMMAND_INFO *command_info, int *ic,
-                                                        int line_number);
+COMMAND_BINARY_LINE *get_command_operands_machine_codes(const LEXED_LINE *lexed_line, int *ic, int line_number,
+                                                        boolean encode);
 
 /**
  * This calculates mat instruction type data machine codes
  * Every cell in the mat is specific machine code,
- * So our final machine codes will be row*col
- * @param mat_instruction_ptr Pointer to mat data
+ * So our final machine codes will be row*col (missing values are zero)
+ * @param lexed_line The lexed mat line
  * @param dc The dc count (It also update it with the new value)
- * @param line_number The mat line number in the assembly file
+ * @param encode Should we build the machine codes strings (FALSE only counts the words)
  * @return All mat instructions machine codes
  */
-INSTRUCTION_BINARY_LINE *get_mat_machine_codes(char **mat_instruction_ptr, int *dc, int line_number);
+INSTRUCTION_BINARY_LINE *get_mat_machine_codes(const LEXED_LINE *lexed_line, int *dc, boolean encode);
 
 /**
- * It gets regular command operand and try to find its type (Mat, symbol, ect...)
- * @param operand The operand string
- * @param line_number The line number of the operand
- * @return The operand type
+ * This function decodes the next command operand in one scan of the line
+ * It finds the operand text (until end / empty char / comma, or the end of the mat brackets),
+ * its type, its values and its extra word, and the symbol name (SYMBOL / MAT)
+ * Errors are not reported here, so the caller can report them in the right order:
+ * invalid registry number is INVALID_OPERAND type, and invalid mat registries is ERROR mat status
+ * @param str_ptr Pointer ot operands string (It updates it only if we find operand)
+ * @param decoded_operand The decoded operand to update (empty text if there is no operand)
  */
-OPERAND_TYPE find_operand_type(const char *operand, int line_number);
+void decode_command_operand(char **str_ptr, DECODED_OPERAND *decoded_operand);
 
 /**
  * Calculate the string instruction machine codes
  * It adds zero to the string end (to indicate the end of the string)
- * It also update the string to the next word (skip the string itself)
- * @param str_ptr Pointer to the string
+ * @param lexed_line The lexed string line
  * @param dc The dc counter
+ * @param encode Should we build the machine codes strings (FALSE only counts the words)
  * @return All string machine codes
  */
-INSTRUCTION_BINARY_LINE *get_string_machine_codes(char **str_ptr, int *dc, int line_number);
+INSTRUCTION_BINARY_LINE *get_string_machine_codes(const LEXED_LINE *lexed_line, int *dc, boolean encode);
 
 /**
  * Get the data instruction number machine codes
- * If the data is invalid this function prints the error and return null
- * This also updates the string with the new address
- * @param str_ptr Pointer to data string contains the numbers
+ * @param lexed_line The lexed data line
  * @param dc The dc counter
- * @param line_number The data instructions line number
+ * @param encode Should we build the machine codes strings (FALSE only counts the words)
  * @return The data instruction machine code
  */
-INSTRUCTION_BINARY_LINE *get_data_machine_codes(char **str_ptr, int *dc, int line_number);
+INSTRUCTION_BINARY_LINE *get_data_machine_codes(const LEXED_LINE *lexed_line, int *dc, boolean encode);
 
 /**
  * This function get pointer to string, and skip all spaces and tabs
@@ -443,32 +1014,24 @@ INSTRUCTION_BINARY_LINE *get_data_machine_codes(char **str_ptr, int *dc, int lin
 void skip_empty_spaces(char **str);
 
 /**
- * This function copy to new string the current symbol or command
- * IF it is invalid, null will be returned
+ * This function finds the current symbol or command
+ * IF it is invalid, empty slice will be returned
  * @param str_ptr The string contains the command or symbol
  * @param line_mumber The line number of the command / symbol
- * @return The new string ot symbole
+ * @param diagnostics The diagnostics sink
+ * @return The command or symbol slice inside the string
  */
-char *coppy_next_command_or_symbol(char **str_ptr, int line_mumber);
+TOKEN_SLICE coppy_next_command_or_symbol(char **str_ptr, int line_mumber, DIAGNOSTICS *diagnostics);
 
 /**
- * Calculate the operands binary codes
- * If it finds invalid operand will return null
- * @param operand The operand as string
+ * Calculate the operand binary codes
+ * @param operand The lexed operand
  * @param ic The ic counter
- * @param operand_type The operand type
  * @param line_number The line which the operand exist
+ * @param encode Should we build the machine codes strings (FALSE only counts the words)
  * @return Tables of the binaries operands
  */
-COMMAND_BINARY_LINE *extract_operand_binary(char *operand, int *ic, OPERAND_TYPE operand_type, int line_number);
-
-/**
- * This function gets pointer to mat instruction,
- * It will return the mat symbol
- * @param input Pointer to the matb instruction
- * @return The mat symbol
- */
-char *extract_mat_symbol(char **input);
+COMMAND_BINARY_LINE *extract_operand_binary(const LEXED_OPERAND *operand, int *ic, int line_number, boolean encode);
 
 /* Base4 chars */
 static const char BASE_4_CHARS[] = {'a', 'b', 'c', 'd'};
@@ -489,7 +1052,124 @@ char *decimal_to_base4(int value);
  */
 char *binary_to_base4(char *binary_str);
 
+/**
+ * This function writes even binary number length as base4 into existing buffer (with \0)
+ * @param base4 The buffer to write to (with at least length / 2 + 1 chars)
+ * @param binary_str The binary string (in even length, doesn't have to end with \0)
+ * @param binary_length The binary length
+ */
+void write_binary_as_base4(char *base4, const char *binary_str, int binary_length);
+
+/**
+ * This function appends positive decimal number as base4 to the output buffer
+ * It writes the same base4 as decimal_to_base4 (without allocating it)
+ * @param buffer The output buffer
+ * @param value The decimal number
+ */
+void append_base4_number(OUTPUT_BUFFER *buffer, int value);
+
+/* Batch io */
+/* Number of sources which the batch io reads ahead */
+#define BATCH_IO_DEPTH 16
+/* Files which we write for each source (.am, .ob, .ent and .ext) */
+#define BATCH_IO_WRITES_PER_SOURCE 4
+
+/* Reads the next sources and writes the outputs in the background (with io_uring when the kernel supports it) */
+typedef struct BATCH_IO BATCH_IO;
+
+/* Source which the batch io read */
+typedef struct BATCH_SOURCE {
+    /* The source text (ends with \0) */
+    char *data;
+    unsigned long length;
+
+    /* Did we find (and read) the source file */
+    boolean found;
+} BATCH_SOURCE;
+
+/* The sources are defined with the command line options */
+struct ASSEMBLER_INPUT;
+
+/**
+ * This function creates new batch io for the inputs, and starts to read the first sources
+ * It uses io_uring if the kernel supports it, otherwise it reads and writes the files directly
+ * @param inputs The sources to assembly (in order)
+ * @param inputs_count The number of sources
+ * @param depth The number of sources to read ahead
+ * @return The new batch io
+ */
+BATCH_IO *create_batch_io(struct ASSEMBLER_INPUT *inputs, int inputs_count, int depth);
+
+/**
+ * This function waits until the source of the input was read
+ * @param batch_io The batch io
+ * @param index The input index (the inputs are assembled in order)
+ * @return The source (null for the stdin source, which the pre assembler reads itself)
+ */
+BATCH_SOURCE *wait_batch_source(BATCH_IO *batch_io, int index);
+
+/**
+ * This function frees the source of the input, and starts to read the next source in its slot
+ * @param batch_io The batch io
+ * @param index The input index
+ */
+void release_batch_source(BATCH_IO *batch_io, int index);
+
+/**
+ * This function creates (or truncates) output file for batch write
+ * @param batch_io The batch io
+ * @param file_name The file name
+ * @return The file descriptor (-1 if we failed to create the file)
+ */
+int open_batch_output(BATCH_IO *batch_io, const char *file_name);
+
+/**
+ * This function writes the output buffer to the file in the background
+ * The batch io takes the buffer text (the buffer stays empty) and closes the file when it is written
+ * @param batch_io The batch io
+ * @param fd The file descriptor (from open_batch_output)
+ * @param buffer The output buffer
+ */
+void submit_batch_write(BATCH_IO *batch_io, int fd, OUTPUT_BUFFER *buffer);
+
+/**
+ * This function waits until all the outputs are written, and frees the batch io
+ * @param batch_io The batch io
+ */
+void finish_batch_io(BATCH_IO *batch_io);
+
 /* Assemblers */
+/* Where the pre assembler reads the source lines from (file or memory) */
+typedef struct SOURCE_READER {
+    /* The source file (NULL if we read from memory) */
+    FILE *file;
+
+    /* The source text in memory, and the end of the text */
+    const char *buffer;
+    const char *buffer_end;
+} SOURCE_READER;
+
+/**
+ * This function reads the next source line (like fgets, the line ends with \n unless it is too long or the last one)
+ * @param reader The source reader
+ * @param line The buffer for the line
+ * @param size The buffer size (the line has at most size - 1 chars)
+ * @return The line, or null if there are no more lines
+ */
+char *read_source_line(SOURCE_READER *reader, char *line, int size);
+
+/**
+ * This function is the pre assembler of source from any reader
+ * It saves the macros and expands the lines for the first assembler (see pre_assembler)
+ * If the tables already have lexed source (e.g. the same document after an edit) its lexed lines are used again
+ * @param reader The source reader
+ * @param expanded_source The buffer for the .am file content (the expanded lines, Can be null)
+ * @param assembler_tables All Assembler tables (include the macro itself)
+ * @return The status code of the pre assembler action
+ */
+STATUS_CODE pre_assemble_source(SOURCE_READER *reader, OUTPUT_BUFFER *expanded_source,
+                                ASSEMBLER_TABLES *assembler_tables);
+
 /**
  * This function is the pre assembler
  * It only saves all the macros and when it seems it in the code it replaces it with the actual macro
@@ -503,11 +1183,15 @@ char *binary_to_base4(char *binary_str);
  * It will be replaced with:
  * prn AS
  * stop
- * @param filename The assembler file name
+ * @param filename The assembler file name (- reads the source from stdin)
+ * @param output_name The .am file name (without the extension)
+ * @param source The source which the batch io already read (null to read the file here)
+ * @param batch_io The batch io to write the .am file with (null to write it here)
  * @param assembler_tables All Assembler tables (include the macro itself)
  * @return The status code of the pre assembler action
  */
-STATUS_CODE pre_assembler(char *filename, ASSEMBLER_TABLES *assembler_tables);
+STATUS_CODE pre_assembler(char *filename, char *output_name, BATCH_SOURCE *source, BATCH_IO *batch_io,
+                          ASSEMBLER_TABLES *assembler_tables);
 
 
 /**
@@ -515,28 +1199,30 @@ STATUS_CODE pre_assembler(char *filename, ASSEMBLER_TABLES *assembler_tables);
  * for rxample it doesn't save word
  * @param macro_name
  * @param line_number
+ * @param diagnostics The diagnostics sink
  * @return Is the macro valid
  */
-boolean validate_macro_name(char *macro_name, int line_number);
+boolean validate_macro_name(char *macro_name, int line_number, DIAGNOSTICS *diagnostics);
 
 /**
  * This funvtion get line contains macro, and return its name
  * @param line Pointer to macro line
  * @param line_number The line number of the macro
+ * @param diagnostics The diagnostics sink
  * @return Teh macro name
  */
-char *extract_macro_name(char **line, int line_number);
+char *extract_macro_name(char **line, int line_number, DIAGNOSTICS *diagnostics);
 
 /**
  * The first assembler!
  * In this assembler we create commands, instructions, entries, external abd symbol table
  * Notice we don't insert all address, because we will know them only in the second assembler
  * After we calculate all symbols
- * @param filename The assembler file name
+ * It reads the lexed source lines of the pre assembler (and not the .am file)
  * @param assembler_tables All Assembler tables (include the macro itself)
  * @return The status code of the pre assembler action
  */
-STATUS_CODE first_assembler(char *filename, ASSEMBLER_TABLES *assembler_tables);
+STATUS_CODE first_assembler(ASSEMBLER_TABLES *assembler_tables);
 
 /**
  * In the second assembly we mainly do three things:
@@ -558,13 +1244,166 @@ STATUS_CODE second_assembler(ASSEMBLER_TABLES *assembler_tables);
  */
 boolean is_valid_operand_type(OPERAND_TYPE type, const COMMAND_INFO *command_info, int opernad_order);
 
+/**
+ * This function builds the content of all assembler files in memory
+ * Include object, external and entry (entry and external stay empty if there are no entries / externals)
+ * @param assembler_tables The assembler tables
+ * @param object The output buffer for the object file
+ * @param entries The output buffer for the entry file
+ * @param externals The output buffer for the external file
+ */
+void build_assembler_images(ASSEMBLER_TABLES *assembler_tables, OUTPUT_BUFFER *object, OUTPUT_BUFFER *entries,
+                            OUTPUT_BUFFER *externals);
+
 /**
  * This function writes all assembler files
- * Include object, external and entry
+ * Include object, external and entry (and removes the old entry and external files if there are none)
+ * In binary object mode it writes only the binary object (.bo) file
+ * Each mode removes the outputs of the other mode left by earlier assembly
+ * The line table (.lin) is written in both modes (with --line-table)
  * @param filename The filename of the assembly file
  * @param assembler_tables The assembler tables
+ * @param batch_io The batch io to write the files with (null to write them here)
+ */
+void write_assembler_files(char *filename, ASSEMBLER_TABLES *assembler_tables, BATCH_IO *batch_io);
+
+/**
+ * This function writes all assembler outputs to a stream (e.g. stdout)
+ * In bundle mode each output starts with a frame header (name, extension and length), like:
+ * input.ob 42
+ * Otherwise only the object is written
+ * @param name The name of the outputs (the assembly file name)
+ * @param assembler_tables The assembler tables
+ * @param bundle Should we write all the outputs with frame headers
+ * @param output The output stream
+ */
+void write_assembler_stream(char *name, ASSEMBLER_TABLES *assembler_tables, boolean bundle, FILE *output);
+
+/* Archive */
+/* One archive file with all the outputs of many sources:
+ * Header - the magic and the number of entries
+ * Table - for each entry (source) the offset and length of its name, object, entries and externals blobs, sorted by
+ * the entries names (so member is found with binary search)
+ * Blobs - all the names and members one after another (member with length 0 doesn't exist)
+ * All the numbers are ARCHIVE_FIELD_SIZE bytes little endian
+ */
+#define ARCHIVE_MAGIC "ASMARC02"
+#define ARCHIVE_MAGIC_SIZE 8
+#define ARCHIVE_FIELD_SIZE 8
+#define ARCHIVE_HEADER_SIZE (ARCHIVE_MAGIC_SIZE + ARCHIVE_FIELD_SIZE)
+#define ARCHIVE_MEMBERS_COUNT 3
+/* The archive extract tool copies the members in parts of this size */
+#define ARCHIVE_COPY_BUFFER_SIZE 4096
+/* Offset and length for the name and for each member */
+#define ARCHIVE_ENTRY_SIZE ((ARCHIVE_MEMBERS_COUNT + 1) * 2 * ARCHIVE_FIELD_SIZE)
+
+/* The blobs of each archive entry */
+typedef enum {
+    ARCHIVE_MEMBER_NAME = -1,
+    ARCHIVE_MEMBER_OBJECT,
+    ARCHIVE_MEMBER_ENTRIES,
+    ARCHIVE_MEMBER_EXTERNALS
+} ARCHIVE_MEMBER;
+
+typedef struct ARCHIVE_WRITER {
+    FILE *file;
+    /* The table (it is written when we close the archive) */
+    unsigned char *table;
+    /* The entries names (the table is sorted by them when we close the archive), and the offset of each one */
+    OUTPUT_BUFFER names;
+    int *name_offsets;
+    unsigned long entries_count;
+    unsigned long next_entry;
+    /* The offset of the next blob */
+    unsigned long offset;
+} ARCHIVE_WRITER;
+
+typedef struct ARCHIVE_READER {
+    FILE *file;
+    unsigned char *table;
+    unsigned long entries_count;
+} ARCHIVE_READER;
+
+/**
+ * This function creates new archive for known number of entries
+ * The blobs are written while we add the entries, and the header and the table when we close the archive
+ * If it fails to create the file it exits the program
+ * @param path The archive path
+ * @param entries_count The number of entries (one for each source)
+ * @return The archive writer
+ */
+ARCHIVE_WRITER *create_archive_writer(const char *path, unsigned long entries_count);
+
+/**
+ * This function adds the next entry to the archive
+ * If it fails to write the blobs it exits the program
+ * @param archive The archive writer
+ * @param name The entry name (the outputs name of the source)
+ * @param members The members of the entry (object, entries and externals, null or empty if they don't exist)
+ */
+void add_archive_entry(ARCHIVE_WRITER *archive, const char *name, OUTPUT_BUFFER *members);
+
+/**
+ * This function writes the archive header and table, and closes the archive
+ * The table is sorted by the entries names, so the reader finds entry with binary search
+ * If it fails to write the file it exits the program
+ * @param archive The archive writer
+ */
+void close_archive_writer(ARCHIVE_WRITER *archive);
+
+/**
+ * This function opens archive for reading (it reads the header and the table)
+ * The entries count and the blobs are checked against the file length (so broken archive isn't read outside it)
+ * @param path The archive path
+ * @return The archive reader, or null if we can't open the file or it is not an archive
+ */
+ARCHIVE_READER *open_archive_reader(const char *path);
+
+/**
+ * This function gets the offset and length of archive blob
+ * @param archive The archive reader
+ * @param index The entry index
+ * @param member The member index (ARCHIVE_MEMBER_NAME for the entry name)
+ * @param offset The blob offset to update
+ * @param length The blob length to update (0 if the member doesn't exist)
+ */
+void get_archive_blob(ARCHIVE_READER *archive, unsigned long index, int member, unsigned long *offset,
+                      unsigned long *length);
+
+/**
+ * This function reads the name of archive entry
+ * @param archive The archive reader
+ * @param index The entry index
+ * @return The new entry name (or null if the archive is broken)
+ */
+char *read_archive_entry_name(ARCHIVE_READER *archive, unsigned long index);
+
+/**
+ * This function finds archive member by its file name (entry name and extension, e.g. input.ob)
+ * The table is sorted by the entries names, so it reads only the names of the binary search (the first entry is
+ * found if some entries have the same name)
+ * @param archive The archive reader
+ * @param member_name The member file name
+ * @param offset The member offset to update
+ * @param length The member length to update
+ * @return The status code (ERROR if there is no such member)
  */
-void write_assembler_files(char *filename, ASSEMBLER_TABLES *assembler_tables);
+STATUS_CODE find_archive_member(ARCHIVE_READER *archive, const char *member_name, unsigned long *offset,
+                                unsigned long *length);
+
+/**
+ * This function closes the archive reader
+ * @param archive The archive reader
+ */
+void close_archive_reader(ARCHIVE_READER *archive);
+
+/**
+ * This function adds all assembler outputs of one source to the archive
+ * @param name The name of the outputs (the assembly file name)
+ * @param assembler_tables The assembler tables (null if the source failed, so the entry has no members)
+ * @param archive The archive writer
+ */
+void write_assembler_archive_entry(char *name, ASSEMBLER_TABLES *assembler_tables, ARCHIVE_WRITER *archive);
 
 /**
  * This function return the length until the next space or tab
@@ -572,3 +1411,780 @@ void write_assembler_files(char *filename, ASSEMBLER_TABLES *assembler_tables);
  * @return The word length
  */
 int get_word_length_until_space(char *str);
+
+/* Binary object */
+/* The object, entries and externals in one binary file (instead of the base4 text files):
+ * Header - the magic and OBJECT_HEADER_FIELDS_COUNT fields (see OBJECT_HEADER_FIELD)
+ * Words - all the words (code and then data) from the base address, OBJECT_WORD_SIZE bytes each
+ * Entries / externals - for each symbol the offset of its name (in the names) and its address
+ * Names - all the symbols names, each one ends with \0
+ * All the numbers are little endian, and each section starts in OBJECT_ALIGNMENT, so the file can be mapped and
+ * read in place
+ */
+#define OBJECT_MAGIC "ASMOBJ01"
+#define OBJECT_MAGIC_SIZE 8
+#define OBJECT_FIELD_SIZE 4
+#define OBJECT_WORD_SIZE 2
+#define OBJECT_ALIGNMENT OBJECT_FIELD_SIZE
+#define OBJECT_SYMBOL_SIZE (2 * OBJECT_FIELD_SIZE)
+#define OBJECT_HEADER_SIZE (OBJECT_MAGIC_SIZE + OBJECT_HEADER_FIELDS_COUNT * OBJECT_FIELD_SIZE)
+/* The length of word in the text object (each base4 char holds 2 bits) */
+#define OBJECT_TEXT_WORD_LENGTH (ADDRESS_SIZE / 2)
+/* The value of char which is not base4 in the base4 values table (a bit which the base4 values don't have) */
+#define OBJECT_NOT_BASE4 4
+
+/* The fields of the binary object header (in their order) */
+typedef enum {
+    OBJECT_BASE_ADDRESS,
+    OBJECT_CODE_LENGTH,
+    OBJECT_DATA_LENGTH,
+    OBJECT_ENTRIES_COUNT,
+    OBJECT_EXTERNALS_COUNT,
+    OBJECT_WORDS_OFFSET,
+    OBJECT_ENTRIES_OFFSET,
+    OBJECT_EXTERNALS_OFFSET,
+    OBJECT_NAMES_OFFSET,
+    OBJECT_NAMES_LENGTH,
+    OBJECT_HEADER_FIELDS_COUNT
+} OBJECT_HEADER_FIELD;
+
+/* Entry or external of the object */
+typedef struct OBJECT_SYMBOL {
+    /* The name (inside the image names) */
+    char *name;
+    int address;
+} OBJECT_SYMBOL;
+
+/* The object, entries and externals of one source as arrays */
+typedef struct OBJECT_IMAGE {
+    /* The address of the first word (the code starts there, and the data is right after it) */
+    int base_address;
+    int code_length;
+    int data_length;
+
+    /* All the words (code_length + data_length), ADDRESS_SIZE bits each */
+    unsigned short *words;
+
+    OBJECT_SYMBOL *entries;
+    int entries_count;
+    OBJECT_SYMBOL *externals;
+    int externals_count;
+
+    /* All the symbols names one after another (each one ends with \0) */
+    char *names;
+    int names_length;
+} OBJECT_IMAGE;
+
+/**
+ * This function builds the object image from the assembler tables (after successful assembly)
+ * @param assembler_tables The assembler tables
+ * @param image The image to init
+ */
+void build_object_image(ASSEMBLER_TABLES *assembler_tables, OBJECT_IMAGE *image);
+
+/**
+ * This function writes the image as binary object
+ * @param image The image
+ * @param buffer The output buffer to append to
+ */
+void build_binary_object(const OBJECT_IMAGE *image, OUTPUT_BUFFER *buffer);
+
+/**
+ * This function reads binary object into image
+ * @param data The binary object content
+ * @param length The content length
+ * @param image The image to init
+ * @return The status code (ERROR if it is not binary object, or it is broken)
+ */
+STATUS_CODE read_binary_object(const char *data, unsigned long length, OBJECT_IMAGE *image);
+
+/**
+ * This function writes the image as base4 text (exactly like the assembler writes the .ob, .ent and .ext files)
+ * @param image The image
+ * @param object The output buffer for the object file
+ * @param entries The output buffer for the entry file
+ * @param externals The output buffer for the external file
+ */
+void build_text_object(const OBJECT_IMAGE *image, OUTPUT_BUFFER *object, OUTPUT_BUFFER *entries,
+                       OUTPUT_BUFFER *externals);
+
+/**
+ * This function reads base4 text object (the .ob, .ent and .ext contents) into image
+ * It parses the exact layout of write_assembler_files in one pass (each char is decoded with one lookup), and it
+ * allocates only the image arrays (never for each line)
+ * @param object The object content
+ * @param object_length The object length
+ * @param entries The entries content (null if there are no entries)
+ * @param entries_length The entries length
+ * @param externals The externals content (null if there are no externals)
+ * @param externals_length The externals length
+ * @param image The image to init
+ * @return The status code (ERROR if the text is broken)
+ */
+STATUS_CODE read_text_object(const char *object, unsigned long object_length, const char *entries,
+                             unsigned long entries_length, const char *externals, unsigned long externals_length,
+                             OBJECT_IMAGE *image);
+
+/**
+ * This function loads the outputs of the assembler into image
+ * The base4 text outputs are name.ob, and name.ent / name.ext if they exist (the binary object is name.bo)
+ * @param name The outputs name (without extension)
+ * @param binary Load the binary object (and not the base4 text outputs)
+ * @param image The image to init
+ * @return The status code (ERROR if we can't read the object, or it is broken)
+ */
+STATUS_CODE load_object_files(char *name, boolean binary, OBJECT_IMAGE *image);
+
+/**
+ * This function frees the image arrays
+ * @param image The image
+ */
+void free_object_image(OBJECT_IMAGE *image);
+
+/* Disassembler */
+#define DISASSEMBLER_ENTRY_DIRECTIVE ".entry "
+#define DISASSEMBLER_EXTERN_DIRECTIVE ".extern "
+#define DISASSEMBLER_DATA_DIRECTIVE ".data "
+#define DISASSEMBLER_DATA_WORDS_PER_LINE 8
+/* The labels of the symbols without names are the prefix and their address (e.g. L112) */
+#define DISASSEMBLER_LABEL_PREFIX 'L'
+#define DISASSEMBLER_LABEL_MAX_LENGTH MAX_SYMBOL_LENGTH
+/* The label of word which has no label, and of word which can't have label (it is not the first word of line) */
+#define DISASSEMBLER_NO_LABEL (-1)
+#define DISASSEMBLER_NOT_LINE (-2)
+/* Sign and the digits of int */
+#define DISASSEMBLER_NUMBER_MAX_LENGTH 11
+#define DISASSEMBLER_COMMENT_MAX_LENGTH 64
+
+/**
+ * This function disassemblies the object image back into assembly source
+ * Each first word is decoded with one lookup in command_decodes, and its operands words are decoded like the
+ * assembler encodes them (symbols are the externals names, entries names, or labels which are created from their
+ * addresses)
+ * Words which are not valid commands are written as comments
+ * The commands tables must be built already (see init_commands_tables)
+ * @param image The image
+ * @param source The source to append to
+ */
+void disassemble_object(const OBJECT_IMAGE *image, OUTPUT_BUFFER *source);
+
+/* Emulator */
+/* The machine has word for each address of symbol word (the symbol words keep SYMBOL_BITS_LENGTH bits) */
+#define EMULATOR_MEMORY_SIZE (1 << SYMBOL_BITS_LENGTH)
+#define EMULATOR_ADDRESS_MASK (EMULATOR_MEMORY_SIZE - 1)
+#define EMULATOR_REGISTRIES_COUNT (MAX_REGISTRY_NUMBER + 1)
+/* Max depth of jsr (the return addresses stack isn't part of the memory) */
+#define EMULATOR_STACK_SIZE 256
+/* The most words of one command (the first word, and two mats operands) */
+#define EMULATOR_MAX_COMMAND_WORDS 5
+/* The value which red reads at the end of the input */
+#define EMULATOR_END_OF_INPUT (-1)
+
+/* The handler of predecoded instruction (the commands handlers are the commands numbers) */
+typedef enum {
+    EMULATOR_MOV_HANDLER,
+    EMULATOR_CMP_HANDLER,
+    EMULATOR_ADD_HANDLER,
+    EMULATOR_SUB_HANDLER,
+    EMULATOR_LEA_HANDLER,
+    EMULATOR_CLR_HANDLER,
+    EMULATOR_NOT_HANDLER,
+    EMULATOR_INC_HANDLER,
+    EMULATOR_DEC_HANDLER,
+    EMULATOR_JMP_HANDLER,
+    EMULATOR_BNE_HANDLER,
+    EMULATOR_JSR_HANDLER,
+    EMULATOR_RED_HANDLER,
+    EMULATOR_PRN_HANDLER,
+    EMULATOR_RTS_HANDLER,
+    EMULATOR_STOP_HANDLER,
+    /* The memory of the instruction changed, so it must be decoded again */
+    EMULATOR_DECODE_HANDLER,
+    /* The word is not valid command */
+    EMULATOR_INVALID_HANDLER,
+    /* The command uses external symbol (the object isn't linked, so it has no address) */
+    EMULATOR_EXTERNAL_HANDLER
+} EMULATOR_HANDLER;
+
+/* Why the emulator stopped */
+typedef enum {
+    EMULATOR_RUNNING,
+    EMULATOR_STOPPED,
+    EMULATOR_INVALID_COMMAND,
+    EMULATOR_EXTERNAL_SYMBOL,
+    EMULATOR_STACK_OVERFLOW,
+    EMULATOR_STACK_UNDERFLOW,
+    EMULATOR_STEPS_LIMIT
+} EMULATOR_STATUS;
+
+/* Predecoded operand */
+typedef struct {
+    /* The operand type (OPERAND_TYPE, UNDEFINED if the command doesn't have this operand) */
+    unsigned char type;
+    /* The registry (REGISTRY), or the row and column registries (MAT) */
+    unsigned char registries[2];
+    /* The number word (SIMPLE), or the address (SYMBOL and MAT) */
+    unsigned short value;
+} EMULATOR_OPERAND;
+
+/* Predecoded command (the instruction of each address is decoded once, until its memory changes) */
+typedef struct {
+    /* The handler (EMULATOR_HANDLER) */
+    unsigned char handler;
+    unsigned char words_count;
+    /* The source and destination operands (one operand commands have only destination) */
+    EMULATOR_OPERAND operands[2];
+} EMULATOR_INSTRUCTION;
+
+/* The commands which ran in each address (with the profiler)
+ * The cycles of a command are its words, and one more for each memory operand it reads or writes */
+typedef struct EMULATOR_PROFILE {
+    unsigned long counts[EMULATOR_MEMORY_SIZE];
+    unsigned long cycles[EMULATOR_MEMORY_SIZE];
+} EMULATOR_PROFILE;
+
+/* The machine of the commands array:
+ * The words and the registries are ADDRESS_SIZE bits, and the numbers are two's complement
+ * cmp sets the zero flag (bne jumps if it isn't set), and the other commands don't change it
+ * The mat element is in the mat address + the row registry + the column registry (the object doesn't keep the mat
+ * columns, so the program adds the row offset to the row registry)
+ * red reads one char (EMULATOR_END_OF_INPUT at the end), and prn prints the number in its own line
+ */
+typedef struct EMULATOR {
+    unsigned short memory[EMULATOR_MEMORY_SIZE];
+    unsigned short registries[EMULATOR_REGISTRIES_COUNT];
+    boolean zero_flag;
+
+    /* The instruction of each address */
+    EMULATOR_INSTRUCTION instructions[EMULATOR_MEMORY_SIZE];
+
+    /* The address of the next command */
+    int pc;
+
+    /* The return addresses of jsr */
+    int stack[EMULATOR_STACK_SIZE];
+    int stack_size;
+
+    /* Number of commands we ran */
+    long steps;
+
+    /* The address of the last memory word which changed (-1 if none), so the JIT knows if its code changed */
+    int changed_address;
+
+    /* Where red reads and prn writes */
+    FILE *input;
+    FILE *output;
+
+    /* Counts the commands which ran (null if we don't profile the program) */
+    EMULATOR_PROFILE *profile;
+
+    EMULATOR_STATUS status;
+} EMULATOR;
+
+/**
+ * This function loads the image into the emulator memory, and predecodes the instruction of each address
+ * The program starts in the image base address
+ * The commands tables must be built already (see init_commands_tables)
+ * @param emulator The emulator to init
+ * @param image The image
+ * @param input Where red reads from
+ * @param output Where prn writes to
+ * @return The status code (ERROR if the image doesn't fit the memory)
+ */
+STATUS_CODE init_emulator(EMULATOR *emulator, const OBJECT_IMAGE *image, FILE *input, FILE *output);
+
+/**
+ * This function predecodes the instruction of the address from the current memory
+ * The commands tables must be built already (see init_commands_tables)
+ * @param emulator The emulator
+ * @param address The address of the first word
+ */
+void decode_emulator_instruction(EMULATOR *emulator, int address);
+
+/**
+ * This function runs the emulator until the program stops (stop, or a command it can't run)
+ * @param emulator The emulator
+ * @param max_steps Stop after this number of commands (0 means no limit)
+ * @return Why the emulator stopped (EMULATOR_STOPPED after stop)
+ */
+EMULATOR_STATUS run_emulator(EMULATOR *emulator, long max_steps);
+
+/**
+ * This function returns the message of the emulator status
+ * @param status The status
+ * @return The message
+ */
+const char *get_emulator_status_message(EMULATOR_STATUS status);
+
+/**
+ * This function runs the program of the image, and prints why it failed (if it didn't stop with stop)
+ * @param name The program name (for the messages)
+ * @param image The image
+ * @param use_jit Run the program with the JIT (if the system can't run native code, we run the emulator)
+ * @param profile The profile to count the commands in (null if we don't profile, the profiler runs the emulator)
+ * @param input Where red reads from
+ * @param output Where prn writes to
+ * @param messages Where to print the failure
+ * @return The status code (ERROR if the program failed)
+ */
+STATUS_CODE run_object_image(const char *name, const OBJECT_IMAGE *image, boolean use_jit, EMULATOR_PROFILE *profile,
+                             FILE *input, FILE *output, FILE *messages);
+
+/* JIT */
+/* The native code of all the blocks (when it is full, we drop all the blocks and translate them again) */
+#define JIT_CODE_SIZE (1 << 20)
+/* Max commands in one block */
+#define JIT_MAX_BLOCK_COMMANDS 64
+/* The most native code of one command (and of the exit after the last command) */
+#define JIT_MAX_COMMAND_CODE 128
+#define JIT_MAX_BLOCK_CODE ((JIT_MAX_BLOCK_COMMANDS + 1) * JIT_MAX_COMMAND_CODE)
+/* The native code returns the next address, and the exit reason in the bits above it */
+#define JIT_EXIT_REASON_SHIFT SYMBOL_BITS_LENGTH
+/* The JIT test runs random programs (or the given objects) with the emulator and with the JIT, and compares them */
+#define JIT_TEST_PROGRAMS_COUNT 20000
+#define JIT_TEST_BASE_ADDRESS IC_COUNTER_DEFAULT_VALUE
+#define JIT_TEST_MIN_CODE_LENGTH 100
+#define JIT_TEST_STEPS_LIMIT 100000
+#define JIT_TEST_SHORT_STEPS_LIMIT 500
+#define JIT_TEST_INPUT "hello world"
+#define JIT_TEST_NAME_MAX_LENGTH 32
+/* Print only the first mismatches */
+#define JIT_TEST_MAX_REPORTS 12
+
+/* Why the native code returned */
+typedef enum {
+    /* Run the block of the next address */
+    JIT_EXIT_NEXT_BLOCK,
+    /* Run the command of the next address with the emulator (it has no native code) */
+    JIT_EXIT_INTERPRET,
+    /* The native code changed a word of translated command, so all the blocks must be translated again */
+    JIT_EXIT_CODE_CHANGED,
+    /* We are near the steps limit (the emulator runs the last commands) */
+    JIT_EXIT_STEPS_LIMIT
+} JIT_EXIT_REASON;
+
+/* Translates the commands to x86-64 code (each block is the commands from one address until a jump) */
+typedef struct JIT JIT;
+
+/**
+ * This function creates JIT with empty code
+ * The code is never writable and executable together (it is writable only while we translate block)
+ * @return The JIT (null if the system can't run the native code, so we should run the emulator)
+ */
+JIT *create_jit(void);
+
+/**
+ * This function runs the emulator program with the JIT until it stops (like run_emulator)
+ * Each block is translated once (in the first time we get to its address), and the blocks jump to each other
+ * without returning. The registries stay in host registries inside the native code
+ * The commands without native code (red, prn, stop and the commands we can't run) run with the emulator
+ * The steps limit is checked in the jumps (a block before it), and the emulator runs the last commands
+ * @param jit The JIT
+ * @param emulator The emulator (after init_emulator)
+ * @param max_steps Stop after this number of commands (0 means no limit)
+ * @return Why the program stopped (EMULATOR_STOPPED after stop)
+ */
+EMULATOR_STATUS run_jit(JIT *jit, EMULATOR *emulator, long max_steps);
+
+/**
+ * This function frees the JIT and its code
+ * @param jit The JIT
+ */
+void free_jit(JIT *jit);
+
+/* Profiler */
+/* The line table file has line for each code word: <address> <line> <label> <macro>
+ * The line is in the source (before the macros were expanded), the label is the last code label before the word, and
+ * the macro is the macro which the line came from (LINE_TABLE_NO_NAME_TEXT if there is no label / macro) */
+#define LINE_TABLE_FILE_EXTENSION ".lin"
+#define LINE_TABLE_NO_NAME_TEXT "-"
+#define LINE_TABLE_LINE_MAX_LENGTH (2 * LINE_MAX_LENGTH)
+#define LINE_TABLE_DEFAULT_CAPACITY 64
+/* The name offset of word without label / macro */
+#define LINE_TABLE_NO_NAME (-1)
+
+/* The hotspots report, and the stacks for flame graph tools (each line is the frames and the cycles) */
+#define PROFILE_FILE_EXTENSION ".prof"
+#define FOLDED_STACKS_FILE_EXTENSION ".folded"
+#define PROFILE_FRAME_SEPARATOR ";"
+#define PROFILE_NUMBER_MAX_LENGTH 64
+#define PROFILE_REPORT_TITLE "Profile of "
+#define PROFILE_LINES_TITLE "Lines:\n"
+#define PROFILE_LABELS_TITLE "Labels:\n"
+#define PROFILE_MACROS_TITLE "Macros:\n"
+#define PROFILE_ADDRESSES_TITLE "Addresses:\n"
+/* The report columns after the numbers (the line / address, and the label) */
+#define PROFILE_LINE_COLUMN_WIDTH 8
+#define PROFILE_NAME_COLUMN_WIDTH (MAX_SYMBOL_LENGTH + 2)
+
+/* The source of one code word */
+typedef struct LINE_TABLE_ENTRY {
+    int address;
+    int line_number;
+
+    /* The offsets of the label and the macro names inside the table names (or LINE_TABLE_NO_NAME) */
+    int label;
+    int macro;
+} LINE_TABLE_ENTRY;
+
+/* The source of all the code words (by their addresses order) */
+typedef struct LINE_TABLE {
+    LINE_TABLE_ENTRY *entries;
+    int count;
+    int capacity;
+
+    /* All the names one after another (each one ends with \0) */
+    OUTPUT_BUFFER names;
+} LINE_TABLE;
+
+/**
+ * This function initializes empty line table
+ * @param line_table The line table
+ */
+void init_line_table(LINE_TABLE *line_table);
+
+/**
+ * This function builds the line table from the assembler tables (after successful assembly)
+ * @param assembler_tables The assembler tables
+ * @param line_table The line table to init
+ */
+void build_line_table(ASSEMBLER_TABLES *assembler_tables, LINE_TABLE *line_table);
+
+/**
+ * This function writes the line table file content
+ * @param line_table The line table
+ * @param buffer The output buffer
+ */
+void build_line_table_text(const LINE_TABLE *line_table, OUTPUT_BUFFER *buffer);
+
+/**
+ * This function loads the line table file (name.lin)
+ * @param name The outputs name (without extension)
+ * @param line_table The line table to init (it is empty if we can't load it)
+ * @return The status code (ERROR if the file doesn't exist or it is broken)
+ */
+STATUS_CODE load_line_table(char *name, LINE_TABLE *line_table);
+
+/**
+ * This function frees the line table entries and names
+ * @param line_table The line table
+ */
+void free_line_table(LINE_TABLE *line_table);
+
+/**
+ * This function writes the hotspots report of the profile
+ * Each part (lines, labels, macros and addresses) is sorted by the cycles (the most expensive first)
+ * @param name The program name
+ * @param profile The profile
+ * @param line_table The line table (empty table reports only the addresses)
+ * @param report The output buffer
+ */
+void build_profile_report(const char *name, const EMULATOR_PROFILE *profile, const LINE_TABLE *line_table,
+                          OUTPUT_BUFFER *report);
+
+/**
+ * This function writes the folded stacks of the profile (program;label;macro;line cycles)
+ * @param name The program name (the root frame)
+ * @param profile The profile
+ * @param line_table The line table (without it the last frame is the address)
+ * @param stacks The output buffer
+ */
+void build_folded_stacks(const char *name, const EMULATOR_PROFILE *profile, const LINE_TABLE *line_table,
+                         OUTPUT_BUFFER *stacks);
+
+/**
+ * This function writes the profile report (name.prof) and the folded stacks (name.folded)
+ * @param name The outputs name (without extension)
+ * @param profile The profile
+ * @param line_table The line table
+ * @return The status code (ERROR if we can't write the files)
+ */
+STATUS_CODE write_profile_files(char *name, const EMULATOR_PROFILE *profile, const LINE_TABLE *line_table);
+
+/* Command line options */
+#define OPTION_PREFIX "--"
+#define CHECK_OPTION "--check"
+#define MAX_ERRORS_OPTION "--max-errors"
+#define JOBS_OPTION "--jobs"
+#define STDOUT_OPTION "--stdout"
+#define BUNDLE_OPTION "--bundle"
+#define MANIFEST_OPTION "--manifest"
+#define ARCHIVE_OPTION "--archive"
+#define ASYNC_IO_OPTION "--async-io"
+#define IF_CHANGED_OPTION "--if-changed"
+#define WATCH_OPTION "--watch"
+#define LSP_OPTION "--lsp"
+#define BINARY_OBJECT_OPTION "--binary-object"
+#define RUN_OPTION "--run"
+#define JIT_OPTION "--jit"
+#define LINE_TABLE_OPTION "--line-table"
+#define PROFILE_OPTION "--profile"
+
+/* Argument which is replaced with the arguments inside the file (e.g. @files.txt) */
+#define RESPONSE_FILE_PREFIX '@'
+/* Manifest line which is ignored */
+#define MANIFEST_COMMENT_PREFIX '#'
+#define DIRECTORY_SEPARATOR '/'
+#define OPTIONS_LIST_DEFAULT_CAPACITY 16
+#define OPTIONS_LINE_DEFAULT_CAPACITY 128
+
+/* File name which reads the source from stdin (its outputs go to stdout) */
+#define STDIN_FILE_NAME "-"
+/* The outputs name of the stdin source (in the bundle frames) */
+#define STDIN_OUTPUT_NAME "stdin"
+/* The bundle frame header (name, extension and the content length) */
+#define BUNDLE_FRAME_FORMAT "%s%s %d\n"
+
+/* One source to assembly */
+typedef struct ASSEMBLER_INPUT {
+    /* The source file name (without the .as extension) */
+    char *filename;
+    /* The outputs file name (without extension), it is the filename if there is no outputs directory */
+    char *output_name;
+} ASSEMBLER_INPUT;
+
+typedef struct ASSEMBLER_OPTIONS {
+    /* Only validate the files (no machine codes and no output files) */
+    boolean check_only;
+    /* Stop each file after this number of errors (0 means no limit) */
+    int max_errors;
+    /* Number of threads to lex each file lines with (1 means no threads) */
+    int jobs;
+    /* Where to write the output files */
+    OUTPUT_MODE output_mode;
+    /* The archive file (in archive mode) */
+    char *archive_path;
+    /* Read the next sources and write the outputs in the background (see BATCH_IO) */
+    boolean async_io;
+    /* Write only the output files whose content changed */
+    boolean write_if_changed;
+    /* After the assembly keep running, and assembly each source again when it changes (see WATCHER) */
+    boolean watch;
+    /* Run as language server (LSP over stdio) instead of assembling files */
+    boolean language_server;
+    /* Write the outputs as one binary object (see OBJECT_IMAGE) instead of the base4 .ob, .ent and .ext */
+    boolean binary_object;
+    /* After the assembly run the program of each source (see EMULATOR) */
+    boolean run;
+    /* Run the programs with the JIT (see JIT), it also sets run */
+    boolean jit;
+    /* Write the line table of each source (see LINE_TABLE) */
+    boolean line_table;
+    /* Count the commands of the programs and write the profile files, it also sets run */
+    boolean profile;
+
+    /* The sources to assembly */
+    ASSEMBLER_INPUT *inputs;
+    int inputs_count;
+    int inputs_capacity;
+} ASSEMBLER_OPTIONS;
+
+/**
+ * This function inits the options to their default values (like the command line without any option)
+ * @param options The options to init
+ */
+void init_assembler_options(ASSEMBLER_OPTIONS *options);
+
+/**
+ * This function parse the command line arguments
+ * Options can be placed anywhere, and they affect all the files
+ * All other arguments are files names (the .as extension is optional, or - to read the source from stdin)
+ * @file arguments are replaced with the arguments inside the file, and --manifest adds the sources of the manifest
+ * Reading from stdin also writes the outputs to stdout (unless we already write them in bundle or archive)
+ * Many sources on stdout are written in bundle mode (so each output has the name of its source)
+ * If we get unknown option (or stdin input more than once) it exits the program
+ * @param argc The number of arguments
+ * @param argv The arguments
+ * @param options The options to update
+ */
+void parse_assembler_options(int argc, char **argv, ASSEMBLER_OPTIONS *options);
+
+/**
+ * This function frees the options inputs (and the archive path)
+ * @param options The options to free
+ */
+void free_assembler_options(ASSEMBLER_OPTIONS *options);
+
+/* Watch */
+/* The changes which may change a source (editors save in place, or replace the file) */
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE)
+#define WATCH_CURRENT_DIRECTORY "."
+#define WATCH_EVENTS_BUFFER_SIZE 4096
+/* After the first change we wait this time for the other changes of the same save */
+#define WATCH_SETTLE_MILLISECONDS 5
+
+/* Watches the sources directories, and keeps the content of each source in its last assembly */
+typedef struct WATCHER WATCHER;
+
+/**
+ * This function creates watcher for the sources, and reads their current content
+ * If the system can't watch the files it exits the program
+ * @param inputs The sources to watch
+ * @param inputs_count The number of sources
+ * @return The new watcher
+ */
+WATCHER *create_watcher(ASSEMBLER_INPUT *inputs, int inputs_count);
+
+/**
+ * This function gets the content of the source in its last assembly
+ * @param watcher The watcher
+ * @param index The input index
+ * @return The source
+ */
+BATCH_SOURCE *get_watched_source(WATCHER *watcher, int index);
+
+/**
+ * This function waits until one of the sources changes
+ * Source which was saved without changes (the same content as in its last assembly) is ignored
+ * @param watcher The watcher
+ * @return The index of the changed source (its new content is in get_watched_source), or -1 if we failed to wait
+ */
+int wait_watched_source(WATCHER *watcher);
+
+/**
+ * This function stops watching the sources, and frees the watcher
+ * @param watcher The watcher
+ */
+void close_watcher(WATCHER *watcher);
+
+/* JSON */
+/* Max depth of arrays and objects (deeper messages are not valid) */
+#define JSON_MAX_DEPTH 64
+/* Bigger numbers are not needed (ids and positions) */
+#define JSON_MAX_NUMBER 1000000000L
+#define JSON_HEX_DIGITS 4
+#define JSON_TRUE_TEXT "true"
+#define JSON_FALSE_TEXT "false"
+#define JSON_NULL_TEXT "null"
+
+typedef enum {
+    JSON_NULL,
+    JSON_FALSE,
+    JSON_TRUE,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+} JSON_TYPE;
+
+/* One JSON value (the array items and the object members are its children) */
+typedef struct JSON_VALUE {
+    JSON_TYPE type;
+    /* The member name (only for object members) */
+    char *name;
+
+    /* JSON_STRING: the decoded string (ends with \0) */
+    char *string;
+    int string_length;
+
+    /* JSON_NUMBER: the number (without the fraction) */
+    long number;
+
+    /* The value text inside the message (e.g. to send the request id back as is) */
+    const char *text;
+    int text_length;
+
+    /* The first child, and the next value in the same array / object */
+    struct JSON_VALUE *children;
+    struct JSON_VALUE *next;
+} JSON_VALUE;
+
+/**
+ * This function parses JSON text
+ * @param text The JSON text (doesn't have to end with \0)
+ * @param length The text length
+ * @return The new value (free it with free_json_value), or null if the text is not valid JSON
+ */
+JSON_VALUE *parse_json(const char *text, int length);
+
+/**
+ * This function finds member of JSON object
+ * @param object The object (Can be null, or another type)
+ * @param name The member name
+ * @return The member value (null if there is no such member)
+ */
+JSON_VALUE *get_json_member(const JSON_VALUE *object, const char *name);
+
+/**
+ * This function appends text as JSON string (with the quotes and the escapes) to the output buffer
+ * @param buffer The output buffer
+ * @param text The text
+ * @param length The text length
+ */
+void append_json_string(OUTPUT_BUFFER *buffer, const char *text, int length);
+
+/**
+ * This function frees the JSON value and all its children
+ * @param value The value
+ */
+void free_json_value(JSON_VALUE *value);
+
+/* Language server */
+#define LSP_HEADER_MAX_LENGTH 256
+#define LSP_CONTENT_LENGTH_HEADER "Content-Length:"
+#define LSP_DIAGNOSTICS_SOURCE "assembler"
+/* The start of diagnostics notification (the document uri is next) */
+#define LSP_PUBLISH_DIAGNOSTICS_START \
+    "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":"
+/* The document cache is cleared when it has more old lines than this factor times the document lines */
+#define LSP_STALE_LINES_FACTOR 2
+/* JSON-RPC errors */
+#define LSP_PARSE_ERROR (-32700)
+#define LSP_METHOD_NOT_FOUND (-32601)
+/* LSP diagnostics severities */
+#define LSP_SEVERITY_ERROR 1
+#define LSP_SEVERITY_WARNING 2
+/* LSP positions count UTF-16 units, and UTF-8 chars from this lead byte are 2 units */
+#define UTF8_FOUR_BYTES_LEAD 0xF0
+
+/* One document which the editor opened */
+typedef struct LSP_DOCUMENT {
+    char *uri;
+    /* The current document text */
+    OUTPUT_BUFFER text;
+    /* The lexed lines of the last assembly (the next assembly lexes only new lines) */
+    LEXED_SOURCE *lexed_source;
+    struct LSP_DOCUMENT *next;
+} LSP_DOCUMENT;
+
+/**
+ * This function runs the language server (LSP over stdio) until the editor asks it to exit
+ * It keeps the lexed lines of each open document, and sends the document diagnostics after each change
+ * @param input The messages from the editor (e.g. stdin)
+ * @param output The messages to the editor (e.g. stdout)
+ * @return The exit code (0 if the editor asked to shutdown before the exit)
+ */
+int run_language_server(FILE *input, FILE *output);
+
+/* Library */
+/* The result of assembly in memory (the content of each output file, and the diagnostics) */
+typedef struct ASSEMBLER_RESULT {
+    /* OK only if the source was assembled without errors */
+    STATUS_CODE status_code;
+
+    /* The files content (empty in check mode, or if the assembly failed) */
+    OUTPUT_BUFFER object;
+    OUTPUT_BUFFER entries;
+    OUTPUT_BUFFER externals;
+
+    /* All the source diagnostics (in line order) */
+    DIAGNOSTICS *diagnostics;
+} ASSEMBLER_RESULT;
+
+/**
+ * This function assemblies source text in memory (without reading or writing any file)
+ * It doesn't use any global state, so many sources can be assembled at the same time
+ * @param source The source text (the content of .as file, doesn't have to end with \0)
+ * @param length The source length
+ * @param options The options of the assembly (max errors, check mode and jobs, null for the default options)
+ * @param result The result to update (free it with free_assembler_result)
+ * @return The status code of the assembly
+ */
+STATUS_CODE assemble_source(const char *source, int length, const ASSEMBLER_OPTIONS *options,
+                            ASSEMBLER_RESULT *result);
+
+/**
+ * This function frees the content and the diagnostics of the assembly result
+ * @param result The assembly result
+ */
+void free_assembler_result(ASSEMBLER_RESULT *result);
@@ -0,0 +1,561 @@
+/* The io_uring backend uses POSIX and Linux calls (open, mmap, syscall) */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+#include "assembler.h"
+
+
+/* One file read or write (the batch io owns its data until it is done) */
+typedef struct {
+    /* The file descriptor (-1 if the slot is free) */
+    int fd;
+
+    /* The read source (for reads the data is the source text) */
+    BATCH_SOURCE source;
+
+    /* The bytes which we already read / wrote */
+    unsigned long done;
+
+    /* The part which is in the ring now */
+    struct iovec iovec;
+
+    /* Is the request in the ring now */
+    boolean pending;
+} BATCH_IO_REQUEST;
+
+struct BATCH_IO {
+    /* The sources to read (in the order of the assembly) */
+    ASSEMBLER_INPUT *inputs;
+    int inputs_count;
+
+    /* Number of sources which we read ahead (the input i is in the read slot i % depth) */
+    int depth;
+    BATCH_IO_REQUEST *reads;
+
+    /* The outputs which we still write */
+    BATCH_IO_REQUEST *writes;
+    int writes_count;
+
+    /* Do we use the io_uring (otherwise all the reads and writes are done directly) */
+    boolean use_ring;
+
+#ifdef __linux__
+    int ring_fd;
+
+    /* The submission queue ring */
+    void *sq_ring;
+    size_t sq_ring_size;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    /* The completion queue ring (It can be the same mapping as the submission ring) */
+    void *cq_ring;
+    size_t cq_ring_size;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    /* Number of entries we added to the submission queue and didn't submit yet */
+    unsigned queued;
+#endif
+};
+
+
+/* The request kind inside the ring user data (the rest is the request slot) */
+#define BATCH_IO_WRITE_FLAG 1
+#define BATCH_IO_SLOT_SHIFT 1
+
+
+#ifdef __linux__
+/**
+ * This function creates the io_uring and maps its rings
+ * @param batch_io The batch io
+ * @param entries The number of submission queue entries
+ * @return Did we create the ring (FALSE if the kernel doesn't support it)
+ */
+static boolean setup_ring(BATCH_IO *batch_io, unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    batch_io->ring_fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+    if (batch_io->ring_fd < 0) return FALSE;
+
+    batch_io->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    batch_io->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    /* New kernels map the two rings together */
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (batch_io->cq_ring_size > batch_io->sq_ring_size) batch_io->sq_ring_size = batch_io->cq_ring_size;
+        batch_io->cq_ring_size = batch_io->sq_ring_size;
+    }
+
+    batch_io->sq_ring = mmap(NULL, batch_io->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                             batch_io->ring_fd, IORING_OFF_SQ_RING);
+    if (batch_io->sq_ring == MAP_FAILED) {
+        close(batch_io->ring_fd);
+        return FALSE;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        batch_io->cq_ring = batch_io->sq_ring;
+    } else {
+        batch_io->cq_ring = mmap(NULL, batch_io->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                 batch_io->ring_fd, IORING_OFF_CQ_RING);
+        if (batch_io->cq_ring == MAP_FAILED) {
+            munmap(batch_io->sq_ring, batch_io->sq_ring_size);
+            close(batch_io->ring_fd);
+            return FALSE;
+        }
+    }
+
+    batch_io->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    batch_io->sqes = mmap(NULL, batch_io->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          batch_io->ring_fd, IORING_OFF_SQES);
+    if (batch_io->sqes == MAP_FAILED) {
+        if (batch_io->cq_ring != batch_io->sq_ring) munmap(batch_io->cq_ring, batch_io->cq_ring_size);
+        munmap(batch_io->sq_ring, batch_io->sq_ring_size);
+        close(batch_io->ring_fd);
+        return FALSE;
+    }
+
+    batch_io->sq_tail = (unsigned *) ((char *) batch_io->sq_ring + params.sq_off.tail);
+    batch_io->sq_mask = (unsigned *) ((char *) batch_io->sq_ring + params.sq_off.ring_mask);
+    batch_io->sq_array = (unsigned *) ((char *) batch_io->sq_ring + params.sq_off.array);
+    batch_io->cq_head = (unsigned *) ((char *) batch_io->cq_ring + params.cq_off.head);
+    batch_io->cq_tail = (unsigned *) ((char *) batch_io->cq_ring + params.cq_off.tail);
+    batch_io->cq_mask = (unsigned *) ((char *) batch_io->cq_ring + params.cq_off.ring_mask);
+    batch_io->cqes = (struct io_uring_cqe *) ((char *) batch_io->cq_ring + params.cq_off.cqes);
+    batch_io->queued = 0;
+
+    return TRUE;
+}
+
+/**
+ * This function unmaps the rings and closes the io_uring
+ * @param batch_io The batch io
+ */
+static void close_ring(BATCH_IO *batch_io) {
+    munmap(batch_io->sqes, batch_io->sqes_size);
+    if (batch_io->cq_ring != batch_io->sq_ring) munmap(batch_io->cq_ring, batch_io->cq_ring_size);
+    munmap(batch_io->sq_ring, batch_io->sq_ring_size);
+    close(batch_io->ring_fd);
+}
+
+/**
+ * This function adds read / write of the rest of the request to the submission queue
+ * It is submitted in the next submit_ring
+ * @param batch_io The batch io
+ * @param request The request
+ * @param user_data The request kind and slot
+ */
+static void queue_request(BATCH_IO *batch_io, BATCH_IO_REQUEST *request, unsigned long user_data) {
+    unsigned tail = *batch_io->sq_tail;
+    unsigned index = tail & *batch_io->sq_mask;
+    struct io_uring_sqe *sqe = &batch_io->sqes[index];
+
+    request->iovec.iov_base = request->source.data + request->done;
+    request->iovec.iov_len = request->source.length - request->done;
+    request->pending = TRUE;
+
+    /* READV / WRITEV are supported by all the io_uring kernels */
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = (user_data & BATCH_IO_WRITE_FLAG) ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd = request->fd;
+    sqe->addr = (unsigned long) &request->iovec;
+    sqe->len = 1;
+    sqe->off = request->done;
+    sqe->user_data = user_data;
+
+    batch_io->sq_array[index] = index;
+
+    /* The kernel must see the entry before the new tail */
+    __sync_synchronize();
+    *batch_io->sq_tail = tail + 1;
+    __sync_synchronize();
+
+    batch_io->queued++;
+}
+
+/**
+ * This function submits all the queued requests, and waits for completions
+ * @param batch_io The batch io
+ * @param wait_count The number of completions to wait for (0 doesn't wait)
+ */
+static void submit_ring(BATCH_IO *batch_io, unsigned wait_count) {
+    long result;
+
+    if (batch_io->queued == 0 && wait_count == 0) return;
+
+    do {
+        result = syscall(__NR_io_uring_enter, batch_io->ring_fd, batch_io->queued, wait_count,
+                         wait_count > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    } while (result < 0 && errno == EINTR);
+
+    if (result < 0) {
+        perror("CRITICAL: Failed to submit file requests!");
+        exit(1);
+    }
+
+    batch_io->queued -= (unsigned) result;
+}
+
+/**
+ * This function handles the completion of one request part
+ * It queues the rest of the request if it was done only partly
+ * @param batch_io The batch io
+ * @param user_data The request kind and slot
+ * @param result The read / write result (number of bytes, or minus the error number)
+ */
+static void complete_request(BATCH_IO *batch_io, unsigned long user_data, int result) {
+    boolean is_write = (user_data & BATCH_IO_WRITE_FLAG) != 0;
+    BATCH_IO_REQUEST *request = is_write ? &batch_io->writes[user_data >> BATCH_IO_SLOT_SHIFT]
+                                         : &batch_io->reads[user_data >> BATCH_IO_SLOT_SHIFT];
+
+    request->pending = FALSE;
+
+    /* A write of zero bytes would be queued again forever, so it fails like an error */
+    if (result <= 0 && is_write) {
+        errno = result < 0 ? -result : EIO;
+        perror("CRITICAL: Failed to write output file!");
+        exit(1);
+    }
+
+    /* Failed read is like missing source */
+    if (result < 0) {
+        request->source.found = FALSE;
+    } else if (result == 0) {
+        /* The file became shorter after we checked its size */
+        request->source.length = request->done;
+    } else {
+        request->done += result;
+    }
+
+    if (request->source.found && request->done < request->source.length) {
+        queue_request(batch_io, request, user_data);
+        return;
+    }
+
+    /* The request is done */
+    close(request->fd);
+    request->fd = -1;
+
+    if (is_write) {
+        free(request->source.data);
+        request->source.data = NULL;
+    } else if (request->source.found) {
+        request->source.data[request->source.length] = END_OF_STRING;
+    }
+}
+
+/**
+ * This function waits for one completion (it submits the queued requests first) and handles it
+ * @param batch_io The batch io
+ */
+static void wait_ring_completion(BATCH_IO *batch_io) {
+    unsigned head = *batch_io->cq_head;
+    struct io_uring_cqe *cqe;
+
+    __sync_synchronize();
+    if (head == *batch_io->cq_tail) {
+        submit_ring(batch_io, 1);
+        head = *batch_io->cq_head;
+        __sync_synchronize();
+    }
+
+    cqe = &batch_io->cqes[head & *batch_io->cq_mask];
+    complete_request(batch_io, (unsigned long) cqe->user_data, cqe->res);
+
+    /* The kernel can use the entry again */
+    __sync_synchronize();
+    *batch_io->cq_head = head + 1;
+    __sync_synchronize();
+}
+#endif
+
+/**
+ * This function reads or writes the rest of the request directly (without the ring)
+ * @param request The request
+ * @param is_write Is this write request
+ */
+static void complete_request_directly(BATCH_IO_REQUEST *request, boolean is_write) {
+    long result;
+
+    while (request->source.found && request->done < request->source.length) {
+        result = is_write
+                     ? write(request->fd, request->source.data + request->done, request->source.length - request->done)
+                     : read(request->fd, request->source.data + request->done, request->source.length - request->done);
+
+        if (result < 0 && errno == EINTR) continue;
+
+        /* A write of zero bytes would leave the file short, so it fails like an error */
+        if (result <= 0 && is_write) {
+            if (result == 0) errno = EIO;
+            perror("CRITICAL: Failed to write output file!");
+            exit(1);
+        }
+
+        if (result < 0) request->source.found = FALSE;
+        else if (result == 0) request->source.length = request->done;
+        else request->done += result;
+    }
+
+    close(request->fd);
+    request->fd = -1;
+
+    if (is_write) {
+        free(request->source.data);
+        request->source.data = NULL;
+    } else if (request->source.found) {
+        request->source.data[request->source.length] = END_OF_STRING;
+    }
+}
+
+/**
+ * This function starts to read the source of the input (in its read slot)
+ * @param batch_io The batch io
+ * @param index The input index
+ */
+static void start_source_read(BATCH_IO *batch_io, int index) {
+    BATCH_IO_REQUEST *request = &batch_io->reads[index % batch_io->depth];
+    char *filename = batch_io->inputs[index].filename;
+    char *file_name_with_extension;
+    struct stat file_stat;
+
+    request->source.data = NULL;
+    request->source.length = 0;
+    request->source.found = FALSE;
+    request->done = 0;
+    request->pending = FALSE;
+    request->fd = -1;
+
+    /* The stdin source is read by the pre assembler */
+    if (strcmp(filename, STDIN_FILE_NAME) == 0) return;
+
+    file_name_with_extension = add_suffix_to_string(filename, ASSEMBLY_FILE_EXTENSION);
+    request->fd = open(file_name_with_extension, O_RDONLY);
+    free(file_name_with_extension);
+
+    if (request->fd < 0) return;
+
+    if (fstat(request->fd, &file_stat) != 0) {
+        close(request->fd);
+        request->fd = -1;
+        return;
+    }
+
+    /* +1 for \0 */
+    request->source.found = TRUE;
+    request->source.length = file_stat.st_size;
+    request->source.data = malloc(request->source.length + 1);
+    if (request->source.data == NULL) {
+        printf("CRITICAL: Failed to allocate memory for source file");
+        exit(1);
+    }
+
+#ifdef __linux__
+    if (batch_io->use_ring && request->source.length > 0) {
+        queue_request(batch_io, request, (unsigned long) (index % batch_io->depth) << BATCH_IO_SLOT_SHIFT);
+        return;
+    }
+#endif
+
+    complete_request_directly(request, FALSE);
+}
+
+/**
+ * This function creates new batch io for the inputs, and starts to read the first sources
+ * It uses io_uring if the kernel supports it, otherwise it reads and writes the files directly
+ * @param inputs The sources to assembly (in order)
+ * @param inputs_count The number of sources
+ * @param depth The number of sources to read ahead
+ * @return The new batch io
+ */
+BATCH_IO *create_batch_io(ASSEMBLER_INPUT *inputs, int inputs_count, int depth) {
+    /* For loop counter */
+    int i;
+
+    BATCH_IO *batch_io = malloc(sizeof(BATCH_IO));
+    if (batch_io == NULL) {
+        printf("CRITICAL: Failed to allocate batch io.\n");
+        exit(1);
+    }
+
+    batch_io->inputs = inputs;
+    batch_io->inputs_count = inputs_count;
+    batch_io->depth = depth;
+    batch_io->writes_count = depth * BATCH_IO_WRITES_PER_SOURCE;
+    batch_io->reads = malloc(sizeof(BATCH_IO_REQUEST) * depth);
+    batch_io->writes = malloc(sizeof(BATCH_IO_REQUEST) * batch_io->writes_count);
+    if (batch_io->reads == NULL || batch_io->writes == NULL) {
+        printf("CRITICAL: Failed to allocate batch io requests.\n");
+        exit(1);
+    }
+
+    for (i = 0; i < depth; i++) {
+        batch_io->reads[i].fd = -1;
+        batch_io->reads[i].pending = FALSE;
+        batch_io->reads[i].source.data = NULL;
+    }
+    for (i = 0; i < batch_io->writes_count; i++) {
+        batch_io->writes[i].fd = -1;
+        batch_io->writes[i].pending = FALSE;
+        batch_io->writes[i].source.data = NULL;
+    }
+
+    /* All the requests can be in the ring at the same time */
+#ifdef __linux__
+    batch_io->use_ring = setup_ring(batch_io, depth + batch_io->writes_count);
+#else
+    batch_io->use_ring = FALSE;
+#endif
+
+    for (i = 0; i < depth && i < inputs_count; i++) start_source_read(batch_io, i);
+
+#ifdef __linux__
+    if (batch_io->use_ring) submit_ring(batch_io, 0);
+#endif
+
+    return batch_io;
+}
+
+/**
+ * This function waits until the source of the input was read
+ * @param batch_io The batch io
+ * @param index The input index (the inputs are assembled in order)
+ * @return The source (null for the stdin source, which the pre assembler reads itself)
+ */
+BATCH_SOURCE *wait_batch_source(BATCH_IO *batch_io, int index) {
+    BATCH_IO_REQUEST *request = &batch_io->reads[index % batch_io->depth];
+
+    if (strcmp(batch_io->inputs[index].filename, STDIN_FILE_NAME) == 0) return NULL;
+
+#ifdef __linux__
+    while (request->pending) wait_ring_completion(batch_io);
+#endif
+
+    return &request->source;
+}
+
+/**
+ * This function frees the source of the input, and starts to read the next source in its slot
+ * @param batch_io The batch io
+ * @param index The input index
+ */
+void release_batch_source(BATCH_IO *batch_io, int index) {
+    BATCH_IO_REQUEST *request = &batch_io->reads[index % batch_io->depth];
+
+    free(request->source.data);
+    request->source.data = NULL;
+
+    if (index + batch_io->depth < batch_io->inputs_count) start_source_read(batch_io, index + batch_io->depth);
+
+    /* Let the kernel work on the new requests while we assembly the next source */
+#ifdef __linux__
+    if (batch_io->use_ring) submit_ring(batch_io, 0);
+#endif
+}
+
+/**
+ * This function creates (or truncates) output file for batch write
+ * @param batch_io The batch io
+ * @param file_name The file name
+ * @return The file descriptor (-1 if we failed to create the file)
+ */
+int open_batch_output(BATCH_IO *batch_io, const char *file_name) {
+    (void) batch_io;
+
+    return open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+}
+
+/**
+ * This function writes the output buffer to the file in the background
+ * The batch io takes the buffer text (the buffer stays empty) and closes the file when it is written
+ * @param batch_io The batch io
+ * @param fd The file descriptor (from open_batch_output)
+ * @param buffer The output buffer
+ */
+void submit_batch_write(BATCH_IO *batch_io, int fd, OUTPUT_BUFFER *buffer) {
+    /* The free write slot */
+    BATCH_IO_REQUEST *request = NULL;
+    int slot = 0;
+
+    while (request == NULL) {
+        for (slot = 0; slot < batch_io->writes_count && batch_io->writes[slot].fd >= 0; slot++);
+
+        if (slot < batch_io->writes_count) {
+            request = &batch_io->writes[slot];
+        }
+#ifdef __linux__
+        else {
+            /* All the slots are in the ring, so wait until one of them is done */
+            wait_ring_completion(batch_io);
+        }
+#endif
+    }
+
+    request->fd = fd;
+    request->source.data = buffer->data;
+    request->source.length = buffer->length;
+    request->source.found = TRUE;
+    request->done = 0;
+
+    /* The request owns the text now */
+    init_output_buffer(buffer);
+
+#ifdef __linux__
+    if (batch_io->use_ring && request->source.length > 0) {
+        queue_request(batch_io, request, ((unsigned long) slot << BATCH_IO_SLOT_SHIFT) | BATCH_IO_WRITE_FLAG);
+        return;
+    }
+#endif
+
+    complete_request_directly(request, TRUE);
+}
+
+/**
+ * This function waits until all the outputs are written, and frees the batch io
+ * @param batch_io The batch io
+ */
+void finish_batch_io(BATCH_IO *batch_io) {
+    /* For loop counter */
+    int i;
+
+#ifdef __linux__
+    if (batch_io->use_ring) {
+        for (i = 0; i < batch_io->writes_count; i++) {
+            while (batch_io->writes[i].pending) wait_ring_completion(batch_io);
+        }
+        for (i = 0; i < batch_io->depth; i++) {
+            while (batch_io->reads[i].pending) wait_ring_completion(batch_io);
+        }
+        close_ring(batch_io);
+    }
+#endif
+
+    for (i = 0; i < batch_io->depth; i++) {
+        if (batch_io->reads[i].fd >= 0) close(batch_io->reads[i].fd);
+        free(batch_io->reads[i].source.data);
+    }
+
+    free(batch_io->reads);
+    free(batch_io->writes);
+    free(batch_io);
+}
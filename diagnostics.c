@@ -0,0 +1,396 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assembler.h"
+
+/* Stringify helpers for numeric consts inside the messages formats */
+#define STRINGIFY_VALUE(value) #value
+#define STRINGIFY(value) STRINGIFY_VALUE(value)
+
+/* Details about how to print each diagnostic code */
+typedef struct {
+    const char *format;
+    DIAGNOSTIC_SEVERITY severity;
+    DIAGNOSTIC_ARGUMENT argument;
+} DIAGNOSTIC_INFO;
+
+/**
+ * Array contains all diagnostics messages (The index is the DIAGNOSTIC_CODE)
+ */
+static const DIAGNOSTIC_INFO diagnostics_info[NUMBER_OF_DIAGNOSTIC_CODES] = {
+    /* Files */
+    {"CRITICAL: Unable to find or open file %s\n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_FILE},
+    {"CRITICAL: Unable to open file %s\n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_FILE},
+
+    /* Pre assembler */
+    {"ERROR: (Line %d) line length should not be more than " STRINGIFY(LINE_MAX_LENGTH) " \n",
+     DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_NONE},
+    {"ERROR: (Line %d) Macro end should not contain spam letters\n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_NONE},
+    {"ERROR (Line %d) You must define macro name \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_NONE},
+    {"ERROR: (Line: %d) found multi macros with same name (%s) \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_TEXT},
+    {"ERROR: (Line: %d) Macro should not contain spam letters\n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_NONE},
+    {"ERROR: (Line %d) Macro name should start only with letters: (%s) \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_TEXT},
+    {"ERROR: (Line %d) Macro should contains only letters / numbers / underscore (%s)",
+     DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_TEXT},
+    {"ERROR: (Line %d) Macro name should not be a command name (%s) \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_TEXT},
+    {"ERROR: (Line %d) Macro name should not be an instruction name (%s) \n",
+     DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_TEXT},
+
+    /* Symbols */
+    {"ERROR: (Line %d) Symbol length should be less than " STRINGIFY(MAX_SYMBOL_LENGTH) " \n",
+     DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_NONE},
+    {"ERROR: (Line %d) Symbol name already defined (%s) \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_TEXT},
+    {"ERROR: (Line %d) Symbol name and macro can't share same name (%s) \n",
+     DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_TEXT},
+    {"ERROR: (Line %d) Multy symbols with same name (%s) \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_TEXT},
+    {"ERROR: (Line %d) Empty symbol name was received \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_NONE},
+    {"ERROR: (Line %d) Symbol must start with alphameric char (%s) \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_TEXT},
+    {"ERROR: (Line %d) Symbol length should not be more than " STRINGIFY(MAX_SYMBOL_LENGTH) " \n",
+     DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_NONE},
+    {"ERROR: (Line %d) Command or Symbol must start with letter (%s) \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_TEXT},
+    {"ERROR: (Line %d) Command or Symbol was not found (%s) \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_TEXT},
+
+    /* Entries and externals */
+    {"WARNING: (Line %d) Symbol not should define in entry instruction \n",
+     DIAGNOSTIC_WARNING, DIAGNOSTIC_ARGUMENT_NONE},
+    {"ERROR: (Line %d) Found multi entries with same name (%s) \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_TEXT},
+    {"WARNING: (Line %d) Symbol not should define in external instruction \n",
+     DIAGNOSTIC_WARNING, DIAGNOSTIC_ARGUMENT_NONE},
+    {"ERROR: (Line %d) Found multi externals with same name (%s) \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_TEXT},
+
+    /* Lines */
+    {"ERROR: (Line %d) Failed to find instruction with name: %s \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_TEXT},
+    {"ERROR (Line %d) Flied to find command name (%s) \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_TEXT},
+    {"ERROR (Line: %d): The line contains unexpected params '%s' \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_TEXT},
+
+    /* Commands operands */
+    {"ERROR: (Line %d) After one operand should be , to another operand (%s) \n",
+     DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_TEXT},
+    {"ERROR: (Line %d) Unexpected second param value \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_NONE},
+    {"ERROR: (Line: %d) Unexpected number of operands (Expected: %d, Actual: %d) \n",
+     DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_NUMBERS},
+    {"ERROR: (Line: %d) Unexpected source operand type \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_NONE},
+    {"ERROR: (Line: %d) Unexpected destination operand type \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_NONE},
+    {"ERROR: (Line %d) Invalid registry number (%s) \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_TEXT},
+    {"ERROR: (Line %d) Invalid mat syntax \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_NONE},
+
+    /* Instructions params */
+    {"ERROR: (Line %d) Invalid mat definition syntax \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_NONE},
+    {"ERROR: (Line %d) Number must start with a valid number or +/- symbols \n",
+     DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_NONE},
+    {"ERROR: (Line %d) Number of params should not be more than %d \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_NUMBERS},
+    {"ERROR: (Line %d) Failed to find any actual string. \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_NONE},
+    {"ERROR: (Line %d) Forget to close your string. \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_NONE},
+    {"ERROR: (Line %d) Expected number values after data instruction \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_NONE},
+    {"ERROR: (Line %d) Number in data instruction should be between " STRINGIFY(MIN_NEGATIVE_NUMBER_VALUE) "<=x<="
+     STRINGIFY(MAX_POSITIVE_NUMBER_VALUE) " (Got: %d) \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_NUMBERS},
+    {"ERROR: (Line %d) After ',' we expect number and not end of the row \n",
+     DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_NONE},
+    {"ERROR (Line %d) After one number expected comma before another number (%s)\n",
+     DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_TEXT},
+
+    /* Second assembler */
+    {"ERROR: (Line %d) Failed to find symbol with name: %s \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_TEXT},
+    {"ERROR: (Line %d) Failed to find symbol name (%s). \n", DIAGNOSTIC_ERROR, DIAGNOSTIC_ARGUMENT_TEXT}
+};
+
+
+/**
+ * Init empty diagnostics sink (e.g. sink which is part of another struct)
+ * @param diagnostics The diagnostics sink
+ */
+void init_diagnostics(DIAGNOSTICS *diagnostics) {
+    diagnostics->head = NULL;
+    diagnostics->tail = NULL;
+    diagnostics->error_count = 0;
+    diagnostics->max_errors = 0;
+}
+
+/**
+ * Create new empty diagnostics sink
+ * @return The new diagnostics sink
+ */
+DIAGNOSTICS *create_diagnostics(void) {
+    DIAGNOSTICS *diagnostics = malloc(sizeof(DIAGNOSTICS));
+    if (diagnostics == NULL) {
+        printf("CRITICAL: Failed to allocate diagnostics.\n");
+        exit(1);
+    }
+
+    init_diagnostics(diagnostics);
+
+    return diagnostics;
+}
+
+/**
+ * Create new diagnostic record and insert it to the sink in line order
+ * Most records arrive in order so we first try to append it after the tail
+ * @param diagnostics The diagnostics sink
+ * @param code The diagnostic code
+ * @param line_number The line number of the diagnostic
+ * @return The new diagnostic record
+ */
+static DIAGNOSTIC *insert_diagnostic(DIAGNOSTICS *diagnostics, DIAGNOSTIC_CODE code, int line_number) {
+    /* Pointer to the record which we insert after */
+    DIAGNOSTIC *prev;
+
+    DIAGNOSTIC *diagnostic = malloc(sizeof(DIAGNOSTIC));
+    if (diagnostic == NULL) {
+        printf("CRITICAL: Failed to allocate diagnostic.\n");
+        exit(1);
+    }
+
+    /* Init the values */
+    diagnostic->code = code;
+    diagnostic->line_number = line_number;
+
+    /* Init default values */
+    diagnostic->numbers[0] = 0;
+    diagnostic->numbers[1] = 0;
+    diagnostic->text = NULL;
+    diagnostic->next = NULL;
+
+    if (diagnostics_info[code].severity == DIAGNOSTIC_ERROR) diagnostics->error_count++;
+
+    /* Empty sink, or the record comes after the last one (records with same line keep their order) */
+    if (diagnostics->tail == NULL || diagnostics->tail->line_number <= line_number) {
+        if (diagnostics->head == NULL) {
+            diagnostics->head = diagnostic;
+        } else {
+            diagnostics->tail->next = diagnostic;
+        }
+        diagnostics->tail = diagnostic;
+
+        return diagnostic;
+    }
+
+    /* The record should be the first one */
+    if (diagnostics->head->line_number > line_number) {
+        diagnostic->next = diagnostics->head;
+        diagnostics->head = diagnostic;
+
+        return diagnostic;
+    }
+
+    /* Find the last record with line number which is not greater than ours */
+    prev = diagnostics->head;
+    while (prev->next != NULL && prev->next->line_number <= line_number) prev = prev->next;
+
+    diagnostic->next = prev->next;
+    prev->next = diagnostic;
+
+    return diagnostic;
+}
+
+/**
+ * Report new diagnostic with optional text argument
+ * The text is copied, so it can point to the current line buffer
+ * @param diagnostics The diagnostics sink
+ * @param code The diagnostic code
+ * @param line_number The line number of the diagnostic (0 if it is about the whole file)
+ * @param text The text argument of the message (Can be null)
+ */
+void report_diagnostic(DIAGNOSTICS *diagnostics, DIAGNOSTIC_CODE code, int line_number, const char *text) {
+    DIAGNOSTIC *diagnostic = insert_diagnostic(diagnostics, code, line_number);
+
+    if (text == NULL) return;
+
+    /* +1 for \0 */
+    diagnostic->text = malloc(strlen(text) + 1);
+    if (diagnostic->text == NULL) {
+        printf("CRITICAL: Failed to allocate diagnostic text.\n");
+        exit(1);
+    }
+    strcpy(diagnostic->text, text);
+}
+
+/**
+ * Report new diagnostic with numbers arguments
+ * @param diagnostics The diagnostics sink
+ * @param code The diagnostic code
+ * @param line_number The line number of the diagnostic
+ * @param first The first number of the message
+ * @param second The second number of the message (Ignored if the message has only one)
+ */
+void report_diagnostic_numbers(DIAGNOSTICS *diagnostics, DIAGNOSTIC_CODE code, int line_number, int first,
+                               int second) {
+    DIAGNOSTIC *diagnostic = insert_diagnostic(diagnostics, code, line_number);
+
+    diagnostic->numbers[0] = first;
+    diagnostic->numbers[1] = second;
+}
+
+/**
+ * Report new diagnostic with text argument which is part of string (e.g. operand inside the line)
+ * @param diagnostics The diagnostics sink
+ * @param code The diagnostic code
+ * @param line_number The line number of the diagnostic
+ * @param text The text argument of the message
+ */
+void report_diagnostic_slice(DIAGNOSTICS *diagnostics, DIAGNOSTIC_CODE code, int line_number, TOKEN_SLICE text) {
+    DIAGNOSTIC *diagnostic = insert_diagnostic(diagnostics, code, line_number);
+
+    /* +1 for \0 */
+    diagnostic->text = malloc(text.length + 1);
+    if (diagnostic->text == NULL) {
+        printf("CRITICAL: Failed to allocate diagnostic text.\n");
+        exit(1);
+    }
+    strncpy(diagnostic->text, text.start, text.length);
+    diagnostic->text[text.length] = END_OF_STRING;
+}
+
+/**
+ * Report again all the diagnostics of another sink in a new line
+ * It is used for errors which were found before we know the actual line number (e.g. lexed macro lines)
+ * @param diagnostics The diagnostics sink
+ * @param source The sink with the diagnostics to report
+ * @param line_number The line number of the new diagnostics
+ */
+void copy_diagnostics(DIAGNOSTICS *diagnostics, const DIAGNOSTICS *source, int line_number) {
+    const DIAGNOSTIC *source_diagnostic = source->head;
+
+    while (source_diagnostic != NULL) {
+        if (source_diagnostic->text != NULL) {
+            report_diagnostic(diagnostics, source_diagnostic->code, line_number, source_diagnostic->text);
+        } else {
+            report_diagnostic_numbers(diagnostics, source_diagnostic->code, line_number,
+                                      source_diagnostic->numbers[0], source_diagnostic->numbers[1]);
+        }
+
+        source_diagnostic = source_diagnostic->next;
+    }
+}
+
+/**
+ * Get the severity of the diagnostic code (e.g. for callers which handle the structured diagnostics)
+ * @param code The diagnostic code
+ * @return The diagnostic severity
+ */
+DIAGNOSTIC_SEVERITY get_diagnostic_severity(DIAGNOSTIC_CODE code) {
+    return diagnostics_info[code].severity;
+}
+
+/**
+ * Format one diagnostic message (without the end of line)
+ * @param diagnostic The diagnostic
+ * @param line_number The line number in the message (e.g. the line in the source and not in the .am file)
+ * @return The new message
+ */
+char *format_diagnostic(const DIAGNOSTIC *diagnostic, int line_number) {
+    const DIAGNOSTIC_INFO *info = &diagnostics_info[diagnostic->code];
+
+    /* The message length (the format is longer than the numbers place holders, +1 for \0) */
+    int length = strlen(info->format) + 3 * DIAGNOSTIC_NUMBER_MAX_LENGTH + 1;
+
+    char *message;
+
+    if (diagnostic->text != NULL) length += strlen(diagnostic->text);
+
+    message = malloc(length);
+    if (message == NULL) {
+        printf("CRITICAL: Failed to allocate diagnostic message.\n");
+        exit(1);
+    }
+
+    switch (info->argument) {
+        case DIAGNOSTIC_ARGUMENT_FILE:
+            sprintf(message, info->format, diagnostic->text);
+            break;
+        case DIAGNOSTIC_ARGUMENT_TEXT:
+            sprintf(message, info->format, line_number, diagnostic->text);
+            break;
+        case DIAGNOSTIC_ARGUMENT_NUMBERS:
+            /* Unused numbers are ignored by the format */
+            sprintf(message, info->format, line_number, diagnostic->numbers[0], diagnostic->numbers[1]);
+            break;
+        default:
+            sprintf(message, info->format, line_number);
+    }
+
+    /* Remove the end of line (and the spaces before it) */
+    length = strlen(message);
+    while (length > 0 && (message[length - 1] == '\n' || message[length - 1] == ' ')) message[--length] = END_OF_STRING;
+
+    return message;
+}
+
+/**
+ * Check if the file already has the maximum number of errors
+ * The passes check it after each line, so they can stop the file early
+ * @param diagnostics The diagnostics sink
+ * @return Should we stop processing this file
+ */
+boolean diagnostics_limit_reached(DIAGNOSTICS *diagnostics) {
+    return diagnostics->max_errors > 0 && diagnostics->error_count >= diagnostics->max_errors;
+}
+
+/**
+ * Format all the diagnostics (in line order) to the output stream
+ * @param diagnostics The diagnostics sink
+ * @param output The output stream (e.g. stdout)
+ */
+void write_diagnostics(DIAGNOSTICS *diagnostics, FILE *output) {
+    DIAGNOSTIC *diagnostic = diagnostics->head;
+
+    /* The current message details */
+    const DIAGNOSTIC_INFO *info;
+
+    while (diagnostic != NULL) {
+        info = &diagnostics_info[diagnostic->code];
+
+        switch (info->argument) {
+            case DIAGNOSTIC_ARGUMENT_FILE:
+                fprintf(output, info->format, diagnostic->text);
+                break;
+            case DIAGNOSTIC_ARGUMENT_TEXT:
+                fprintf(output, info->format, diagnostic->line_number, diagnostic->text);
+                break;
+            case DIAGNOSTIC_ARGUMENT_NUMBERS:
+                /* Unused numbers are ignored by the format */
+                fprintf(output, info->format, diagnostic->line_number, diagnostic->numbers[0],
+                        diagnostic->numbers[1]);
+                break;
+            default:
+                fprintf(output, info->format, diagnostic->line_number);
+        }
+
+        diagnostic = diagnostic->next;
+    }
+
+    /* Let the user know there can be more errors we didn't check */
+    if (diagnostics_limit_reached(diagnostics)) {
+        fprintf(output, "WARNING: Stopped after %d errors \n", diagnostics->error_count);
+    }
+}
+
+/**
+ * This function frees all the records of the diagnostics sink
+ * The sink itself stays empty and can be used again
+ * @param diagnostics The diagnostics sink
+ */
+void clear_diagnostics(DIAGNOSTICS *diagnostics) {
+    DIAGNOSTIC *diagnostic = diagnostics->head;
+    DIAGNOSTIC *prev_diagnostic;
+
+    while (diagnostic != NULL) {
+        prev_diagnostic = diagnostic;
+        diagnostic = diagnostic->next;
+        free(prev_diagnostic->text);
+        free(prev_diagnostic);
+    }
+
+    diagnostics->head = NULL;
+    diagnostics->tail = NULL;
+    diagnostics->error_count = 0;
+}
+
+/**
+ * This function frees the diagnostics sink and all its records
+ * @param diagnostics The diagnostics sink
+ */
+void free_diagnostics(DIAGNOSTICS *diagnostics) {
+    clear_diagnostics(diagnostics);
+    free(diagnostics);
+}
@@ -0,0 +1,439 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assembler.h"
+
+
+/* The disassembler state of one image */
+typedef struct {
+    const OBJECT_IMAGE *image;
+
+    /* The label of each word (offset inside the labels names, DISASSEMBLER_NO_LABEL or DISASSEMBLER_NOT_LINE) */
+    int *labels;
+    OUTPUT_BUFFER labels_names;
+
+    /* The external of each word (index inside the image externals, or -1 if the word is not external) */
+    int *externals;
+} DISASSEMBLER;
+
+
+/**
+ * This function checks if the name is already the name of entry or external
+ * @param image The image
+ * @param name The name
+ * @return Is the name used
+ */
+static boolean is_object_symbol_name(const OBJECT_IMAGE *image, const char *name) {
+    /* For loop counter */
+    int i;
+
+    for (i = 0; i < image->entries_count; i++) {
+        if (strcmp(image->entries[i].name, name) == 0) return TRUE;
+    }
+    for (i = 0; i < image->externals_count; i++) {
+        if (strcmp(image->externals[i].name, name) == 0) return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ * This function adds label to the word
+ * @param disassembler The disassembler
+ * @param index The word index (it must not have label already)
+ * @param name The label name (null to create name from the word address)
+ */
+static void add_disassembler_label(DISASSEMBLER *disassembler, int index, const char *name) {
+    /* The label name from the address (the prefix is repeated until it is not entry or external name) */
+    char label[DISASSEMBLER_LABEL_MAX_LENGTH + 1];
+    int prefix_length = 0;
+
+    if (name == NULL) {
+        do {
+            label[prefix_length++] = DISASSEMBLER_LABEL_PREFIX;
+            sprintf(label + prefix_length, "%d", disassembler->image->base_address + index);
+        } while (is_object_symbol_name(disassembler->image, label) && prefix_length < MAX_SYMBOL_LENGTH / 2);
+        name = label;
+    }
+
+    disassembler->labels[index] = disassembler->labels_names.length;
+    append_to_output_buffer(&disassembler->labels_names, name, strlen(name) + 1);
+}
+
+/**
+ * This function finds the label of symbol word address
+ * The symbol word keeps only SYMBOL_BITS_LENGTH bits of the address (like the assembler writes it), so each word
+ * whose address has these bits is the same symbol
+ * @param disassembler The disassembler
+ * @param address The symbol word address
+ * @param create Create label in the first word which can have label (if none of the words has label)
+ * @return The word index of the label, or -1 if there is no label
+ */
+static int find_symbol_label(DISASSEMBLER *disassembler, int address, boolean create) {
+    int words_count = disassembler->image->code_length + disassembler->image->data_length;
+
+    /* The first word with the address bits */
+    int first_index = address - disassembler->image->base_address;
+    int index;
+
+    while (first_index < 0) first_index += 1 << SYMBOL_BITS_LENGTH;
+
+    for (index = first_index; index < words_count; index += 1 << SYMBOL_BITS_LENGTH) {
+        if (disassembler->labels[index] >= 0) return index;
+    }
+
+    for (index = first_index; create && index < words_count; index += 1 << SYMBOL_BITS_LENGTH) {
+        if (disassembler->labels[index] == DISASSEMBLER_NO_LABEL) {
+            add_disassembler_label(disassembler, index, NULL);
+            return index;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * This function returns the value of number word (ADDRESS_SIZE bits two's complement)
+ * @param word The word
+ * @return The number
+ */
+static int get_word_number(unsigned short word) {
+    return word > MAX_POSITIVE_NUMBER_VALUE ? (int) word - WORDS_COUNT : (int) word;
+}
+
+/**
+ * This function returns the address of symbol word
+ * @param word The symbol word
+ * @return The symbol address
+ */
+static int get_symbol_word_address(unsigned short word) {
+    return word >> ERA_BITS_SIZE;
+}
+
+/**
+ * This function returns the number of words of the command in the code
+ * @param image The image
+ * @param index The index of the command first word
+ * @return The number of words, or 0 if the word is not valid command (or the code ends before its operands words)
+ */
+static int get_command_words_count(const OBJECT_IMAGE *image, int index) {
+    const COMMAND_DECODE *decode = &command_decodes[image->words[index]];
+
+    if (decode->command_info == NULL || index + decode->words_count > image->code_length) return 0;
+
+    return decode->words_count;
+}
+
+/**
+ * This function adds labels for all the symbols which the command uses
+ * @param disassembler The disassembler
+ * @param decode The command decode
+ * @param index The index of the command first word
+ */
+static void add_command_labels(DISASSEMBLER *disassembler, const COMMAND_DECODE *decode, int index) {
+    /* The operand word */
+    int operand_index = index + 1;
+    unsigned short word;
+
+    OPERAND_TYPE operands_types[2];
+    int i;
+
+    operands_types[SOURCE_OPERAND_ORDER] = decode->source_operand_type;
+    operands_types[DES_OPERAND_ORDER] = decode->des_operand_type;
+
+    for (i = SOURCE_OPERAND_ORDER; i <= DES_OPERAND_ORDER; i++) {
+        if (operands_types[i] == SYMBOL || operands_types[i] == MAT) {
+            word = disassembler->image->words[operand_index];
+            if ((word & ((1 << ERA_BITS_SIZE) - 1)) == DATA && disassembler->externals[operand_index] < 0) {
+                find_symbol_label(disassembler, get_symbol_word_address(word), TRUE);
+            }
+        }
+
+        /* Like the assembler - mat has two words, and registry or number has one */
+        if (operands_types[i] != UNDEFINED) operand_index += operands_types[i] == MAT ? 2 : 1;
+    }
+}
+
+/**
+ * This function appends the registry operand (like r3)
+ * @param source The source to append to
+ * @param registry The registry number
+ */
+static void append_registry(OUTPUT_BUFFER *source, int registry) {
+    /* The registry name (+1 for \0) */
+    char name[DISASSEMBLER_NUMBER_MAX_LENGTH + 2];
+
+    sprintf(name, "%c%d", REGISTRY_PREFIX, registry);
+    append_to_output_buffer(source, name, strlen(name));
+}
+
+/**
+ * This function appends the symbol of symbol word (the external name, the label, or the address if it has no label)
+ * @param disassembler The disassembler
+ * @param source The source to append to
+ * @param index The symbol word index
+ */
+static void append_symbol(DISASSEMBLER *disassembler, OUTPUT_BUFFER *source, int index) {
+    const OBJECT_IMAGE *image = disassembler->image;
+
+    /* The symbol address, and the word index of its label */
+    int address = get_symbol_word_address(image->words[index]);
+    int label_index;
+
+    /* The address as text (+1 for \0) */
+    char text[DISASSEMBLER_NUMBER_MAX_LENGTH + 1];
+
+    const char *name;
+
+    if (disassembler->externals[index] >= 0) {
+        name = image->externals[disassembler->externals[index]].name;
+    } else if ((label_index = find_symbol_label(disassembler, address, FALSE)) >= 0) {
+        name = disassembler->labels_names.data + disassembler->labels[label_index];
+    } else {
+        sprintf(text, "%d", address);
+        name = text;
+    }
+
+    append_to_output_buffer(source, name, strlen(name));
+}
+
+/**
+ * This function appends the command operands (like 'M1[r2][r3], r4')
+ * @param disassembler The disassembler
+ * @param source The source to append to
+ * @param decode The command decode
+ * @param index The index of the command first word
+ */
+static void append_command_operands(DISASSEMBLER *disassembler, OUTPUT_BUFFER *source, const COMMAND_DECODE *decode,
+                                    int index) {
+    /* The operand word */
+    int operand_index = index + 1;
+    unsigned short word;
+
+    /* The number as text (+1 for \0) */
+    char number[DISASSEMBLER_NUMBER_MAX_LENGTH + 2];
+
+    OPERAND_TYPE operands_types[2];
+    int i;
+
+    const unsigned short *words = disassembler->image->words;
+
+    operands_types[SOURCE_OPERAND_ORDER] = decode->source_operand_type;
+    operands_types[DES_OPERAND_ORDER] = decode->des_operand_type;
+
+    /* Two registries share one word (the source registry in the first 4 bits, and the destination in the second) */
+    if (operands_types[SOURCE_OPERAND_ORDER] == REGISTRY && operands_types[DES_OPERAND_ORDER] == REGISTRY) {
+        word = words[operand_index];
+        append_to_output_buffer(source, " ", 1);
+        append_registry(source, word >> (REGISTRY_BITS_SIZE + ERA_BITS_SIZE));
+        append_to_output_buffer(source, ", ", 2);
+        append_registry(source, (word >> ERA_BITS_SIZE) & ((1 << REGISTRY_BITS_SIZE) - 1));
+        return;
+    }
+
+    for (i = SOURCE_OPERAND_ORDER; i <= DES_OPERAND_ORDER; i++) {
+        if (operands_types[i] == UNDEFINED) continue;
+
+        append_to_output_buffer(source, operand_index == index + 1 ? " " : ", ", operand_index == index + 1 ? 1 : 2);
+        word = words[operand_index];
+
+        switch (operands_types[i]) {
+            case SIMPLE:
+                sprintf(number, "%c%d", NUMBER_PREFIX, get_word_number(word));
+                append_to_output_buffer(source, number, strlen(number));
+                operand_index++;
+                break;
+            case REGISTRY:
+                append_registry(source, word >> (REGISTRY_BITS_SIZE + ERA_BITS_SIZE));
+                operand_index++;
+                break;
+            case SYMBOL:
+                append_symbol(disassembler, source, operand_index);
+                operand_index++;
+                break;
+            case MAT:
+                /* The symbol word, and the registries word */
+                append_symbol(disassembler, source, operand_index);
+                word = words[operand_index + 1];
+                append_to_output_buffer(source, "[", 1);
+                append_registry(source, word >> (REGISTRY_BITS_SIZE + ERA_BITS_SIZE));
+                append_to_output_buffer(source, "][", 2);
+                append_registry(source, (word >> ERA_BITS_SIZE) & ((1 << REGISTRY_BITS_SIZE) - 1));
+                append_to_output_buffer(source, "]", 1);
+                operand_index += 2;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/**
+ * This function appends the label of the word (like 'MAIN: '), if it has label
+ * @param disassembler The disassembler
+ * @param source The source to append to
+ * @param index The word index
+ */
+static void append_line_label(DISASSEMBLER *disassembler, OUTPUT_BUFFER *source, int index) {
+    const char *name;
+
+    if (disassembler->labels[index] < 0) return;
+
+    name = disassembler->labels_names.data + disassembler->labels[index];
+    append_to_output_buffer(source, name, strlen(name));
+    append_to_output_buffer(source, ": ", 2);
+}
+
+/**
+ * This function appends the symbols declarations (.entry, and .extern once for each name)
+ * @param image The image
+ * @param source The source to append to
+ */
+static void append_symbols_declarations(const OBJECT_IMAGE *image, OUTPUT_BUFFER *source) {
+    /* For loop counters */
+    int i, j;
+
+    for (i = 0; i < image->entries_count; i++) {
+        append_to_output_buffer(source, DISASSEMBLER_ENTRY_DIRECTIVE, strlen(DISASSEMBLER_ENTRY_DIRECTIVE));
+        append_to_output_buffer(source, image->entries[i].name, strlen(image->entries[i].name));
+        append_to_output_buffer(source, "\n", 1);
+    }
+
+    for (i = 0; i < image->externals_count; i++) {
+        /* The external is used in many words, but declared once */
+        for (j = 0; j < i && strcmp(image->externals[j].name, image->externals[i].name) != 0; j++);
+        if (j < i) continue;
+
+        append_to_output_buffer(source, DISASSEMBLER_EXTERN_DIRECTIVE, strlen(DISASSEMBLER_EXTERN_DIRECTIVE));
+        append_to_output_buffer(source, image->externals[i].name, strlen(image->externals[i].name));
+        append_to_output_buffer(source, "\n", 1);
+    }
+}
+
+/**
+ * This function appends the data words as .data lines (a new line starts in each label)
+ * @param disassembler The disassembler
+ * @param source The source to append to
+ */
+static void append_data_lines(DISASSEMBLER *disassembler, OUTPUT_BUFFER *source) {
+    const OBJECT_IMAGE *image = disassembler->image;
+
+    /* The number as text (+1 for \0) */
+    char number[DISASSEMBLER_NUMBER_MAX_LENGTH + 1];
+
+    /* The words in the current line */
+    int line_words = 0;
+
+    int index;
+
+    for (index = image->code_length; index < image->code_length + image->data_length; index++) {
+        if (line_words > 0 && (line_words == DISASSEMBLER_DATA_WORDS_PER_LINE || disassembler->labels[index] >= 0)) {
+            append_to_output_buffer(source, "\n", 1);
+            line_words = 0;
+        }
+
+        if (line_words == 0) {
+            append_line_label(disassembler, source, index);
+            append_to_output_buffer(source, DISASSEMBLER_DATA_DIRECTIVE, strlen(DISASSEMBLER_DATA_DIRECTIVE));
+        } else {
+            append_to_output_buffer(source, ", ", 2);
+        }
+
+        sprintf(number, "%d", get_word_number(image->words[index]));
+        append_to_output_buffer(source, number, strlen(number));
+        line_words++;
+    }
+
+    if (line_words > 0) append_to_output_buffer(source, "\n", 1);
+}
+
+/**
+ * This function disassemblies the object image back into assembly source
+ * Each first word is decoded with one lookup in command_decodes, and its operands words are decoded like the
+ * assembler encodes them (symbols are the externals names, entries names, or labels which are created from their
+ * addresses)
+ * Words which are not valid commands are written as comments
+ * The commands tables must be built already (see init_commands_tables)
+ * @param image The image
+ * @param source The source to append to
+ */
+void disassemble_object(const OBJECT_IMAGE *image, OUTPUT_BUFFER *source) {
+    DISASSEMBLER disassembler;
+
+    /* The current word, its command and the command words */
+    int index;
+    const COMMAND_DECODE *decode;
+    int command_words_count;
+
+    /* The comment of invalid word */
+    char comment[DISASSEMBLER_COMMENT_MAX_LENGTH + 1];
+
+    int words_count = image->code_length + image->data_length;
+    int i;
+
+    disassembler.image = image;
+    disassembler.labels = malloc(sizeof(int) * (words_count > 0 ? words_count : 1));
+    disassembler.externals = malloc(sizeof(int) * (words_count > 0 ? words_count : 1));
+    if (disassembler.labels == NULL || disassembler.externals == NULL) {
+        printf("CRITICAL: Failed to allocate disassembler.\n");
+        exit(1);
+    }
+    init_output_buffer(&disassembler.labels_names);
+
+    for (i = 0; i < words_count; i++) {
+        disassembler.labels[i] = DISASSEMBLER_NO_LABEL;
+        disassembler.externals[i] = -1;
+    }
+
+    /* Only lines can have labels (not the operands words, and not the invalid words which are comments) */
+    for (index = 0; index < image->code_length; index += command_words_count > 0 ? command_words_count : 1) {
+        command_words_count = get_command_words_count(image, index);
+        if (command_words_count == 0) disassembler.labels[index] = DISASSEMBLER_NOT_LINE;
+        for (i = 1; i < command_words_count; i++) disassembler.labels[index + i] = DISASSEMBLER_NOT_LINE;
+    }
+
+    for (i = 0; i < image->externals_count; i++) {
+        index = image->externals[i].address - image->base_address;
+        if (index >= 0 && index < words_count) disassembler.externals[index] = i;
+    }
+
+    /* The entries have their own names, and the other symbols get labels from their addresses */
+    for (i = 0; i < image->entries_count; i++) {
+        index = image->entries[i].address - image->base_address;
+        if (index >= 0 && index < words_count && disassembler.labels[index] == DISASSEMBLER_NO_LABEL) {
+            add_disassembler_label(&disassembler, index, image->entries[i].name);
+        }
+    }
+
+    for (index = 0; index < image->code_length; index += command_words_count > 0 ? command_words_count : 1) {
+        command_words_count = get_command_words_count(image, index);
+        if (command_words_count > 0) add_command_labels(&disassembler, &command_decodes[image->words[index]], index);
+    }
+
+    append_symbols_declarations(image, source);
+
+    for (index = 0; index < image->code_length; index += command_words_count > 0 ? command_words_count : 1) {
+        command_words_count = get_command_words_count(image, index);
+        decode = &command_decodes[image->words[index]];
+
+        /* Command without all its operands words (in the end of the code) is invalid too */
+        if (command_words_count == 0) {
+            sprintf(comment, "%c %d: %d is not a command\n", COMMENT_SYMBOL, image->base_address + index,
+                    image->words[index]);
+            append_to_output_buffer(source, comment, strlen(comment));
+            continue;
+        }
+
+        append_line_label(&disassembler, source, index);
+        append_to_output_buffer(source, decode->command_info->name, strlen(decode->command_info->name));
+        append_command_operands(&disassembler, source, decode, index);
+        append_to_output_buffer(source, "\n", 1);
+    }
+
+    append_data_lines(&disassembler, source);
+
+    free(disassembler.labels);
+    free(disassembler.externals);
+    free_output_buffer(&disassembler.labels_names);
+}
@@ -0,0 +1,440 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assembler.h"
+
+
+/**
+ * This function decodes the registry field of registries word
+ * @param word The registries word
+ * @param order The field order (the first registry is in the high bits)
+ * @return The registry number
+ */
+static int get_word_registry(unsigned short word, int order) {
+    int shift = order == SOURCE_OPERAND_ORDER ? REGISTRY_BITS_SIZE + ERA_BITS_SIZE : ERA_BITS_SIZE;
+
+    return (word >> shift) & ((1 << REGISTRY_BITS_SIZE) - 1);
+}
+
+/**
+ * This function predecodes the instruction of the address from the current memory
+ * Like the disassembler the first word is decoded with one lookup, and the operands words are decoded like
+ * extract_operand_binary encodes them
+ * The commands tables must be built already (see init_commands_tables)
+ * @param emulator The emulator
+ * @param address The address of the first word
+ */
+void decode_emulator_instruction(EMULATOR *emulator, int address) {
+    EMULATOR_INSTRUCTION *instruction = &emulator->instructions[address];
+    const COMMAND_DECODE *decode = &command_decodes[emulator->memory[address]];
+    EMULATOR_OPERAND *operand;
+
+    /* The operand word address */
+    int operand_address = address + 1;
+    unsigned short word;
+
+    int i;
+
+    instruction->handler = EMULATOR_INVALID_HANDLER;
+    instruction->words_count = 1;
+    if (decode->command_info == NULL) return;
+
+    instruction->operands[SOURCE_OPERAND_ORDER].type = decode->source_operand_type;
+    instruction->operands[DES_OPERAND_ORDER].type = decode->des_operand_type;
+
+    for (i = SOURCE_OPERAND_ORDER; i <= DES_OPERAND_ORDER; i++) {
+        operand = &instruction->operands[i];
+        word = emulator->memory[operand_address & EMULATOR_ADDRESS_MASK];
+
+        switch (operand->type) {
+            case SIMPLE:
+                operand->value = word;
+                operand_address++;
+                break;
+            case REGISTRY:
+                /* Two registries share one word (and one registry is in the high field) */
+                if (decode->source_operand_type == REGISTRY && decode->des_operand_type == REGISTRY) {
+                    operand->registries[0] = get_word_registry(word, i);
+                    if (i == DES_OPERAND_ORDER) operand_address++;
+                } else {
+                    operand->registries[0] = get_word_registry(word, SOURCE_OPERAND_ORDER);
+                    operand_address++;
+                }
+                if (operand->registries[0] > MAX_REGISTRY_NUMBER) return;
+                break;
+            case SYMBOL:
+            case MAT:
+                /* External symbol has no address until the object is linked */
+                if ((word & ((1 << ERA_BITS_SIZE) - 1)) == EXTERNAL) {
+                    instruction->handler = EMULATOR_EXTERNAL_HANDLER;
+                    return;
+                }
+                operand->value = word >> ERA_BITS_SIZE;
+                operand_address++;
+
+                if (operand->type == MAT) {
+                    word = emulator->memory[operand_address & EMULATOR_ADDRESS_MASK];
+                    operand->registries[0] = get_word_registry(word, SOURCE_OPERAND_ORDER);
+                    operand->registries[1] = get_word_registry(word, DES_OPERAND_ORDER);
+                    if (operand->registries[0] > MAX_REGISTRY_NUMBER || operand->registries[1] > MAX_REGISTRY_NUMBER) {
+                        return;
+                    }
+                    operand_address++;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    instruction->handler = decode->command_info->command_number;
+    instruction->words_count = decode->words_count;
+}
+
+/**
+ * This function returns the address of symbol or mat operand
+ * @param emulator The emulator
+ * @param operand The operand
+ * @return The address
+ */
+static int get_operand_address(EMULATOR *emulator, EMULATOR_OPERAND *operand) {
+    if (operand->type == SYMBOL) return operand->value;
+
+    return (operand->value + emulator->registries[operand->registries[0]] +
+            emulator->registries[operand->registries[1]]) & EMULATOR_ADDRESS_MASK;
+}
+
+/**
+ * This function returns the word of the operand value
+ * @param emulator The emulator
+ * @param operand The operand
+ * @return The operand word (the number of SIMPLE operand is in the operand itself)
+ */
+static unsigned short *get_operand_word(EMULATOR *emulator, EMULATOR_OPERAND *operand) {
+    switch (operand->type) {
+        case SIMPLE:
+            return &operand->value;
+        case REGISTRY:
+            return &emulator->registries[operand->registries[0]];
+        default:
+            return &emulator->memory[get_operand_address(emulator, operand)];
+    }
+}
+
+/**
+ * This function writes the operand value
+ * The instructions which contain the changed memory word are decoded again before they run
+ * @param emulator The emulator
+ * @param operand The operand (SYMBOL, MAT or REGISTRY)
+ * @param value The new value (only its ADDRESS_SIZE bits are kept)
+ */
+static void set_operand_value(EMULATOR *emulator, EMULATOR_OPERAND *operand, int value) {
+    /* The memory address */
+    int address;
+
+    int i;
+
+    if (operand->type == REGISTRY) {
+        emulator->registries[operand->registries[0]] = value & ADDRESS_MASK;
+        return;
+    }
+
+    address = get_operand_address(emulator, operand);
+    if (emulator->memory[address] == (value & ADDRESS_MASK)) return;
+
+    emulator->memory[address] = value & ADDRESS_MASK;
+    emulator->changed_address = address;
+    for (i = 0; i < EMULATOR_MAX_COMMAND_WORDS; i++) {
+        emulator->instructions[(address - i) & EMULATOR_ADDRESS_MASK].handler = EMULATOR_DECODE_HANDLER;
+    }
+}
+
+/**
+ * This function returns the jump address of jmp, bne and jsr
+ * @param emulator The emulator
+ * @param operand The destination operand
+ * @return The address
+ */
+static int get_jump_address(EMULATOR *emulator, EMULATOR_OPERAND *operand) {
+    if (operand->type == REGISTRY) return emulator->registries[operand->registries[0]] & EMULATOR_ADDRESS_MASK;
+
+    return get_operand_address(emulator, operand);
+}
+
+/**
+ * This function returns the number of word (the word is two's complement)
+ * @param word The word
+ * @return The number
+ */
+static int get_word_number(unsigned short word) {
+    return word > MAX_POSITIVE_NUMBER_VALUE ? (int) word - WORDS_COUNT : (int) word;
+}
+
+/**
+ * This function returns the cycles of the instruction (its words, and its memory operands reads and writes)
+ * @param instruction The instruction
+ * @return The cycles
+ */
+static int get_instruction_cycles(const EMULATOR_INSTRUCTION *instruction) {
+    int cycles = instruction->words_count;
+
+    /* The operands in the memory (the jumps and lea use only their address) */
+    int source_in_memory = instruction->operands[SOURCE_OPERAND_ORDER].type == SYMBOL ||
+                           instruction->operands[SOURCE_OPERAND_ORDER].type == MAT;
+    int destination_in_memory = instruction->operands[DES_OPERAND_ORDER].type == SYMBOL ||
+                                instruction->operands[DES_OPERAND_ORDER].type == MAT;
+
+    switch (instruction->handler) {
+        case EMULATOR_MOV_HANDLER:
+        case EMULATOR_CMP_HANDLER:
+            return cycles + source_in_memory + destination_in_memory;
+        case EMULATOR_ADD_HANDLER:
+        case EMULATOR_SUB_HANDLER:
+            /* The destination is read and written */
+            return cycles + source_in_memory + 2 * destination_in_memory;
+        case EMULATOR_NOT_HANDLER:
+        case EMULATOR_INC_HANDLER:
+        case EMULATOR_DEC_HANDLER:
+            return cycles + 2 * destination_in_memory;
+        case EMULATOR_CLR_HANDLER:
+        case EMULATOR_RED_HANDLER:
+        case EMULATOR_PRN_HANDLER:
+        case EMULATOR_LEA_HANDLER:
+            return cycles + destination_in_memory;
+        default:
+            return cycles;
+    }
+}
+
+/**
+ * This function loads the image into the emulator memory, and predecodes the instruction of each address
+ * The program starts in the image base address
+ * The commands tables must be built already (see init_commands_tables)
+ * @param emulator The emulator to init
+ * @param image The image
+ * @param input Where red reads from
+ * @param output Where prn writes to
+ * @return The status code (ERROR if the image doesn't fit the memory)
+ */
+STATUS_CODE init_emulator(EMULATOR *emulator, const OBJECT_IMAGE *image, FILE *input, FILE *output) {
+    int address;
+
+    /* Each length is checked against the memory left (adding them may overflow) */
+    if (image->base_address < 0 || image->base_address > EMULATOR_MEMORY_SIZE || image->code_length < 0 ||
+        image->data_length < 0 || image->code_length > EMULATOR_MEMORY_SIZE - image->base_address ||
+        image->data_length > EMULATOR_MEMORY_SIZE - image->base_address - image->code_length) {
+        return ERROR;
+    }
+
+    memset(emulator->memory, 0, sizeof(emulator->memory));
+    memcpy(emulator->memory + image->base_address, image->words,
+           sizeof(unsigned short) * (image->code_length + image->data_length));
+    memset(emulator->registries, 0, sizeof(emulator->registries));
+    emulator->zero_flag = FALSE;
+
+    for (address = 0; address < EMULATOR_MEMORY_SIZE; address++) decode_emulator_instruction(emulator, address);
+
+    emulator->pc = image->base_address;
+    emulator->stack_size = 0;
+    emulator->steps = 0;
+    emulator->changed_address = -1;
+    emulator->input = input;
+    emulator->output = output;
+    emulator->profile = NULL;
+    emulator->status = EMULATOR_RUNNING;
+
+    return OK;
+}
+
+/**
+ * This function runs the emulator until the program stops (stop, or a command it can't run)
+ * @param emulator The emulator
+ * @param max_steps Stop after this number of commands (0 means no limit)
+ * @return Why the emulator stopped (EMULATOR_STOPPED after stop)
+ */
+EMULATOR_STATUS run_emulator(EMULATOR *emulator, long max_steps) {
+    EMULATOR_INSTRUCTION *instruction;
+    EMULATOR_OPERAND *source, *destination;
+
+    /* The address of the command, and the address of the next command (the jumps replace it) */
+    int pc = emulator->pc;
+    int next_pc;
+
+    /* The value of the source operand */
+    int value;
+
+    /* The steps when we stop (-1 for no limit) */
+    long steps = emulator->steps;
+    long last_step = max_steps > 0 ? steps + max_steps : -1;
+
+    while (emulator->status == EMULATOR_RUNNING) {
+        if (steps == last_step) {
+            emulator->status = EMULATOR_STEPS_LIMIT;
+            break;
+        }
+
+        instruction = &emulator->instructions[pc];
+        source = &instruction->operands[SOURCE_OPERAND_ORDER];
+        destination = &instruction->operands[DES_OPERAND_ORDER];
+        next_pc = (pc + instruction->words_count) & EMULATOR_ADDRESS_MASK;
+
+        /* The commands which fail don't run (so the pc stays in their address) */
+        switch (instruction->handler) {
+            case EMULATOR_MOV_HANDLER:
+                set_operand_value(emulator, destination, *get_operand_word(emulator, source));
+                break;
+            case EMULATOR_CMP_HANDLER:
+                emulator->zero_flag = *get_operand_word(emulator, source) == *get_operand_word(emulator, destination);
+                break;
+            case EMULATOR_ADD_HANDLER:
+                value = *get_operand_word(emulator, source);
+                set_operand_value(emulator, destination, *get_operand_word(emulator, destination) + value);
+                break;
+            case EMULATOR_SUB_HANDLER:
+                value = *get_operand_word(emulator, source);
+                set_operand_value(emulator, destination, *get_operand_word(emulator, destination) - value);
+                break;
+            case EMULATOR_LEA_HANDLER:
+                set_operand_value(emulator, destination, get_operand_address(emulator, source));
+                break;
+            case EMULATOR_CLR_HANDLER:
+                set_operand_value(emulator, destination, 0);
+                break;
+            case EMULATOR_NOT_HANDLER:
+                set_operand_value(emulator, destination, ~*get_operand_word(emulator, destination));
+                break;
+            case EMULATOR_INC_HANDLER:
+                set_operand_value(emulator, destination, *get_operand_word(emulator, destination) + 1);
+                break;
+            case EMULATOR_DEC_HANDLER:
+                set_operand_value(emulator, destination, *get_operand_word(emulator, destination) - 1);
+                break;
+            case EMULATOR_JMP_HANDLER:
+                next_pc = get_jump_address(emulator, destination);
+                break;
+            case EMULATOR_BNE_HANDLER:
+                if (!emulator->zero_flag) next_pc = get_jump_address(emulator, destination);
+                break;
+            case EMULATOR_JSR_HANDLER:
+                if (emulator->stack_size == EMULATOR_STACK_SIZE) {
+                    emulator->status = EMULATOR_STACK_OVERFLOW;
+                    continue;
+                }
+                emulator->stack[emulator->stack_size++] = next_pc;
+                next_pc = get_jump_address(emulator, destination);
+                break;
+            case EMULATOR_RED_HANDLER:
+                value = getc(emulator->input);
+                set_operand_value(emulator, destination, value == EOF ? EMULATOR_END_OF_INPUT : value);
+                break;
+            case EMULATOR_PRN_HANDLER:
+                fprintf(emulator->output, "%d\n", get_word_number(*get_operand_word(emulator, destination)));
+                break;
+            case EMULATOR_RTS_HANDLER:
+                if (emulator->stack_size == 0) {
+                    emulator->status = EMULATOR_STACK_UNDERFLOW;
+                    continue;
+                }
+                next_pc = emulator->stack[--emulator->stack_size];
+                break;
+            case EMULATOR_STOP_HANDLER:
+                emulator->status = EMULATOR_STOPPED;
+                break;
+            case EMULATOR_DECODE_HANDLER:
+                /* Its memory changed, so we decode it again before it runs */
+                decode_emulator_instruction(emulator, pc);
+                continue;
+            case EMULATOR_EXTERNAL_HANDLER:
+                emulator->status = EMULATOR_EXTERNAL_SYMBOL;
+                continue;
+            default:
+                emulator->status = EMULATOR_INVALID_COMMAND;
+                continue;
+        }
+
+        /* The failed commands didn't run, so they are not counted */
+        if (emulator->profile != NULL) {
+            emulator->profile->counts[pc]++;
+            emulator->profile->cycles[pc] += get_instruction_cycles(instruction);
+        }
+
+        pc = next_pc;
+        steps++;
+    }
+
+    emulator->pc = pc;
+    emulator->steps = steps;
+
+    return emulator->status;
+}
+
+/**
+ * This function returns the message of the emulator status
+ * @param status The status
+ * @return The message
+ */
+const char *get_emulator_status_message(EMULATOR_STATUS status) {
+    switch (status) {
+        case EMULATOR_RUNNING:
+            return "The program is running";
+        case EMULATOR_STOPPED:
+            return "The program stopped";
+        case EMULATOR_INVALID_COMMAND:
+            return "The word is not valid command";
+        case EMULATOR_EXTERNAL_SYMBOL:
+            return "The command uses external symbol";
+        case EMULATOR_STACK_OVERFLOW:
+            return "Too many nested jsr";
+        case EMULATOR_STACK_UNDERFLOW:
+            return "rts without jsr";
+        default:
+            return "The program didn't stop";
+    }
+}
+
+/**
+ * This function runs the program of the image, and prints why it failed (if it didn't stop with stop)
+ * @param name The program name (for the messages)
+ * @param image The image
+ * @param use_jit Run the program with the JIT (if the system can't run native code, we run the emulator)
+ * @param profile The profile to count the commands in (null if we don't profile, the profiler runs the emulator)
+ * @param input Where red reads from
+ * @param output Where prn writes to
+ * @param messages Where to print the failure
+ * @return The status code (ERROR if the program failed)
+ */
+STATUS_CODE run_object_image(const char *name, const OBJECT_IMAGE *image, boolean use_jit, EMULATOR_PROFILE *profile,
+                             FILE *input, FILE *output, FILE *messages) {
+    EMULATOR *emulator = malloc(sizeof(EMULATOR));
+    JIT *jit;
+    STATUS_CODE status_code = OK;
+
+    if (emulator == NULL) {
+        printf("CRITICAL: Failed to allocate memory for emulator");
+        exit(1);
+    }
+
+    /* The profile is empty even if the image doesn't fit */
+    if (profile != NULL) memset(profile, 0, sizeof(EMULATOR_PROFILE));
+
+    if (init_emulator(emulator, image, input, output) != OK) {
+        fprintf(messages, "CRITICAL: %s doesn't fit the emulator memory (%d words) \n", name, EMULATOR_MEMORY_SIZE);
+        free(emulator);
+        return ERROR;
+    }
+
+    /* The native code doesn't count the commands, so the profiler runs the emulator */
+    emulator->profile = profile;
+    jit = use_jit && profile == NULL ? create_jit() : NULL;
+    if ((jit != NULL ? run_jit(jit, emulator, 0) : run_emulator(emulator, 0)) != EMULATOR_STOPPED) {
+        fflush(output);
+        fprintf(messages, "CRITICAL: %s: %s (address %d, after %ld commands) \n", name,
+                get_emulator_status_message(emulator->status), emulator->pc, emulator->steps);
+        status_code = ERROR;
+    }
+
+    if (jit != NULL) free_jit(jit);
+    free(emulator);
+    return status_code;
+}
@@ -0,0 +1,2 @@
+; The third source fails, so its entry has no members
+        mov r1
@@ -0,0 +1,6 @@
+; The first source of the archive (with entries and externals)
+.entry MAIN
+.extern OUT
+MAIN:   mov #1, r1
+        jsr OUT
+        stop
@@ -0,0 +1,3 @@
+; The second source of the archive (only the object)
+        prn #2
+        stop
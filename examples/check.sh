@@ -0,0 +1,104 @@
+#!/bin/sh
+# Checks the examples of the tools against their expected outputs (make check runs it from the repository root)
+# Each case runs in a copy of its directory under the work directory (the tools write their outputs next to the
+# inputs):
+# archive/<case> - the sources in one archive (assembler --archive input.arc first second ...) and its members list:
+# output.txt, and each member is the same as the output of its source. A case with input.arc is a broken archive, and
+# output.txt is its rejection
+# object/<case> - object_convert input.ob gives input.bo, and object_convert input.bo gives the same text outputs
+# invalid_objects/<case> - object_convert input.ob / input.bo: output.txt (the rejection)
+# disassemble/<case> - object_disassemble input.ob: output.as, and assembling it gives the same outputs
+# run/<case> - assembler --run input, or object_run input.bo if there is no source (stdin is input.txt if it
+# exists): output.txt
+
+TOOLS=$(pwd)
+WORK=${1:-check_outputs}
+FAILED=0
+
+fail() {
+    echo "FAILED: $1"
+    FAILED=1
+}
+
+# The same file, or both don't exist
+same_output() {
+    if [ -f "$1" ] || [ -f "$2" ]; then cmp -s "$1" "$2"; fi
+}
+
+rm -rf "$WORK"
+
+for case in examples/archive/*/; do
+    dir="$WORK/$case"
+    mkdir -p "$dir" && cp "$case"* "$dir" && rm -f "$dir"output.txt
+    if [ -f "$case"input.arc ]; then
+        (cd "$dir" && "$TOOLS"/archive_extract input.arc > output.txt 2>&1) && fail "$case (it was accepted)"
+        same_output "$dir"output.txt "$case"output.txt || fail "$case"
+        continue
+    fi
+
+    # The sources in the archive (in reverse order, so the table is sorted), and each one alone
+    sources=$(cd "$case" && ls -r *.as | sed 's/\.as$//')
+    (cd "$dir" && "$TOOLS"/assembler --archive input.arc $sources; "$TOOLS"/archive_extract input.arc) \
+        > "$dir"output.txt 2>&1
+    (cd "$dir" && for source in $sources; do "$TOOLS"/assembler "$source"; done) > /dev/null 2>&1
+    result=0
+    same_output "$dir"output.txt "$case"output.txt || result=1
+    for source in $sources; do
+        for extension in ob ent ext; do
+            if (cd "$dir" && "$TOOLS"/archive_extract input.arc "$source.$extension" > member 2> /dev/null); then
+                same_output "$dir"member "$dir$source.$extension" || result=1
+            elif [ -f "$dir$source.$extension" ]; then
+                result=1
+            fi
+        done
+    done
+    [ $result = 0 ] || fail "$case"
+done
+
+for case in examples/object/*/; do
+    dir="$WORK/$case"
+    mkdir -p "$dir/text" "$dir/binary" && cp "$case"input.ob "$dir/text" && cp "$case"input.bo "$dir/binary"
+    for extension in ent ext; do [ -f "$case"input.$extension ] && cp "$case"input.$extension "$dir/text"; done
+    (cd "$dir/text" && "$TOOLS"/object_convert input.ob) && (cd "$dir/binary" && "$TOOLS"/object_convert input.bo)
+    result=0
+    same_output "$dir"text/input.bo "$case"input.bo || result=1
+    for extension in ob ent ext; do same_output "$dir"binary/input.$extension "$case"input.$extension || result=1; done
+    [ $result = 0 ] || fail "$case"
+done
+
+for case in examples/invalid_objects/*/; do
+    dir="$WORK/$case"
+    mkdir -p "$dir" && cp "$case"input.* "$dir"
+    object=input.ob
+    [ -f "$case"input.bo ] && object=input.bo
+    (cd "$dir" && "$TOOLS"/object_convert $object > output.txt 2>&1) && fail "$case (it was accepted)"
+    same_output "$dir"output.txt "$case"output.txt || fail "$case"
+done
+
+for case in examples/disassemble/*/; do
+    dir="$WORK/$case"
+    mkdir -p "$dir" && cp "$case"input.ob "$dir"
+    for extension in ent ext; do [ -f "$case"input.$extension ] && cp "$case"input.$extension "$dir"; done
+    (cd "$dir" && "$TOOLS"/object_disassemble input.ob > output.as && "$TOOLS"/assembler output > /dev/null)
+    result=0
+    same_output "$dir"output.as "$case"output.as || result=1
+    for extension in ob ent ext; do same_output "$dir"output.$extension "$case"input.$extension || result=1; done
+    [ $result = 0 ] || fail "$case"
+done
+
+for case in examples/run/*/; do
+    dir="$WORK/$case"
+    mkdir -p "$dir" && cp "$case"input.* "$dir" && rm -f "$dir"input.ob
+    input=/dev/null
+    [ -f "$case"input.txt ] && input="$case"input.txt
+    if [ -f "$case"input.as ]; then
+        (cd "$dir" && "$TOOLS"/assembler --run input > output.txt 2>&1) < "$input"
+        same_output "$dir"input.ob "$case"input.ob || fail "$case"
+    else
+        (cd "$dir" && "$TOOLS"/object_run input.bo > output.txt 2>&1) < "$input"
+    fi
+    same_output "$dir"output.txt "$case"output.txt || fail "$case"
+done
+
+[ $FAILED = 0 ] && echo "All the examples match"
+exit $FAILED
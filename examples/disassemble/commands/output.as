@@ -0,0 +1,26 @@
+.entry MAIN
+.entry LIST
+.extern OUT
+MAIN: mov #-5, r1
+mov LIST, L158[r1][r2]
+cmp r1, r2
+cmp #3, LIST
+add L158[r3][r4], r5
+sub #1, LIST
+lea L158[r0][r1], r6
+lea L153, OUT
+clr L158[r2][r3]
+not r7
+inc LIST
+dec OUT
+jmp L137
+L137: bne MAIN
+jsr L149
+red r0
+prn #-512
+prn L158[r1][r1]
+stop
+L149: rts
+LIST: .data 7, -8, 511
+L153: .data 97, 98, 32, 99, 0
+L158: .data 1, -2, 3, 0, 0, 0, 0, 0
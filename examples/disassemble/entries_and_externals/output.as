@@ -0,0 +1,12 @@
+.entry A
+.entry C
+.entry E
+.extern B
+.extern D
+mov #-5, B
+mov #-8, B
+lea B, r3
+cmp D, B
+A: .data 7, 8, 9
+C: .data 1, 2, 3
+E: .data 4, 5, 6
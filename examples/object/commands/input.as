@@ -0,0 +1,28 @@
+; All the commands with their operand types, and all the data kinds
+.entry MAIN
+.entry LIST
+.extern OUT
+MAIN:   mov #-5, r1
+        mov LIST, M[r1][r2]
+        cmp r1, r2
+        cmp #3, LIST
+        add M[r3][r4], r5
+        sub #1, LIST
+        lea M[r0][r1], r6
+        lea TEXT, OUT
+        clr M[r2][r3]
+        not r7
+        inc LIST
+        dec OUT
+        jmp LOOP
+LOOP:   bne MAIN
+        jsr SUB
+        red r0
+        prn #-512
+        prn M[r1][r1]
+        stop
+SUB:    rts
+LIST:   .data 7, -8, 511
+TEXT:   .string "ab c"
+M:      .mat [2][3] 1, -2, 3
+EMPTY:  .mat [1][2]
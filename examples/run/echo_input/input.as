@@ -0,0 +1,8 @@
+; Print the code of each input char until the end of the input
+; (red reads -1 at the end)
+NEXT:   red r1
+        cmp r1, #-1
+        bne PRINT
+        stop
+PRINT:  prn r1
+        jmp NEXT
@@ -0,0 +1,33 @@
+; Walk a 3x4 mat row by row: print the sum of each row and the total,
+; and copy each cell doubled into another mat, then print its total
+        clr r7
+        clr r1
+ROWS:   clr r2
+        clr r3
+COLS:   mov M[r1][r2], r4
+        add r4, r3
+        add r4, r4
+        mov r4, D[r1][r2]
+        inc r2
+        cmp r2, #4
+        bne COLS
+        prn r3
+        add r3, r7
+        add #4, r1
+        cmp r1, #12
+        bne ROWS
+        prn r7
+        clr r1
+        clr r6
+SUM:    clr r2
+CELLS:  add D[r1][r2], r6
+        inc r2
+        cmp r2, #4
+        bne CELLS
+        add #4, r1
+        cmp r1, #12
+        bne SUM
+        prn r6
+        stop
+M:      .mat [3][4] 1, 2, 3, 4, 5, 6, 7, 8, -9, 10, -11, 12
+D:      .mat [3][4]
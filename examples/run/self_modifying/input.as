@@ -0,0 +1,11 @@
+; The program rewrites its own commands while it runs:
+; in the last pass it copies stop over the jump back to the loop
+        mov #3, r1
+LOOP:   prn r1
+        dec r1
+        cmp r1, #0
+        bne SKIP
+        mov HALT, BACK
+SKIP:   prn #100
+BACK:   jmp LOOP
+HALT:   stop
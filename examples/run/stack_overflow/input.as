@@ -0,0 +1,5 @@
+; Each call calls itself again before it returns,
+; so the return addresses stack overflows
+        prn #1
+REC:    jsr REC
+        stop
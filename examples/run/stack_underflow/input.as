@@ -0,0 +1,5 @@
+; The subroutine returns twice, so the second rts has no return address
+        jsr SUB
+        prn #2
+SUB:    prn #1
+        rts
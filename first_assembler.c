@@ -1,4 +1,3 @@
-#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,41 +5,50 @@
 #include "assembler.h"
 
 
+/**
+ * This function creates copy of the lexed name
+ * The tables keep their own names, because the same lexed line can be used many times (in macros)
+ * @param name The name to copy
+ * @return The new name
+ */
+static char *copy_lexed_name(const char *name) {
+    /* +1 for \0 */
+    char *new_name = malloc(strlen(name) + 1);
+    if (new_name == NULL) {
+        printf("CRITICAL: Failed to allocate memory for new symbol");
+        exit(1);
+    }
+
+    strcpy(new_name, name);
+
+    return new_name;
+}
+
 /**
  * The first assembler
  * In this assembler we create commands, instructions, entries, external abd symbol table
  * Notice we don't insert all address, because we will know them only in the second assembler
  * After we calculate all symbols
- * @param filename The assembler file name
+ * It reads the lexed source lines of the pre assembler (and not the .am file)
  * @param assembler_tables All Assembler tables (include the macro itself)
  * @return The status code of the pre assembler action
  */
-STATUS_CODE first_assembler(char *filename, ASSEMBLER_TABLES *assembler_tables) {
-    /* Define the pre assembler file name to read the code */
-    char *input_file_name_with_extension = add_suffix_to_string(filename, PRE_ASSEMBLER_FILE_EXTENSION);
+STATUS_CODE first_assembler(ASSEMBLER_TABLES *assembler_tables) {
+    /* The expanded source lines */
+    LEXED_SOURCE *lexed_source = assembler_tables->lexed_source;
 
-    /* Define string contains each line (can't be more than the line max length) */
-    char line[LINE_MAX_LENGTH];
+    /* The current line */
+    const LEXED_LINE *lexed_line;
 
     /* Counter for line number in the file */
-    int line_number = 0;
+    int line_number;
 
     /* IC and DC counter init default values */
     int ic = IC_COUNTER_DEFAULT_VALUE, dc = DC_COUNTER_DEFAULT_VALUE;
 
-    /* Command name (e.g. .data/mov/jmp...) */
-    char *command_name;
-
-    /* Pointer to char inside the file line */
-    char *line_ptr;
-
     /* The symbol name of the line (if defined) */
     char *symbol_name;
 
-    /* Entry and External names */
-    char *entry_name;
-    char *external_name;
-
     /* If the assembler was successfully (default ok otherwise we find error) */
     STATUS_CODE status_code = OK;
 
@@ -60,114 +68,102 @@ STATUS_CODE first_assembler(char *filename, ASSEMBLER_TABLES *assembler_tables)
     ENTRY_INSTRUCTION *tail_entry_instruction = NULL;
     ENTRY_INSTRUCTION *new_entry_instruction = NULL;
 
-    /* Find details about commands */
-    const COMMAND_INFO *command_info;
+    /* All the errors and warnings of this file */
+    DIAGNOSTICS *diagnostics = assembler_tables->diagnostics;
 
-    /* Open the input file */
-    FILE *assembly_file = fopen(input_file_name_with_extension, "r");
-    if (assembly_file == NULL) {
-        printf("ERROR: Unable to find or open file %s\n", input_file_name_with_extension);
-        return ERROR;
-    }
+    /* In check mode we only validate, so we don't build any machine codes strings */
+    boolean encode = !assembler_tables->check_only;
 
-    while (fgets(line, sizeof(line), assembly_file) != NULL) {
-        line_ptr = line;
-        /* Update the line number counter */
-        line_number++;
+    /* The pre assembler only collects the lines, now we lex them (big sources in threads) */
+    lex_source_lines(lexed_source, assembler_tables->jobs);
 
-        /* Remove end of line with end of string */
-        trim_newline(line_ptr);
+    for (line_number = 1; line_number <= lexed_source->count; line_number++) {
+        /* We already found enough errors in this file */
+        if (diagnostics_limit_reached(diagnostics)) break;
 
-        /* Line can be starts with empty spaces */
-        skip_empty_spaces(&line_ptr);
+        lexed_line = lexed_source->lines[line_number - 1];
 
         /* Not every ine symbol define, so remove the last line name */
         symbol_name = NULL;
         new_symbol = NULL;
 
-        /* Empty line, go to the next line*/
-        if (!*line_ptr) continue;
-        /* Line with comment, go to the next line*/
-        if (*line_ptr == COMMENT_SYMBOL) continue;
+        /* Empty line or comment line, go to the next line*/
+        if (lexed_line->kind == LINE_EMPTY) continue;
 
-        /* Extract the first word of the line (can be symbol / command / instruction) */
-        command_name = coppy_next_command_or_symbol(&line_ptr, line_number);
-        if (command_name == NULL) {
+        /* The first word of the line is invalid */
+        if (lexed_line->error_stage == LEX_STAGE_FIRST_WORD) {
+            copy_diagnostics(diagnostics, &lexed_line->errors, line_number);
             status_code = ERROR;
             continue;
         }
 
-        /* Possibly a symbol definition, Therefore updating the symbol and the command vars */
-        if (command_name[strlen(command_name) - 1] == SYMBOL_SUFFIX) {
-            /* Replacing symbol name var with command name */
-            symbol_name = malloc(strlen(command_name) + 1);
-            if (symbol_name == NULL) {
-                printf("CRITICAL: Failed to allocate memory for new symbol");
-                exit(1);
-            }
-
-            /* Update the symbol var with current value */
-            strcpy(symbol_name, command_name);
-            /* We don't want to save the last char (':') so we remove this */
-            symbol_name[strlen(symbol_name) - 1] = END_OF_STRING;
-
+        /* Symbol definition */
+        if (lexed_line->label != NULL) {
             /* Check symbol length */
-            if (strlen(symbol_name) > MAX_SYMBOL_LENGTH) {
-                printf("ERROR: (Line %d) Symbol length should be less than %d \n", line_number, MAX_SYMBOL_LENGTH);
+            if (lexed_line->error_stage == LEX_STAGE_LABEL) {
+                copy_diagnostics(diagnostics, &lexed_line->errors, line_number);
                 status_code = ERROR;
                 continue;
             }
-            if (find_symbol_by_name(assembler_tables->symbol_table, symbol_name) != NULL) {
-                printf("ERROR: (Line %d) Symbol name already defined (%s) \n", line_number, symbol_name);
+            if (find_symbol_by_name(assembler_tables->symbol_table, lexed_line->label) != NULL) {
+                report_diagnostic(diagnostics, DIAGNOSTIC_LABEL_DUPLICATE, line_number, lexed_line->label);
                 status_code = ERROR;
                 continue;
             }
-            if (find_macro_by_name(assembler_tables->macro, symbol_name, strlen(symbol_name)) != NULL) {
-                printf("ERROR: (Line %d) Symbol name and macro can't share same name (%s) \n", line_number, symbol_name);
+            if (find_macro_by_name(assembler_tables->macro, lexed_line->label, strlen(lexed_line->label)) != NULL) {
+                report_diagnostic(diagnostics, DIAGNOSTIC_LABEL_IS_MACRO, line_number, lexed_line->label);
                 status_code = ERROR;
                 continue;
             }
 
-            /* Calculate the new command */
-            command_name = coppy_next_command_or_symbol(&line_ptr, line_number);
-
-            if (command_name == NULL) {
+            /* The word after the symbol is invalid */
+            if (lexed_line->error_stage == LEX_STAGE_SECOND_WORD) {
+                copy_diagnostics(diagnostics, &lexed_line->errors, line_number);
                 status_code = ERROR;
                 continue;
             }
+
+            symbol_name = copy_lexed_name(lexed_line->label);
         }
 
-        /* Now line_ptr is after the command and symbol */
-        skip_empty_spaces(&line_ptr);
+        /* Symbol is not allowed in entry and external lines (we ignore these lines) */
+        if (symbol_name != NULL && (lexed_line->kind == LINE_ENTRY || lexed_line->kind == LINE_EXTERN)) {
+            report_diagnostic(diagnostics, lexed_line->kind == LINE_ENTRY ? DIAGNOSTIC_ENTRY_WITH_LABEL
+                                                                          : DIAGNOSTIC_EXTERNAL_WITH_LABEL,
+                              line_number, NULL);
+            free(symbol_name);
+            continue;
+        }
 
-        /* Our command is instruction type */
-        if (*command_name == INSTRUCTION_PREFIX) {
-            /* Ignore the prefix */
-            command_name++;
+        /* Line with symbol, so check it before the data (with the current 'dc' address) */
+        if (symbol_name != NULL && lexed_line->kind != LINE_COMMAND && lexed_line->kind != LINE_INVALID &&
+            find_symbol_by_name(assembler_tables->symbol_table, symbol_name) != NULL) {
+            report_diagnostic(diagnostics, DIAGNOSTIC_DATA_LABEL_DUPLICATE, line_number, symbol_name);
+            free(symbol_name);
+            status_code = ERROR;
+            continue;
+        }
 
-            /* Entry Type */
-            if (strcmp(command_name, ENTRY_INSTRUCTION_NAME) == 0) {
-                if (symbol_name != NULL) {
-                    printf("WARNING: (Line %d) Symbol not should define in entry instruction \n", line_number);
-                    continue;
-                }
-                /* After '.entry' we expected to get the entry name */
-                entry_name = get_current_symbol(&line_ptr, line_number);
+        /* The command / instruction or its params are invalid */
+        if (lexed_line->error_stage == LEX_STAGE_BODY) {
+            copy_diagnostics(diagnostics, &lexed_line->errors, line_number);
+            free(symbol_name);
+            status_code = ERROR;
+            continue;
+        }
 
-                /* Symbol name is invalid */
-                if (entry_name == NULL) {
-                    status_code = ERROR;
-                    continue;
-                }
+        switch (lexed_line->kind) {
+            case LINE_ENTRY:
                 /* Entry Already exist */
-                if (find_entry_instruction(assembler_tables->entry_instruction, entry_name) != NULL) {
-                    printf("ERROR: (Line %d) Found multi entries with same name (%s) \n", line_number, entry_name);
+                if (find_entry_instruction(assembler_tables->entry_instruction, lexed_line->symbol) != NULL) {
+                    report_diagnostic(diagnostics, DIAGNOSTIC_ENTRY_DUPLICATE, line_number, lexed_line->symbol);
                     status_code = ERROR;
                     continue;
                 }
 
                 /* We still don't know this entry address (only in the second assembler) so we set it as 0 */
-                new_entry_instruction = create_entry_instruction(entry_name, 0, line_number);
+                new_entry_instruction = create_entry_instruction(copy_lexed_name(lexed_line->symbol), 0,
+                                                                 line_number);
                 /* Check if this is the first entry in the table */
                 if (assembler_tables->entry_instruction == NULL) {
                     assembler_tables->entry_instruction = new_entry_instruction;
@@ -178,57 +174,59 @@ STATUS_CODE first_assembler(char *filename, ASSEMBLER_TABLES *assembler_tables)
 
                 /*  Update the last entry with the new one */
                 tail_entry_instruction = new_entry_instruction;
-                /* External Type*/
-            } else if (strcmp(command_name, EXTERNAL_INSTRUCTION_NAME) == 0) {
-                if (symbol_name != NULL) {
-                    printf("WARNING: (Line %d) Symbol not should define in external instruction \n", line_number);
-                    continue;
-                }
-                external_name = get_current_symbol(&line_ptr, line_number);
-
-                /* Symbol name is invalid */
-                if (external_name == NULL) {
-                    status_code = ERROR;
-                    continue;
-                }
+                break;
+            case LINE_EXTERN:
                 /* External Already exist */
-                if (find_symbol_by_name(assembler_tables->symbol_table, external_name) != NULL) {
-                    printf("ERROR: (Line %d) Found multi externals with same name (%s) \n", line_number, external_name);
+                if (find_symbol_by_name(assembler_tables->symbol_table, lexed_line->symbol) != NULL) {
+                    report_diagnostic(diagnostics, DIAGNOSTIC_EXTERNAL_DUPLICATE, line_number, lexed_line->symbol);
                     status_code = ERROR;
                     continue;
                 }
 
                 /* In external symbol we don't know the address, so init with 0 */
-                new_symbol = create_symbol(external_name, EXTERNAL, 0);
-                /* Other instruction (data, mat, string)*/
-            } else {
-                /* Line with symbol, so save the symal with the current 'dc' address */
+                new_symbol = create_symbol(copy_lexed_name(lexed_line->symbol), EXTERNAL, 0);
+                break;
+            case LINE_COMMAND:
+                /* Save the symbol with the current ic command */
                 if (symbol_name != NULL) {
-                    /* Already exist */
-                    if (find_symbol_by_name(assembler_tables->symbol_table, symbol_name) != NULL) {
-                        printf("ERROR: (Line %d) Multy symbols with same name (%s) \n", line_number, symbol_name);
-                        status_code = ERROR;
-                        continue;
-                    }
+                    new_symbol = create_symbol(symbol_name, CODE, ic);
+                }
+
+                command_binary_line_new = get_command_operands_machine_codes(lexed_line, &ic, line_number, encode);
+
+                /* This is the first command, so update the head */
+                if (assembler_tables->command_binary_line == NULL) {
+                    assembler_tables->command_binary_line = command_binary_line_new;
+                } else {
+                    /* Connect the new command to the last commands */
+                    command_binary_line_tail->next = command_binary_line_new;
+                }
 
+                /* Can be many machine codes (e.g. command with operands)
+                   So we want to loop over the codes and update the latest for the next time */
+                while (command_binary_line_new->next != NULL)
+                    command_binary_line_new = command_binary_line_new->next;
+                command_binary_line_tail = command_binary_line_new;
+                break;
+            default:
+                /* Line with symbol, so save the symal with the current 'dc' address */
+                if (symbol_name != NULL) {
                     new_symbol = create_symbol(symbol_name, DATA, dc);
                 }
 
-                /* Data Type */
-                if (strcmp(command_name, DATA_INSTRUCTION_NAME) == 0) {
-                    instruction_binary_line_new = get_data_machine_codes(&line_ptr, &dc, line_number);
-                } else if (strcmp(command_name, MAT_INSTRUCTION_NAME) == 0) {
-                    instruction_binary_line_new = get_mat_machine_codes(&line_ptr, &dc, line_number);
-                } else if (strcmp(command_name, STRING_INSTRUCTION_NAME) == 0) {
-                    instruction_binary_line_new = get_string_machine_codes(&line_ptr, &dc, line_number);
+                /* Other instruction (data, mat, string)*/
+                if (lexed_line->kind == LINE_DATA) {
+                    instruction_binary_line_new = get_data_machine_codes(lexed_line, &dc, encode);
+                } else if (lexed_line->kind == LINE_MAT) {
+                    instruction_binary_line_new = get_mat_machine_codes(lexed_line, &dc, encode);
                 } else {
-                    printf("ERROR: (Line %d) Failed to find instruction with name: %s \n", line_number, command_name);
-                    status_code = ERROR;
-                    continue;
+                    instruction_binary_line_new = get_string_machine_codes(lexed_line, &dc, encode);
                 }
 
-                /* The data was invalid */
+                /* The data was empty (e.g. '.mat [0][0]') */
                 if (instruction_binary_line_new == NULL) {
+                    free(symbol_name);
+                    free(new_symbol);
                     status_code = ERROR;
                     continue;
                 }
@@ -245,42 +243,6 @@ STATUS_CODE first_assembler(char *filename, ASSEMBLER_TABLES *assembler_tables)
                 while (instruction_binary_line_new->next != NULL)
                     instruction_binary_line_new = instruction_binary_line_new->next;
                 instruction_binary_line_tail = instruction_binary_line_new;
-            }
-            /* Regular command type */
-        } else {
-            /* Save the symbol with the current ic command */
-            if (symbol_name != NULL) {
-                new_symbol = create_symbol(symbol_name, CODE, ic);
-            }
-
-            /* Find current command info */
-            command_info = get_command_info_by_name(command_name);
-            if (command_info == NULL) {
-                printf("ERROR (Line %d) Flied to find command name (%s) \n", line_number, command_name);
-                status_code = ERROR;
-                continue;
-            }
-
-            command_binary_line_new = get_command_operands_machine_codes(&line_ptr, command_info, &ic, line_number);
-            /*  Failed to calculate the command binaries */
-            if (command_binary_line_new == NULL) {
-                status_code = ERROR;
-                continue;
-            }
-
-            /* This is the first command, so update the head */
-            if (assembler_tables->command_binary_line == NULL) {
-                assembler_tables->command_binary_line = command_binary_line_new;
-            } else {
-                /* Connect the new command to the last commands */
-                command_binary_line_tail->next = command_binary_line_new;
-            }
-
-            /* Can be many instructions (e.g. in .string)
-               So we want to loop over the instruction and update the latest for the next time */
-            while (command_binary_line_new->next != NULL)
-                command_binary_line_new = command_binary_line_new->next;
-            command_binary_line_tail = command_binary_line_new;
         }
 
         /* Update assembler table with the new  */
@@ -290,10 +252,9 @@ STATUS_CODE first_assembler(char *filename, ASSEMBLER_TABLES *assembler_tables)
         }
 
         /* We expect to this line to be ended, so if it doesn't we get unexpected params */
-        if (*line_ptr && *line_ptr != COMMENT_SYMBOL) {
-            printf("ERROR (Line: %d): The line contains unexpected params '%s' \n", line_number, line_ptr);
+        if (lexed_line->error_stage == LEX_STAGE_TRAILING) {
+            copy_diagnostics(diagnostics, &lexed_line->errors, line_number);
             status_code = ERROR;
-            continue;
         }
     }
 
@@ -301,374 +262,329 @@ STATUS_CODE first_assembler(char *filename, ASSEMBLER_TABLES *assembler_tables)
     assembler_tables->ic = ic;
     assembler_tables->dc = dc;
 
-    /* Close the assembler file */
-    fclose(assembly_file);
-
     return status_code;
 }
 
 
 /**
- * This function calculate command (such as mov) operands
- * It clculate all operands machine codes
- * @param operands_ptr Pointer to operands string
- * @param command_info The current command details
+ * This function calculate the command (such as mov) machine codes from the lexed line
+ * It calculates the command word and all operands machine codes
+ * @param lexed_line The lexed command line
  * @param ic The ic counter (It also updates it)
  * @param line_number The command line number
- * @return All operands machine codes
+ * @param encode Should we build the machine codes strings (FALSE only counts the words)
+ * @return All command machine codes
  */
-COMMAND_BINARY_LINE *get_command_operands_machine_codes(char **operands_ptr, const COMMAND_INFO *command_info, int *ic,
-                                                        int line_number) {
-    /* In the end we will update with the real address */
-    char *str = *operands_ptr;
-
-    /* We add +1 for \0 end of string */
-    char *command_binary = malloc(ADDRESS_SIZE + 1);
+COMMAND_BINARY_LINE *get_command_operands_machine_codes(const LEXED_LINE *lexed_line, int *ic, int line_number,
+                                                        boolean encode) {
+    /* The command machine code (stays null when we only validate) */
+    char *command_binary = NULL;
 
     /* If we create address for operand we save it here */
     char *operand_address;
-    /* Hold the command address */
-    int command_address;
 
     /* Init command codes tables */
     COMMAND_BINARY_LINE *head_command_binary_line = NULL;
     COMMAND_BINARY_LINE *tail_command_binary_line = NULL;
     COMMAND_BINARY_LINE *command_binary_line = NULL;
 
-    /* The operands type */
-    OPERAND_TYPE first_operand_type;
-    OPERAND_TYPE second_operand_type;
+    /* The operands (only one operand is the destination) */
+    const LEXED_OPERAND *source_operand = lexed_line->operands_count == 2 ? &lexed_line->operands[0] : NULL;
+    const LEXED_OPERAND *des_operand = lexed_line->operands_count == 0
+                                           ? NULL
+                                           : &lexed_line->operands[lexed_line->operands_count - 1];
+
+    /* Default operand type (0), if we need, we will update them */
+    OPERAND_TYPE source_operand_type = source_operand != NULL ? source_operand->type : 0;
+    OPERAND_TYPE des_operand_type = des_operand != NULL ? des_operand->type : 0;
+
+    /* Now that we know the operands types we can create the command address (it is already built) */
+    if (encode) {
+        /* We add +1 for \0 end of string */
+        command_binary = malloc(ADDRESS_SIZE + 1);
+        if (command_binary == NULL) {
+            printf("CRITICAL: Failed to allocate command machine code.\n");
+            exit(1);
+        }
 
-    /* How much operands we have */
-    int num_of_params;
+        strcpy(command_binary,
+               command_first_words[lexed_line->command_info->command_number][source_operand_type][des_operand_type]);
+    }
 
-    /* Set default operand type (0) in binary. if we need, we will update them */
-    char *source_operand_binary = decimal_to_binary(0, OPERAND_TYPE_BINARY_SIZE);
-    char *des_operand_binary = decimal_to_binary(0, OPERAND_TYPE_BINARY_SIZE);
+    /* Create the command lien itself */
+    command_binary_line = create_command_binary_line((*ic)++, command_binary, line_number);
 
-    /* Find the two operands (if one of them or both are not exist it will set it as undefined) */
-    char *first_param = get_next_command_operand(&str);
-    char *second_param;
+    /* If the both operands are registry thay share the same line (the destination is in the second 4 bits) */
+    if (source_operand_type == REGISTRY && des_operand_type == REGISTRY) {
+        operand_address = NULL;
 
-    /* Validate not containing garbage data */
-    command_binary[0] = END_OF_STRING;
+        if (encode) {
+            operand_address = decimal_to_binary(source_operand->word | (des_operand->word >> REGISTRY_BITS_SIZE),
+                                                ADDRESS_SIZE);
+        }
 
-    /* Insert the command type to the machine code (we will insert the operand type in the next codes) */
-    strcat(command_binary, decimal_to_binary(command_info->command_number, COMMAND_NUMBER_BITS_SIZE));
-    /* Save current address, we will use it when we create the full command binary table */
-    command_address = (*ic)++;
+        command_binary_line->next = create_command_binary_line((*ic)++, operand_address, line_number);
 
-    /* Can be r2  ,*/
-    skip_empty_spaces(&str);
+        return command_binary_line;
+    }
 
-    /* If we don't have ',' should not be more operands */
-    if (*str != DATA_DELIMITER) {
-        if (*str && *str != COMMENT_SYMBOL) {
-            printf("ERROR: (Line %d) After one operand should be , to another operand (%s) \n", line_number, str);
-            return NULL;
-        }
+    if (source_operand != NULL) {
+        head_command_binary_line = extract_operand_binary(source_operand, ic, line_number, encode);
+        tail_command_binary_line = head_command_binary_line;
 
-        /* We have only one operand -> set the second as undefined */
-        second_param = NULL;
-    } else {
-        /* Skip the DATA_DELIMITER */
-        str++;
-        second_param = get_next_command_operand(&str);
+        /* Can be more that one line in same operand */
+        while (tail_command_binary_line->next != NULL) tail_command_binary_line = tail_command_binary_line->next;
+    }
 
-        if (second_param == NULL) {
-            printf("ERROR: (Line %d) Unexpected second param value \n", line_number);
-            return NULL;
+    if (des_operand != NULL) {
+        /* Added the destination operand address */
+        if (tail_command_binary_line == NULL) {
+            head_command_binary_line = extract_operand_binary(des_operand, ic, line_number, encode);
+        } else {
+            tail_command_binary_line->next = extract_operand_binary(des_operand, ic, line_number, encode);
         }
     }
 
-    /* Find the operands type (can be undefined for invalid operands or empty one) */
-    first_operand_type = find_operand_type(first_param, line_number);
-    second_operand_type = find_operand_type(second_param, line_number);
+    /* Add the operands after the command line */
+    command_binary_line->next = head_command_binary_line;
 
-    /* Invalid operands format */
-    if (first_operand_type == INVALID_OPERAND || second_operand_type == INVALID_OPERAND) {
-        return NULL;
-    }
+    return command_binary_line;
+}
 
 
-    /* If one of param is none !!param will return 0 so if we combine the sum we get the number of params */
-    num_of_params = !!first_param + !!second_param;
-    /* Check correct number of operands (for more operands we will deal with in the next) */
-    if (num_of_params != command_info->num_of_operands) {
-        printf("ERROR: (Line: %d) Unexpected number of operands (Expected: %d, Actual: %d) \n",
-               line_number, command_info->num_of_operands, num_of_params
-        );
-        return NULL;
-    }
+/**
+ * Create data words node for number of words, and move the dc after them
+ * The words are written by the caller directly into the node machine code
+ * @param dc The dc counter (It also update it with the new value)
+ * @param words_count The number of words
+ * @param encode Should we allocate the machine codes (FALSE only counts the words)
+ * @return The new data words node
+ */
+static INSTRUCTION_BINARY_LINE *create_data_words(int *dc, int words_count, boolean encode) {
+    /* The words machine codes (+1 for \0) */
+    char *machine_code = NULL;
 
-    /* We don't have any operands (e.g. stop command) */
-    if (first_operand_type == UNDEFINED && second_operand_type == UNDEFINED) {
-        head_command_binary_line = NULL;
-        /* We have only one operand */
-    } else if (second_operand_type == UNDEFINED) {
-        if (!is_valid_operand_type(first_operand_type, command_info, DES_OPERAND_ORDER)) {
-            printf("ERROR: (Line: %d) Unexpected destination operand type \n", line_number);
-            return NULL;
-        }
+    INSTRUCTION_BINARY_LINE *data_words;
 
-        head_command_binary_line = extract_operand_binary(first_param, ic, first_operand_type, line_number);
-        des_operand_binary = decimal_to_binary(first_operand_type, OPERAND_TYPE_BINARY_SIZE);
-    } else {
-        if (!is_valid_operand_type(first_operand_type, command_info, SOURCE_OPERAND_ORDER)) {
-            printf("ERROR: (Line: %d) Unexpected source operand type \n", line_number);
-            return NULL;
-        }
-        if (!is_valid_operand_type(second_operand_type, command_info, DES_OPERAND_ORDER)) {
-            printf("ERROR: (Line: %d) Unexpected destination operand type \n", line_number);
-            return NULL;
+    if (encode) {
+        machine_code = malloc(words_count * ADDRESS_SIZE + 1);
+        if (machine_code == NULL) {
+            printf("CRITICAL: Failed to allocate data words.\n");
+            exit(1);
         }
+        machine_code[words_count * ADDRESS_SIZE] = END_OF_STRING;
+    }
 
-        source_operand_binary = decimal_to_binary(first_operand_type, OPERAND_TYPE_BINARY_SIZE);
-        des_operand_binary = decimal_to_binary(second_operand_type, OPERAND_TYPE_BINARY_SIZE);
-        /* If the both operands are registry thay share the same line */
-        if (first_operand_type == REGISTRY && second_operand_type == REGISTRY) {
-            /* We add +1 for \0 */
-            operand_address = malloc(COMMAND_NUMBER_BITS_SIZE + 1);
+    data_words = create_instruction_binary_line(*dc, machine_code);
+    data_words->words_count = words_count;
+    *dc += words_count;
 
-            /* Validate the end is in the start*/
-            operand_address[0] = END_OF_STRING;
+    return data_words;
+}
 
-            /* Update the registry address */
-            strcat(operand_address, decimal_to_binary(first_param[1] - '0', REGISTRY_BITS_SIZE));
-            strcat(operand_address, decimal_to_binary(second_param[1] - '0', REGISTRY_BITS_SIZE));
-            /* Update the ERA (in registry 0) */
-            strcat(operand_address, decimal_to_binary(0, ERA_BITS_SIZE));
+/**
+ * This calculates mat instruction type data machine codes
+ * Every cell in the mat is specific machine code,
+ * So our final machine codes will be row*col (missing values are zero)
+ * The missing values are saved as one repeated word (they are expanded only in the output)
+ * @param lexed_line The lexed mat line
+ * @param dc The dc count (It also update it with the new value)
+ * @param encode Should we build the machine codes strings (FALSE only counts the words)
+ * @return All mat instructions machine codes
+ */
+INSTRUCTION_BINARY_LINE *get_mat_machine_codes(const LEXED_LINE *lexed_line, int *dc, boolean encode) {
+    /* The defined cells, and the missing cells */
+    INSTRUCTION_BINARY_LINE *defined_cells = NULL;
+    INSTRUCTION_BINARY_LINE *default_cells = NULL;
 
-            head_command_binary_line = create_command_binary_line((*ic)++, operand_address, line_number);
-        } else {
-            head_command_binary_line = extract_operand_binary(first_param, ic, first_operand_type, line_number);
-            tail_command_binary_line = head_command_binary_line;
+    /* Loop counter */
+    int i;
 
-            /* Can be more that one line in same operand */
-            while (tail_command_binary_line->next != NULL) tail_command_binary_line = tail_command_binary_line->next;
+    /* Empty mat (e.g. '.mat [0][2]') has no machine codes */
+    if (lexed_line->mat_size <= 0) return NULL;
 
-            /* Added the second operand address */
-            tail_command_binary_line->next = extract_operand_binary(second_param, ic, second_operand_type, line_number);
+    if (lexed_line->numbers_count > 0) {
+        defined_cells = create_data_words(dc, lexed_line->numbers_count, encode);
+        for (i = 0; encode && i < lexed_line->numbers_count; i++) {
+            write_binary(defined_cells->machine_code + i * ADDRESS_SIZE, lexed_line->numbers[i], ADDRESS_SIZE);
         }
     }
 
-    /* Now that we know the operands types we can create the command address */
-    strcat(command_binary, source_operand_binary);
-    strcat(command_binary, des_operand_binary);
-    strcat(command_binary, decimal_to_binary(COMMAND_ERA_DEFAULT_VALUE, ERA_BITS_SIZE));
-
-    /* Create the command lien itself and add it to the start */
-    command_binary_line = create_command_binary_line(command_address, command_binary, line_number);
-    command_binary_line->next = head_command_binary_line;
+    /* All the missing cells have the default value */
+    if (lexed_line->numbers_count < lexed_line->mat_size) {
+        default_cells = create_instruction_binary_line(
+            *dc, encode ? decimal_to_binary(MAT_DEFAULT_VALUE, ADDRESS_SIZE) : NULL);
+        default_cells->repeat_count = lexed_line->mat_size - lexed_line->numbers_count;
+        *dc += default_cells->repeat_count;
+    }
 
-    /* Update the pointer actual address */
-    *operands_ptr = str;
+    if (defined_cells == NULL) return default_cells;
 
-    return command_binary_line;
+    defined_cells->next = default_cells;
+    return defined_cells;
 }
 
 
 /**
- * This calculates mat instruction type data machine codes
- * Every cell in the mat is specific machine code,
- * So our final machine codes will be row*col
- * @param mat_instruction_ptr Pointer to mat data
- * @param dc The dc count (It also update it with the new value)
- * @param line_number The mat line number in the assembly file
- * @return All mat instructions machine codes
+ * This function decodes the next command operand in one scan of the line
+ * It finds the operand text (until end / empty char / comma, or the end of the mat brackets),
+ * its type, its values and its extra word, and the symbol name (SYMBOL / MAT)
+ * Errors are not reported here, so the caller can report them in the right order:
+ * invalid registry number is INVALID_OPERAND type, and invalid mat registries is ERROR mat status
+ * @param str_ptr Pointer ot operands string (It updates it only if we find operand)
+ * @param decoded_operand The decoded operand to update (empty text if there is no operand)
  */
-INSTRUCTION_BINARY_LINE *get_mat_machine_codes(char **mat_instruction_ptr, int *dc, int line_number) {
-    /* In the function end we want to update to the new address */
-    char *mat_instruction = *mat_instruction_ptr;
-
-    /* Init instruction tables */
-    INSTRUCTION_BINARY_LINE *head_instruction_binary_line = NULL;
-    INSTRUCTION_BINARY_LINE *last_instruction_binary_line = NULL;
-    INSTRUCTION_BINARY_LINE *new_instruction_binary_line = NULL;
+void decode_command_operand(char **str_ptr, DECODED_OPERAND *decoded_operand) {
+    /* We will update the real address in the end */
+    char *str = *str_ptr;
 
-    /* We need to define num_of_params in the address */
-    int num_of_params = get_mat_instruction_size(&mat_instruction);
+    /* In mat can be space between the symbol and the [] so we save another pointer to check if this is mat */
+    char *mat_str;
 
-    /* Check how much actually params we got */
-    int actual_params_number = 0;
+    /* Did we already find the whole mat (symbol and valid registries) */
+    boolean is_mat_found = FALSE;
 
-    /* The current number value */
-    int current_number;
+    /* The number value (SIMPLE), only its word bits are used so we keep only them (it can't overflow) */
+    unsigned int number = 0;
+    boolean is_negative = FALSE;
 
-    /* Loop counter */
-    int i;
+    LEXED_OPERAND *operand = &decoded_operand->operand;
 
-    /* Error in mat definition size */
-    if (num_of_params == -1) {
-        printf("ERROR: (Line %d) Invalid mat definition syntax \n", line_number);
-        return NULL;
-    }
+    /* Before the operand can be spaces (e.g. 'mov  r2') */
+    skip_empty_spaces(&str);
+    decoded_operand->text.start = str;
+    decoded_operand->text.length = 0;
+    decoded_operand->symbol = decoded_operand->text;
+    decoded_operand->mat_status = OK;
+    operand->type = UNDEFINED;
+    operand->value = 0;
+    operand->second_value = 0;
+    operand->word = 0;
+    operand->symbol = NULL;
+
+    if (*str == END_OF_STRING) return;
 
-    /* We can define .mat[1][2]    3 -> so skip all these empty spaces */
-    skip_empty_spaces(&mat_instruction);
+    /* Number operand starts with # */
+    if (*str == NUMBER_PREFIX) {
+        str++;
 
-    /* If the first value starts with invalid char (e.g. '.mat ,') */
-    if (*mat_instruction && !isdigit(*mat_instruction) && *mat_instruction != POSITIVE_NUMBER_SYMBOL && *mat_instruction
-        !=
-        NEGATIVE_NUMBER_SYMBOL) {
-        printf("ERROR: (Line %d) Number must start with a valid number or +/- symbols \n", line_number);
-        return NULL;
-    }
+        /* Number can start with + / - or not */
+        is_negative = *str == NEGATIVE_NUMBER_SYMBOL;
+        if (is_negative || *str == POSITIVE_NUMBER_SYMBOL) str++;
 
-    while (*mat_instruction) {
-        /* We update the current number and if we get error we return null */
-        if (get_next_number_from_instruction_params(&mat_instruction, &current_number, line_number) == ERROR) {
-            return NULL;
+        /* The number is the digits until the first none digit */
+        while (IS_DIGIT_CHAR(*str)) {
+            number = (number * 10 + (*str - '0')) & ADDRESS_MASK;
+            str++;
         }
+    }
 
-        /* We have new number, so update the counter */
-        actual_params_number++;
-
-        /* We got more than expected params */
-        if (actual_params_number > num_of_params) {
-            printf("ERROR: (Line %d) Number of params should not be more than %d \n", line_number, num_of_params);
-            return NULL;
-        }
+    /* Can be any letter or number (this is also the symbol of mat) */
+    decoded_operand->symbol.start = str;
+    while (IS_ALNUM_CHAR(*str)) str++;
+    decoded_operand->symbol.length = str - decoded_operand->symbol.start;
 
-        /* Update the new number value with current number */
-        new_instruction_binary_line = create_instruction_binary_line(
-            (*dc)++, decimal_to_binary(current_number, ADDRESS_SIZE));
-        if (head_instruction_binary_line == NULL) {
-            head_instruction_binary_line = new_instruction_binary_line;;
-        } else {
-            last_instruction_binary_line->next = new_instruction_binary_line;
+    /* Mat has its registries right after the symbol, we read them in the same scan */
+    if (*decoded_operand->text.start != NUMBER_PREFIX && *str == MAT_OPEN_BRACKET) {
+        mat_str = str;
+        decoded_operand->mat_status = get_mat_registries(&mat_str, &operand->value, &operand->second_value);
+        if (decoded_operand->mat_status == OK) {
+            is_mat_found = TRUE;
+            str = mat_str;
         }
-        last_instruction_binary_line = new_instruction_binary_line;
     }
 
-    /* Added default values for other mat cells */
-    for (i = 0; i < num_of_params - actual_params_number; i++) {
-        /* We set default value for empty cells */
-        new_instruction_binary_line = create_instruction_binary_line(
-            (*dc)++, decimal_to_binary(MAT_DEFAULT_VALUE, ADDRESS_SIZE));
-        if (head_instruction_binary_line == NULL) {
-            head_instruction_binary_line = new_instruction_binary_line;;
-        } else {
-            last_instruction_binary_line->next = new_instruction_binary_line;
+    /* Check if this is mat, and if it is the length is greater than regular operand */
+    if (!is_mat_found) {
+        mat_str = str;
+        skip_empty_spaces(&mat_str);
+        if (*mat_str == MAT_OPEN_BRACKET) {
+            /* Go until the first close bracket */
+            while (*mat_str && *mat_str != MAT_CLOSE_BRACKET) mat_str++;
+            if (*mat_str && *mat_str == MAT_CLOSE_BRACKET) mat_str++;
+            /* Go until the final mat string */
+            while (*mat_str && *mat_str != MAT_CLOSE_BRACKET) mat_str++;
+        }
+        if (*mat_str == MAT_CLOSE_BRACKET) {
+            str = mat_str + 1;
         }
-        last_instruction_binary_line = new_instruction_binary_line;
     }
 
-    /* Update the new address */
-    *mat_instruction_ptr = mat_instruction;
-
-    return head_instruction_binary_line;
-}
-
-
-/**
- * It gets regular command operand and try to find its type (Mat, symbol, ect...)
- * @param operand The operand string
- * @param line_number The line number of the operand
- * @return The operand type
- */
-OPERAND_TYPE find_operand_type(const char *operand, int line_number) {
-    /* We hold the registry number (e.g. r4 -> 4)*/
-    int registry_number;
+    /* Calculate the operand size */
+    decoded_operand->text.length = str - decoded_operand->text.start;
 
-    /* This is empty string */
-    if (operand == NULL || !*operand) {
-        return UNDEFINED;
+    /* Invalid operand length or undined number (only #) */
+    if (decoded_operand->text.length == 0 ||
+        (decoded_operand->text.length == 1 && *decoded_operand->text.start == NUMBER_PREFIX)) {
+        decoded_operand->text.length = 0;
+        operand->type = UNDEFINED;
+        return;
     }
 
-    /* This is symple number */
-    if (operand[0] == NUMBER_PREFIX) {
-        return SIMPLE;
-    }
+    /* Update the pointer with the new address */
+    *str_ptr = str;
 
-    /* Check if this is registry */
-    if (operand[0] == REGISTRY_PREFIX) {
-        /* Registry syntax should be length two with 'r' and after that digit, otherwise this is symbol */
-        if (strlen(operand) == 2 && isdigit(operand[1])) {
-            /* Convert the registry number to int */
-            registry_number = operand[1] - '0';
-
-            /* Invalid registry syntax */
-            if (registry_number < MIN_REGISTRY_NUMBER || registry_number > MAX_REGISTRY_NUMBER) {
-                printf("ERROR: (Line %d) Invalid registry number (%s) \n", line_number, operand);
-                return INVALID_OPERAND;
-            }
+    if (*decoded_operand->text.start == NUMBER_PREFIX) {
+        operand->type = SIMPLE;
+        operand->value = is_negative ? -(int) number : (int) number;
+        operand->word = operand->value;
+    }
+    /* Registry syntax should be length two with 'r' and after that digit, otherwise this is symbol */
+    else if (*decoded_operand->text.start == REGISTRY_PREFIX && decoded_operand->text.length == 2 &&
+             IS_DIGIT_CHAR(decoded_operand->text.start[1])) {
+        operand->value = decoded_operand->text.start[1] - '0';
 
-            return REGISTRY;
+        /* Invalid registry syntax */
+        if (operand->value < MIN_REGISTRY_NUMBER || operand->value > MAX_REGISTRY_NUMBER) {
+            operand->type = INVALID_OPERAND;
+            return;
         }
-    }
 
-    /* Operands can be any letter, member, [ */
-    while (isalnum(*operand) || *operand == MAT_OPEN_BRACKET) {
-        if (*operand == MAT_OPEN_BRACKET)
-            return MAT;
-        operand++;
+        /* Registry is saved in the first 4 bits (The ERA is 0) */
+        operand->type = REGISTRY;
+        operand->word = operand->value << (REGISTRY_BITS_SIZE + ERA_BITS_SIZE);
     }
+    /* Mat has [ right after the symbol (and inside the operand, e.g. 'M1[r1' is symbol and more params) */
+    else if (decoded_operand->symbol.start[decoded_operand->symbol.length] == MAT_OPEN_BRACKET &&
+             decoded_operand->symbol.length < str - decoded_operand->symbol.start) {
+        operand->type = MAT;
 
-    /* We find all other type so it must be symbol */
-    return SYMBOL;
+        /* The two registries are saved in the first and second 4 bits (The ERA is 0) */
+        operand->word = (operand->value << (REGISTRY_BITS_SIZE + ERA_BITS_SIZE)) |
+                        (operand->second_value << ERA_BITS_SIZE);
+    } else {
+        /* We find all other type so it must be symbol (its word is known only in the second assembler) */
+        operand->type = SYMBOL;
+        decoded_operand->symbol = decoded_operand->text;
+    }
 }
 
 /**
- * Calculate the operands binary codes
- * If it finds invalid operand will return null
- * @param operand The operand as string
+ * Calculate the operand binary codes
+ * @param operand The lexed operand
  * @param ic The ic counter
- * @param operand_type The operand type
  * @param line_number The line which the operand exist
+ * @param encode Should we build the machine codes strings (FALSE only counts the words)
  * @return Tables of the binaries operands
  */
-COMMAND_BINARY_LINE *extract_operand_binary(char *operand, int *ic, OPERAND_TYPE operand_type, int line_number) {
-    /* The binary address in bits */
-    char *address;
-    /* The registry values as int */
-    int first_registry_num = 0, second_registry_num = 0;
-
+COMMAND_BINARY_LINE *extract_operand_binary(const LEXED_OPERAND *operand, int *ic, int line_number, boolean encode) {
     /* When we have more than one binary lines we should save these here */
     COMMAND_BINARY_LINE *additional_binary_lines = NULL;
     COMMAND_BINARY_LINE *new_binary_lines = NULL;
 
-    if (operand_type == SIMPLE) {
-        /* We have only one binary -> the number itself */
-        return create_command_binary_line((*ic)++, decimal_to_binary(atoi(++operand), ADDRESS_SIZE), line_number);
-    }
-    if (operand_type == SYMBOL) {
+    if (operand->type == SYMBOL) {
         /* We still don't know the address so we put the symbol name, and in the second assembly we will update it */
-        return create_command_binary_line((*ic)++, operand, line_number);
+        return create_command_binary_line((*ic)++, copy_lexed_name(operand->symbol), line_number);
     }
 
-    /* Additional +1 for \0 */
-    address = malloc(COMMAND_NUMBER_BITS_SIZE + 1);
-
-    /* Validate empty string */
-    address[0] = END_OF_STRING;
-
-    if (operand_type == MAT) {
+    if (operand->type == MAT) {
         /* Added the mat symbol to binary line (Will update in the second) */
-        additional_binary_lines = create_command_binary_line((*ic)++, extract_mat_symbol(&operand), line_number);
-        /* Extract the two registries, and also check for error */
-        if (get_mat_registries(&operand, &first_registry_num, &second_registry_num) == ERROR) {
-            printf("ERROR: (Line %d) Invalid mat syntax \n", line_number);
-            return NULL;
-        }
-    }
-
-    if (operand_type == REGISTRY && strlen(operand) >= REGISTRY_MIN_LENGTH) {
-        /* Registry second char is the registry number */
-        first_registry_num = operand[1] - '0';
-        /* We don't touch the second 4 bits */
-        second_registry_num = 0;
+        additional_binary_lines = create_command_binary_line((*ic)++, copy_lexed_name(operand->symbol), line_number);
     }
 
-    /* Insert to binary the registries addresses */
-    strcat(address, decimal_to_binary(first_registry_num, REGISTRY_BITS_SIZE));
-    strcat(address, decimal_to_binary(second_registry_num, REGISTRY_BITS_SIZE));
-
-    /* This is registry so the ERA is 0 */
-    strcat(address, decimal_to_binary(0, ERA_BITS_SIZE));
-
-    /* Init the registry addresses */
-    new_binary_lines = create_command_binary_line((*ic)++, address, line_number);
+    /* The number or the registries word (the decoder already built it) */
+    new_binary_lines = create_command_binary_line((*ic)++, encode ? decimal_to_binary(operand->word, ADDRESS_SIZE)
+                                                                  : NULL, line_number);
 
     /* We have only one line so return this */
     if (additional_binary_lines == NULL) return new_binary_lines;
@@ -679,168 +595,52 @@ COMMAND_BINARY_LINE *extract_operand_binary(char *operand, int *ic, OPERAND_TYPE
     return additional_binary_lines;
 }
 
-/**
- * This function gets pointer to mat instruction,
- * It will return the mat symbol
- * @param input Pointer to the matb instruction
- * @return The mat symbol
- */
-char *extract_mat_symbol(char **input) {
-    /* Additional pointer, for real update location */
-    char *str = *input;
-
-    /* For loop counter */
-    int i = 0;
-
-    /* The final mat symbol */
-    char *result;
-
-    /* Count until we arrive to the end of the symbol */
-    while (isalnum(str[i])) i++;
-
-    /* Init new address for the symbol (+1 for \0) */
-    result = malloc(i + 1);
-    if (result == NULL) {
-        printf("CRITICAL: Failed to allocate memory for mat symbol.");
-        exit(1);
-    }
-
-    /* Copy the new symbol name */
-    strncpy(result, str, i);
-    result[i] = END_OF_STRING;
-
-    /* Update the original pointer */
-    *input = str + i;
-
-    return result;
-}
-
 
 /**
  * Calculate the string instruction machine codes
  * It adds zero to the string end (to indicate the end of the string)
- * It also update the string to the next word (skip the string itself)
- * @param str_ptr Pointer to the string
+ * All the chars are written into one data words node
+ * @param lexed_line The lexed string line
  * @param dc The dc counter
+ * @param encode Should we build the machine codes strings (FALSE only counts the words)
  * @return All string machine codes
  */
-INSTRUCTION_BINARY_LINE *get_string_machine_codes(char **str_ptr, int *dc, int line_number) {
-    /* New string to go ever the string and update in the end */
-    char *str = *str_ptr;
-
-    /* Init all our tables (We create tail to avoid loop all over the tables again and again) */
-    INSTRUCTION_BINARY_LINE *head_instruction_binary_line = NULL;
-    INSTRUCTION_BINARY_LINE *tail_instruction_binary_line = NULL;
-    INSTRUCTION_BINARY_LINE *new_instruction_binary_line = NULL;
-
-    /* The 0 in the end pf the string */
-    INSTRUCTION_BINARY_LINE *end_of_the_string;
-
-
-    /* We don't have any string as parameter */
-    if (*str == END_OF_STRING || *str != STRING_SYMBOL) {
-        printf("ERROR: (Line %d) Failed to find any actual string. \n", line_number);
-        return NULL;
-    }
-
-    /* Skip the string start symbol ('"') */
-    str++;
-
-    /* Loop until the end of string or the line end (and after the while throw error)*/
-    while (*str && *str != STRING_SYMBOL) {
-        /* create the current char string machine code */
-        new_instruction_binary_line = create_instruction_binary_line((*dc)++, decimal_to_binary(*str, 10));
-
-        /* Update the table with the new char machine code */
-        if (head_instruction_binary_line == NULL) {
-            head_instruction_binary_line = new_instruction_binary_line;
-        } else {
-            tail_instruction_binary_line->next = new_instruction_binary_line;
-        }
-        tail_instruction_binary_line = new_instruction_binary_line;
-
-        /* Go to next char */
-        str++;
-    }
+INSTRUCTION_BINARY_LINE *get_string_machine_codes(const LEXED_LINE *lexed_line, int *dc, boolean encode) {
+    /* All the string chars and the 0 in the end pf the string */
+    INSTRUCTION_BINARY_LINE *string_words = create_data_words(dc, lexed_line->string_length + 1, encode);
 
-    /* Wo don't close our string with the symbol */
-    if (*str != STRING_SYMBOL) {
-        printf("ERROR: (Line %d) Forget to close your string. \n", line_number);
-        return NULL;
-    }
+    /* Loop counter */
+    int i;
 
-    /* Create the last 0 char in the end */
-    end_of_the_string = create_instruction_binary_line((*dc)++, decimal_to_binary(0, 10));
+    if (!encode) return string_words;
 
-    /* Our string is not empty -> so add to the last one */
-    if (tail_instruction_binary_line != NULL) {
-        tail_instruction_binary_line->next = end_of_the_string;
-    }
-    /* Our string is empty, so only update the head */
-    else {
-        head_instruction_binary_line = end_of_the_string;
+    for (i = 0; i < lexed_line->string_length; i++) {
+        write_binary(string_words->machine_code + i * ADDRESS_SIZE, lexed_line->string_start[i], ADDRESS_SIZE);
     }
+    write_binary(string_words->machine_code + i * ADDRESS_SIZE, 0, ADDRESS_SIZE);
 
-    /* Skip last '"' char */
-    str++;
-
-    /* Update the string param with the new address */
-    *str_ptr = str;
-
-    return head_instruction_binary_line;
+    return string_words;
 }
 
 /**
  * Get the data instruction number machine codes
- * If the data is invalid this function prints the error and return null
- * This also updates the string with the new address
- * @param str_ptr Pointer to data string contains the numbers
+ * All the numbers are written into one data words node
+ * @param lexed_line The lexed data line
  * @param dc The dc counter
+ * @param encode Should we build the machine codes strings (FALSE only counts the words)
  * @return The data instruction machine code
  */
-INSTRUCTION_BINARY_LINE *get_data_machine_codes(char **str_ptr, int *dc, int line_number) {
-    /* Create new pointer, and in the end update the param with that value */
-    char *str = *str_ptr;
-
-    /* Init the tables */
-    INSTRUCTION_BINARY_LINE *head_instruction_binary_line = NULL;
-    INSTRUCTION_BINARY_LINE *tail_instruction_binary_line = NULL;
-    INSTRUCTION_BINARY_LINE *new_instruction_binary_line = NULL;
-
-    /* Hold current number value */
-    int current_number;
-
-    /* We can define .data    3 -> so skip all these empty spaces */
-    skip_empty_spaces(&str);
+INSTRUCTION_BINARY_LINE *get_data_machine_codes(const LEXED_LINE *lexed_line, int *dc, boolean encode) {
+    INSTRUCTION_BINARY_LINE *data_words = create_data_words(dc, lexed_line->numbers_count, encode);
 
-    /* If the first value starts with invalid char (e.g. '.data ,') */
-    if (!isdigit(*str) && *str != POSITIVE_NUMBER_SYMBOL && *str != NEGATIVE_NUMBER_SYMBOL) {
-        printf("ERROR: (Line %d) Number must start with a valid number or +/- symbols \n", line_number);
-        return NULL;
-    }
-
-    while (*str) {
-        if (get_next_number_from_instruction_params(&str, &current_number, line_number) == ERROR) {
-            return NULL;
-        }
-
-        /* Create new machine code for current number */
-        new_instruction_binary_line = create_instruction_binary_line(
-            (*dc)++, decimal_to_binary(current_number, ADDRESS_SIZE));
+    /* Loop counter */
+    int i;
 
-        /* Update the instructions tables with the new value */
-        if (head_instruction_binary_line == NULL) {
-            head_instruction_binary_line = new_instruction_binary_line;
-        } else {
-            tail_instruction_binary_line->next = new_instruction_binary_line;
-        }
-        tail_instruction_binary_line = new_instruction_binary_line;
+    for (i = 0; encode && i < lexed_line->numbers_count; i++) {
+        write_binary(data_words->machine_code + i * ADDRESS_SIZE, lexed_line->numbers[i], ADDRESS_SIZE);
     }
 
-    /* Update the original string with the new address */
-    *str_ptr = str;
-
-    return head_instruction_binary_line;
+    return data_words;
 }
 
 
@@ -855,8 +655,8 @@ int get_mat_instruction_size(char **mat_ptr) {
     /* In the end we update the new address */
     char *mat = *mat_ptr;
 
-    /* The row and col size as string */
-    char *row_size_as_string, *col_size_as_string;
+    /* The row and col size inside the string */
+    TOKEN_SLICE row_size_as_string, col_size_as_string;
 
     /* The row and col size as int */
     int row_size, col_size;
@@ -873,7 +673,7 @@ int get_mat_instruction_size(char **mat_ptr) {
 
     row_size_as_string = copy_next_number(&mat);
 
-    if (row_size_as_string == NULL) return -1;
+    if (row_size_as_string.length == 0) return -1;
 
     skip_empty_spaces(&mat);
 
@@ -887,7 +687,7 @@ int get_mat_instruction_size(char **mat_ptr) {
     skip_empty_spaces(&mat);
     col_size_as_string = copy_next_number(&mat);
 
-    if (col_size_as_string == NULL) return -1;
+    if (col_size_as_string.length == 0) return -1;
 
     skip_empty_spaces(&mat);
     if (*mat != MAT_CLOSE_BRACKET) return -1;
@@ -896,8 +696,9 @@ int get_mat_instruction_size(char **mat_ptr) {
     /* Update the new address */
     *mat_ptr = mat;
 
-    row_size = atoi(row_size_as_string);
-    col_size = atoi(col_size_as_string);
+    /* atoi stops in the first none digit, so it reads only the number itself */
+    row_size = atoi(row_size_as_string.start);
+    col_size = atoi(col_size_as_string.start);
 
     return row_size * col_size;
 }
@@ -928,7 +729,7 @@ STATUS_CODE get_mat_registries(char **mat_ptr, int *r1_out, int *r2_out) {
     skip_empty_spaces(&mat);
     if (!*mat || *mat != REGISTRY_PREFIX) return ERROR;
     mat++;
-    if (!*mat || !isdigit(*mat)) return ERROR;
+    if (!*mat || !IS_DIGIT_CHAR(*mat)) return ERROR;
     row_size = *mat - '0';
     mat++;
     skip_empty_spaces(&mat);
@@ -941,7 +742,7 @@ STATUS_CODE get_mat_registries(char **mat_ptr, int *r1_out, int *r2_out) {
     skip_empty_spaces(&mat);
     if (!*mat || *mat != REGISTRY_PREFIX) return ERROR;
     mat++;
-    if (!*mat || !isdigit(*mat)) return ERROR;
+    if (!*mat || !IS_DIGIT_CHAR(*mat)) return ERROR;
     col_size = *mat - '0';
     mat++;
     skip_empty_spaces(&mat);
@@ -965,31 +766,31 @@ STATUS_CODE get_mat_registries(char **mat_ptr, int *r1_out, int *r2_out) {
  * @param instruction_params The instruction params
  * @param out_member Pointer to int which we want to update the integre value
  * @param line_number The instrunction line in the assembler file
+ * @param diagnostics The diagnostics sink
  * @return Pointer to the number value
  */
-STATUS_CODE get_next_number_from_instruction_params(char **instruction_params, int *out_member, int line_number) {
+STATUS_CODE get_next_number_from_instruction_params(char **instruction_params, int *out_member, int line_number,
+                                                    DIAGNOSTICS *diagnostics) {
     /* In the end we update the new address */
     char *str = *instruction_params;
-    /* Hold current number value as string */
-    char *current_number;
+    /* Hold current number inside the string */
+    TOKEN_SLICE current_number;
     /* Hold current number value as int */
     int number_as_int;
 
     current_number = copy_next_number(&str);
 
     /* We don't find number, instead we find another char (e.g. adsad) */
-    if (current_number == NULL) {
-        printf("ERROR: (Line %d) Expected number values after data instruction \n", line_number);
+    if (current_number.length == 0) {
+        report_diagnostic(diagnostics, DIAGNOSTIC_NUMBER_EXPECTED, line_number, NULL);
         return ERROR;
     }
 
-    /* Convert to actual number */
-    number_as_int = atoi(current_number);
-
-    /* We only have 10 bits so we have to check we don't get number with more bits */
-    if (number_as_int > MAX_POSITIVE_NUMBER_VALUE || number_as_int < MIN_NEGATIVE_NUMBER_VALUE) {
-        printf("ERROR: (Line %d) Number in data instruction should be between %d<=x<=%d (Got: %d) \n",
-               line_number, MIN_NEGATIVE_NUMBER_VALUE, MAX_POSITIVE_NUMBER_VALUE, number_as_int);
+    /* We only have 10 bits so we have to check we don't get number with more bits
+     * (The message shows the whole number, so only here we convert it with atoi)
+     */
+    if (parse_number(current_number, &number_as_int) == ERROR) {
+        report_diagnostic_numbers(diagnostics, DIAGNOSTIC_NUMBER_RANGE, line_number, atoi(current_number.start), 0);
         return ERROR;
     }
 
@@ -1007,7 +808,7 @@ STATUS_CODE get_next_number_from_instruction_params(char **instruction_params, i
 
         /* We find ',' without any number */
         if (*str == END_OF_STRING) {
-            printf("ERROR: (Line %d) After ',' we expect number and not end of the row \n", line_number);
+            report_diagnostic(diagnostics, DIAGNOSTIC_NUMBER_AFTER_COMMA, line_number, NULL);
             return ERROR;
         }
     } else {
@@ -1015,7 +816,7 @@ STATUS_CODE get_next_number_from_instruction_params(char **instruction_params, i
         skip_empty_spaces(&str);
 
         if (*str && *str != COMMENT_SYMBOL) {
-            printf("ERROR (Line %d) After one number expected comma before another number (%s)\n", line_number, str);
+            report_diagnostic(diagnostics, DIAGNOSTIC_NUMBER_MISSING_COMMA, line_number, str);
             return ERROR;
         }
     }
@@ -1023,9 +824,6 @@ STATUS_CODE get_next_number_from_instruction_params(char **instruction_params, i
     /* Update with new address */
     *instruction_params = str;
 
-    /* Free our macros */
-    free(current_number);
-
     /* Update the outcome value*/
     *out_member = number_as_int;
 
@@ -1034,147 +832,53 @@ STATUS_CODE get_next_number_from_instruction_params(char **instruction_params, i
 
 
 /**
- * This function copy to new string the current symbol or command
- * IF it is invalid, null will be returned
+ * This function finds the current symbol or command
+ * IF it is invalid, empty slice will be returned
  * @param str_ptr The string contains the command or symbol
  * @param line_mumber The line number of the command / symbol
- * @return The new string ot symbole
+ * @param diagnostics The diagnostics sink
+ * @return The command or symbol slice inside the string
  */
-char *coppy_next_command_or_symbol(char **str_ptr, int line_mumber) {
+TOKEN_SLICE coppy_next_command_or_symbol(char **str_ptr, int line_mumber, DIAGNOSTICS *diagnostics) {
     /* In the end we update the pointer to the new address */
     char *current_ptr = *str_ptr;
 
-    /* Save the first char */
-    char *start;
-
-    /* Length of the whole word */
-    int command_len;
-
-    /* Pointer to new string*/
-    char *new_command;
+    /* The whole word (starts in the first char) */
+    TOKEN_SLICE command;
 
     /* Symbol or command can be lead by spaces (e.g. ' mov') */
     skip_empty_spaces(&current_ptr);
-    start = current_ptr;
+    command.start = current_ptr;
+    command.length = 0;
 
     /* If this is instruction prefix, it can be start with this symbol */
     if (*current_ptr == INSTRUCTION_PREFIX) current_ptr++;
 
     /* Must start with letter */
-    if (!isalpha(*current_ptr)) {
-        printf("ERROR: (Line %d) Command or Symbol must start with letter (%s) \n", line_mumber, current_ptr);
-        return NULL;
+    if (!IS_ALPHA_CHAR(*current_ptr)) {
+        report_diagnostic(diagnostics, DIAGNOSTIC_WORD_START, line_mumber, current_ptr);
+        return command;
     }
 
     /* Could be cany letter or number so go to next char */
-    while (isalnum(*current_ptr)) current_ptr++;
+    while (IS_ALNUM_CHAR(*current_ptr)) current_ptr++;
 
     /* Added the symbol suffix itself */
     if (*current_ptr == SYMBOL_SUFFIX) current_ptr++;
 
     /* Calculate the command length */
-    command_len = current_ptr - start;
+    command.length = current_ptr - command.start;
 
     /* We don't find any command or symbol */
-    if (command_len == 0) {
-        printf("ERROR: (Line %d) Command or Symbol was not found (%s) \n", line_mumber, current_ptr);
-        return NULL;
+    if (command.length == 0) {
+        report_diagnostic(diagnostics, DIAGNOSTIC_WORD_NOT_FOUND, line_mumber, current_ptr);
+        return command;
     }
 
-    /* +1 -> /0 */
-    new_command = malloc(command_len + 1);
-    if (new_command == NULL) {
-        printf("CRITICAL: Failed to allocate memory for coping new word");
-        exit(1);
-    }
-
-    /* Coppy the new string */
-    strncpy(new_command, start, command_len);
-    new_command[command_len] = '\0';
-
     /* Update the pointer to the new location */
     *str_ptr = current_ptr;
 
-    return new_command;
-}
-
-/**
- * Extract the current command operand
- * We search until we arrive to end / empty char / comma
- * If the string is empty it will return null
- * @param str_ptr Pointer ot operands string
- * @return String contains only the operand itself
- */
-char *get_next_command_operand(char **str_ptr) {
-    /* We will update the real address in the end */
-    char *str = *str_ptr;
-
-    /* Save the operand start char */
-    char *start;
-
-    /* In mat can be space between the symbol and the [] so we save another pointer to check if this is mat */
-    char *mat_str;
-
-    /* The operand size */
-    int new_string_len;
-
-    /* The operand as string */
-    char *new_word;
-
-    /* Before the operand can be spaces (e.g. 'mov  r2') */
-    skip_empty_spaces(&str);
-    start = str;
-
-    if (*str == END_OF_STRING) {
-        return NULL;
-    }
-
-    /* Number operand starts with # */
-    if (*str == NUMBER_PREFIX) {
-        str++;
-
-        /* Number can start with + / - or not */
-        if (*str == NEGATIVE_NUMBER_SYMBOL || *str == POSITIVE_NUMBER_SYMBOL) str++;
-    }
-
-    /* Can be any letter or number */
-    while (isalnum(*str)) str++;
-
-    /* Check if this is mat, and if it is the length is greater than regular operand */
-    mat_str = str;
-    skip_empty_spaces(&mat_str);
-    if (*mat_str == MAT_OPEN_BRACKET) {
-        /* Go until the first close bracket */
-        while (*mat_str && *mat_str != MAT_CLOSE_BRACKET) mat_str++;
-        if (*mat_str && *mat_str == MAT_CLOSE_BRACKET) mat_str++;
-        /* Go until the final mat string */
-        while (*mat_str && *mat_str != MAT_CLOSE_BRACKET) mat_str++;
-    }
-    if (*mat_str == MAT_CLOSE_BRACKET) {
-        str = mat_str + 1;
-    }
-
-    /* Calculate the operand size */
-    new_string_len = str - start;
-
-    /* Invalid operand length or undined number (only #) */
-    if (new_string_len == 0 || (new_string_len == 1 && *start == NUMBER_PREFIX)) return NULL;
-
-    /* We add +1 for \0 */
-    new_word = malloc(new_string_len + 1);
-    if (!new_word) {
-        printf("CRITICAL: Failed to allocate memory for operand string \n");
-        exit(1);
-    }
-
-    /* Copy the new word */
-    strncpy(new_word, start, new_string_len);
-    new_word[new_string_len] = END_OF_STRING;
-
-    /* Update the pointer with the new address */
-    *str_ptr = str;
-
-    return new_word;
+    return command;
 }
 
 
@@ -1186,18 +890,6 @@ char *get_next_command_operand(char **str_ptr) {
  * @return If this is valid operand
  */
 boolean is_valid_operand_type(OPERAND_TYPE type, const COMMAND_INFO *command_info, int opernad_order) {
-    /* For counter */
-    int i;
-
-    /* Find number of allow operands type in this command position */
-    int count = command_info->allowed_operand_number[opernad_order];
-
-    /* We find the type in the command allow types */
-    for (i = 0; i < count; i++) {
-        if (command_info->allowed_operands[opernad_order][i] == type)
-            return TRUE;
-    }
-
-    /* This type is not allowed */
-    return FALSE;
+    /* One bit for each allowed type (built from the command allow types) */
+    return (allowed_operands_masks[command_info->command_number][opernad_order] & OPERAND_TYPE_BIT(type)) != 0;
 }
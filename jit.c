@@ -0,0 +1,1032 @@
+/* The native code memory uses POSIX and Linux calls (mmap) */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <limits.h>
+
+#if defined(__linux__) && defined(__x86_64__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define JIT_SUPPORTED
+#endif
+
+#include "assembler.h"
+
+
+#ifdef JIT_SUPPORTED
+
+/* The host registries (x86-64 numbers) */
+#define HOST_EAX 0
+#define HOST_ECX 1
+#define HOST_EDX 2
+/* The zero flag */
+#define HOST_EBX 3
+/* The steps */
+#define HOST_RBP 5
+/* The JIT */
+#define HOST_RSI 6
+/* The emulator */
+#define HOST_RDI 7
+/* The registries r0 - r7 are in r8 - r15 */
+#define HOST_REGISTRIES_BASE 8
+
+/* The opcodes of operation between two registries (op r/m32, r32) */
+#define X86_ADD 0x01
+#define X86_SUB 0x29
+#define X86_CMP 0x39
+#define X86_MOV 0x89
+/* The extensions of operation with immediate (0x81 /extension imm32) */
+#define X86_IMMEDIATE_ADD 0
+#define X86_IMMEDIATE_AND 4
+#define X86_IMMEDIATE_XOR 6
+#define X86_IMMEDIATE_CMP 7
+/* The scales of index (index * 1, index * 2 or index * 4) */
+#define X86_SCALE_BYTE 0
+#define X86_SCALE_WORD 1
+#define X86_SCALE_INT 2
+/* No index in memory operand */
+#define X86_NO_INDEX (-1)
+
+/* Enters the native code of block: enter(emulator, jit, code) */
+typedef int (*JIT_ENTER)(EMULATOR *emulator, JIT *jit, unsigned char *code);
+
+struct JIT {
+    /* All the native code (the enter and leave code, and then the blocks) */
+    unsigned char *code;
+    int code_length;
+
+    /* The enter code is in the start of the code, and the leave code is after it */
+    JIT_ENTER enter;
+    int leave_offset;
+
+    /* The length of the enter and leave code (the blocks start there) */
+    int stubs_length;
+
+    /* The system page size (the protection changes only the pages of the block we translate) */
+    long page_size;
+
+    /* Can the native code run (FALSE if we failed to make it executable after translation, so the emulator runs the
+     * rest of the program) */
+    boolean executable;
+
+    /* The native code of the block which starts in each address (null if it isn't translated) */
+    unsigned char *blocks[EMULATOR_MEMORY_SIZE];
+
+    /* The words of translated commands (the native code exits if it writes to them) */
+    unsigned char code_words[EMULATOR_MEMORY_SIZE];
+
+    /* The native code exits in the jumps after this number of steps (block before the steps limit, so the emulator
+     * runs the last commands, and we stop exactly in the limit) */
+    long last_step;
+};
+
+/* The commands of one block (while we translate it) */
+typedef struct {
+    /* The address and the instruction of each command */
+    int addresses[JIT_MAX_BLOCK_COMMANDS];
+    const EMULATOR_INSTRUCTION *instructions[JIT_MAX_BLOCK_COMMANDS];
+    int count;
+
+    /* The commands which the next commands jump to (they start new steps count) */
+    boolean targets[JIT_MAX_BLOCK_COMMANDS];
+
+    /* The native code offset of each command we already translated */
+    int offsets[JIT_MAX_BLOCK_COMMANDS];
+    int translated_count;
+
+    /* The commands we translated and didn't add to the steps yet (the steps are added once for many commands) */
+    int steps;
+} JIT_BLOCK;
+
+
+/**
+ * This function appends byte to the native code
+ * @param jit The JIT
+ * @param byte The byte
+ */
+static void emit_byte(JIT *jit, int byte) {
+    jit->code[jit->code_length++] = (unsigned char) byte;
+}
+
+/**
+ * This function appends 32 bits number to the native code (little endian)
+ * @param jit The JIT
+ * @param value The number
+ */
+static void emit_int32(JIT *jit, long value) {
+    int i;
+
+    for (i = 0; i < 4; i++) emit_byte(jit, (int) ((unsigned long) value >> (8 * i)) & 0xFF);
+}
+
+/**
+ * This function writes 32 bits number in place of the native code (little endian)
+ * @param jit The JIT
+ * @param offset The number offset
+ * @param value The number
+ */
+static void patch_int32(JIT *jit, int offset, long value) {
+    int i;
+
+    for (i = 0; i < 4; i++) jit->code[offset + i] = (unsigned char) (((unsigned long) value >> (8 * i)) & 0xFF);
+}
+
+/**
+ * This function appends the REX prefix (only if the instruction needs it)
+ * @param jit The JIT
+ * @param wide The instruction is 64 bits
+ * @param reg The registry of the modrm reg field
+ * @param index The index registry (X86_NO_INDEX if there is no index)
+ * @param base The registry of the modrm rm field (or the base)
+ */
+static void emit_rex(JIT *jit, boolean wide, int reg, int index, int base) {
+    int rex = (wide ? 0x08 : 0) | (reg >= 8 ? 0x04 : 0) | (index >= 8 ? 0x02 : 0) | (base >= 8 ? 0x01 : 0);
+
+    if (rex != 0) emit_byte(jit, 0x40 | rex);
+}
+
+/**
+ * This function appends memory operand ([base + index * scale + displacement], with 32 bits displacement)
+ * @param jit The JIT
+ * @param reg The modrm reg field
+ * @param base The base registry
+ * @param index The index registry (X86_NO_INDEX if there is no index)
+ * @param scale The index scale
+ * @param displacement The displacement
+ */
+static void emit_memory_operand(JIT *jit, int reg, int base, int index, int scale, long displacement) {
+    if (index == X86_NO_INDEX) {
+        emit_byte(jit, 0x80 | ((reg & 7) << 3) | (base & 7));
+    } else {
+        emit_byte(jit, 0x80 | ((reg & 7) << 3) | 4);
+        emit_byte(jit, (scale << 6) | ((index & 7) << 3) | (base & 7));
+    }
+    emit_int32(jit, displacement);
+}
+
+/**
+ * This function appends 32 bits operation between two registries (like add destination, source)
+ * @param jit The JIT
+ * @param opcode The opcode
+ * @param source The source registry
+ * @param destination The destination registry
+ */
+static void emit_registries_operation(JIT *jit, int opcode, int source, int destination) {
+    emit_rex(jit, FALSE, source, X86_NO_INDEX, destination);
+    emit_byte(jit, opcode);
+    emit_byte(jit, 0xC0 | ((source & 7) << 3) | (destination & 7));
+}
+
+/**
+ * This function appends 32 bits operation with immediate (like and destination, 0x3FF)
+ * @param jit The JIT
+ * @param extension The opcode extension
+ * @param destination The destination registry
+ * @param immediate The immediate
+ */
+static void emit_immediate_operation(JIT *jit, int extension, int destination, long immediate) {
+    emit_rex(jit, FALSE, 0, X86_NO_INDEX, destination);
+    emit_byte(jit, 0x81);
+    emit_byte(jit, 0xC0 | (extension << 3) | (destination & 7));
+    emit_int32(jit, immediate);
+}
+
+/**
+ * This function appends mov registry, immediate
+ * @param jit The JIT
+ * @param destination The destination registry
+ * @param immediate The immediate
+ */
+static void emit_move_immediate(JIT *jit, int destination, long immediate) {
+    emit_rex(jit, FALSE, 0, X86_NO_INDEX, destination);
+    emit_byte(jit, 0xB8 | (destination & 7));
+    emit_int32(jit, immediate);
+}
+
+/**
+ * This function appends load of emulator word (movzx registry, word [rdi + index * 2 + displacement])
+ * @param jit The JIT
+ * @param destination The destination registry
+ * @param index The index registry (X86_NO_INDEX if there is no index)
+ * @param displacement The word offset inside the emulator
+ */
+static void emit_load_word(JIT *jit, int destination, int index, long displacement) {
+    emit_rex(jit, FALSE, destination, index, HOST_RDI);
+    emit_byte(jit, 0x0F);
+    emit_byte(jit, 0xB7);
+    emit_memory_operand(jit, destination, HOST_RDI, index, X86_SCALE_WORD, displacement);
+}
+
+/**
+ * This function appends store of emulator word (mov word [rdi + index * 2 + displacement], registry)
+ * @param jit The JIT
+ * @param source The source registry
+ * @param index The index registry (X86_NO_INDEX if there is no index)
+ * @param displacement The word offset inside the emulator
+ */
+static void emit_store_word(JIT *jit, int source, int index, long displacement) {
+    emit_byte(jit, 0x66);
+    emit_rex(jit, FALSE, source, index, HOST_RDI);
+    emit_byte(jit, X86_MOV);
+    emit_memory_operand(jit, source, HOST_RDI, index, X86_SCALE_WORD, displacement);
+}
+
+/**
+ * This function appends jmp to the leave code
+ * @param jit The JIT
+ */
+static void emit_leave(JIT *jit) {
+    emit_byte(jit, 0xE9);
+    emit_int32(jit, jit->leave_offset - (jit->code_length + 4));
+}
+
+/**
+ * This function appends add rbp, steps
+ * @param jit The JIT
+ * @param steps The number of steps
+ */
+static void emit_add_steps(JIT *jit, int steps) {
+    emit_byte(jit, 0x48);
+    emit_byte(jit, 0x81);
+    emit_byte(jit, 0xC5);
+    emit_int32(jit, steps);
+}
+
+/**
+ * This function appends exit from the native code (add the steps, mov eax, exit code and jmp to the leave code)
+ * @param jit The JIT
+ * @param address The next address
+ * @param reason The exit reason
+ * @param steps The steps to add before the exit
+ */
+static void emit_exit(JIT *jit, int address, JIT_EXIT_REASON reason, int steps) {
+    if (steps > 0) emit_add_steps(jit, steps);
+    emit_move_immediate(jit, HOST_EAX, address | (reason << JIT_EXIT_REASON_SHIFT));
+    emit_leave(jit);
+}
+
+/**
+ * This function appends short conditional jump over the code after it
+ * @param jit The JIT
+ * @param opcode The jump opcode (like 0x74 for je)
+ * @return The offset of the jump size (see patch_skip)
+ */
+static int emit_skip(JIT *jit, int opcode) {
+    emit_byte(jit, opcode);
+    emit_byte(jit, 0);
+
+    return jit->code_length - 1;
+}
+
+/**
+ * This function updates the size of short conditional jump to the current code
+ * @param jit The JIT
+ * @param offset The offset of the jump size
+ */
+static void patch_skip(JIT *jit, int offset) {
+    jit->code[offset] = (unsigned char) (jit->code_length - (offset + 1));
+}
+
+/**
+ * This function adds the commands we translated to the steps (before they can jump or exit)
+ * @param jit The JIT
+ * @param block The block
+ */
+static void emit_block_steps(JIT *jit, JIT_BLOCK *block) {
+    if (block->steps > 0) emit_add_steps(jit, block->steps);
+    block->steps = 0;
+}
+
+/**
+ * This function appends exit if we ran max steps (before jump which may repeat commands)
+ * @param jit The JIT
+ * @param address The jump address (-1 if the address is in eax)
+ */
+static void emit_steps_check(JIT *jit, int address) {
+    int skip;
+
+    /* cmp rbp, [rsi + last_step], and jb over the exit */
+    emit_rex(jit, TRUE, HOST_RBP, X86_NO_INDEX, HOST_RSI);
+    emit_byte(jit, 0x3B);
+    emit_memory_operand(jit, HOST_RBP, HOST_RSI, X86_NO_INDEX, X86_SCALE_BYTE, offsetof(JIT, last_step));
+    skip = emit_skip(jit, 0x72);
+
+    if (address >= 0) {
+        emit_exit(jit, address, JIT_EXIT_STEPS_LIMIT, 0);
+    } else {
+        /* or eax, reason (the address is already in eax) */
+        emit_byte(jit, 0x0D);
+        emit_int32(jit, JIT_EXIT_STEPS_LIMIT << JIT_EXIT_REASON_SHIFT);
+        emit_leave(jit);
+    }
+
+    patch_skip(jit, skip);
+}
+
+/**
+ * This function appends jump to the block of the address in eax (or exit if it isn't translated yet)
+ * @param jit The JIT
+ */
+static void emit_dynamic_jump(JIT *jit) {
+    /* mov rdx, [rsi + rax * 8 + blocks] */
+    emit_byte(jit, 0x48);
+    emit_byte(jit, 0x8B);
+    emit_byte(jit, 0x94);
+    emit_byte(jit, 0xC6);
+    emit_int32(jit, offsetof(JIT, blocks));
+
+    /* test rdx, rdx, and jz to the leave code (eax is the address, and the reason is JIT_EXIT_NEXT_BLOCK) */
+    emit_byte(jit, 0x48);
+    emit_byte(jit, 0x85);
+    emit_byte(jit, 0xD2);
+    emit_byte(jit, 0x0F);
+    emit_byte(jit, 0x84);
+    emit_int32(jit, jit->leave_offset - (jit->code_length + 4));
+
+    emit_steps_check(jit, -1);
+
+    /* jmp rdx */
+    emit_byte(jit, 0xFF);
+    emit_byte(jit, 0xE2);
+}
+
+/**
+ * This function appends jump to address
+ * The jumps to the commands before it in the block and to translated blocks are direct, and the other jumps
+ * find the block when they run
+ * @param jit The JIT
+ * @param block The block
+ * @param address The jump address
+ */
+static void emit_jump(JIT *jit, const JIT_BLOCK *block, int address) {
+    unsigned char *target = jit->blocks[address];
+    int i;
+
+    for (i = 0; i < block->translated_count && target == NULL; i++) {
+        if (block->addresses[i] == address) target = jit->code + block->offsets[i];
+    }
+
+    if (target == NULL) {
+        emit_move_immediate(jit, HOST_EAX, address);
+        emit_dynamic_jump(jit);
+        return;
+    }
+
+    emit_steps_check(jit, address);
+    emit_byte(jit, 0xE9);
+    emit_int32(jit, (long) (target - (jit->code + jit->code_length + 4)));
+}
+
+/**
+ * This function appends the address of mat operand to registry (mat address + the two registries)
+ * @param jit The JIT
+ * @param operand The mat operand
+ * @param destination The registry
+ */
+static void emit_mat_address(JIT *jit, const EMULATOR_OPERAND *operand, int destination) {
+    emit_move_immediate(jit, destination, operand->value);
+    emit_registries_operation(jit, X86_ADD, HOST_REGISTRIES_BASE + operand->registries[0], destination);
+    emit_registries_operation(jit, X86_ADD, HOST_REGISTRIES_BASE + operand->registries[1], destination);
+    emit_immediate_operation(jit, X86_IMMEDIATE_AND, destination, EMULATOR_ADDRESS_MASK);
+}
+
+/**
+ * This function appends load of operand value to registry
+ * @param jit The JIT
+ * @param operand The operand
+ * @param destination The registry
+ * @param address_registry The registry for the address of mat operand
+ */
+static void emit_load_operand(JIT *jit, const EMULATOR_OPERAND *operand, int destination, int address_registry) {
+    switch (operand->type) {
+        case SIMPLE:
+            emit_move_immediate(jit, destination, operand->value);
+            break;
+        case REGISTRY:
+            emit_registries_operation(jit, X86_MOV, HOST_REGISTRIES_BASE + operand->registries[0], destination);
+            break;
+        case SYMBOL:
+            emit_load_word(jit, destination, X86_NO_INDEX,
+                           offsetof(EMULATOR, memory) + operand->value * sizeof(unsigned short));
+            break;
+        default:
+            emit_mat_address(jit, operand, address_registry);
+            emit_load_word(jit, destination, address_registry, offsetof(EMULATOR, memory));
+            break;
+    }
+}
+
+/**
+ * This function returns the host registry with the operand value (the registries are already there, and the other
+ * operands are loaded to registry)
+ * @param jit The JIT
+ * @param operand The operand
+ * @param destination The registry to load the operand to
+ * @param address_registry The registry for the address of mat operand
+ * @return The host registry
+ */
+static int emit_operand_registry(JIT *jit, const EMULATOR_OPERAND *operand, int destination, int address_registry) {
+    if (operand->type == REGISTRY) return HOST_REGISTRIES_BASE + operand->registries[0];
+
+    emit_load_operand(jit, operand, destination, address_registry);
+    return destination;
+}
+
+/**
+ * This function appends store of registry to memory operand, and exit if the word is part of translated command
+ * The address of mat operand must be in edx
+ * @param jit The JIT
+ * @param block The block
+ * @param operand The operand (SYMBOL or MAT)
+ * @param source The registry
+ * @param next_address The address of the next command
+ */
+static void emit_store_memory_operand(JIT *jit, const JIT_BLOCK *block, const EMULATOR_OPERAND *operand, int source,
+                                      int next_address) {
+    int index = operand->type == MAT ? HOST_EDX : X86_NO_INDEX;
+    long word_offset = operand->type == MAT ? 0 : operand->value;
+    int skip;
+
+    emit_store_word(jit, source, index, offsetof(EMULATOR, memory) + word_offset * sizeof(unsigned short));
+
+    /* cmp byte [rsi + index + code_words], 0 */
+    emit_rex(jit, FALSE, 0, index, HOST_RSI);
+    emit_byte(jit, 0x80);
+    emit_memory_operand(jit, X86_IMMEDIATE_CMP, HOST_RSI, index, X86_SCALE_BYTE,
+                        offsetof(JIT, code_words) + word_offset);
+    emit_byte(jit, 0);
+
+    /* je over the exit (the command already ran, so it is in the steps) */
+    skip = emit_skip(jit, 0x74);
+    emit_exit(jit, next_address, JIT_EXIT_CODE_CHANGED, block->steps + 1);
+    patch_skip(jit, skip);
+}
+
+/**
+ * This function appends the change of destination operand
+ * The operation is between the destination and the source registry (or immediate if the opcode is 0x81)
+ * The registries are changed in place, and the memory is changed in ecx (after it the value is masked)
+ * @param jit The JIT
+ * @param block The block
+ * @param operand The destination operand
+ * @param source The source registry (it must not be ecx or edx)
+ * @param opcode The opcode (X86_MOV, X86_ADD or X86_SUB), or 0x81 for operation with immediate
+ * @param extension The extension of operation with immediate
+ * @param immediate The immediate
+ * @param next_address The address of the next command
+ */
+static void emit_change_operand(JIT *jit, const JIT_BLOCK *block, const EMULATOR_OPERAND *operand, int source,
+                                int opcode, int extension, long immediate, int next_address) {
+    int destination = operand->type == REGISTRY ? HOST_REGISTRIES_BASE + operand->registries[0] : HOST_ECX;
+
+    if (operand->type == MAT) emit_mat_address(jit, operand, HOST_EDX);
+
+    /* The memory value (mov doesn't need it) */
+    if (operand->type != REGISTRY && opcode != X86_MOV) {
+        emit_load_word(jit, HOST_ECX, operand->type == MAT ? HOST_EDX : X86_NO_INDEX,
+                       offsetof(EMULATOR, memory) +
+                       (operand->type == MAT ? 0 : operand->value * sizeof(unsigned short)));
+    }
+
+    if (opcode == 0x81) {
+        emit_immediate_operation(jit, extension, destination, immediate);
+        if (extension != X86_IMMEDIATE_XOR) emit_immediate_operation(jit, X86_IMMEDIATE_AND, destination, ADDRESS_MASK);
+    } else if (opcode == X86_MOV && operand->type != REGISTRY) {
+        /* The memory gets the source registry itself */
+        destination = source;
+    } else {
+        emit_registries_operation(jit, opcode, source, destination);
+        if (opcode != X86_MOV) emit_immediate_operation(jit, X86_IMMEDIATE_AND, destination, ADDRESS_MASK);
+    }
+
+    if (operand->type != REGISTRY) emit_store_memory_operand(jit, block, operand, destination, next_address);
+}
+
+/**
+ * This function appends the jump address of jmp, bne and jsr to eax (for MAT and REGISTRY operands)
+ * @param jit The JIT
+ * @param operand The destination operand
+ */
+static void emit_jump_address(JIT *jit, const EMULATOR_OPERAND *operand) {
+    if (operand->type == MAT) {
+        emit_mat_address(jit, operand, HOST_EAX);
+    } else {
+        emit_registries_operation(jit, X86_MOV, HOST_REGISTRIES_BASE + operand->registries[0], HOST_EAX);
+        emit_immediate_operation(jit, X86_IMMEDIATE_AND, HOST_EAX, EMULATOR_ADDRESS_MASK);
+    }
+}
+
+/**
+ * This function appends jump to the destination operand of jmp, bne and jsr
+ * @param jit The JIT
+ * @param block The block commands (until this command)
+ * @param operand The destination operand
+ */
+static void emit_operand_jump(JIT *jit, const JIT_BLOCK *block, const EMULATOR_OPERAND *operand) {
+    if (operand->type == SYMBOL) {
+        emit_jump(jit, block, operand->value);
+    } else {
+        emit_jump_address(jit, operand);
+        emit_dynamic_jump(jit);
+    }
+}
+
+/**
+ * This function appends check of the jsr stack, and exit to the emulator if jsr / rts can't run
+ * @param jit The JIT
+ * @param block The block
+ * @param address The command address
+ * @param jsr The command is jsr (the stack must have free place), or rts (the stack must have address)
+ */
+static void emit_stack_check(JIT *jit, const JIT_BLOCK *block, int address, boolean jsr) {
+    int skip;
+
+    /* mov eax, [rdi + stack_size] */
+    emit_byte(jit, 0x8B);
+    emit_memory_operand(jit, HOST_EAX, HOST_RDI, X86_NO_INDEX, X86_SCALE_BYTE, offsetof(EMULATOR, stack_size));
+
+    if (jsr) {
+        /* jb over the exit */
+        emit_immediate_operation(jit, X86_IMMEDIATE_CMP, HOST_EAX, EMULATOR_STACK_SIZE);
+        skip = emit_skip(jit, 0x72);
+    } else {
+        /* test eax, eax, and jnz over the exit */
+        emit_byte(jit, 0x85);
+        emit_byte(jit, 0xC0);
+        skip = emit_skip(jit, 0x75);
+    }
+
+    /* The emulator runs the command (so it isn't in the steps) */
+    emit_exit(jit, address, JIT_EXIT_INTERPRET, block->steps);
+    patch_skip(jit, skip);
+}
+
+/**
+ * This function returns if the command has native code
+ * @param instruction The command instruction
+ * @return TRUE if the command has native code
+ */
+static boolean is_native_instruction(const EMULATOR_INSTRUCTION *instruction) {
+    return instruction->handler <= EMULATOR_STOP_HANDLER && instruction->handler != EMULATOR_RED_HANDLER &&
+           instruction->handler != EMULATOR_PRN_HANDLER && instruction->handler != EMULATOR_STOP_HANDLER;
+}
+
+/**
+ * This function appends the native code of one command
+ * @param jit The JIT
+ * @param block The block (the command is the next command to translate)
+ */
+static void emit_command(JIT *jit, JIT_BLOCK *block) {
+    const EMULATOR_INSTRUCTION *instruction = block->instructions[block->translated_count];
+    const EMULATOR_OPERAND *source = &instruction->operands[SOURCE_OPERAND_ORDER];
+    const EMULATOR_OPERAND *destination = &instruction->operands[DES_OPERAND_ORDER];
+    int address = block->addresses[block->translated_count];
+    int next_address = (address + instruction->words_count) & EMULATOR_ADDRESS_MASK;
+
+    /* The host registry of the source value */
+    int source_registry;
+
+    /* The jump offset of bne (when the zero flag is set) */
+    int skip_offset;
+
+    /* The jumps to this command count its steps from it */
+    if (block->targets[block->translated_count]) emit_block_steps(jit, block);
+    block->offsets[block->translated_count++] = jit->code_length;
+
+    switch (instruction->handler) {
+        case EMULATOR_MOV_HANDLER:
+            source_registry = emit_operand_registry(jit, source, HOST_EAX, HOST_ECX);
+            emit_change_operand(jit, block, destination, source_registry, X86_MOV, 0, 0, next_address);
+            break;
+        case EMULATOR_CMP_HANDLER:
+            source_registry = emit_operand_registry(jit, source, HOST_EAX, HOST_ECX);
+            if (destination->type == SIMPLE) {
+                emit_immediate_operation(jit, X86_IMMEDIATE_CMP, source_registry, destination->value);
+            } else {
+                emit_registries_operation(jit, X86_CMP, emit_operand_registry(jit, destination, HOST_EDX, HOST_EDX),
+                                          source_registry);
+            }
+            /* sete bl */
+            emit_byte(jit, 0x0F);
+            emit_byte(jit, 0x94);
+            emit_byte(jit, 0xC3);
+            break;
+        case EMULATOR_ADD_HANDLER:
+        case EMULATOR_SUB_HANDLER:
+            source_registry = emit_operand_registry(jit, source, HOST_EAX, HOST_ECX);
+            emit_change_operand(jit, block, destination, source_registry,
+                                instruction->handler == EMULATOR_ADD_HANDLER ? X86_ADD : X86_SUB, 0, 0, next_address);
+            break;
+        case EMULATOR_LEA_HANDLER:
+            if (source->type == MAT) {
+                emit_mat_address(jit, source, HOST_EAX);
+            } else {
+                emit_move_immediate(jit, HOST_EAX, source->value);
+            }
+            emit_change_operand(jit, block, destination, HOST_EAX, X86_MOV, 0, 0, next_address);
+            break;
+        case EMULATOR_CLR_HANDLER:
+            emit_move_immediate(jit, HOST_EAX, 0);
+            emit_change_operand(jit, block, destination, HOST_EAX, X86_MOV, 0, 0, next_address);
+            break;
+        case EMULATOR_NOT_HANDLER:
+            emit_change_operand(jit, block, destination, HOST_EAX, 0x81, X86_IMMEDIATE_XOR, ADDRESS_MASK,
+                                next_address);
+            break;
+        case EMULATOR_INC_HANDLER:
+            emit_change_operand(jit, block, destination, HOST_EAX, 0x81, X86_IMMEDIATE_ADD, 1, next_address);
+            break;
+        case EMULATOR_DEC_HANDLER:
+            /* -1 is ADDRESS_MASK (after the mask) */
+            emit_change_operand(jit, block, destination, HOST_EAX, 0x81, X86_IMMEDIATE_ADD, ADDRESS_MASK,
+                                next_address);
+            break;
+        case EMULATOR_JMP_HANDLER:
+            block->steps++;
+            emit_block_steps(jit, block);
+            emit_operand_jump(jit, block, destination);
+            return;
+        case EMULATOR_BNE_HANDLER:
+            block->steps++;
+            emit_block_steps(jit, block);
+
+            /* test bl, bl, and jnz over the jump */
+            emit_byte(jit, 0x84);
+            emit_byte(jit, 0xDB);
+            emit_byte(jit, 0x0F);
+            emit_byte(jit, 0x85);
+            skip_offset = jit->code_length;
+            emit_int32(jit, 0);
+            emit_operand_jump(jit, block, destination);
+            patch_int32(jit, skip_offset, jit->code_length - (skip_offset + 4));
+            return;
+        case EMULATOR_JSR_HANDLER:
+            emit_stack_check(jit, block, address, TRUE);
+
+            /* mov dword [rdi + rax * 4 + stack], next address */
+            emit_byte(jit, 0xC7);
+            emit_memory_operand(jit, 0, HOST_RDI, HOST_EAX, X86_SCALE_INT, offsetof(EMULATOR, stack));
+            emit_int32(jit, next_address);
+
+            /* add eax, 1, and mov [rdi + stack_size], eax */
+            emit_immediate_operation(jit, X86_IMMEDIATE_ADD, HOST_EAX, 1);
+            emit_byte(jit, X86_MOV);
+            emit_memory_operand(jit, HOST_EAX, HOST_RDI, X86_NO_INDEX, X86_SCALE_BYTE, offsetof(EMULATOR, stack_size));
+
+            block->steps++;
+            emit_block_steps(jit, block);
+            emit_operand_jump(jit, block, destination);
+            return;
+        default:
+            emit_stack_check(jit, block, address, FALSE);
+
+            /* rts - sub eax, 1, mov [rdi + stack_size], eax, and mov eax, [rdi + rax * 4 + stack] */
+            emit_immediate_operation(jit, X86_IMMEDIATE_ADD, HOST_EAX, -1);
+            emit_byte(jit, X86_MOV);
+            emit_memory_operand(jit, HOST_EAX, HOST_RDI, X86_NO_INDEX, X86_SCALE_BYTE, offsetof(EMULATOR, stack_size));
+            emit_byte(jit, 0x8B);
+            emit_memory_operand(jit, HOST_EAX, HOST_RDI, HOST_EAX, X86_SCALE_INT, offsetof(EMULATOR, stack));
+
+            block->steps++;
+            emit_block_steps(jit, block);
+            emit_dynamic_jump(jit);
+            return;
+    }
+
+    block->steps++;
+}
+
+/**
+ * This function appends the enter and leave code to the empty code
+ * The enter code loads the emulator state to the host registries, and jumps to the block
+ * The leave code stores the state, and returns the exit code (it is in eax)
+ * @param jit The JIT
+ */
+static void emit_stubs(JIT *jit) {
+    /* The callee saved registries which we use (rbx, rbp, r12 - r15) */
+    static const int saved_registries[] = {HOST_EBX, HOST_RBP, 12, 13, 14, 15};
+    int saved_count = sizeof(saved_registries) / sizeof(saved_registries[0]);
+
+    int i;
+
+    jit->code_length = 0;
+
+    for (i = 0; i < saved_count; i++) {
+        emit_rex(jit, FALSE, 0, X86_NO_INDEX, saved_registries[i]);
+        emit_byte(jit, 0x50 | (saved_registries[i] & 7));
+    }
+    for (i = 0; i < EMULATOR_REGISTRIES_COUNT; i++) {
+        emit_load_word(jit, HOST_REGISTRIES_BASE + i, X86_NO_INDEX,
+                       offsetof(EMULATOR, registries) + i * sizeof(unsigned short));
+    }
+
+    /* mov ebx, [rdi + zero_flag], mov rbp, [rdi + steps], and jmp rdx */
+    emit_byte(jit, 0x8B);
+    emit_memory_operand(jit, HOST_EBX, HOST_RDI, X86_NO_INDEX, X86_SCALE_BYTE, offsetof(EMULATOR, zero_flag));
+    emit_byte(jit, 0x48);
+    emit_byte(jit, 0x8B);
+    emit_memory_operand(jit, HOST_RBP, HOST_RDI, X86_NO_INDEX, X86_SCALE_BYTE, offsetof(EMULATOR, steps));
+    emit_byte(jit, 0xFF);
+    emit_byte(jit, 0xE2);
+
+    jit->leave_offset = jit->code_length;
+    for (i = 0; i < EMULATOR_REGISTRIES_COUNT; i++) {
+        emit_store_word(jit, HOST_REGISTRIES_BASE + i, X86_NO_INDEX,
+                        offsetof(EMULATOR, registries) + i * sizeof(unsigned short));
+    }
+    emit_byte(jit, X86_MOV);
+    emit_memory_operand(jit, HOST_EBX, HOST_RDI, X86_NO_INDEX, X86_SCALE_BYTE, offsetof(EMULATOR, zero_flag));
+    emit_byte(jit, 0x48);
+    emit_byte(jit, X86_MOV);
+    emit_memory_operand(jit, HOST_RBP, HOST_RDI, X86_NO_INDEX, X86_SCALE_BYTE, offsetof(EMULATOR, steps));
+
+    for (i = saved_count - 1; i >= 0; i--) {
+        emit_rex(jit, FALSE, 0, X86_NO_INDEX, saved_registries[i]);
+        emit_byte(jit, 0x58 | (saved_registries[i] & 7));
+    }
+    /* ret */
+    emit_byte(jit, 0xC3);
+
+    jit->stubs_length = jit->code_length;
+}
+
+/**
+ * This function changes the protection of the native code pages (writable while we translate, executable while it
+ * runs)
+ * @param jit The JIT
+ * @param offset The offset of the code to change
+ * @param length The length of the code to change (the pages around it change)
+ * @param writable Make the code writable (or executable)
+ * @return The status code (ERROR if the system refused)
+ */
+static STATUS_CODE protect_code(JIT *jit, int offset, int length, boolean writable) {
+    int protection = writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC;
+
+    /* The first and the last pages */
+    long start = offset - offset % jit->page_size;
+    long end = offset + length > JIT_CODE_SIZE ? JIT_CODE_SIZE : offset + length;
+
+    return mprotect(jit->code + start, end - start, protection) == 0 ? OK : ERROR;
+}
+
+/**
+ * This function drops all the blocks (the code of the commands changed, or the code is full)
+ * @param jit The JIT
+ */
+static void flush_jit(JIT *jit) {
+    jit->code_length = jit->stubs_length;
+    memset(jit->blocks, 0, sizeof(jit->blocks));
+    memset(jit->code_words, 0, sizeof(jit->code_words));
+}
+
+/**
+ * This function returns if the command ends the block (it always jumps)
+ * @param instruction The command instruction
+ * @return TRUE if the command ends the block
+ */
+static boolean is_block_end(const EMULATOR_INSTRUCTION *instruction) {
+    return instruction->handler == EMULATOR_JMP_HANDLER || instruction->handler == EMULATOR_JSR_HANDLER ||
+           instruction->handler == EMULATOR_RTS_HANDLER;
+}
+
+/**
+ * This function marks the commands which the block jumps back to (jmp, bne and jsr to symbol in the block)
+ * @param block The block
+ */
+static void find_block_targets(JIT_BLOCK *block) {
+    const EMULATOR_INSTRUCTION *instruction;
+    int i, j;
+
+    for (i = 0; i < block->count; i++) block->targets[i] = FALSE;
+
+    for (i = 0; i < block->count; i++) {
+        instruction = block->instructions[i];
+        if ((instruction->handler == EMULATOR_JMP_HANDLER || instruction->handler == EMULATOR_BNE_HANDLER ||
+             instruction->handler == EMULATOR_JSR_HANDLER) &&
+            instruction->operands[DES_OPERAND_ORDER].type == SYMBOL) {
+            for (j = 0; j <= i; j++) {
+                if (block->addresses[j] == instruction->operands[DES_OPERAND_ORDER].value) block->targets[j] = TRUE;
+            }
+        }
+    }
+}
+
+/**
+ * This function translates the block which starts in the address
+ * The block is the commands from the address until jump (or command without native code)
+ * @param jit The JIT
+ * @param emulator The emulator
+ * @param address The block address
+ * @return The block native code (null if the first command has no native code, or the code can't be written)
+ */
+static unsigned char *translate_block(JIT *jit, EMULATOR *emulator, int address) {
+    JIT_BLOCK block;
+    const EMULATOR_INSTRUCTION *instruction;
+    unsigned char *code;
+    int i;
+
+    /* The commands of the block */
+    block.count = 0;
+    while (block.count < JIT_MAX_BLOCK_COMMANDS) {
+        decode_emulator_instruction(emulator, address);
+        instruction = &emulator->instructions[address];
+
+        /* The emulator runs the commands without native code (and the commands after the end of the memory) */
+        if (!is_native_instruction(instruction) || address + instruction->words_count > EMULATOR_MEMORY_SIZE) break;
+
+        block.addresses[block.count] = address;
+        block.instructions[block.count++] = instruction;
+        address = (address + instruction->words_count) & EMULATOR_ADDRESS_MASK;
+        if (is_block_end(instruction)) break;
+    }
+    if (block.count == 0) return NULL;
+
+    if (jit->code_length + JIT_MAX_BLOCK_CODE > JIT_CODE_SIZE) flush_jit(jit);
+    code = jit->code + jit->code_length;
+    if (protect_code(jit, jit->code_length, JIT_MAX_BLOCK_CODE, TRUE) != OK) return NULL;
+
+    for (i = 0; i < block.count; i++) {
+        for (address = 0; address < block.instructions[i]->words_count; address++) {
+            jit->code_words[block.addresses[i] + address] = TRUE;
+        }
+    }
+
+    find_block_targets(&block);
+    block.translated_count = 0;
+    block.steps = 0;
+    while (block.translated_count < block.count) emit_command(jit, &block);
+
+    /* The block which doesn't end with jump continues in the next address */
+    if (!is_block_end(block.instructions[block.count - 1])) {
+        address = (block.addresses[block.count - 1] + block.instructions[block.count - 1]->words_count) &
+                  EMULATOR_ADDRESS_MASK;
+        emit_block_steps(jit, &block);
+        if (block.count < JIT_MAX_BLOCK_COMMANDS) {
+            emit_exit(jit, address, JIT_EXIT_INTERPRET, 0);
+        } else {
+            emit_jump(jit, &block, address);
+        }
+    }
+
+    /* The pages of the block are writable now, so the blocks in them can't run */
+    if (protect_code(jit, (int) (code - jit->code), JIT_MAX_BLOCK_CODE, FALSE) != OK) {
+        jit->executable = FALSE;
+        return NULL;
+    }
+
+    jit->blocks[block.addresses[0]] = code;
+    return code;
+}
+
+/**
+ * This function runs one command with the emulator
+ * The native code doesn't update the predecoded instructions, so the command is decoded again
+ * @param jit The JIT
+ * @param emulator The emulator
+ */
+static void interpret_command(JIT *jit, EMULATOR *emulator) {
+    emulator->instructions[emulator->pc].handler = EMULATOR_DECODE_HANDLER;
+    emulator->changed_address = -1;
+
+    if (run_emulator(emulator, 1) == EMULATOR_STEPS_LIMIT) emulator->status = EMULATOR_RUNNING;
+
+    /* red can change translated command */
+    if (emulator->changed_address >= 0 && jit->code_words[emulator->changed_address]) flush_jit(jit);
+}
+
+#endif
+
+/**
+ * This function creates JIT with empty code
+ * The code is never writable and executable together (it is writable only while we translate block)
+ * @return The JIT (null if the system can't run the native code, so we should run the emulator)
+ */
+JIT *create_jit(void) {
+#ifdef JIT_SUPPORTED
+    JIT *jit = malloc(sizeof(JIT));
+    void *enter_code;
+
+    if (jit == NULL) {
+        printf("CRITICAL: Failed to allocate memory for jit");
+        exit(1);
+    }
+
+    jit->code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (jit->code == MAP_FAILED) {
+        free(jit);
+        return NULL;
+    }
+
+    /* The enter code is in the start of the code (ISO C doesn't cast data pointer to function pointer) */
+    enter_code = jit->code;
+    memcpy(&jit->enter, &enter_code, sizeof(jit->enter));
+
+    emit_stubs(jit);
+    flush_jit(jit);
+
+    /* The system doesn't let us run the code */
+    jit->page_size = sysconf(_SC_PAGESIZE);
+    if (jit->page_size <= 0 || protect_code(jit, 0, JIT_CODE_SIZE, FALSE) != OK) {
+        munmap(jit->code, JIT_CODE_SIZE);
+        free(jit);
+        return NULL;
+    }
+    jit->executable = TRUE;
+
+    return jit;
+#else
+    return NULL;
+#endif
+}
+
+/**
+ * This function runs the emulator program with the JIT until it stops (like run_emulator)
+ * Each block is translated once (in the first time we get to its address), and the blocks jump to each other
+ * without returning. The registries stay in host registries inside the native code
+ * The commands without native code (red, prn, stop and the commands we can't run) run with the emulator
+ * The steps limit is checked in the jumps (a block before it), and the emulator runs the last commands
+ * @param jit The JIT
+ * @param emulator The emulator (after init_emulator)
+ * @param max_steps Stop after this number of commands (0 means no limit)
+ * @return Why the program stopped (EMULATOR_STOPPED after stop)
+ */
+EMULATOR_STATUS run_jit(JIT *jit, EMULATOR *emulator, long max_steps) {
+#ifdef JIT_SUPPORTED
+    unsigned char *block;
+
+    /* The exit code of the native code */
+    int exit_code;
+
+    /* The next command runs with the emulator */
+    boolean interpret = FALSE;
+
+    /* The steps when we stop */
+    long last_step = max_steps > 0 ? emulator->steps + max_steps : LONG_MAX;
+
+    int address;
+
+    /* The memory may have changed since the last run (or it is another program), so the blocks are translated again */
+    flush_jit(jit);
+    jit->last_step = last_step - JIT_MAX_BLOCK_COMMANDS;
+
+    while (emulator->status == EMULATOR_RUNNING) {
+        if (emulator->steps >= last_step) {
+            emulator->status = EMULATOR_STEPS_LIMIT;
+            break;
+        }
+
+        block = NULL;
+        if (!interpret && jit->executable && emulator->steps < jit->last_step) {
+            block = jit->blocks[emulator->pc];
+            if (block == NULL) block = translate_block(jit, emulator, emulator->pc);
+        }
+        interpret = FALSE;
+
+        if (block == NULL) {
+            interpret_command(jit, emulator);
+            continue;
+        }
+
+        exit_code = jit->enter(emulator, jit, block);
+        emulator->pc = exit_code & EMULATOR_ADDRESS_MASK;
+
+        switch (exit_code >> JIT_EXIT_REASON_SHIFT) {
+            case JIT_EXIT_INTERPRET:
+                interpret = TRUE;
+                break;
+            case JIT_EXIT_CODE_CHANGED:
+                flush_jit(jit);
+                break;
+            default:
+                /* The next block, or the last commands before the steps limit */
+                break;
+        }
+    }
+
+    /* The native code changed the memory without the predecoded instructions, so they are decoded again */
+    for (address = 0; address < EMULATOR_MEMORY_SIZE; address++) {
+        emulator->instructions[address].handler = EMULATOR_DECODE_HANDLER;
+    }
+
+    return emulator->status;
+#else
+    (void) jit;
+    return run_emulator(emulator, max_steps);
+#endif
+}
+
+/**
+ * This function frees the JIT and its code
+ * @param jit The JIT
+ */
+void free_jit(JIT *jit) {
+#ifdef JIT_SUPPORTED
+    munmap(jit->code, JIT_CODE_SIZE);
+    free(jit);
+#else
+    (void) jit;
+#endif
+}
@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assembler.h"
+
+
+/**
+ * This function returns the next random number of the test (the same seed always gives the same programs)
+ * @param seed The seed to update
+ * @return The random number (15 bits)
+ */
+static int next_random(unsigned long *seed) {
+    *seed = (*seed * 1103515245UL + 12345UL) & 0xFFFFFFFFUL;
+    return (int) ((*seed >> 16) & 0x7FFF);
+}
+
+/**
+ * This function returns random address of the program (the symbols operands point into the program)
+ * @param seed The seed
+ * @return The address
+ */
+static int get_random_address(unsigned long *seed) {
+    return JIT_TEST_BASE_ADDRESS + next_random(seed) % (EMULATOR_MEMORY_SIZE - JIT_TEST_BASE_ADDRESS);
+}
+
+/**
+ * This function generates random program until the end of the memory
+ * Most of the words are valid commands with their operands words (the rest are random words, so there are also
+ * invalid commands), and the symbols are relocatable addresses inside the program (some of them are externals)
+ * @param seed The seed
+ * @param words The words (from the base address to the end of the memory)
+ * @param image The image to init (its words are the words)
+ */
+static void generate_program(unsigned long *seed, unsigned short *words, OBJECT_IMAGE *image) {
+    int words_count = EMULATOR_MEMORY_SIZE - JIT_TEST_BASE_ADDRESS;
+    int i = 0, order;
+
+    const COMMAND_DECODE *decode;
+    int first_word, type, number;
+
+    while (i < words_count) {
+        if (next_random(seed) % 8 == 0) {
+            words[i++] = (unsigned short) (next_random(seed) & ADDRESS_MASK);
+            continue;
+        }
+
+        /* The first word (without ERA) of valid command */
+        do {
+            first_word = next_random(seed) & ADDRESS_MASK & ~((1 << ERA_BITS_SIZE) - 1);
+            decode = &command_decodes[first_word];
+        } while (decode->command_info == NULL);
+        words[i++] = (unsigned short) first_word;
+
+        for (order = SOURCE_OPERAND_ORDER; order <= DES_OPERAND_ORDER && i < words_count; order++) {
+            type = order == SOURCE_OPERAND_ORDER ? decode->source_operand_type : decode->des_operand_type;
+
+            if (type == SIMPLE) {
+                /* Small numbers (the mats and the loops use them), and sometimes any number */
+                number = next_random(seed) % 5 ? next_random(seed) % 16
+                                               : next_random(seed) & (int) (ADDRESS_MASK >> ERA_BITS_SIZE);
+                words[i++] = (unsigned short) (number << ERA_BITS_SIZE);
+            } else if (type == REGISTRY && order == SOURCE_OPERAND_ORDER && decode->des_operand_type == REGISTRY) {
+                /* Two registries share one word */
+                words[i++] = (unsigned short) ((next_random(seed) % EMULATOR_REGISTRIES_COUNT)
+                                               << (REGISTRY_BITS_SIZE + ERA_BITS_SIZE) |
+                                               (next_random(seed) % EMULATOR_REGISTRIES_COUNT) << ERA_BITS_SIZE);
+                order++;
+            } else if (type == REGISTRY) {
+                words[i++] = (unsigned short) ((next_random(seed) % EMULATOR_REGISTRIES_COUNT)
+                                               << (order == SOURCE_OPERAND_ORDER ? REGISTRY_BITS_SIZE + ERA_BITS_SIZE
+                                                                                 : ERA_BITS_SIZE));
+            } else if (type == SYMBOL || type == MAT) {
+                words[i++] = (unsigned short) (get_random_address(seed) << ERA_BITS_SIZE |
+                                               (next_random(seed) % 30 ? DATA : EXTERNAL));
+                if (type == MAT && i < words_count) {
+                    words[i++] = (unsigned short) ((next_random(seed) % EMULATOR_REGISTRIES_COUNT)
+                                                   << (REGISTRY_BITS_SIZE + ERA_BITS_SIZE) |
+                                                   (next_random(seed) % EMULATOR_REGISTRIES_COUNT) << ERA_BITS_SIZE);
+                }
+            }
+        }
+    }
+
+    memset(image, 0, sizeof(OBJECT_IMAGE));
+    image->base_address = JIT_TEST_BASE_ADDRESS;
+    image->code_length = JIT_TEST_MIN_CODE_LENGTH + next_random(seed) % (words_count - JIT_TEST_MIN_CODE_LENGTH);
+    image->data_length = words_count - image->code_length;
+    image->words = words;
+}
+
+/**
+ * This function creates temporary file with the test input
+ * @return The file
+ */
+static FILE *create_test_input(void) {
+    FILE *input = tmpfile();
+    if (input == NULL) {
+        printf("CRITICAL: Failed to create temporary file.\n");
+        exit(1);
+    }
+
+    fputs(JIT_TEST_INPUT, input);
+    rewind(input);
+
+    return input;
+}
+
+/**
+ * This function reads the whole output of the program
+ * @param output The output (temporary file)
+ * @param buffer The buffer to update
+ */
+static void read_test_output(FILE *output, OUTPUT_BUFFER *buffer) {
+    char part[OUTPUT_COMPARE_BUFFER_SIZE];
+    size_t length;
+
+    rewind(output);
+    while ((length = fread(part, 1, sizeof(part), output)) > 0) append_to_output_buffer(buffer, part, (int) length);
+}
+
+/**
+ * This function runs the image with the emulator and with the JIT, and compares the machines when they stop
+ * Both machines start with the same registries, input and steps limit
+ * @param jit The JIT
+ * @param image The image
+ * @param registries The registries at the start
+ * @param max_steps The steps limit
+ * @param name The program name (for the mismatch message)
+ * @param print Print the mismatch
+ * @return Do the machines match
+ */
+static boolean compare_runs(JIT *jit, const OBJECT_IMAGE *image, const unsigned short *registries, long max_steps,
+                            const char *name, boolean print) {
+    /* The emulator machine, and the JIT machine */
+    static EMULATOR emulator, jit_emulator;
+
+    FILE *emulator_input = create_test_input(), *jit_input = create_test_input();
+    FILE *emulator_output = tmpfile(), *jit_output = tmpfile();
+
+    OUTPUT_BUFFER emulator_text, jit_text;
+    boolean same;
+
+    if (emulator_output == NULL || jit_output == NULL) {
+        printf("CRITICAL: Failed to create temporary file.\n");
+        exit(1);
+    }
+
+    if (init_emulator(&emulator, image, emulator_input, emulator_output) != OK ||
+        init_emulator(&jit_emulator, image, jit_input, jit_output) != OK) {
+        printf("ERROR: %s doesn't fit the emulator memory \n", name);
+        same = FALSE;
+    } else {
+        memcpy(emulator.registries, registries, sizeof(emulator.registries));
+        memcpy(jit_emulator.registries, registries, sizeof(jit_emulator.registries));
+
+        run_emulator(&emulator, max_steps);
+        run_jit(jit, &jit_emulator, max_steps);
+
+        init_output_buffer(&emulator_text);
+        init_output_buffer(&jit_text);
+        read_test_output(emulator_output, &emulator_text);
+        read_test_output(jit_output, &jit_text);
+
+        same = emulator.status == jit_emulator.status && emulator.steps == jit_emulator.steps &&
+               emulator.pc == jit_emulator.pc && emulator.zero_flag == jit_emulator.zero_flag &&
+               emulator.stack_size == jit_emulator.stack_size &&
+               memcmp(emulator.stack, jit_emulator.stack, emulator.stack_size * sizeof(int)) == 0 &&
+               memcmp(emulator.memory, jit_emulator.memory, sizeof(emulator.memory)) == 0 &&
+               memcmp(emulator.registries, jit_emulator.registries, sizeof(emulator.registries)) == 0 &&
+               emulator_text.length == jit_text.length &&
+               (emulator_text.length == 0 || memcmp(emulator_text.data, jit_text.data, emulator_text.length) == 0);
+
+        if (!same && print) {
+            printf("ERROR: %s: emulator (%s, address %d, after %ld commands) and JIT (%s, address %d, after %ld "
+                   "commands) don't match \n", name, get_emulator_status_message(emulator.status), emulator.pc,
+                   emulator.steps, get_emulator_status_message(jit_emulator.status), jit_emulator.pc,
+                   jit_emulator.steps);
+        }
+
+        free_output_buffer(&emulator_text);
+        free_output_buffer(&jit_text);
+    }
+
+    fclose(emulator_input);
+    fclose(jit_input);
+    fclose(emulator_output);
+    fclose(jit_output);
+
+    return same;
+}
+
+/**
+ * This function runs random programs with the emulator and with the JIT
+ * One JIT runs all the programs (so it also checks that the blocks of the last program are dropped)
+ * @param jit The JIT
+ * @param count The number of programs
+ * @return The number of programs which don't match
+ */
+static int test_random_programs(JIT *jit, int count) {
+    /* For loop counters */
+    int i, registry;
+
+    /* The current registry value */
+    int value;
+
+    unsigned short words[EMULATOR_MEMORY_SIZE - JIT_TEST_BASE_ADDRESS];
+    unsigned short registries[EMULATOR_REGISTRIES_COUNT];
+    OBJECT_IMAGE image;
+
+    /* The program name (for the mismatch message) */
+    char name[JIT_TEST_NAME_MAX_LENGTH];
+
+    unsigned long seed;
+    long max_steps;
+    int mismatches = 0;
+
+    for (i = 0; i < count; i++) {
+        seed = (unsigned long) i * 7919UL + 1UL;
+        generate_program(&seed, words, &image);
+
+        /* Registries with small values (mats indexes), and sometimes any value */
+        for (registry = 0; registry < EMULATOR_REGISTRIES_COUNT; registry++) {
+            value = next_random(&seed) % 4 ? next_random(&seed) % 8 : next_random(&seed) & (int) ADDRESS_MASK;
+            registries[registry] = (unsigned short) value;
+        }
+
+        /* Some programs stop in the steps limit (in the middle of a block) */
+        max_steps = i % 3 ? JIT_TEST_STEPS_LIMIT : next_random(&seed) % JIT_TEST_SHORT_STEPS_LIMIT + 1;
+
+        sprintf(name, "program %d", i);
+        if (!compare_runs(jit, &image, registries, max_steps, name, mismatches < JIT_TEST_MAX_REPORTS)) mismatches++;
+    }
+
+    return mismatches;
+}
+
+/**
+ * The JIT test
+ * jit_test [count] - runs count random programs (JIT_TEST_PROGRAMS_COUNT by default) with the emulator and with the
+ * JIT, and checks that the machines are the same when they stop (status, steps, pc, flag, stack, memory, registries
+ * and output)
+ * jit_test <name>.ob / <name>.bo ... - checks the programs of the objects the same way
+ * If the system can't run the native code there is nothing to check
+ */
+int main(int argc, char **argv) {
+    /* For loop counter */
+    int i;
+
+    /* The file extension, and is it binary object */
+    char *extension;
+    boolean binary;
+
+    /* The objects programs start with zero registries */
+    unsigned short registries[EMULATOR_REGISTRIES_COUNT];
+    OBJECT_IMAGE image;
+
+    int count = JIT_TEST_PROGRAMS_COUNT, mismatches = 0;
+    boolean objects = argc > 1 && strrchr(argv[1], '.') != NULL;
+
+    JIT *jit;
+
+    if (argc > 2 && !objects) {
+        fprintf(stderr, "Usage: %s [count | <name%s | name%s> ...] \n", argv[0], OBJECT_FILE_EXTENSION,
+                BINARY_OBJECT_FILE_EXTENSION);
+        return 1;
+    }
+    if (argc == 2 && !objects) count = atoi(argv[1]);
+
+    init_commands_tables();
+
+    jit = create_jit();
+    if (jit == NULL) {
+        printf("The system can't run the JIT code, nothing to check \n");
+        return 0;
+    }
+
+    if (!objects) {
+        mismatches = test_random_programs(jit, count);
+        printf("%d of %d random programs don't match \n", mismatches, count);
+    }
+
+    memset(registries, 0, sizeof(registries));
+    for (i = 1; objects && i < argc; i++) {
+        extension = strrchr(argv[i], '.');
+        if (strcmp(extension, OBJECT_FILE_EXTENSION) != 0 && strcmp(extension, BINARY_OBJECT_FILE_EXTENSION) != 0) {
+            fprintf(stderr, "ERROR: Not an object %s \n", argv[i]);
+            mismatches++;
+            continue;
+        }
+
+        /* The outputs name is the file name without its extension */
+        binary = strcmp(extension, BINARY_OBJECT_FILE_EXTENSION) == 0;
+        *extension = END_OF_STRING;
+        if (load_object_files(argv[i], binary, &image) != OK) {
+            fprintf(stderr, "CRITICAL: Unable to load object %s%s \n", argv[i],
+                    binary ? BINARY_OBJECT_FILE_EXTENSION : OBJECT_FILE_EXTENSION);
+            mismatches++;
+            continue;
+        }
+
+        if (!compare_runs(jit, &image, registries, JIT_TEST_STEPS_LIMIT, argv[i], TRUE)) mismatches++;
+        free_object_image(&image);
+    }
+    if (objects) printf("%d of %d objects don't match \n", mismatches, argc - 1);
+
+    free_jit(jit);
+
+    return mismatches == 0 ? 0 : 1;
+}
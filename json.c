@@ -0,0 +1,460 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assembler.h"
+
+
+/* The JSON text we parse */
+typedef struct {
+    const char *ptr;
+    const char *end;
+    int depth;
+} JSON_PARSER;
+
+
+static JSON_VALUE *parse_json_value(JSON_PARSER *parser);
+
+/**
+ * This function skips the JSON white spaces
+ * @param parser The parser
+ */
+static void skip_json_spaces(JSON_PARSER *parser) {
+    while (parser->ptr < parser->end &&
+           (*parser->ptr == ' ' || *parser->ptr == '\t' || *parser->ptr == '\n' || *parser->ptr == '\r')) {
+        parser->ptr++;
+    }
+}
+
+/**
+ * This function creates new JSON value
+ * @param type The value type
+ * @param text The value text inside the message
+ * @return The new value
+ */
+static JSON_VALUE *create_json_value(JSON_TYPE type, const char *text) {
+    JSON_VALUE *value = malloc(sizeof(JSON_VALUE));
+    if (value == NULL) {
+        printf("CRITICAL: Failed to allocate JSON value.\n");
+        exit(1);
+    }
+
+    value->type = type;
+    value->name = NULL;
+    value->string = NULL;
+    value->string_length = 0;
+    value->number = 0;
+    value->text = text;
+    value->text_length = 0;
+    value->children = NULL;
+    value->next = NULL;
+
+    return value;
+}
+
+/**
+ * This function reads 4 hex digits (of \u escape)
+ * @param parser The parser (after the \u)
+ * @param code The code to update
+ * @return The status code (ERROR if these are not 4 hex digits)
+ */
+static STATUS_CODE parse_json_hex(JSON_PARSER *parser, unsigned long *code) {
+    /* For loop counter */
+    int i;
+
+    char digit;
+
+    if (parser->end - parser->ptr < JSON_HEX_DIGITS) return ERROR;
+
+    *code = 0;
+    for (i = 0; i < JSON_HEX_DIGITS; i++) {
+        digit = *parser->ptr++;
+
+        if (digit >= '0' && digit <= '9') *code = *code * 16 + (digit - '0');
+        else if (digit >= 'a' && digit <= 'f') *code = *code * 16 + (digit - 'a' + 10);
+        else if (digit >= 'A' && digit <= 'F') *code = *code * 16 + (digit - 'A' + 10);
+        else return ERROR;
+    }
+
+    return OK;
+}
+
+/**
+ * This function writes unicode char as UTF-8
+ * @param string The string to write to (with place for 4 bytes)
+ * @param code The unicode char
+ * @return The number of bytes we wrote
+ */
+static int write_utf8_char(char *string, unsigned long code) {
+    if (code < 0x80) {
+        string[0] = (char) code;
+        return 1;
+    }
+    if (code < 0x800) {
+        string[0] = (char) (0xC0 | (code >> 6));
+        string[1] = (char) (0x80 | (code & 0x3F));
+        return 2;
+    }
+    if (code < 0x10000) {
+        string[0] = (char) (0xE0 | (code >> 12));
+        string[1] = (char) (0x80 | ((code >> 6) & 0x3F));
+        string[2] = (char) (0x80 | (code & 0x3F));
+        return 3;
+    }
+
+    string[0] = (char) (0xF0 | (code >> 18));
+    string[1] = (char) (0x80 | ((code >> 12) & 0x3F));
+    string[2] = (char) (0x80 | ((code >> 6) & 0x3F));
+    string[3] = (char) (0x80 | (code & 0x3F));
+    return 4;
+}
+
+/**
+ * This function parses JSON string (and decodes its escapes)
+ * @param parser The parser (on the opening ")
+ * @param string The new string to update (ends with \0)
+ * @param length The string length to update
+ * @return The status code (ERROR if the string is not valid)
+ */
+static STATUS_CODE parse_json_string(JSON_PARSER *parser, char **string, int *length) {
+    /* The unicode char of \u escape (and the second half of surrogate pair) */
+    unsigned long code, low_code;
+
+    /* The decoded string is never longer than the JSON string */
+    const char *end;
+    char *decoded;
+
+    /* Find the closing " (escaped chars are skipped) */
+    for (end = parser->ptr + 1; end < parser->end && *end != '"'; end++) {
+        if (*end == '\\') end++;
+    }
+    if (end >= parser->end) return ERROR;
+
+    /* +1 for \0 */
+    decoded = malloc(end - parser->ptr);
+    if (decoded == NULL) {
+        printf("CRITICAL: Failed to allocate JSON string.\n");
+        exit(1);
+    }
+
+    *string = decoded;
+    *length = 0;
+    parser->ptr++;
+
+    while (parser->ptr < end) {
+        if (*parser->ptr != '\\') {
+            decoded[(*length)++] = *parser->ptr++;
+            continue;
+        }
+
+        parser->ptr++;
+        switch (*parser->ptr++) {
+            case '"':
+                decoded[(*length)++] = '"';
+                break;
+            case '\\':
+                decoded[(*length)++] = '\\';
+                break;
+            case '/':
+                decoded[(*length)++] = '/';
+                break;
+            case 'b':
+                decoded[(*length)++] = '\b';
+                break;
+            case 'f':
+                decoded[(*length)++] = '\f';
+                break;
+            case 'n':
+                decoded[(*length)++] = '\n';
+                break;
+            case 'r':
+                decoded[(*length)++] = '\r';
+                break;
+            case 't':
+                decoded[(*length)++] = '\t';
+                break;
+            case 'u':
+                if (parse_json_hex(parser, &code) != OK) return ERROR;
+
+                /* Chars after 0xFFFF are written as surrogate pair (two \u escapes) */
+                if (code >= 0xD800 && code <= 0xDBFF && end - parser->ptr >= 2 + JSON_HEX_DIGITS &&
+                    parser->ptr[0] == '\\' && parser->ptr[1] == 'u') {
+                    parser->ptr += 2;
+                    if (parse_json_hex(parser, &low_code) != OK || low_code < 0xDC00 || low_code > 0xDFFF) {
+                        return ERROR;
+                    }
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low_code - 0xDC00);
+                }
+
+                *length += write_utf8_char(decoded + *length, code);
+                break;
+            default:
+                return ERROR;
+        }
+    }
+
+    decoded[*length] = END_OF_STRING;
+    parser->ptr = end + 1;
+
+    return OK;
+}
+
+/**
+ * This function parses JSON number (the fraction and the exponent are ignored)
+ * @param parser The parser (on the number)
+ * @param value The value to update
+ * @return The status code (ERROR if there are no digits)
+ */
+static STATUS_CODE parse_json_number(JSON_PARSER *parser, JSON_VALUE *value) {
+    boolean is_negative = FALSE;
+    boolean has_digits = FALSE;
+
+    if (*parser->ptr == '-') {
+        is_negative = TRUE;
+        parser->ptr++;
+    }
+
+    /* Bigger numbers stay JSON_MAX_NUMBER (we use only ids and positions) */
+    while (parser->ptr < parser->end && IS_DIGIT_CHAR(*parser->ptr)) {
+        if (value->number < JSON_MAX_NUMBER) value->number = value->number * 10 + (*parser->ptr - '0');
+        if (value->number > JSON_MAX_NUMBER) value->number = JSON_MAX_NUMBER;
+        parser->ptr++;
+        has_digits = TRUE;
+    }
+    if (is_negative) value->number = -value->number;
+
+    /* The fraction and the exponent */
+    while (parser->ptr < parser->end && (IS_DIGIT_CHAR(*parser->ptr) || *parser->ptr == '.' || *parser->ptr == 'e' ||
+                                         *parser->ptr == 'E' || *parser->ptr == '+' || *parser->ptr == '-')) {
+        parser->ptr++;
+    }
+
+    return has_digits ? OK : ERROR;
+}
+
+/**
+ * This function parses the items of JSON array, or the members of JSON object
+ * @param parser The parser (on the opening [ or {)
+ * @param value The array / object to add the children to
+ * @return The status code (ERROR if the array / object is not valid)
+ */
+static STATUS_CODE parse_json_children(JSON_PARSER *parser, JSON_VALUE *value) {
+    /* The closing char */
+    char close = value->type == JSON_ARRAY ? ']' : '}';
+
+    /* The current member name, and the last child */
+    char *name;
+    int name_length;
+    JSON_VALUE *child, *last_child = NULL;
+
+    parser->ptr++;
+    skip_json_spaces(parser);
+    if (parser->ptr < parser->end && *parser->ptr == close) {
+        parser->ptr++;
+        return OK;
+    }
+
+    while (parser->ptr < parser->end) {
+        name = NULL;
+
+        /* Object member starts with its name */
+        if (value->type == JSON_OBJECT) {
+            if (*parser->ptr != '"' || parse_json_string(parser, &name, &name_length) != OK) {
+                free(name);
+                return ERROR;
+            }
+
+            skip_json_spaces(parser);
+            if (parser->ptr >= parser->end || *parser->ptr != ':') {
+                free(name);
+                return ERROR;
+            }
+            parser->ptr++;
+        }
+
+        child = parse_json_value(parser);
+        if (child == NULL) {
+            free(name);
+            return ERROR;
+        }
+
+        child->name = name;
+        if (last_child == NULL) value->children = child;
+        else last_child->next = child;
+        last_child = child;
+
+        skip_json_spaces(parser);
+        if (parser->ptr >= parser->end) return ERROR;
+        if (*parser->ptr == close) {
+            parser->ptr++;
+            return OK;
+        }
+        if (*parser->ptr != ',') return ERROR;
+
+        parser->ptr++;
+        skip_json_spaces(parser);
+    }
+
+    return ERROR;
+}
+
+/**
+ * This function checks if the text starts with the keyword (e.g. true)
+ * @param parser The parser
+ * @param keyword The keyword
+ * @return Does the text start with the keyword (the parser moves after it)
+ */
+static boolean parse_json_keyword(JSON_PARSER *parser, const char *keyword) {
+    int length = strlen(keyword);
+
+    if (parser->end - parser->ptr < length || strncmp(parser->ptr, keyword, length) != 0) return FALSE;
+
+    parser->ptr += length;
+    return TRUE;
+}
+
+/**
+ * This function parses one JSON value
+ * @param parser The parser
+ * @return The new value (null if the value is not valid)
+ */
+static JSON_VALUE *parse_json_value(JSON_PARSER *parser) {
+    JSON_VALUE *value;
+    STATUS_CODE status_code = OK;
+
+    skip_json_spaces(parser);
+    if (parser->ptr >= parser->end || parser->depth >= JSON_MAX_DEPTH) return NULL;
+
+    value = create_json_value(JSON_NULL, parser->ptr);
+    parser->depth++;
+
+    if (*parser->ptr == '{' || *parser->ptr == '[') {
+        value->type = *parser->ptr == '{' ? JSON_OBJECT : JSON_ARRAY;
+        status_code = parse_json_children(parser, value);
+    } else if (*parser->ptr == '"') {
+        value->type = JSON_STRING;
+        status_code = parse_json_string(parser, &value->string, &value->string_length);
+    } else if (*parser->ptr == '-' || IS_DIGIT_CHAR(*parser->ptr)) {
+        value->type = JSON_NUMBER;
+        status_code = parse_json_number(parser, value);
+    } else if (parse_json_keyword(parser, JSON_TRUE_TEXT)) {
+        value->type = JSON_TRUE;
+    } else if (parse_json_keyword(parser, JSON_FALSE_TEXT)) {
+        value->type = JSON_FALSE;
+    } else if (!parse_json_keyword(parser, JSON_NULL_TEXT)) {
+        status_code = ERROR;
+    }
+
+    parser->depth--;
+
+    if (status_code != OK) {
+        free_json_value(value);
+        return NULL;
+    }
+
+    value->text_length = parser->ptr - value->text;
+
+    return value;
+}
+
+/**
+ * This function parses JSON text
+ * @param text The JSON text (doesn't have to end with \0)
+ * @param length The text length
+ * @return The new value (free it with free_json_value), or null if the text is not valid JSON
+ */
+JSON_VALUE *parse_json(const char *text, int length) {
+    JSON_VALUE *value;
+
+    JSON_PARSER parser;
+    parser.ptr = text;
+    parser.end = text + length;
+    parser.depth = 0;
+
+    value = parse_json_value(&parser);
+
+    /* Only spaces can be after the value */
+    skip_json_spaces(&parser);
+    if (value != NULL && parser.ptr != parser.end) {
+        free_json_value(value);
+        return NULL;
+    }
+
+    return value;
+}
+
+/**
+ * This function finds member of JSON object
+ * @param object The object (Can be null, or another type)
+ * @param name The member name
+ * @return The member value (null if there is no such member)
+ */
+JSON_VALUE *get_json_member(const JSON_VALUE *object, const char *name) {
+    JSON_VALUE *member;
+
+    if (object == NULL || object->type != JSON_OBJECT) return NULL;
+
+    for (member = object->children; member != NULL; member = member->next) {
+        if (strcmp(member->name, name) == 0) return member;
+    }
+
+    return NULL;
+}
+
+/**
+ * This function appends text as JSON string (with the quotes and the escapes) to the output buffer
+ * @param buffer The output buffer
+ * @param text The text
+ * @param length The text length
+ */
+void append_json_string(OUTPUT_BUFFER *buffer, const char *text, int length) {
+    /* For loop counter */
+    int i;
+
+    /* The escape of control char (\u00XX) */
+    char escape[JSON_HEX_DIGITS + 3];
+
+    /* The text part which doesn't need escapes */
+    int part_start = 0;
+
+    append_to_output_buffer(buffer, "\"", 1);
+
+    for (i = 0; i < length; i++) {
+        if (text[i] != '"' && text[i] != '\\' && (unsigned char) text[i] >= ' ') continue;
+
+        append_to_output_buffer(buffer, text + part_start, i - part_start);
+        part_start = i + 1;
+
+        if (text[i] == '"') append_to_output_buffer(buffer, "\\\"", 2);
+        else if (text[i] == '\\') append_to_output_buffer(buffer, "\\\\", 2);
+        else if (text[i] == '\n') append_to_output_buffer(buffer, "\\n", 2);
+        else if (text[i] == '\r') append_to_output_buffer(buffer, "\\r", 2);
+        else if (text[i] == '\t') append_to_output_buffer(buffer, "\\t", 2);
+        else {
+            sprintf(escape, "\\u%04x", (unsigned char) text[i]);
+            append_to_output_buffer(buffer, escape, strlen(escape));
+        }
+    }
+
+    append_to_output_buffer(buffer, text + part_start, length - part_start);
+    append_to_output_buffer(buffer, "\"", 1);
+}
+
+/**
+ * This function frees the JSON value and all its children
+ * @param value The value
+ */
+void free_json_value(JSON_VALUE *value) {
+    JSON_VALUE *child = value->children;
+    JSON_VALUE *next_child;
+
+    while (child != NULL) {
+        next_child = child->next;
+        free_json_value(child);
+        child = next_child;
+    }
+
+    free(value->name);
+    free(value->string);
+    free(value);
+}
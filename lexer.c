@@ -0,0 +1,768 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "assembler.h"
+
+
+/**
+ * This function classify the line by its first word
+ * It only detects the macros definitions lines (mcro / mcroend), all other lines are statements
+ * It updates the line pointer to be after the leading spaces and the macro keyword (if exists)
+ * @param line_ptr Pointer to the line
+ * @return The line kind (LINE_MACRO_START / LINE_MACRO_END / LINE_STATEMENT)
+ */
+LINE_KIND classify_line(char **line_ptr) {
+    /* In the end we update the pointer to the new address */
+    char *line = *line_ptr;
+
+    /* Remove leading space (e.g. ' mcro') */
+    skip_empty_spaces(&line);
+
+    /* mcroend also starts with mcro, so we check it first */
+    if (strncmp(line, END_MACRO_NAME, strlen(END_MACRO_NAME)) == 0) {
+        *line_ptr = line + strlen(END_MACRO_NAME);
+        return LINE_MACRO_END;
+    }
+    if (strncmp(line, MACRO_NAME, strlen(MACRO_NAME)) == 0) {
+        *line_ptr = line + strlen(MACRO_NAME);
+        return LINE_MACRO_START;
+    }
+
+    *line_ptr = line;
+    return LINE_STATEMENT;
+}
+
+/**
+ * This function save the parsed numbers in the lexed line
+ * @param lexed_line The lexed line
+ * @param numbers The parsed numbers
+ * @param count How many numbers we parsed
+ */
+static void save_lexed_numbers(LEXED_LINE *lexed_line, const int *numbers, int count) {
+    lexed_line->numbers_count = count;
+
+    /* No need to allocate memory (e.g. '.mat [2][2]') */
+    if (count == 0) return;
+
+    lexed_line->numbers = malloc(sizeof(int) * count);
+    if (lexed_line->numbers == NULL) {
+        printf("CRITICAL: Failed to allocate memory for numbers");
+        exit(1);
+    }
+
+    memcpy(lexed_line->numbers, numbers, sizeof(int) * count);
+}
+
+/**
+ * Lex the data instruction params (e.g. '.data 1, -2, 3')
+ * @param str_ptr Pointer to the params (It also updates it)
+ * @param lexed_line The lexed line to update with the numbers
+ * @return The status code
+ */
+static STATUS_CODE lex_data_params(char **str_ptr, LEXED_LINE *lexed_line) {
+    char *str = *str_ptr;
+
+    /* Line can't have more numbers than chars */
+    int numbers[LINE_MAX_LENGTH];
+    int count = 0;
+
+    /* We can define .data    3 -> so skip all these empty spaces */
+    skip_empty_spaces(&str);
+
+    /* If the first value starts with invalid char (e.g. '.data ,') */
+    if (!IS_CHAR_CLASS(*str, CHAR_CLASS_DIGIT | CHAR_CLASS_SIGN)) {
+        report_diagnostic(&lexed_line->errors, DIAGNOSTIC_NUMBER_START, 0, NULL);
+        return ERROR;
+    }
+
+    while (*str) {
+        if (count >= LINE_MAX_LENGTH ||
+            get_next_number_from_instruction_params(&str, &numbers[count], 0, &lexed_line->errors) == ERROR) {
+            return ERROR;
+        }
+        count++;
+    }
+
+    save_lexed_numbers(lexed_line, numbers, count);
+    *str_ptr = str;
+
+    return OK;
+}
+
+/**
+ * Lex the mat instruction params (e.g. '.mat [2][2] 1, 2')
+ * @param str_ptr Pointer to the params (It also updates it)
+ * @param lexed_line The lexed line to update with the mat size and numbers
+ * @return The status code
+ */
+static STATUS_CODE lex_mat_params(char **str_ptr, LEXED_LINE *lexed_line) {
+    char *str = *str_ptr;
+
+    /* Line can't have more numbers than chars */
+    int numbers[LINE_MAX_LENGTH];
+    int count = 0;
+
+    /* We need to define num_of_params in the address */
+    lexed_line->mat_size = get_mat_instruction_size(&str);
+
+    /* Error in mat definition size */
+    if (lexed_line->mat_size == -1) {
+        report_diagnostic(&lexed_line->errors, DIAGNOSTIC_MAT_DEFINITION_SYNTAX, 0, NULL);
+        return ERROR;
+    }
+
+    /* We can define .mat[1][2]    3 -> so skip all these empty spaces */
+    skip_empty_spaces(&str);
+
+    /* If the first value starts with invalid char (e.g. '.mat ,') */
+    if (*str && !IS_CHAR_CLASS(*str, CHAR_CLASS_DIGIT | CHAR_CLASS_SIGN)) {
+        report_diagnostic(&lexed_line->errors, DIAGNOSTIC_NUMBER_START, 0, NULL);
+        return ERROR;
+    }
+
+    while (*str) {
+        if (count >= LINE_MAX_LENGTH ||
+            get_next_number_from_instruction_params(&str, &numbers[count], 0, &lexed_line->errors) == ERROR) {
+            return ERROR;
+        }
+
+        /* We got more than expected params */
+        if (++count > lexed_line->mat_size) {
+            report_diagnostic_numbers(&lexed_line->errors, DIAGNOSTIC_MAT_TOO_MANY_PARAMS, 0, lexed_line->mat_size,
+                                      0);
+            return ERROR;
+        }
+    }
+
+    save_lexed_numbers(lexed_line, numbers, count);
+    *str_ptr = str;
+
+    return OK;
+}
+
+/**
+ * Lex the string instruction param (e.g. '.string "abc"')
+ * We only save the string span, the chars are encoded in the first assembler
+ * @param str_ptr Pointer to the param (It also updates it)
+ * @param lexed_line The lexed line to update with the string span
+ * @return The status code
+ */
+static STATUS_CODE lex_string_param(char **str_ptr, LEXED_LINE *lexed_line) {
+    char *str = *str_ptr;
+
+    /* We don't have any string as parameter */
+    if (*str == END_OF_STRING || *str != STRING_SYMBOL) {
+        report_diagnostic(&lexed_line->errors, DIAGNOSTIC_STRING_MISSING, 0, NULL);
+        return ERROR;
+    }
+
+    /* Skip the string start symbol ('"') */
+    lexed_line->string_start = ++str;
+
+    /* Go until the end of string (strchr scans the line in blocks, so long strings are cheap) */
+    str = strchr(str, STRING_SYMBOL);
+
+    /* Wo don't close our string with the symbol */
+    if (str == NULL) {
+        report_diagnostic(&lexed_line->errors, DIAGNOSTIC_STRING_NOT_CLOSED, 0, NULL);
+        return ERROR;
+    }
+
+    lexed_line->string_length = str - lexed_line->string_start;
+
+    /* Skip last '"' char */
+    *str_ptr = str + 1;
+
+    return OK;
+}
+
+/**
+ * This function saves name from the line (label, symbol...) as string
+ * All the names share one copy of the line, and each name ends with \0 inside this copy
+ * (Names never touch each other, so the char after the name is never part of another name)
+ * @param lexed_line The lexed line
+ * @param name The name slice inside the line text
+ * @return The name as string
+ */
+static char *save_lexed_name(LEXED_LINE *lexed_line, TOKEN_SLICE name) {
+    /* The name inside the names copy */
+    char *saved_name;
+
+    /* First name of this line, so we create the copy */
+    if (lexed_line->names == NULL) {
+        /* +1 for \0 */
+        lexed_line->names = malloc(strlen(lexed_line->text) + 1);
+        if (lexed_line->names == NULL) {
+            printf("CRITICAL: Failed to allocate memory for names");
+            exit(1);
+        }
+        strcpy(lexed_line->names, lexed_line->text);
+    }
+
+    saved_name = lexed_line->names + (name.start - lexed_line->text);
+    saved_name[name.length] = END_OF_STRING;
+
+    return saved_name;
+}
+
+/**
+ * Save the decoded operand in the lexed line (with its symbol name)
+ * @param lexed_line The lexed line
+ * @param decoded_operand The decoded operand (Its type is already validated)
+ * @param lexed_operand The lexed operand to update
+ * @return The status code
+ */
+static STATUS_CODE save_lexed_operand(LEXED_LINE *lexed_line, const DECODED_OPERAND *decoded_operand,
+                                      LEXED_OPERAND *lexed_operand) {
+    /* Mat with invalid registries syntax */
+    if (decoded_operand->operand.type == MAT && decoded_operand->mat_status == ERROR) {
+        report_diagnostic(&lexed_line->errors, DIAGNOSTIC_MAT_OPERAND_SYNTAX, 0, NULL);
+        return ERROR;
+    }
+
+    *lexed_operand = decoded_operand->operand;
+
+    /* We still don't know the address, so we save the symbol name */
+    if (lexed_operand->type == SYMBOL || lexed_operand->type == MAT) {
+        lexed_operand->symbol = save_lexed_name(lexed_line, decoded_operand->symbol);
+    }
+
+    return OK;
+}
+
+/**
+ * Lex the command operands, and validate them for the command
+ * (Number of operands and the allowed operands types)
+ * @param str_ptr Pointer to operands string (It also updates it)
+ * @param lexed_line The lexed line (with the command info)
+ * @return The status code
+ */
+static STATUS_CODE lex_command_operands(char **str_ptr, LEXED_LINE *lexed_line) {
+    char *str = *str_ptr;
+
+    /* The line errors sink */
+    DIAGNOSTICS *errors = &lexed_line->errors;
+
+    /* The current command details */
+    const COMMAND_INFO *command_info = lexed_line->command_info;
+
+    /* The two operands (if one of them or both are not exist their type is undefined) */
+    DECODED_OPERAND first_operand;
+    DECODED_OPERAND second_operand;
+
+    /* The operands types */
+    OPERAND_TYPE first_operand_type;
+    OPERAND_TYPE second_operand_type;
+
+    decode_command_operand(&str, &first_operand);
+
+    /* Can be r2  ,*/
+    skip_empty_spaces(&str);
+
+    /* If we don't have ',' should not be more operands */
+    if (*str != DATA_DELIMITER) {
+        if (*str && *str != COMMENT_SYMBOL) {
+            report_diagnostic(errors, DIAGNOSTIC_OPERAND_MISSING_COMMA, 0, str);
+            return ERROR;
+        }
+
+        /* We have only one operand -> the second is empty (nothing left in the line) */
+        decode_command_operand(&str, &second_operand);
+    } else {
+        /* Skip the DATA_DELIMITER */
+        str++;
+        decode_command_operand(&str, &second_operand);
+
+        if (second_operand.text.length == 0) {
+            report_diagnostic(errors, DIAGNOSTIC_SECOND_OPERAND_INVALID, 0, NULL);
+            return ERROR;
+        }
+    }
+
+    first_operand_type = first_operand.operand.type;
+    second_operand_type = second_operand.operand.type;
+
+    /* Invalid registry number (e.g. r9) */
+    if (first_operand_type == INVALID_OPERAND) {
+        report_diagnostic_slice(errors, DIAGNOSTIC_REGISTRY_NUMBER, 0, first_operand.text);
+    }
+    if (second_operand_type == INVALID_OPERAND) {
+        report_diagnostic_slice(errors, DIAGNOSTIC_REGISTRY_NUMBER, 0, second_operand.text);
+    }
+
+    /* If one of param is empty !!length will return 0 so if we combine the sum we get the number of params */
+    lexed_line->operands_count = !!first_operand.text.length + !!second_operand.text.length;
+
+    /* Invalid operands format */
+    if (first_operand_type == INVALID_OPERAND || second_operand_type == INVALID_OPERAND) {
+        return ERROR;
+    }
+
+    /* Check correct number of operands */
+    if (lexed_line->operands_count != command_info->num_of_operands) {
+        report_diagnostic_numbers(errors, DIAGNOSTIC_OPERANDS_COUNT, 0, command_info->num_of_operands,
+                                  lexed_line->operands_count);
+        return ERROR;
+    }
+
+    /* Validate the operands types are allowed in this command (only one operand is the destination) */
+    if (first_operand_type != UNDEFINED && second_operand_type == UNDEFINED) {
+        if (!is_valid_operand_type(first_operand_type, command_info, DES_OPERAND_ORDER)) {
+            report_diagnostic(errors, DIAGNOSTIC_DES_OPERAND_TYPE, 0, NULL);
+            return ERROR;
+        }
+    } else if (second_operand_type != UNDEFINED) {
+        if (!is_valid_operand_type(first_operand_type, command_info, SOURCE_OPERAND_ORDER)) {
+            report_diagnostic(errors, DIAGNOSTIC_SOURCE_OPERAND_TYPE, 0, NULL);
+            return ERROR;
+        }
+        if (!is_valid_operand_type(second_operand_type, command_info, DES_OPERAND_ORDER)) {
+            report_diagnostic(errors, DIAGNOSTIC_DES_OPERAND_TYPE, 0, NULL);
+            return ERROR;
+        }
+    }
+
+    /* Now we can save the operands values */
+    if (save_lexed_operand(lexed_line, &first_operand, &lexed_line->operands[0]) == ERROR ||
+        save_lexed_operand(lexed_line, &second_operand, &lexed_line->operands[1]) == ERROR) {
+        return ERROR;
+    }
+
+    /* Update the pointer actual address */
+    *str_ptr = str;
+
+    return OK;
+}
+
+/**
+ * Check if the name slice is exactly the given name
+ * @param name The name slice
+ * @param expected The expected name
+ * @return TRUE if they are the same
+ */
+static boolean is_slice_name(TOKEN_SLICE name, const char *expected) {
+    return strncmp(name.start, expected, name.length) == 0 && expected[name.length] == END_OF_STRING;
+}
+
+/**
+ * Lex the line after the command or instruction name
+ * @param line_ptr Pointer to the line after the name (It also updates it)
+ * @param name The command or instruction name slice
+ * @param lexed_line The lexed line to update
+ * @return The status code
+ */
+static STATUS_CODE lex_statement_body(char **line_ptr, TOKEN_SLICE name, LEXED_LINE *lexed_line) {
+    /* The entry / extern symbol */
+    TOKEN_SLICE symbol;
+
+    /* Our command is instruction type */
+    if (*name.start == INSTRUCTION_PREFIX) {
+        /* Ignore the prefix */
+        name.start++;
+        name.length--;
+
+        if (is_slice_name(name, ENTRY_INSTRUCTION_NAME) || is_slice_name(name, EXTERNAL_INSTRUCTION_NAME)) {
+            lexed_line->kind = is_slice_name(name, ENTRY_INSTRUCTION_NAME) ? LINE_ENTRY : LINE_EXTERN;
+
+            /* After '.entry' / '.extern' we expected to get the symbol name */
+            symbol = get_current_symbol(line_ptr, 0, &lexed_line->errors);
+            if (symbol.length == 0) return ERROR;
+
+            lexed_line->symbol = save_lexed_name(lexed_line, symbol);
+            return OK;
+        }
+        if (is_slice_name(name, DATA_INSTRUCTION_NAME)) {
+            lexed_line->kind = LINE_DATA;
+            return lex_data_params(line_ptr, lexed_line);
+        }
+        if (is_slice_name(name, MAT_INSTRUCTION_NAME)) {
+            lexed_line->kind = LINE_MAT;
+            return lex_mat_params(line_ptr, lexed_line);
+        }
+        if (is_slice_name(name, STRING_INSTRUCTION_NAME)) {
+            lexed_line->kind = LINE_STRING;
+            return lex_string_param(line_ptr, lexed_line);
+        }
+
+        report_diagnostic_slice(&lexed_line->errors, DIAGNOSTIC_UNKNOWN_INSTRUCTION, 0, name);
+        return ERROR;
+    }
+
+    /* Regular command type */
+    lexed_line->command_info = get_command_info_by_name(name.start, name.length);
+    if (lexed_line->command_info == NULL) {
+        report_diagnostic_slice(&lexed_line->errors, DIAGNOSTIC_UNKNOWN_COMMAND, 0, name);
+        return ERROR;
+    }
+
+    lexed_line->kind = LINE_COMMAND;
+    return lex_command_operands(line_ptr, lexed_line);
+}
+
+/**
+ * This function lex a statement line (all lines which are not macros definitions)
+ * It scans the line once and saves the label, command / instruction and its params
+ * Errors are not reported here, they are saved in the line with the stage they found,
+ * so the first assembler can report them in the same order as its own checks
+ * @param lexed_line The lexed line (with its text)
+ */
+static void lex_statement(LEXED_LINE *lexed_line) {
+    /* Pointer to char inside the line */
+    char *line_ptr = lexed_line->text;
+
+    /* Command name (e.g. .data/mov/jmp...) */
+    TOKEN_SLICE command_name;
+
+    /* Line can be starts with empty spaces */
+    skip_empty_spaces(&line_ptr);
+
+    /* Empty line or comment line */
+    if (!*line_ptr || *line_ptr == COMMENT_SYMBOL) {
+        lexed_line->kind = LINE_EMPTY;
+        return;
+    }
+
+    /* Until we know what is the line we define it as invalid */
+    lexed_line->kind = LINE_INVALID;
+
+    /* Extract the first word of the line (can be symbol / command / instruction) */
+    command_name = coppy_next_command_or_symbol(&line_ptr, 0, &lexed_line->errors);
+    if (command_name.length == 0) {
+        lexed_line->error_stage = LEX_STAGE_FIRST_WORD;
+        return;
+    }
+
+    /* Symbol definition, so the first word is the label */
+    if (command_name.start[command_name.length - 1] == SYMBOL_SUFFIX) {
+        /* We don't want to save the last char (':') so we remove this */
+        command_name.length--;
+        lexed_line->label = save_lexed_name(lexed_line, command_name);
+
+        if (command_name.length > MAX_SYMBOL_LENGTH) {
+            report_diagnostic(&lexed_line->errors, DIAGNOSTIC_LABEL_TOO_LONG, 0, NULL);
+            lexed_line->error_stage = LEX_STAGE_LABEL;
+            return;
+        }
+
+        /* Calculate the new command */
+        command_name = coppy_next_command_or_symbol(&line_ptr, 0, &lexed_line->errors);
+        if (command_name.length == 0) {
+            lexed_line->error_stage = LEX_STAGE_SECOND_WORD;
+            return;
+        }
+    }
+
+    /* Now line_ptr is after the command and symbol */
+    skip_empty_spaces(&line_ptr);
+
+    if (lex_statement_body(&line_ptr, command_name, lexed_line) == ERROR) {
+        lexed_line->error_stage = LEX_STAGE_BODY;
+    }
+    /* We expect to this line to be ended, so if it doesn't we get unexpected params */
+    else if (*line_ptr && *line_ptr != COMMENT_SYMBOL) {
+        report_diagnostic(&lexed_line->errors, DIAGNOSTIC_UNEXPECTED_PARAMS, 0, line_ptr);
+        lexed_line->error_stage = LEX_STAGE_TRAILING;
+    }
+}
+
+/**
+ * Create new lexed line from the line text, without lexing it yet
+ * The text is copied, so it can be the current line buffer
+ * @param text The line text (without the end of line)
+ * @return The new lexed line
+ */
+static LEXED_LINE *new_lexed_line(const char *text) {
+    LEXED_LINE *lexed_line = malloc(sizeof(LEXED_LINE));
+    if (lexed_line == NULL) {
+        printf("CRITICAL: Failed to allocate lexed line.\n");
+        exit(1);
+    }
+
+    /* +1 for \0 */
+    lexed_line->text = malloc(strlen(text) + 1);
+    if (lexed_line->text == NULL) {
+        printf("CRITICAL: Failed to allocate lexed line text.\n");
+        exit(1);
+    }
+    strcpy(lexed_line->text, text);
+
+    /* Init default values */
+    lexed_line->kind = LINE_EMPTY;
+    lexed_line->label = NULL;
+    lexed_line->command_info = NULL;
+    lexed_line->operands_count = 0;
+    lexed_line->operands[0].symbol = NULL;
+    lexed_line->operands[1].symbol = NULL;
+    lexed_line->numbers = NULL;
+    lexed_line->numbers_count = 0;
+    lexed_line->mat_size = 0;
+    lexed_line->string_start = NULL;
+    lexed_line->string_length = 0;
+    lexed_line->symbol = NULL;
+    lexed_line->names = NULL;
+    lexed_line->error_stage = LEX_STAGE_NONE;
+    lexed_line->hash = 0;
+    lexed_line->next_cached = NULL;
+    init_diagnostics(&lexed_line->errors);
+
+    return lexed_line;
+}
+
+/**
+ * Create new lexed line from the line text
+ * The text is copied, so it can be the current line buffer
+ * @param text The line text (without the end of line)
+ * @return The new lexed line
+ */
+LEXED_LINE *create_lexed_line(const char *text) {
+    LEXED_LINE *lexed_line = new_lexed_line(text);
+
+    lex_statement(lexed_line);
+
+    return lexed_line;
+}
+
+/**
+ * This function frees the lexed line and all its tokens
+ * @param lexed_line The lexed line
+ */
+void free_lexed_line(LEXED_LINE *lexed_line) {
+    free(lexed_line->text);
+    free(lexed_line->names);
+    free(lexed_line->numbers);
+    clear_diagnostics(&lexed_line->errors);
+    free(lexed_line);
+}
+
+/**
+ * Create new empty lexed source
+ * @return The new lexed source
+ */
+LEXED_SOURCE *create_lexed_source(void) {
+    /* For loop counter */
+    int i;
+
+    LEXED_SOURCE *lexed_source = malloc(sizeof(LEXED_SOURCE));
+    if (lexed_source == NULL) {
+        printf("CRITICAL: Failed to allocate lexed source.\n");
+        exit(1);
+    }
+
+    /* Init default values */
+    lexed_source->lines = NULL;
+    lexed_source->count = 0;
+    lexed_source->capacity = 0;
+    lexed_source->source_line_numbers = NULL;
+    lexed_source->macros = NULL;
+    lexed_source->owned_lines = NULL;
+    lexed_source->owned_count = 0;
+    lexed_source->owned_capacity = 0;
+    lexed_source->lexed_count = 0;
+    for (i = 0; i < LEXED_CACHE_SIZE; i++) lexed_source->cache[i] = NULL;
+
+    return lexed_source;
+}
+
+/**
+ * Add line to the end of lines array
+ * @param lines The lines array (It also updates it when it grows)
+ * @param count The number of lines (It also updates it)
+ * @param capacity The array capacity (It also updates it)
+ * @param lexed_line The line to add
+ */
+static void append_lexed_line(LEXED_LINE ***lines, int *count, int *capacity, LEXED_LINE *lexed_line) {
+    /* We double the array each time it is full */
+    if (*count == *capacity) {
+        *capacity = *capacity == 0 ? LEXED_SOURCE_DEFAULT_CAPACITY : *capacity * 2;
+        *lines = realloc(*lines, sizeof(LEXED_LINE *) * *capacity);
+        if (*lines == NULL) {
+            printf("CRITICAL: Failed to allocate lexed source lines.\n");
+            exit(1);
+        }
+    }
+
+    (*lines)[(*count)++] = lexed_line;
+}
+
+/**
+ * Add line to the end of the lexed source
+ * Macros lines can be added many times (they are owned by the macro)
+ * @param lexed_source The lexed source
+ * @param lexed_line The line to add
+ * @param source_line_number The line number in the source (before the macros were expanded)
+ * @param macro The macro which the line came from (null if it is not macro line)
+ */
+void add_lexed_line(LEXED_SOURCE *lexed_source, LEXED_LINE *lexed_line, int source_line_number, MACRO *macro) {
+    /* The lines array capacity before we add the line */
+    int capacity = lexed_source->capacity;
+
+    append_lexed_line(&lexed_source->lines, &lexed_source->count, &lexed_source->capacity, lexed_line);
+
+    /* The line numbers and macros arrays have the same capacity as the lines */
+    if (lexed_source->capacity != capacity) {
+        lexed_source->source_line_numbers = realloc(lexed_source->source_line_numbers,
+                                                    sizeof(int) * lexed_source->capacity);
+        lexed_source->macros = realloc(lexed_source->macros, sizeof(MACRO *) * lexed_source->capacity);
+        if (lexed_source->source_line_numbers == NULL || lexed_source->macros == NULL) {
+            printf("CRITICAL: Failed to allocate lexed source line numbers.\n");
+            exit(1);
+        }
+    }
+
+    lexed_source->source_line_numbers[lexed_source->count - 1] = source_line_number;
+    lexed_source->macros[lexed_source->count - 1] = macro;
+}
+
+/**
+ * Remove all the lines from the lexed source, but keep the lines it owns
+ * So the next source (e.g. the same source after an edit) lexes only its new lines
+ * @param lexed_source The lexed source
+ */
+void reuse_lexed_source(LEXED_SOURCE *lexed_source) {
+    lexed_source->count = 0;
+}
+
+/**
+ * Get the line cache key (the text without its leading spaces)
+ * @param text The line text
+ * @return The key inside the text
+ */
+static const char *get_lexed_line_key(const char *text) {
+    while (IS_SPACE_CHAR(*text)) text++;
+
+    return text;
+}
+
+/**
+ * Find the line of this text in the lexed source cache, or create it and save it in the cache
+ * The key is the text without its leading spaces (they don't change the lexed line)
+ * New lines are not lexed yet, they are lexed all together in lex_source_lines
+ * @param lexed_source The lexed source
+ * @param text The line text (without the end of line)
+ * @return The line (owned by the lexed source)
+ */
+LEXED_LINE *get_cached_lexed_line(LEXED_SOURCE *lexed_source, const char *text) {
+    /* The text without the leading spaces */
+    const char *key = get_lexed_line_key(text);
+
+    /* Pointer to char inside the key */
+    const char *key_ptr;
+
+    /* The key hash (djb2) */
+    unsigned long hash = 5381;
+
+    /* The cache list of this key */
+    LEXED_LINE **cache_list;
+
+    LEXED_LINE *lexed_line;
+
+    for (key_ptr = key; *key_ptr; key_ptr++) {
+        hash = hash * 33 + (unsigned char) *key_ptr;
+    }
+
+    /* We already lexed this line */
+    cache_list = &lexed_source->cache[hash % LEXED_CACHE_SIZE];
+    for (lexed_line = *cache_list; lexed_line != NULL; lexed_line = lexed_line->next_cached) {
+        if (lexed_line->hash == hash && strcmp(get_lexed_line_key(lexed_line->text), key) == 0) return lexed_line;
+    }
+
+    /* New line, add it to the start of the cache list */
+    lexed_line = new_lexed_line(text);
+    lexed_line->hash = hash;
+    lexed_line->next_cached = *cache_list;
+    *cache_list = lexed_line;
+    append_lexed_line(&lexed_source->owned_lines, &lexed_source->owned_count, &lexed_source->owned_capacity,
+                      lexed_line);
+
+    return lexed_line;
+}
+
+/**
+ * Lex all the lines of the chunk (It is the thread function)
+ * @param chunk_ptr The chunk to lex
+ * @return Always null
+ */
+static void *lex_chunk(void *chunk_ptr) {
+    LEX_CHUNK *chunk = chunk_ptr;
+
+    /* For loop counter */
+    int i;
+
+    for (i = 0; i < chunk->count; i++) lex_statement(chunk->lines[i]);
+
+    return NULL;
+}
+
+/**
+ * Lex all the lines the lexed source owns (lines which are already lexed are not lexed again)
+ * Each line is lexed only by itself, so big sources are split to chunks which are lexed in threads
+ * @param lexed_source The lexed source
+ * @param jobs The max number of threads (1 means we lex without threads)
+ */
+void lex_source_lines(LEXED_SOURCE *lexed_source, int jobs) {
+    /* The chunks and their threads */
+    LEX_CHUNK chunks[MAX_LEX_JOBS];
+    pthread_t threads[MAX_LEX_JOBS];
+    boolean is_thread_created[MAX_LEX_JOBS];
+
+    /* Number of chunks and the lines in each one */
+    int chunks_count = jobs;
+    int chunk_lines;
+
+    /* The lines which are not lexed yet */
+    LEXED_LINE **new_lines = lexed_source->owned_lines + lexed_source->lexed_count;
+    int new_count = lexed_source->owned_count - lexed_source->lexed_count;
+
+    /* For loop counter */
+    int i;
+
+    lexed_source->lexed_count = lexed_source->owned_count;
+
+    /* Each chunk should have enough lines */
+    if (chunks_count > new_count / MIN_LEX_CHUNK_LINES) chunks_count = new_count / MIN_LEX_CHUNK_LINES;
+    if (chunks_count > MAX_LEX_JOBS) chunks_count = MAX_LEX_JOBS;
+
+    /* Small source, so we lex it here */
+    if (chunks_count <= 1) {
+        chunks[0].lines = new_lines;
+        chunks[0].count = new_count;
+        lex_chunk(&chunks[0]);
+        return;
+    }
+
+    chunk_lines = (new_count + chunks_count - 1) / chunks_count;
+    for (i = 0; i < chunks_count; i++) {
+        chunks[i].lines = new_lines + i * chunk_lines;
+        chunks[i].count = i == chunks_count - 1 ? new_count - i * chunk_lines : chunk_lines;
+
+        /* If we can't create the thread we lex the chunk here */
+        is_thread_created[i] = pthread_create(&threads[i], NULL, lex_chunk, &chunks[i]) == 0;
+        if (!is_thread_created[i]) lex_chunk(&chunks[i]);
+    }
+
+    for (i = 0; i < chunks_count; i++) {
+        if (is_thread_created[i]) pthread_join(threads[i], NULL);
+    }
+}
+
+/**
+ * This function frees the lexed source and all the lines it owns
+ * Macros lines are not freed here (they are freed with the macros)
+ * @param lexed_source The lexed source
+ */
+void free_lexed_source(LEXED_SOURCE *lexed_source) {
+    /* For loop counter */
+    int i;
+
+    /* The lines array can have the same line many times, so we free the owned lines */
+    for (i = 0; i < lexed_source->owned_count; i++) free_lexed_line(lexed_source->owned_lines[i]);
+
+    free(lexed_source->owned_lines);
+
+    free(lexed_source->lines);
+    free(lexed_source->source_line_numbers);
+    free(lexed_source->macros);
+    free(lexed_source);
+}
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "assembler.h"
+
+
+/**
+ * This function inits the options to their default values (like the command line without any option)
+ * @param options The options to init
+ */
+void init_assembler_options(ASSEMBLER_OPTIONS *options) {
+    options->check_only = FALSE;
+    options->max_errors = 0;
+    options->jobs = 1;
+    options->output_mode = OUTPUT_FILES;
+    options->archive_path = NULL;
+    options->async_io = FALSE;
+    options->write_if_changed = FALSE;
+    options->watch = FALSE;
+    options->language_server = FALSE;
+    options->binary_object = FALSE;
+    options->run = FALSE;
+    options->jit = FALSE;
+    options->line_table = FALSE;
+    options->profile = FALSE;
+    options->inputs = NULL;
+    options->inputs_count = 0;
+    options->inputs_capacity = 0;
+}
+
+/**
+ * This function assemblies source text in memory (without reading or writing any file)
+ * It doesn't use any global state, so many sources can be assembled at the same time
+ * @param source The source text (the content of .as file, doesn't have to end with \0)
+ * @param length The source length
+ * @param options The options of the assembly (max errors, check mode and jobs, null for the default options)
+ * @param result The result to update (free it with free_assembler_result)
+ * @return The status code of the assembly
+ */
+STATUS_CODE assemble_source(const char *source, int length, const ASSEMBLER_OPTIONS *options,
+                            ASSEMBLER_RESULT *result) {
+    /* The main assemblers status code */
+    STATUS_CODE first_assembler_status_code, second_assembler_status_code;
+
+    /* Contain all assembler tables */
+    ASSEMBLER_TABLES *assembler_tables;
+
+    /* The default options (like the command line without any option) */
+    ASSEMBLER_OPTIONS default_options;
+
+    /* Read the lines from the source text */
+    SOURCE_READER reader;
+    reader.file = NULL;
+    reader.buffer = source;
+    reader.buffer_end = source + length;
+
+    if (options == NULL) {
+        init_assembler_options(&default_options);
+        options = &default_options;
+    }
+
+    /* The commands tables are shared by all the sources (they are built only once) */
+    init_commands_tables();
+
+    init_output_buffer(&result->object);
+    init_output_buffer(&result->entries);
+    init_output_buffer(&result->externals);
+
+    assembler_tables = create_assembler_tables(options);
+
+    /* Run all the assemblers (the main assemblers run only after successful pre assembler) */
+    result->status_code = pre_assemble_source(&reader, NULL, assembler_tables);
+    if (result->status_code == OK) {
+        first_assembler_status_code = first_assembler(assembler_tables);
+
+        /* No need to resolve the symbols if we already stopped this source */
+        second_assembler_status_code = diagnostics_limit_reached(assembler_tables->diagnostics)
+                                           ? ERROR
+                                           : second_assembler(assembler_tables);
+
+        if (first_assembler_status_code != OK || second_assembler_status_code != OK) result->status_code = ERROR;
+    }
+
+    /* If assembler was successfully build the output files */
+    if (result->status_code == OK && !options->check_only) {
+        build_assembler_images(assembler_tables, &result->object, &result->entries, &result->externals);
+    }
+
+    /* The diagnostics are part of the result, so we don't free them with the tables */
+    result->diagnostics = assembler_tables->diagnostics;
+    assembler_tables->diagnostics = NULL;
+    free_assembler_tables(assembler_tables);
+
+    return result->status_code;
+}
+
+/**
+ * This function frees the content and the diagnostics of the assembly result
+ * @param result The assembly result
+ */
+void free_assembler_result(ASSEMBLER_RESULT *result) {
+    free_output_buffer(&result->object);
+    free_output_buffer(&result->entries);
+    free_output_buffer(&result->externals);
+
+    if (result->diagnostics != NULL) free_diagnostics(result->diagnostics);
+    result->diagnostics = NULL;
+}
@@ -0,0 +1,514 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assembler.h"
+
+
+/* The language server state */
+typedef struct {
+    FILE *input;
+    FILE *output;
+
+    /* The open documents */
+    LSP_DOCUMENT *documents;
+
+    /* The options of each assembly (check mode, we only need the diagnostics) */
+    ASSEMBLER_OPTIONS options;
+
+    /* Did the editor ask to shutdown */
+    boolean shutdown;
+} LSP_SERVER;
+
+
+/**
+ * This function reads the next message from the editor (the headers, and the JSON content after them)
+ * @param server The language server
+ * @param length The content length to update
+ * @return The new content, or null if there are no more messages
+ */
+static char *read_lsp_message(LSP_SERVER *server, int *length) {
+    /* The current header line */
+    char header[LSP_HEADER_MAX_LENGTH];
+
+    char *content;
+
+    *length = -1;
+
+    /* The headers end with empty line */
+    while (fgets(header, sizeof(header), server->input) != NULL) {
+        if (strncmp(header, LSP_CONTENT_LENGTH_HEADER, strlen(LSP_CONTENT_LENGTH_HEADER)) == 0) {
+            *length = atoi(header + strlen(LSP_CONTENT_LENGTH_HEADER));
+        } else if ((header[0] == '\r' || header[0] == '\n') && *length >= 0) {
+            break;
+        }
+    }
+
+    if (*length < 0 || feof(server->input)) return NULL;
+
+    /* +1 for \0 */
+    content = malloc(*length + 1);
+    if (content == NULL) {
+        printf("CRITICAL: Failed to allocate language server message.\n");
+        exit(1);
+    }
+
+    if ((int) fread(content, 1, *length, server->input) != *length) {
+        free(content);
+        return NULL;
+    }
+    content[*length] = END_OF_STRING;
+
+    return content;
+}
+
+/**
+ * This function sends message to the editor
+ * @param server The language server
+ * @param content The message JSON content
+ */
+static void send_lsp_message(LSP_SERVER *server, OUTPUT_BUFFER *content) {
+    fprintf(server->output, LSP_CONTENT_LENGTH_HEADER " %d\r\n\r\n", content->length);
+    fwrite(content->data, 1, content->length, server->output);
+    fflush(server->output);
+}
+
+/**
+ * This function appends number to the message
+ * @param message The message
+ * @param number The number
+ */
+static void append_lsp_number(OUTPUT_BUFFER *message, long number) {
+    /* +1 for \0 */
+    char text[DIAGNOSTIC_NUMBER_MAX_LENGTH + 1];
+
+    sprintf(text, "%ld", number);
+    append_to_output_buffer(message, text, strlen(text));
+}
+
+/**
+ * This function appends text (without escapes, e.g. JSON parts) to the message
+ * @param message The message
+ * @param text The text
+ */
+static void append_lsp_text(OUTPUT_BUFFER *message, const char *text) {
+    append_to_output_buffer(message, text, strlen(text));
+}
+
+/**
+ * This function sends response to the editor request
+ * @param server The language server
+ * @param id The request id
+ * @param result The result JSON
+ */
+static void send_lsp_response(LSP_SERVER *server, const JSON_VALUE *id, const char *result) {
+    OUTPUT_BUFFER message;
+    init_output_buffer(&message);
+
+    append_lsp_text(&message, "{\"jsonrpc\":\"2.0\",\"id\":");
+    append_to_output_buffer(&message, id->text, id->text_length);
+    append_lsp_text(&message, ",\"result\":");
+    append_lsp_text(&message, result);
+    append_lsp_text(&message, "}");
+
+    send_lsp_message(server, &message);
+    free_output_buffer(&message);
+}
+
+/**
+ * This function sends error response to the editor request
+ * @param server The language server
+ * @param id The request id (null if we don't know it)
+ * @param code The JSON-RPC error code
+ * @param text The error message
+ */
+static void send_lsp_error(LSP_SERVER *server, const JSON_VALUE *id, int code, const char *text) {
+    OUTPUT_BUFFER message;
+    init_output_buffer(&message);
+
+    append_lsp_text(&message, "{\"jsonrpc\":\"2.0\",\"id\":");
+    if (id != NULL) append_to_output_buffer(&message, id->text, id->text_length);
+    else append_lsp_text(&message, JSON_NULL_TEXT);
+    append_lsp_text(&message, ",\"error\":{\"code\":");
+    append_lsp_number(&message, code);
+    append_lsp_text(&message, ",\"message\":");
+    append_json_string(&message, text, strlen(text));
+    append_lsp_text(&message, "}}");
+
+    send_lsp_message(server, &message);
+    free_output_buffer(&message);
+}
+
+/**
+ * This function appends the diagnostics of the document (as LSP diagnostics) to the message
+ * Each diagnostic covers its whole source line
+ * @param message The message
+ * @param diagnostics The diagnostics
+ * @param lexed_source The expanded source lines to find the source lines with (null if the diagnostics already
+ *                     have the source lines, e.g. the pre assembler diagnostics)
+ * @param is_first Is this the first diagnostic in the message (It also updates it)
+ */
+static void append_lsp_diagnostics(OUTPUT_BUFFER *message, const DIAGNOSTICS *diagnostics,
+                                   const LEXED_SOURCE *lexed_source, boolean *is_first) {
+    const DIAGNOSTIC *diagnostic;
+
+    /* The source line number, and the diagnostic message */
+    int line_number;
+    char *text;
+
+    for (diagnostic = diagnostics->head; diagnostic != NULL; diagnostic = diagnostic->next) {
+        line_number = diagnostic->line_number;
+        if (lexed_source != NULL && line_number >= 1 && line_number <= lexed_source->count) {
+            line_number = lexed_source->source_line_numbers[line_number - 1];
+        }
+
+        /* LSP lines start from 0 (diagnostics about the whole file are on the first line) */
+        if (line_number < 1) line_number = 1;
+
+        if (!*is_first) append_lsp_text(message, ",");
+        *is_first = FALSE;
+
+        append_lsp_text(message, "{\"range\":{\"start\":{\"line\":");
+        append_lsp_number(message, line_number - 1);
+        append_lsp_text(message, ",\"character\":0},\"end\":{\"line\":");
+        append_lsp_number(message, line_number);
+        append_lsp_text(message, ",\"character\":0}},\"severity\":");
+        append_lsp_number(message, get_diagnostic_severity(diagnostic->code) == DIAGNOSTIC_ERROR
+                                       ? LSP_SEVERITY_ERROR
+                                       : LSP_SEVERITY_WARNING);
+        append_lsp_text(message, ",\"source\":\"" LSP_DIAGNOSTICS_SOURCE "\",\"message\":");
+
+        text = format_diagnostic(diagnostic, line_number);
+        append_json_string(message, text, strlen(text));
+        free(text);
+
+        append_lsp_text(message, "}");
+    }
+}
+
+/**
+ * This function assemblies the document (in check mode) and sends its diagnostics to the editor
+ * The document keeps its lexed lines, so the next assembly lexes only the lines which changed
+ * @param server The language server
+ * @param document The document
+ */
+static void publish_lsp_diagnostics(LSP_SERVER *server, LSP_DOCUMENT *document) {
+    /* All the assemblers status code */
+    STATUS_CODE pre_assembler_status_code;
+
+    /* Contain all assembler tables */
+    ASSEMBLER_TABLES *assembler_tables;
+
+    /* The pre assembler diagnostics (they have the source lines, and not the expanded source lines) */
+    DIAGNOSTICS pre_assembler_diagnostics;
+
+    OUTPUT_BUFFER message;
+    boolean is_first = TRUE;
+
+    /* Read the lines from the document text */
+    SOURCE_READER reader;
+    reader.file = NULL;
+    reader.buffer = document->text.data;
+    reader.buffer_end = document->text.data + document->text.length;
+
+    assembler_tables = create_assembler_tables(&server->options);
+    assembler_tables->lexed_source = document->lexed_source;
+
+    pre_assembler_status_code = pre_assemble_source(&reader, NULL, assembler_tables);
+    pre_assembler_diagnostics = *assembler_tables->diagnostics;
+    init_diagnostics(assembler_tables->diagnostics);
+
+    /* Like the command line, the main assemblers run only after successful pre assembler */
+    if (pre_assembler_status_code == OK) {
+        first_assembler(assembler_tables);
+        second_assembler(assembler_tables);
+    }
+
+    init_output_buffer(&message);
+    append_lsp_text(&message, LSP_PUBLISH_DIAGNOSTICS_START);
+    append_json_string(&message, document->uri, strlen(document->uri));
+    append_lsp_text(&message, ",\"diagnostics\":[");
+    append_lsp_diagnostics(&message, &pre_assembler_diagnostics, NULL, &is_first);
+    append_lsp_diagnostics(&message, assembler_tables->diagnostics, assembler_tables->lexed_source, &is_first);
+    append_lsp_text(&message, "]}}");
+
+    send_lsp_message(server, &message);
+    free_output_buffer(&message);
+
+    /* The document keeps the lexed lines (unless most of them are old lines, from before many edits) */
+    document->lexed_source = assembler_tables->lexed_source;
+    assembler_tables->lexed_source = NULL;
+    if (document->lexed_source->owned_count >
+        LSP_STALE_LINES_FACTOR * document->lexed_source->count + LEXED_SOURCE_DEFAULT_CAPACITY) {
+        free_lexed_source(document->lexed_source);
+        document->lexed_source = NULL;
+    }
+
+    clear_diagnostics(&pre_assembler_diagnostics);
+    free_assembler_tables(assembler_tables);
+}
+
+/**
+ * This function finds open document by its uri
+ * @param server The language server
+ * @param uri The document uri (Can be null)
+ * @return The document (null if it is not open)
+ */
+static LSP_DOCUMENT *find_lsp_document(LSP_SERVER *server, const JSON_VALUE *uri) {
+    LSP_DOCUMENT *document;
+
+    if (uri == NULL || uri->type != JSON_STRING) return NULL;
+
+    for (document = server->documents; document != NULL; document = document->next) {
+        if (strcmp(document->uri, uri->string) == 0) return document;
+    }
+
+    return NULL;
+}
+
+/**
+ * This function finds the offset of LSP position inside the document text
+ * The position character counts UTF-16 units (chars after 0xFFFF are 2 units, and 4 bytes in UTF-8)
+ * @param document The document
+ * @param position The position (line and character, Can be null)
+ * @return The offset (positions after the line / text end are at the line / text end)
+ */
+static int get_lsp_text_offset(const LSP_DOCUMENT *document, const JSON_VALUE *position) {
+    const JSON_VALUE *line = get_json_member(position, "line");
+    const JSON_VALUE *character = get_json_member(position, "character");
+
+    /* The current line and character */
+    long line_index = 0, units = 0;
+
+    int offset = 0;
+    const char *text = document->text.data;
+
+    if (line == NULL || character == NULL) return document->text.length;
+
+    while (line_index < line->number && offset < document->text.length) {
+        if (text[offset++] == '\n') line_index++;
+    }
+
+    while (units < character->number && offset < document->text.length && text[offset] != '\n') {
+        units += ((unsigned char) text[offset] >= UTF8_FOUR_BYTES_LEAD) ? 2 : 1;
+
+        /* Skip the continuation bytes of the char */
+        offset++;
+        while (offset < document->text.length && ((unsigned char) text[offset] & 0xC0) == 0x80) offset++;
+    }
+
+    return offset;
+}
+
+/**
+ * This function applies one change of the document (the whole text, or range of the text)
+ * @param document The document
+ * @param change The change (text, and optional range)
+ */
+static void apply_lsp_change(LSP_DOCUMENT *document, const JSON_VALUE *change) {
+    const JSON_VALUE *text = get_json_member(change, "text");
+    const JSON_VALUE *range = get_json_member(change, "range");
+
+    /* The changed part */
+    int start = 0, end = document->text.length;
+
+    OUTPUT_BUFFER new_text;
+
+    if (text == NULL || text->type != JSON_STRING) return;
+
+    if (range != NULL) {
+        start = get_lsp_text_offset(document, get_json_member(range, "start"));
+        end = get_lsp_text_offset(document, get_json_member(range, "end"));
+        if (end < start) end = start;
+    }
+
+    init_output_buffer(&new_text);
+    append_to_output_buffer(&new_text, document->text.data, start);
+    append_to_output_buffer(&new_text, text->string, text->string_length);
+    append_to_output_buffer(&new_text, document->text.data + end, document->text.length - end);
+
+    free_output_buffer(&document->text);
+    document->text = new_text;
+}
+
+/**
+ * This function opens new document, and sends its diagnostics
+ * @param server The language server
+ * @param params The didOpen params
+ */
+static void open_lsp_document(LSP_SERVER *server, const JSON_VALUE *params) {
+    const JSON_VALUE *text_document = get_json_member(params, "textDocument");
+    const JSON_VALUE *uri = get_json_member(text_document, "uri");
+    const JSON_VALUE *text = get_json_member(text_document, "text");
+
+    LSP_DOCUMENT *document;
+
+    if (uri == NULL || uri->type != JSON_STRING || text == NULL || text->type != JSON_STRING) return;
+
+    /* The editor opens the same document again, so we use its new text */
+    document = find_lsp_document(server, uri);
+    if (document == NULL) {
+        document = malloc(sizeof(LSP_DOCUMENT));
+        if (document == NULL) {
+            printf("CRITICAL: Failed to allocate document.\n");
+            exit(1);
+        }
+
+        document->uri = malloc(uri->string_length + 1);
+        if (document->uri == NULL) {
+            printf("CRITICAL: Failed to allocate document uri.\n");
+            exit(1);
+        }
+        strcpy(document->uri, uri->string);
+
+        init_output_buffer(&document->text);
+        document->lexed_source = NULL;
+        document->next = server->documents;
+        server->documents = document;
+    }
+
+    free_output_buffer(&document->text);
+    append_to_output_buffer(&document->text, text->string, text->string_length);
+
+    publish_lsp_diagnostics(server, document);
+}
+
+/**
+ * This function applies the changes of the document, and sends its new diagnostics
+ * @param server The language server
+ * @param params The didChange params
+ */
+static void change_lsp_document(LSP_SERVER *server, const JSON_VALUE *params) {
+    LSP_DOCUMENT *document = find_lsp_document(server, get_json_member(get_json_member(params, "textDocument"),
+                                                                       "uri"));
+    const JSON_VALUE *changes = get_json_member(params, "contentChanges");
+    const JSON_VALUE *change;
+
+    if (document == NULL || changes == NULL || changes->type != JSON_ARRAY) return;
+
+    /* The changes are in order (each one is on the text after the changes before it) */
+    for (change = changes->children; change != NULL; change = change->next) apply_lsp_change(document, change);
+
+    publish_lsp_diagnostics(server, document);
+}
+
+/**
+ * This function frees the document
+ * @param document The document
+ */
+static void free_lsp_document(LSP_DOCUMENT *document) {
+    if (document->lexed_source != NULL) free_lexed_source(document->lexed_source);
+    free_output_buffer(&document->text);
+    free(document->uri);
+    free(document);
+}
+
+/**
+ * This function closes the document, and clears its diagnostics in the editor
+ * @param server The language server
+ * @param params The didClose params
+ */
+static void close_lsp_document(LSP_SERVER *server, const JSON_VALUE *params) {
+    LSP_DOCUMENT *document = find_lsp_document(server, get_json_member(get_json_member(params, "textDocument"),
+                                                                       "uri"));
+    LSP_DOCUMENT **document_ptr;
+    OUTPUT_BUFFER message;
+
+    if (document == NULL) return;
+
+    for (document_ptr = &server->documents; *document_ptr != document; document_ptr = &(*document_ptr)->next);
+    *document_ptr = document->next;
+
+    init_output_buffer(&message);
+    append_lsp_text(&message, LSP_PUBLISH_DIAGNOSTICS_START);
+    append_json_string(&message, document->uri, strlen(document->uri));
+    append_lsp_text(&message, ",\"diagnostics\":[]}}");
+    send_lsp_message(server, &message);
+    free_output_buffer(&message);
+
+    free_lsp_document(document);
+}
+
+/**
+ * This function handles one message from the editor
+ * @param server The language server
+ * @param message The message
+ * @return Should we exit (the editor sent exit)
+ */
+static boolean handle_lsp_message(LSP_SERVER *server, const JSON_VALUE *message) {
+    const JSON_VALUE *method = get_json_member(message, "method");
+    const JSON_VALUE *id = get_json_member(message, "id");
+    const JSON_VALUE *params = get_json_member(message, "params");
+
+    /* Responses to our requests (we don't send requests) */
+    if (method == NULL || method->type != JSON_STRING) return FALSE;
+
+    if (strcmp(method->string, "initialize") == 0 && id != NULL) {
+        /* Open / close notifications, and incremental changes */
+        send_lsp_response(server, id, "{\"capabilities\":{\"textDocumentSync\":{\"openClose\":true,\"change\":2}},"
+                                      "\"serverInfo\":{\"name\":\"" LSP_DIAGNOSTICS_SOURCE "\"}}");
+    } else if (strcmp(method->string, "shutdown") == 0 && id != NULL) {
+        server->shutdown = TRUE;
+        send_lsp_response(server, id, JSON_NULL_TEXT);
+    } else if (strcmp(method->string, "exit") == 0) {
+        return TRUE;
+    } else if (strcmp(method->string, "textDocument/didOpen") == 0) {
+        open_lsp_document(server, params);
+    } else if (strcmp(method->string, "textDocument/didChange") == 0) {
+        change_lsp_document(server, params);
+    } else if (strcmp(method->string, "textDocument/didClose") == 0) {
+        close_lsp_document(server, params);
+    } else if (id != NULL) {
+        /* Other notifications are ignored, but requests must get response */
+        send_lsp_error(server, id, LSP_METHOD_NOT_FOUND, "Method not found");
+    }
+
+    return FALSE;
+}
+
+/**
+ * This function runs the language server (LSP over stdio) until the editor asks it to exit
+ * It keeps the lexed lines of each open document, and sends the document diagnostics after each change
+ * @param input The messages from the editor (e.g. stdin)
+ * @param output The messages to the editor (e.g. stdout)
+ * @return The exit code (0 if the editor asked to shutdown before the exit)
+ */
+int run_language_server(FILE *input, FILE *output) {
+    /* The current message */
+    char *content;
+    int length;
+    JSON_VALUE *message;
+
+    boolean exit_requested = FALSE;
+
+    LSP_SERVER server;
+    server.input = input;
+    server.output = output;
+    server.documents = NULL;
+    server.shutdown = FALSE;
+
+    /* Check mode without errors limit (the lexer threads are not worth it for one document) */
+    init_assembler_options(&server.options);
+    server.options.check_only = TRUE;
+
+    while (!exit_requested && (content = read_lsp_message(&server, &length)) != NULL) {
+        message = parse_json(content, length);
+
+        if (message == NULL) {
+            send_lsp_error(&server, NULL, LSP_PARSE_ERROR, "Parse error");
+        } else {
+            exit_requested = handle_lsp_message(&server, message);
+            free_json_value(message);
+        }
+
+        free(content);
+    }
+
+    while (server.documents != NULL) {
+        LSP_DOCUMENT *next_document = server.documents->next;
+        free_lsp_document(server.documents);
+        server.documents = next_document;
+    }
+
+    return server.shutdown ? 0 : 1;
+}
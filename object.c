@@ -0,0 +1,723 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "assembler.h"
+
+
+/**
+ * This function allocates array of the image (with at least one item, so empty arrays are not null)
+ * @param count The number of items
+ * @param size The item size
+ * @return The new array
+ */
+static void *allocate_object_array(unsigned long count, unsigned long size) {
+    void *array = malloc((count > 0 ? count : 1) * size);
+    if (array == NULL) {
+        printf("CRITICAL: Failed to allocate object image.\n");
+        exit(1);
+    }
+
+    return array;
+}
+
+/**
+ * This function converts word machine code to number
+ * @param machine_code The machine code (ADDRESS_SIZE chars of 0 and 1)
+ * @return The word
+ */
+static unsigned short machine_code_to_word(const char *machine_code) {
+    /* For loop counter */
+    int i;
+
+    unsigned short word = 0;
+
+    for (i = 0; i < ADDRESS_SIZE; i++) word = (word << 1) | (machine_code[i] == '1');
+
+    return word;
+}
+
+/**
+ * This function builds the object image from the assembler tables (after successful assembly)
+ * @param assembler_tables The assembler tables
+ * @param image The image to init
+ */
+void build_object_image(ASSEMBLER_TABLES *assembler_tables, OBJECT_IMAGE *image) {
+    /* Init tables pointers */
+    COMMAND_BINARY_LINE *command_binary_line;
+    INSTRUCTION_BINARY_LINE *instruction_binary_line;
+    ENTRY_INSTRUCTION *entry_instruction;
+    EXTERNAL_INSTRUCTION *external_instruction;
+
+    /* For loop counters */
+    int i, j;
+
+    /* The next word, symbol and name in the image */
+    int word_index = 0, symbol_index;
+    char *name;
+
+    image->base_address = IC_COUNTER_DEFAULT_VALUE;
+    image->code_length = assembler_tables->ic - IC_COUNTER_DEFAULT_VALUE;
+    image->data_length = assembler_tables->dc - DC_COUNTER_DEFAULT_VALUE;
+    image->words = allocate_object_array(image->code_length + image->data_length, sizeof(unsigned short));
+
+    /* The commands, and then the instructions (each node words are expanded to word per address) */
+    for (command_binary_line = assembler_tables->command_binary_line; command_binary_line != NULL;
+         command_binary_line = command_binary_line->next) {
+        image->words[word_index++] = machine_code_to_word(command_binary_line->machine_code);
+    }
+
+    for (instruction_binary_line = assembler_tables->instruction_binary_line; instruction_binary_line != NULL;
+         instruction_binary_line = instruction_binary_line->next) {
+        for (i = 0; i < instruction_binary_line->repeat_count; i++) {
+            for (j = 0; j < instruction_binary_line->words_count; j++) {
+                image->words[word_index++] =
+                    machine_code_to_word(instruction_binary_line->machine_code + j * ADDRESS_SIZE);
+            }
+        }
+    }
+
+    /* Count the symbols and their names, so all the names are in one array */
+    image->entries_count = 0;
+    image->externals_count = 0;
+    image->names_length = 0;
+    for (entry_instruction = assembler_tables->entry_instruction; entry_instruction != NULL;
+         entry_instruction = entry_instruction->next) {
+        image->entries_count++;
+        image->names_length += strlen(entry_instruction->name) + 1;
+    }
+    for (external_instruction = assembler_tables->external_instruction; external_instruction != NULL;
+         external_instruction = external_instruction->next) {
+        image->externals_count++;
+        image->names_length += strlen(external_instruction->name) + 1;
+    }
+
+    image->entries = allocate_object_array(image->entries_count, sizeof(OBJECT_SYMBOL));
+    image->externals = allocate_object_array(image->externals_count, sizeof(OBJECT_SYMBOL));
+    image->names = allocate_object_array(image->names_length, sizeof(char));
+    name = image->names;
+
+    for (entry_instruction = assembler_tables->entry_instruction, symbol_index = 0; entry_instruction != NULL;
+         entry_instruction = entry_instruction->next, symbol_index++) {
+        strcpy(name, entry_instruction->name);
+        image->entries[symbol_index].name = name;
+        image->entries[symbol_index].address = entry_instruction->address;
+        name += strlen(name) + 1;
+    }
+
+    for (external_instruction = assembler_tables->external_instruction, symbol_index = 0;
+         external_instruction != NULL; external_instruction = external_instruction->next, symbol_index++) {
+        strcpy(name, external_instruction->name);
+        image->externals[symbol_index].name = name;
+        image->externals[symbol_index].address = external_instruction->address;
+        name += strlen(name) + 1;
+    }
+}
+
+/**
+ * This function writes unsigned number as little endian field
+ * @param field The buffer to write to (with at least size bytes)
+ * @param value The number
+ * @param size The field size
+ */
+static void write_object_field(unsigned char *field, unsigned long value, int size) {
+    /* For loop counter */
+    int i;
+
+    for (i = 0; i < size; i++) {
+        field[i] = (unsigned char) (value & 0xFF);
+        value >>= 8;
+    }
+}
+
+/**
+ * This function reads unsigned number from little endian field
+ * @param field The field
+ * @param size The field size
+ * @return The number
+ */
+static unsigned long read_object_field(const unsigned char *field, int size) {
+    /* For loop counter */
+    int i;
+
+    unsigned long value = 0;
+
+    for (i = size - 1; i >= 0; i--) value = value * 256 + field[i];
+
+    return value;
+}
+
+/**
+ * This function returns the offset after the section, aligned to the next section
+ * @param offset The section offset
+ * @param length The section length
+ * @return The next section offset
+ */
+static unsigned long get_next_object_section(unsigned long offset, unsigned long length) {
+    return (offset + length + OBJECT_ALIGNMENT - 1) / OBJECT_ALIGNMENT * OBJECT_ALIGNMENT;
+}
+
+/**
+ * This function writes the symbols table of the binary object
+ * @param table The table to write to (OBJECT_SYMBOL_SIZE bytes for each symbol)
+ * @param symbols The symbols
+ * @param count The number of symbols
+ * @param names The image names (the symbols names are inside them)
+ */
+static void write_object_symbols(unsigned char *table, const OBJECT_SYMBOL *symbols, int count, const char *names) {
+    /* For loop counter */
+    int i;
+
+    for (i = 0; i < count; i++) {
+        write_object_field(table + i * OBJECT_SYMBOL_SIZE, symbols[i].name - names, OBJECT_FIELD_SIZE);
+        write_object_field(table + i * OBJECT_SYMBOL_SIZE + OBJECT_FIELD_SIZE, symbols[i].address, OBJECT_FIELD_SIZE);
+    }
+}
+
+/**
+ * This function writes the image as binary object
+ * @param image The image
+ * @param buffer The output buffer to append to
+ */
+void build_binary_object(const OBJECT_IMAGE *image, OUTPUT_BUFFER *buffer) {
+    /* For loop counter */
+    int i;
+
+    /* The header fields */
+    unsigned long fields[OBJECT_HEADER_FIELDS_COUNT];
+
+    /* The whole binary object (the sections padding stays zeros) */
+    unsigned char *content;
+    unsigned long length;
+
+    int words_count = image->code_length + image->data_length;
+
+    fields[OBJECT_BASE_ADDRESS] = image->base_address;
+    fields[OBJECT_CODE_LENGTH] = image->code_length;
+    fields[OBJECT_DATA_LENGTH] = image->data_length;
+    fields[OBJECT_ENTRIES_COUNT] = image->entries_count;
+    fields[OBJECT_EXTERNALS_COUNT] = image->externals_count;
+    fields[OBJECT_WORDS_OFFSET] = OBJECT_HEADER_SIZE;
+    fields[OBJECT_ENTRIES_OFFSET] = get_next_object_section(fields[OBJECT_WORDS_OFFSET],
+                                                            (unsigned long) words_count * OBJECT_WORD_SIZE);
+    fields[OBJECT_EXTERNALS_OFFSET] = get_next_object_section(fields[OBJECT_ENTRIES_OFFSET],
+                                                              (unsigned long) image->entries_count *
+                                                              OBJECT_SYMBOL_SIZE);
+    fields[OBJECT_NAMES_OFFSET] = get_next_object_section(fields[OBJECT_EXTERNALS_OFFSET],
+                                                          (unsigned long) image->externals_count *
+                                                          OBJECT_SYMBOL_SIZE);
+    fields[OBJECT_NAMES_LENGTH] = image->names_length;
+    length = get_next_object_section(fields[OBJECT_NAMES_OFFSET], fields[OBJECT_NAMES_LENGTH]);
+
+    content = calloc(length, 1);
+    if (content == NULL) {
+        printf("CRITICAL: Failed to allocate binary object.\n");
+        exit(1);
+    }
+
+    memcpy(content, OBJECT_MAGIC, OBJECT_MAGIC_SIZE);
+    for (i = 0; i < OBJECT_HEADER_FIELDS_COUNT; i++) {
+        write_object_field(content + OBJECT_MAGIC_SIZE + i * OBJECT_FIELD_SIZE, fields[i], OBJECT_FIELD_SIZE);
+    }
+
+    for (i = 0; i < words_count; i++) {
+        write_object_field(content + fields[OBJECT_WORDS_OFFSET] + i * OBJECT_WORD_SIZE, image->words[i],
+                           OBJECT_WORD_SIZE);
+    }
+
+    write_object_symbols(content + fields[OBJECT_ENTRIES_OFFSET], image->entries, image->entries_count,
+                         image->names);
+    write_object_symbols(content + fields[OBJECT_EXTERNALS_OFFSET], image->externals, image->externals_count,
+                         image->names);
+    memcpy(content + fields[OBJECT_NAMES_OFFSET], image->names, image->names_length);
+
+    append_to_output_buffer(buffer, (char *) content, (int) length);
+    free(content);
+}
+
+/**
+ * This function reads the symbols table of the binary object
+ * @param table The table (OBJECT_SYMBOL_SIZE bytes for each symbol)
+ * @param count The number of symbols
+ * @param image The image (with the names already)
+ * @return The new symbols array, or null if symbol name is outside the names
+ */
+static OBJECT_SYMBOL *read_object_symbols(const unsigned char *table, int count, const OBJECT_IMAGE *image) {
+    /* For loop counter */
+    int i;
+
+    unsigned long name_offset, address;
+
+    OBJECT_SYMBOL *symbols = allocate_object_array(count, sizeof(OBJECT_SYMBOL));
+
+    for (i = 0; i < count; i++) {
+        name_offset = read_object_field(table + i * OBJECT_SYMBOL_SIZE, OBJECT_FIELD_SIZE);
+        address = read_object_field(table + i * OBJECT_SYMBOL_SIZE + OBJECT_FIELD_SIZE, OBJECT_FIELD_SIZE);
+        if (name_offset >= (unsigned long) image->names_length || address > INT_MAX) {
+            free(symbols);
+            return NULL;
+        }
+
+        symbols[i].name = image->names + name_offset;
+        symbols[i].address = (int) address;
+    }
+
+    return symbols;
+}
+
+/**
+ * This function checks that section of the binary object is inside the content
+ * @param offset The section offset
+ * @param count The number of items in the section
+ * @param size The item size
+ * @param length The content length
+ * @return Is the section inside the content
+ */
+static boolean object_section_fits(unsigned long offset, unsigned long count, unsigned long size,
+                                   unsigned long length) {
+    return offset <= length && count <= (length - offset) / size;
+}
+
+/**
+ * This function reads binary object into image
+ * @param data The binary object content
+ * @param length The content length
+ * @param image The image to init
+ * @return The status code (ERROR if it is not binary object, or it is broken)
+ */
+STATUS_CODE read_binary_object(const char *data, unsigned long length, OBJECT_IMAGE *image) {
+    /* For loop counter */
+    int i;
+
+    /* The header fields */
+    unsigned long fields[OBJECT_HEADER_FIELDS_COUNT];
+
+    unsigned long words_count;
+
+    const unsigned char *content = (const unsigned char *) data;
+
+    if (length < OBJECT_HEADER_SIZE || memcmp(content, OBJECT_MAGIC, OBJECT_MAGIC_SIZE) != 0) return ERROR;
+
+    for (i = 0; i < OBJECT_HEADER_FIELDS_COUNT; i++) {
+        fields[i] = read_object_field(content + OBJECT_MAGIC_SIZE + i * OBJECT_FIELD_SIZE, OBJECT_FIELD_SIZE);
+    }
+
+    /* The image fields must fit int (they aren't truncated), so the words count doesn't overflow too */
+    for (i = OBJECT_BASE_ADDRESS; i <= OBJECT_EXTERNALS_COUNT; i++) {
+        if (fields[i] > INT_MAX) return ERROR;
+    }
+    if (fields[OBJECT_NAMES_LENGTH] > INT_MAX ||
+        fields[OBJECT_DATA_LENGTH] > INT_MAX - fields[OBJECT_CODE_LENGTH]) {
+        return ERROR;
+    }
+
+    /* All the sections must be inside the content, and the last name must end with \0 */
+    words_count = fields[OBJECT_CODE_LENGTH] + fields[OBJECT_DATA_LENGTH];
+    if (!object_section_fits(fields[OBJECT_WORDS_OFFSET], words_count, OBJECT_WORD_SIZE, length) ||
+        !object_section_fits(fields[OBJECT_ENTRIES_OFFSET], fields[OBJECT_ENTRIES_COUNT], OBJECT_SYMBOL_SIZE,
+                             length) ||
+        !object_section_fits(fields[OBJECT_EXTERNALS_OFFSET], fields[OBJECT_EXTERNALS_COUNT], OBJECT_SYMBOL_SIZE,
+                             length) ||
+        !object_section_fits(fields[OBJECT_NAMES_OFFSET], fields[OBJECT_NAMES_LENGTH], 1, length) ||
+        (fields[OBJECT_NAMES_LENGTH] > 0 &&
+         content[fields[OBJECT_NAMES_OFFSET] + fields[OBJECT_NAMES_LENGTH] - 1] != END_OF_STRING)) {
+        return ERROR;
+    }
+
+    image->base_address = (int) fields[OBJECT_BASE_ADDRESS];
+    image->code_length = (int) fields[OBJECT_CODE_LENGTH];
+    image->data_length = (int) fields[OBJECT_DATA_LENGTH];
+    image->entries_count = (int) fields[OBJECT_ENTRIES_COUNT];
+    image->externals_count = (int) fields[OBJECT_EXTERNALS_COUNT];
+    image->names_length = (int) fields[OBJECT_NAMES_LENGTH];
+
+    image->words = allocate_object_array(words_count, sizeof(unsigned short));
+    for (i = 0; i < (int) words_count; i++) {
+        image->words[i] = (unsigned short) (read_object_field(content + fields[OBJECT_WORDS_OFFSET] +
+                                                              i * OBJECT_WORD_SIZE, OBJECT_WORD_SIZE) &
+                                            ADDRESS_MASK);
+    }
+
+    image->names = allocate_object_array(image->names_length, sizeof(char));
+    memcpy(image->names, content + fields[OBJECT_NAMES_OFFSET], image->names_length);
+
+    image->entries = read_object_symbols(content + fields[OBJECT_ENTRIES_OFFSET], image->entries_count, image);
+    image->externals = read_object_symbols(content + fields[OBJECT_EXTERNALS_OFFSET], image->externals_count,
+                                           image);
+    if (image->entries == NULL || image->externals == NULL) {
+        free(image->entries);
+        free(image->externals);
+        free(image->words);
+        free(image->names);
+        return ERROR;
+    }
+
+    return OK;
+}
+
+/**
+ * This function appends the symbols lines (name and base4 address) to the text output
+ * @param buffer The output buffer
+ * @param symbols The symbols
+ * @param count The number of symbols
+ */
+static void append_text_symbols(OUTPUT_BUFFER *buffer, const OBJECT_SYMBOL *symbols, int count) {
+    /* For loop counter */
+    int i;
+
+    for (i = 0; i < count; i++) {
+        append_to_output_buffer(buffer, symbols[i].name, strlen(symbols[i].name));
+        append_to_output_buffer(buffer, "\t", 1);
+        append_base4_number(buffer, symbols[i].address);
+        append_to_output_buffer(buffer, "\n", 1);
+    }
+}
+
+/**
+ * This function writes the image as base4 text (exactly like the assembler writes the .ob, .ent and .ext files)
+ * @param image The image
+ * @param object The output buffer for the object file
+ * @param entries The output buffer for the entry file
+ * @param externals The output buffer for the external file
+ */
+void build_text_object(const OBJECT_IMAGE *image, OUTPUT_BUFFER *object, OUTPUT_BUFFER *entries,
+                       OUTPUT_BUFFER *externals) {
+    /* For loop counters */
+    int i, j;
+
+    /* The current word in base4 */
+    char word[OBJECT_TEXT_WORD_LENGTH];
+
+    /* The object header is the commands and the instructions lengths */
+    append_to_output_buffer(object, "\t", 1);
+    append_base4_number(object, image->code_length);
+    append_to_output_buffer(object, " ", 1);
+    append_base4_number(object, image->data_length);
+    append_to_output_buffer(object, "\n", 1);
+
+    for (i = 0; i < image->code_length + image->data_length; i++) {
+        /* The first char has the highest bits */
+        for (j = 0; j < OBJECT_TEXT_WORD_LENGTH; j++) {
+            word[j] = BASE_4_CHARS[(image->words[i] >> (2 * (OBJECT_TEXT_WORD_LENGTH - 1 - j))) & 3];
+        }
+
+        append_base4_number(object, image->base_address + i);
+        append_to_output_buffer(object, "\t", 1);
+        append_to_output_buffer(object, word, OBJECT_TEXT_WORD_LENGTH);
+        append_to_output_buffer(object, "\n", 1);
+    }
+
+    append_text_symbols(entries, image->entries, image->entries_count);
+    append_text_symbols(externals, image->externals, image->externals_count);
+}
+
+/* Short name for the base4 values table */
+#define NB OBJECT_NOT_BASE4
+
+/**
+ * Array contains the value of each base4 char, and OBJECT_NOT_BASE4 for other chars (The index is the char as
+ * unsigned char)
+ * It is the reverse of BASE_4_CHARS, so each char is decoded with one lookup
+ */
+static const unsigned char base4_values[CHAR_CLASSES_SIZE] = {
+    /* 0x00 */ NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB,
+    /* 0x10 */ NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB,
+    /* 0x20 */ NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB,
+    /* 0x30 */ NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB,
+    /* 0x40 */ NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB,
+    /* 0x50 */ NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB,
+    /* 0x60 */ NB, 0, 1, 2, 3, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB,
+    /* 0x70 */ NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB,
+    /* 0x80 */ NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB,
+    /* 0x90 */ NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB,
+    /* 0xA0 */ NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB,
+    /* 0xB0 */ NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB,
+    /* 0xC0 */ NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB,
+    /* 0xD0 */ NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB,
+    /* 0xE0 */ NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB,
+    /* 0xF0 */ NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB, NB
+};
+
+#undef NB
+
+/**
+ * This function reads base4 number from the text
+ * @param ptr The text pointer (It also moves it after the number)
+ * @param end The text end
+ * @param value The number to update
+ * @return The status code (ERROR if there are no base4 chars, or the number is too big)
+ */
+static STATUS_CODE read_base4_number(const char **ptr, const char *end, long *value) {
+    /* The value of the current char */
+    unsigned char digit;
+
+    const char *text = *ptr;
+
+    *value = 0;
+    while (text < end && (digit = base4_values[(unsigned char) *text]) != OBJECT_NOT_BASE4) {
+        if (*value > LONG_MAX / 4) return ERROR;
+        *value = *value * 4 + digit;
+        text++;
+    }
+
+    if (text == *ptr) return ERROR;
+    *ptr = text;
+
+    return OK;
+}
+
+/**
+ * This function reads the word of object line (exactly OBJECT_TEXT_WORD_LENGTH base4 chars)
+ * @param text The word text (with at least OBJECT_TEXT_WORD_LENGTH chars)
+ * @param word The word to update
+ * @return The status code (ERROR if one of the chars is not base4)
+ */
+static STATUS_CODE read_base4_word(const char *text, unsigned short *word) {
+    /* For loop counter */
+    int i;
+
+    /* All the chars values together (OBJECT_NOT_BASE4 has bit which base4 values don't have) */
+    unsigned char digits = 0;
+    unsigned char digit;
+
+    *word = 0;
+    for (i = 0; i < OBJECT_TEXT_WORD_LENGTH; i++) {
+        digit = base4_values[(unsigned char) text[i]];
+        digits |= digit;
+        *word = (*word << 2) | (digit & 3);
+    }
+
+    return (digits & OBJECT_NOT_BASE4) ? ERROR : OK;
+}
+
+/**
+ * This function counts the lines of the text (the last line may not end with new line)
+ * @param text The text
+ * @param length The text length
+ * @return The number of lines
+ */
+static int count_text_lines(const char *text, unsigned long length) {
+    int count = 0;
+    const char *end = text + length;
+
+    while (text < end) {
+        text = memchr(text, '\n', end - text);
+        count++;
+        if (text == NULL) break;
+        text++;
+    }
+
+    return count;
+}
+
+/**
+ * This function reads the symbols lines (name, tab and base4 address) of the .ent or .ext text
+ * The symbols array is allocated once for all the lines, and the names are copied into the image names
+ * @param text The text (Can be null if there are no symbols)
+ * @param length The text length
+ * @param symbols The symbols array to update
+ * @param count The number of symbols to update
+ * @param names The next name in the image names (It also moves it after the names)
+ * @return The status code (ERROR if the text is broken)
+ */
+static STATUS_CODE read_text_symbols(const char *text, unsigned long length, OBJECT_SYMBOL **symbols, int *count,
+                                     char **names) {
+    /* The current line, and the name end inside it */
+    const char *line = text, *name_end;
+    const char *end = text + length;
+
+    long address;
+
+    *count = 0;
+    *symbols = allocate_object_array(text == NULL ? 0 : count_text_lines(text, length), sizeof(OBJECT_SYMBOL));
+    if (text == NULL) return OK;
+
+    while (line < end) {
+        name_end = memchr(line, '\t', end - line);
+        if (name_end == NULL || name_end == line || memchr(line, '\n', name_end - line) != NULL) return ERROR;
+
+        memcpy(*names, line, name_end - line);
+        (*names)[name_end - line] = END_OF_STRING;
+        (*symbols)[*count].name = *names;
+        *names += name_end - line + 1;
+
+        /* The address ends the line (the last line may not end with new line) */
+        line = name_end + 1;
+        if (read_base4_number(&line, end, &address) != OK || address > INT_MAX || (line < end && *line++ != '\n')) {
+            return ERROR;
+        }
+
+        (*symbols)[(*count)++].address = (int) address;
+    }
+
+    return OK;
+}
+
+/**
+ * This function reads base4 text object (the .ob, .ent and .ext contents) into image
+ * It parses the exact layout of write_assembler_files in one pass (each char is decoded with one lookup), and it
+ * allocates only the image arrays (never for each line)
+ * @param object The object content
+ * @param object_length The object length
+ * @param entries The entries content (null if there are no entries)
+ * @param entries_length The entries length
+ * @param externals The externals content (null if there are no externals)
+ * @param externals_length The externals length
+ * @param image The image to init
+ * @return The status code (ERROR if the text is broken)
+ */
+STATUS_CODE read_text_object(const char *object, unsigned long object_length, const char *entries,
+                             unsigned long entries_length, const char *externals, unsigned long externals_length,
+                             OBJECT_IMAGE *image) {
+    /* The current line */
+    const char *line = object;
+    const char *end = object + object_length;
+
+    /* The current address */
+    long address;
+    long code_length, data_length;
+    int word_index, words_count;
+
+    /* The most words the object can have */
+    long words_limit;
+
+    /* The next name in the image names */
+    char *name;
+
+    STATUS_CODE status_code = OK;
+
+    /* The names are copied into one array, so their texts must fit int together */
+    if (entries_length > INT_MAX || externals_length > INT_MAX - entries_length) return ERROR;
+
+    /* The header - tab, the code length, space and the data length */
+    if (line >= end || *line++ != '\t' || read_base4_number(&line, end, &code_length) != OK || line >= end ||
+        *line++ != ' ' || read_base4_number(&line, end, &data_length) != OK || line >= end || *line++ != '\n') {
+        return ERROR;
+    }
+
+    /* Each word line has at least one address char, tab, the word and new line (the lengths are checked one by
+     * one, adding them may overflow) */
+    words_limit = (long) (end - line) / (OBJECT_TEXT_WORD_LENGTH + 3);
+    if (words_limit > INT_MAX) words_limit = INT_MAX;
+    if (code_length > words_limit || data_length > words_limit - code_length) return ERROR;
+    words_count = (int) (code_length + data_length);
+
+    image->base_address = IC_COUNTER_DEFAULT_VALUE;
+    image->code_length = (int) code_length;
+    image->data_length = (int) data_length;
+    image->words = allocate_object_array(words_count, sizeof(unsigned short));
+
+    /* Each line is the address and the word (the addresses are one after another) */
+    for (word_index = 0; word_index < words_count && status_code == OK; word_index++) {
+        if (read_base4_number(&line, end, &address) != OK || end - line < OBJECT_TEXT_WORD_LENGTH + 2 ||
+            line[0] != '\t' || line[OBJECT_TEXT_WORD_LENGTH + 1] != '\n' ||
+            read_base4_word(line + 1, &image->words[word_index]) != OK) {
+            status_code = ERROR;
+        } else if (word_index == 0 && address > INT_MAX - words_count) {
+            /* The last address must fit the image too (it isn't truncated) */
+            status_code = ERROR;
+        } else if (word_index == 0) {
+            image->base_address = (int) address;
+        } else if (address != image->base_address + word_index) {
+            status_code = ERROR;
+        }
+
+        line += OBJECT_TEXT_WORD_LENGTH + 2;
+    }
+
+    /* The names are shorter than their lines (the tab is replaced with \0) */
+    image->names_length = (int) (entries_length + externals_length);
+    image->names = allocate_object_array(image->names_length, sizeof(char));
+    name = image->names;
+
+    image->entries = NULL;
+    image->externals = NULL;
+    if (status_code != OK || line != end ||
+        read_text_symbols(entries, entries_length, &image->entries, &image->entries_count, &name) != OK ||
+        read_text_symbols(externals, externals_length, &image->externals, &image->externals_count, &name) != OK) {
+        free_object_image(image);
+        return ERROR;
+    }
+
+    image->names_length = name - image->names;
+
+    return OK;
+}
+
+/**
+ * This function reads the whole file into memory
+ * @param path The file path
+ * @param length The length to update
+ * @return The new file content, or null if we can't read the file
+ */
+static char *read_object_file(const char *path, unsigned long *length) {
+    long file_length;
+    char *content;
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return NULL;
+
+    if (fseek(file, 0, SEEK_END) != 0 || (file_length = ftell(file)) < 0) {
+        fclose(file);
+        return NULL;
+    }
+    rewind(file);
+
+    content = allocate_object_array(file_length, sizeof(char));
+    *length = fread(content, 1, file_length, file);
+    fclose(file);
+
+    return content;
+}
+
+/**
+ * This function loads the outputs of the assembler into image
+ * The base4 text outputs are name.ob, and name.ent / name.ext if they exist (the binary object is name.bo)
+ * @param name The outputs name (without extension)
+ * @param binary Load the binary object (and not the base4 text outputs)
+ * @param image The image to init
+ * @return The status code (ERROR if we can't read the object, or it is broken)
+ */
+STATUS_CODE load_object_files(char *name, boolean binary, OBJECT_IMAGE *image) {
+    /* The files names */
+    char *object_path = add_suffix_to_string(name, binary ? BINARY_OBJECT_FILE_EXTENSION : OBJECT_FILE_EXTENSION);
+    char *entries_path = add_suffix_to_string(name, ENTRY_FILE_EXTENSION);
+    char *externals_path = add_suffix_to_string(name, EXTERNAL_FILE_EXTENSION);
+
+    /* The files contents (entries and externals are null if they don't exist) */
+    char *object, *entries = NULL, *externals = NULL;
+    unsigned long object_length = 0, entries_length = 0, externals_length = 0;
+
+    STATUS_CODE status_code = ERROR;
+
+    object = read_object_file(object_path, &object_length);
+    if (object != NULL && binary) {
+        status_code = read_binary_object(object, object_length, image);
+    } else if (object != NULL) {
+        entries = read_object_file(entries_path, &entries_length);
+        externals = read_object_file(externals_path, &externals_length);
+        status_code = read_text_object(object, object_length, entries, entries_length, externals, externals_length,
+                                       image);
+    }
+
+    free(object);
+    free(entries);
+    free(externals);
+    free(object_path);
+    free(entries_path);
+    free(externals_path);
+
+    return status_code;
+}
+
+/**
+ * This function frees the image arrays
+ * @param image The image
+ */
+void free_object_image(OBJECT_IMAGE *image) {
+    free(image->words);
+    free(image->entries);
+    free(image->externals);
+    free(image->names);
+}
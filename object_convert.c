@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assembler.h"
+
+
+/**
+ * This function writes output buffer to new file
+ * @param path The file path
+ * @param buffer The output buffer
+ * @return The status code (ERROR if we can't write the file)
+ */
+static STATUS_CODE write_object_file(const char *path, OUTPUT_BUFFER *buffer) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "CRITICAL: Unable to create file %s \n", path);
+        return ERROR;
+    }
+
+    fwrite(buffer->data, 1, buffer->length, file);
+    fclose(file);
+
+    return OK;
+}
+
+/**
+ * This function converts the assembler outputs from one format to the other
+ * The base4 text outputs (name.ob, and name.ent / name.ext if they exist) are converted to name.bo
+ * The binary object (name.bo) is converted to the base4 text outputs, like the assembler writes them
+ * (name.ob, and name.ent / name.ext only if there are entries / externals)
+ * @param name The outputs name (without extension)
+ * @param to_binary Convert the text outputs to binary object (or the binary object to text outputs)
+ * @return The status code
+ */
+static STATUS_CODE convert_object(char *name, boolean to_binary) {
+    /* The files names */
+    char *object_path = add_suffix_to_string(name, OBJECT_FILE_EXTENSION);
+    char *entries_path = add_suffix_to_string(name, ENTRY_FILE_EXTENSION);
+    char *externals_path = add_suffix_to_string(name, EXTERNAL_FILE_EXTENSION);
+    char *binary_path = add_suffix_to_string(name, BINARY_OBJECT_FILE_EXTENSION);
+
+    OBJECT_IMAGE image;
+    OUTPUT_BUFFER object, entries, externals;
+
+    STATUS_CODE status_code = ERROR;
+
+    if (load_object_files(name, !to_binary, &image) != OK) {
+        fprintf(stderr, "CRITICAL: Unable to load object %s \n", to_binary ? object_path : binary_path);
+    } else {
+        init_output_buffer(&object);
+        init_output_buffer(&entries);
+        init_output_buffer(&externals);
+
+        if (to_binary) {
+            build_binary_object(&image, &object);
+            status_code = write_object_file(binary_path, &object);
+        } else {
+            build_text_object(&image, &object, &entries, &externals);
+
+            status_code = write_object_file(object_path, &object);
+            if (status_code == OK && image.entries_count > 0) {
+                status_code = write_object_file(entries_path, &entries);
+            }
+            if (status_code == OK && image.externals_count > 0) {
+                status_code = write_object_file(externals_path, &externals);
+            }
+        }
+
+        free_output_buffer(&object);
+        free_output_buffer(&entries);
+        free_output_buffer(&externals);
+        free_object_image(&image);
+    }
+
+    free(object_path);
+    free(entries_path);
+    free(externals_path);
+    free(binary_path);
+
+    return status_code;
+}
+
+/**
+ * The object convert tool
+ * object_convert <name>.ob - writes <name>.bo from the base4 text outputs (<name>.ob, <name>.ent and <name>.ext)
+ * object_convert <name>.bo - writes the base4 text outputs from <name>.bo
+ */
+int main(int argc, char **argv) {
+    /* The file extension */
+    char *extension;
+
+    /* Convert the text outputs to binary object (or the binary object to text outputs) */
+    boolean to_binary;
+
+    STATUS_CODE status_code;
+
+    extension = argc == 2 ? strrchr(argv[1], '.') : NULL;
+    if (extension == NULL ||
+        (strcmp(extension, OBJECT_FILE_EXTENSION) != 0 && strcmp(extension, BINARY_OBJECT_FILE_EXTENSION) != 0)) {
+        fprintf(stderr, "Usage: %s <name%s | name%s> \n", argv[0], OBJECT_FILE_EXTENSION,
+                BINARY_OBJECT_FILE_EXTENSION);
+        return 1;
+    }
+
+    /* The outputs name is the file name without its extension */
+    to_binary = strcmp(extension, OBJECT_FILE_EXTENSION) == 0;
+    *extension = END_OF_STRING;
+    status_code = convert_object(argv[1], to_binary);
+
+    return status_code == OK ? 0 : 1;
+}
@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assembler.h"
+
+
+/**
+ * The object disassemble tool
+ * object_disassemble <name>.ob - writes the source of the base4 text outputs (<name>.ob, <name>.ent and <name>.ext)
+ * object_disassemble <name>.bo - writes the source of the binary object
+ */
+int main(int argc, char **argv) {
+    /* The file extension */
+    char *extension;
+
+    /* Load the binary object (or the text outputs) */
+    boolean binary;
+
+    OBJECT_IMAGE image;
+    OUTPUT_BUFFER source;
+
+    extension = argc == 2 ? strrchr(argv[1], '.') : NULL;
+    if (extension == NULL ||
+        (strcmp(extension, OBJECT_FILE_EXTENSION) != 0 && strcmp(extension, BINARY_OBJECT_FILE_EXTENSION) != 0)) {
+        fprintf(stderr, "Usage: %s <name%s | name%s> \n", argv[0], OBJECT_FILE_EXTENSION,
+                BINARY_OBJECT_FILE_EXTENSION);
+        return 1;
+    }
+
+    /* The outputs name is the file name without its extension */
+    binary = strcmp(extension, BINARY_OBJECT_FILE_EXTENSION) == 0;
+    *extension = END_OF_STRING;
+
+    if (load_object_files(argv[1], binary, &image) != OK) {
+        fprintf(stderr, "CRITICAL: Unable to load object %s%s \n", argv[1],
+                binary ? BINARY_OBJECT_FILE_EXTENSION : OBJECT_FILE_EXTENSION);
+        return 1;
+    }
+
+    /* The decodes table is built with the other commands tables */
+    init_commands_tables();
+
+    init_output_buffer(&source);
+    disassemble_object(&image, &source);
+    fwrite(source.data, 1, source.length, stdout);
+
+    free_output_buffer(&source);
+    free_object_image(&image);
+
+    return 0;
+}
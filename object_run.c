@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assembler.h"
+
+
+/**
+ * The object run tool
+ * object_run <name>.ob - runs the program of the base4 text outputs (<name>.ob, <name>.ent and <name>.ext)
+ * object_run <name>.bo - runs the program of the binary object
+ * object_run --jit <name>.ob / <name>.bo - runs the program with the JIT
+ * object_run --profile <name>.ob / <name>.bo - runs the program with the profiler, and writes <name>.prof and
+ * <name>.folded (the lines, labels and macros are in <name>.lin, if it exists)
+ * red reads from the stdin, and prn writes to the stdout
+ */
+int main(int argc, char **argv) {
+    /* The file extension */
+    char *extension;
+
+    /* Load the binary object (or the text outputs) */
+    boolean binary;
+
+    /* Run with the JIT (--jit) or the profiler (--profile), and the object file argument */
+    boolean use_jit = argc == 3 && strcmp(argv[1], JIT_OPTION) == 0;
+    boolean use_profiler = argc == 3 && strcmp(argv[1], PROFILE_OPTION) == 0;
+    char *path = argv[argc - 1];
+
+    OBJECT_IMAGE image;
+    EMULATOR_PROFILE profile;
+    LINE_TABLE line_table;
+    STATUS_CODE status_code;
+
+    extension = argc == 2 || use_jit || use_profiler ? strrchr(path, '.') : NULL;
+    if (extension == NULL ||
+        (strcmp(extension, OBJECT_FILE_EXTENSION) != 0 && strcmp(extension, BINARY_OBJECT_FILE_EXTENSION) != 0)) {
+        fprintf(stderr, "Usage: %s [%s | %s] <name%s | name%s> \n", argv[0], JIT_OPTION, PROFILE_OPTION,
+                OBJECT_FILE_EXTENSION, BINARY_OBJECT_FILE_EXTENSION);
+        return 1;
+    }
+
+    /* The outputs name is the file name without its extension */
+    binary = strcmp(extension, BINARY_OBJECT_FILE_EXTENSION) == 0;
+    *extension = END_OF_STRING;
+
+    if (load_object_files(path, binary, &image) != OK) {
+        fprintf(stderr, "CRITICAL: Unable to load object %s%s \n", path,
+                binary ? BINARY_OBJECT_FILE_EXTENSION : OBJECT_FILE_EXTENSION);
+        return 1;
+    }
+
+    /* The instructions are predecoded with the decodes table (it is built with the other commands tables) */
+    init_commands_tables();
+
+    status_code = run_object_image(path, &image, use_jit, use_profiler ? &profile : NULL, stdin, stdout, stderr);
+    free_object_image(&image);
+
+    /* Without the line table the profile has only the addresses */
+    if (use_profiler) {
+        if (load_line_table(path, &line_table) != OK) {
+            fprintf(stderr, "WARNING: Unable to load line table %s%s \n", path, LINE_TABLE_FILE_EXTENSION);
+        }
+        if (write_profile_files(path, &profile, &line_table) != OK) status_code = ERROR;
+        free_line_table(&line_table);
+    }
+
+    return status_code == OK ? 0 : 1;
+}
@@ -0,0 +1,464 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assembler.h"
+
+
+/* The command line arguments after we replace each @file with its arguments (all the arguments are copies) */
+typedef struct {
+    char **values;
+    int count;
+    int capacity;
+} ARGUMENTS_LIST;
+
+
+/**
+ * This function copies part of string to new string
+ * @param str The string to copy
+ * @param length The number of chars to copy
+ * @return The new string
+ */
+static char *copy_string(const char *str, int length) {
+    /* +1 for \0 */
+    char *copy = malloc(length + 1);
+    if (copy == NULL) {
+        printf("CRITICAL: Failed to allocate memory for option");
+        exit(1);
+    }
+
+    strncpy(copy, str, length);
+    copy[length] = END_OF_STRING;
+
+    return copy;
+}
+
+/**
+ * This function adds copy of argument to the end of the arguments list
+ * @param arguments The arguments list
+ * @param argument The argument
+ * @param length The argument length
+ */
+static void add_argument(ARGUMENTS_LIST *arguments, const char *argument, int length) {
+    if (arguments->count == arguments->capacity) {
+        arguments->capacity = arguments->capacity > 0 ? arguments->capacity * 2 : OPTIONS_LIST_DEFAULT_CAPACITY;
+        arguments->values = realloc(arguments->values, sizeof(char *) * arguments->capacity);
+        if (arguments->values == NULL) {
+            printf("CRITICAL: Failed to allocate memory for arguments");
+            exit(1);
+        }
+    }
+
+    arguments->values[arguments->count++] = copy_string(argument, length);
+}
+
+/**
+ * This function reads the next line of a file (in any length)
+ * @param file The file to read from
+ * @param line The line buffer to update (it grows if it needs, starts as null)
+ * @param capacity The line buffer capacity to update
+ * @return FALSE if there are no more lines
+ */
+static boolean read_option_file_line(FILE *file, char **line, int *capacity) {
+    /* The line length */
+    int length = 0;
+
+    /* The current char */
+    int c;
+
+    while ((c = getc(file)) != EOF && c != '\n') {
+        /* +1 for \0 */
+        if (length + 1 >= *capacity) {
+            *capacity = *capacity > 0 ? *capacity * 2 : OPTIONS_LINE_DEFAULT_CAPACITY;
+            *line = realloc(*line, *capacity);
+            if (*line == NULL) {
+                printf("CRITICAL: Failed to allocate memory for option line");
+                exit(1);
+            }
+        }
+
+        (*line)[length++] = (char) c;
+    }
+
+    if (c == EOF && length == 0) return FALSE;
+
+    /* Empty line still needs buffer for the \0 */
+    if (*line == NULL) {
+        *capacity = OPTIONS_LINE_DEFAULT_CAPACITY;
+        *line = malloc(*capacity);
+        if (*line == NULL) {
+            printf("CRITICAL: Failed to allocate memory for option line");
+            exit(1);
+        }
+    }
+
+    (*line)[length] = END_OF_STRING;
+    trim_newline(*line);
+
+    return TRUE;
+}
+
+/**
+ * This function opens option file (response file or manifest)
+ * If it fails it exits the program
+ * @param kind The file kind (for the error message)
+ * @param path The file path
+ * @return The opened file
+ */
+static FILE *open_option_file(const char *kind, const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "CRITICAL: Unable to open %s file %s \n", kind, path);
+        exit(1);
+    }
+
+    return file;
+}
+
+/**
+ * This function adds all the arguments of response file (@file) to the arguments list
+ * The arguments are separated by spaces, tabs or new lines
+ * @param path The response file path (without the @)
+ * @param arguments The arguments list
+ */
+static void read_response_file(const char *path, ARGUMENTS_LIST *arguments) {
+    FILE *file = open_option_file("response", path);
+
+    /* The current line */
+    char *line = NULL;
+    int capacity = 0;
+
+    /* The current argument inside the line */
+    char *argument;
+
+    while (read_option_file_line(file, &line, &capacity)) {
+        argument = line;
+        skip_empty_spaces(&argument);
+
+        while (*argument) {
+            add_argument(arguments, argument, get_word_length_until_space(argument));
+            argument += get_word_length_until_space(argument);
+            skip_empty_spaces(&argument);
+        }
+    }
+
+    free(line);
+    fclose(file);
+}
+
+/**
+ * This function adds new source to the options inputs
+ * The .as extension of the source is optional, and the outputs are written to the output directory (if we have one)
+ * @param options The options to update
+ * @param filename The source file name
+ * @param filename_length The source file name length
+ * @param output_directory The outputs directory (Can be null)
+ * @param output_directory_length The outputs directory length
+ */
+static void add_assembler_input(ASSEMBLER_OPTIONS *options, const char *filename, int filename_length,
+                                const char *output_directory, int output_directory_length) {
+    /* The new input */
+    ASSEMBLER_INPUT *input;
+
+    /* The source name without its directory */
+    const char *base_name = filename;
+
+    /* The extension length */
+    int extension_length = strlen(ASSEMBLY_FILE_EXTENSION);
+
+    /* For loop counter */
+    int i;
+
+    if (options->inputs_count == options->inputs_capacity) {
+        options->inputs_capacity = options->inputs_capacity > 0 ? options->inputs_capacity * 2
+                                                                : OPTIONS_LIST_DEFAULT_CAPACITY;
+        options->inputs = realloc(options->inputs, sizeof(ASSEMBLER_INPUT) * options->inputs_capacity);
+        if (options->inputs == NULL) {
+            printf("CRITICAL: Failed to allocate memory for files names");
+            exit(1);
+        }
+    }
+    input = &options->inputs[options->inputs_count++];
+
+    /* Remove the .as extension */
+    if (filename_length > extension_length &&
+        strncmp(filename + filename_length - extension_length, ASSEMBLY_FILE_EXTENSION, extension_length) == 0) {
+        filename_length -= extension_length;
+    }
+    input->filename = copy_string(filename, filename_length);
+
+    /* Without output directory the outputs are next to the source */
+    if (output_directory == NULL) {
+        input->output_name = input->filename;
+        return;
+    }
+
+    for (i = 0; i < filename_length; i++) {
+        if (filename[i] == DIRECTORY_SEPARATOR) base_name = filename + i + 1;
+    }
+    filename_length -= base_name - filename;
+
+    /* The directory, separator and the source name (+1 for \0) */
+    input->output_name = malloc(output_directory_length + filename_length + 2);
+    if (input->output_name == NULL) {
+        printf("CRITICAL: Failed to allocate memory for output name");
+        exit(1);
+    }
+    strncpy(input->output_name, output_directory, output_directory_length);
+    input->output_name[output_directory_length] = DIRECTORY_SEPARATOR;
+    strncpy(input->output_name + output_directory_length + 1, base_name, filename_length);
+    input->output_name[output_directory_length + filename_length + 1] = END_OF_STRING;
+}
+
+/**
+ * This function adds all the sources of manifest file to the options inputs
+ * Each line is source file, and optional outputs directory (separated by spaces)
+ * Empty lines and lines which start with # are ignored
+ * @param path The manifest file path
+ * @param options The options to update
+ */
+static void read_manifest_file(const char *path, ASSEMBLER_OPTIONS *options) {
+    FILE *file = open_option_file("manifest", path);
+
+    /* The current line */
+    char *line = NULL;
+    int capacity = 0;
+    int line_number = 0;
+
+    /* The line source and outputs directory (and the rest of the line after them) */
+    char *filename, *output_directory, *rest;
+    int filename_length, output_directory_length;
+
+    while (read_option_file_line(file, &line, &capacity)) {
+        line_number++;
+        filename = line;
+        skip_empty_spaces(&filename);
+
+        if (!*filename || *filename == MANIFEST_COMMENT_PREFIX) continue;
+
+        filename_length = get_word_length_until_space(filename);
+        output_directory = filename + filename_length;
+        skip_empty_spaces(&output_directory);
+        output_directory_length = get_word_length_until_space(output_directory);
+
+        /* Only the source and the outputs directory */
+        rest = output_directory + output_directory_length;
+        skip_empty_spaces(&rest);
+        if (*rest) {
+            fprintf(stderr, "CRITICAL: (%s line %d) Expected source and optional output directory \n",
+                    path, line_number);
+            exit(1);
+        }
+
+        add_assembler_input(options, filename, filename_length,
+                            output_directory_length > 0 ? output_directory : NULL, output_directory_length);
+    }
+
+    free(line);
+    fclose(file);
+}
+
+/**
+ * This function gets the value of option (e.g. --manifest files.txt)
+ * If the value is missing it exits the program
+ * @param argc The number of arguments
+ * @param argv The arguments
+ * @param index The option index (It also updates it to the value index)
+ * @return The option value
+ */
+static char *get_option_value(int argc, char **argv, int *index) {
+    if (*index + 1 >= argc) {
+        fprintf(stderr, "CRITICAL: Missing value for option %s \n", argv[*index]);
+        exit(1);
+    }
+
+    (*index)++;
+
+    return argv[*index];
+}
+
+/**
+ * This function gets the value of numeric option (e.g. --max-errors 10)
+ * If the value is missing or invalid it exits the program
+ * @param argc The number of arguments
+ * @param argv The arguments
+ * @param index The option index (It also updates it to the value index)
+ * @return The option value
+ */
+static int get_numeric_option_value(int argc, char **argv, int *index) {
+    /* The option name, for the error message */
+    char *option_name = argv[*index];
+
+    /* Pointer to the first invalid char of the value */
+    char *end;
+
+    /* The option value */
+    long value = strtol(get_option_value(argc, argv, index), &end, 10);
+
+    /* The value must be only positive number */
+    if (end == argv[*index] || *end != END_OF_STRING || value <= 0) {
+        fprintf(stderr, "CRITICAL: Invalid value for option %s (%s) \n", option_name, argv[*index]);
+        exit(1);
+    }
+
+    return (int) value;
+}
+
+/**
+ * This function parse the command line arguments
+ * Options can be placed anywhere, and they affect all the files
+ * All other arguments are files names (the .as extension is optional, or - to read the source from stdin)
+ * @file arguments are replaced with the arguments inside the file, and --manifest adds the sources of the manifest
+ * Reading from stdin also writes the outputs to stdout (unless we already write them in bundle or archive)
+ * Many sources on stdout are written in bundle mode (so each output has the name of its source)
+ * If we get unknown option (or stdin input more than once) it exits the program
+ * @param argc The number of arguments
+ * @param argv The arguments
+ * @param options The options to update
+ */
+void parse_assembler_options(int argc, char **argv, ASSEMBLER_OPTIONS *options) {
+    /* For loop counter */
+    int i;
+
+    /* Do we read any source from stdin */
+    boolean read_stdin = FALSE;
+
+    /* The arguments (include the response files arguments) */
+    ARGUMENTS_LIST arguments;
+    arguments.values = NULL;
+    arguments.count = 0;
+    arguments.capacity = 0;
+
+    init_assembler_options(options);
+
+    for (i = 1; i < argc; i++) {
+        if (*argv[i] == RESPONSE_FILE_PREFIX) {
+            read_response_file(argv[i] + 1, &arguments);
+        } else {
+            add_argument(&arguments, argv[i], strlen(argv[i]));
+        }
+    }
+
+    for (i = 0; i < arguments.count; i++) {
+        if (strcmp(arguments.values[i], CHECK_OPTION) == 0) {
+            options->check_only = TRUE;
+        } else if (strcmp(arguments.values[i], MAX_ERRORS_OPTION) == 0) {
+            options->max_errors = get_numeric_option_value(arguments.count, arguments.values, &i);
+        } else if (strcmp(arguments.values[i], JOBS_OPTION) == 0) {
+            options->jobs = get_numeric_option_value(arguments.count, arguments.values, &i);
+        } else if (strcmp(arguments.values[i], STDOUT_OPTION) == 0) {
+            options->output_mode = OUTPUT_STDOUT;
+        } else if (strcmp(arguments.values[i], BUNDLE_OPTION) == 0) {
+            options->output_mode = OUTPUT_BUNDLE;
+        } else if (strcmp(arguments.values[i], ASYNC_IO_OPTION) == 0) {
+            options->async_io = TRUE;
+        } else if (strcmp(arguments.values[i], IF_CHANGED_OPTION) == 0) {
+            options->write_if_changed = TRUE;
+        } else if (strcmp(arguments.values[i], WATCH_OPTION) == 0) {
+            options->watch = TRUE;
+        } else if (strcmp(arguments.values[i], LSP_OPTION) == 0) {
+            options->language_server = TRUE;
+        } else if (strcmp(arguments.values[i], BINARY_OBJECT_OPTION) == 0) {
+            options->binary_object = TRUE;
+        } else if (strcmp(arguments.values[i], RUN_OPTION) == 0) {
+            options->run = TRUE;
+        } else if (strcmp(arguments.values[i], JIT_OPTION) == 0) {
+            /* The JIT runs the programs (like --run) */
+            options->run = TRUE;
+            options->jit = TRUE;
+        } else if (strcmp(arguments.values[i], LINE_TABLE_OPTION) == 0) {
+            options->line_table = TRUE;
+        } else if (strcmp(arguments.values[i], PROFILE_OPTION) == 0) {
+            /* The profiler runs the programs (like --run) */
+            options->run = TRUE;
+            options->profile = TRUE;
+        } else if (strcmp(arguments.values[i], MANIFEST_OPTION) == 0) {
+            read_manifest_file(get_option_value(arguments.count, arguments.values, &i), options);
+        } else if (strcmp(arguments.values[i], ARCHIVE_OPTION) == 0) {
+            free(options->archive_path);
+            options->archive_path = get_option_value(arguments.count, arguments.values, &i);
+            options->output_mode = OUTPUT_ARCHIVE;
+
+            /* The options own the path (it is not freed with the arguments) */
+            arguments.values[i] = NULL;
+        } else if (strncmp(arguments.values[i], OPTION_PREFIX, strlen(OPTION_PREFIX)) == 0) {
+            fprintf(stderr, "CRITICAL: Unknown option %s \n", arguments.values[i]);
+            exit(1);
+        } else {
+            /* This is a file to assembly */
+            add_assembler_input(options, arguments.values[i], strlen(arguments.values[i]), NULL, 0);
+        }
+    }
+
+    /* The stdin source has no file name, so its outputs can't be files */
+    for (i = 0; i < options->inputs_count; i++) {
+        if (strcmp(options->inputs[i].filename, STDIN_FILE_NAME) != 0) continue;
+
+        /* The second read of stdin would get an empty source */
+        if (read_stdin) {
+            fprintf(stderr, "CRITICAL: The source can be read from stdin (%s) only once \n", STDIN_FILE_NAME);
+            exit(1);
+        }
+        read_stdin = TRUE;
+    }
+    if (read_stdin && options->output_mode == OUTPUT_FILES) options->output_mode = OUTPUT_STDOUT;
+
+    /* The objects of many sources can't be told apart without the bundle frames */
+    if (options->output_mode == OUTPUT_STDOUT && options->inputs_count > 1) options->output_mode = OUTPUT_BUNDLE;
+
+    /* The watch mode assemblies each source again when its file changes (so all the sources must be files) */
+    if (options->watch && (read_stdin || options->output_mode == OUTPUT_ARCHIVE)) {
+        fprintf(stderr, "CRITICAL: %s can't watch stdin or write archive \n", WATCH_OPTION);
+        exit(1);
+    }
+
+    /* The archive members are the base4 text outputs */
+    if (options->binary_object && options->output_mode == OUTPUT_ARCHIVE) {
+        fprintf(stderr, "CRITICAL: %s can't write archive \n", BINARY_OBJECT_OPTION);
+        exit(1);
+    }
+
+    /* The archive has only the object members */
+    if (options->line_table && options->output_mode == OUTPUT_ARCHIVE) {
+        fprintf(stderr, "CRITICAL: %s can't write archive \n", LINE_TABLE_OPTION);
+        exit(1);
+    }
+
+    /* The native code doesn't count the commands */
+    if (options->profile && options->jit) {
+        fprintf(stderr, "CRITICAL: %s can't run with %s \n", PROFILE_OPTION, JIT_OPTION);
+        exit(1);
+    }
+
+    /* The program needs the machine codes, and it prints to the stdout (so the outputs can't be there) */
+    if (options->run && (options->check_only || options->output_mode == OUTPUT_STDOUT ||
+                         options->output_mode == OUTPUT_BUNDLE)) {
+        fprintf(stderr, "CRITICAL: %s can't run in check mode or write the outputs to stdout \n", RUN_OPTION);
+        exit(1);
+    }
+
+    /* The inputs have their own copies */
+    for (i = 0; i < arguments.count; i++) free(arguments.values[i]);
+    free(arguments.values);
+}
+
+/**
+ * This function frees the options inputs (and the archive path)
+ * @param options The options to free
+ */
+void free_assembler_options(ASSEMBLER_OPTIONS *options) {
+    /* For loop counter */
+    int i;
+
+    for (i = 0; i < options->inputs_count; i++) {
+        if (options->inputs[i].output_name != options->inputs[i].filename) free(options->inputs[i].output_name);
+        free(options->inputs[i].filename);
+    }
+
+    free(options->inputs);
+    free(options->archive_path);
+    options->inputs = NULL;
+    options->archive_path = NULL;
+    options->inputs_count = 0;
+    options->inputs_capacity = 0;
+}
@@ -1,4 +1,3 @@
-#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,9 +9,10 @@
  * This funvtion get line contains macro, and return its name
  * @param line Pointer to macro line
  * @param line_number The line number of the macro
+ * @param diagnostics The diagnostics sink
  * @return Teh macro name
  */
-char *extract_macro_name(char **line, int line_number) {
+char *extract_macro_name(char **line, int line_number, DIAGNOSTICS *diagnostics) {
     /* Pointer to line start */
     char *start = *line;
 
@@ -32,16 +32,16 @@ char *extract_macro_name(char **line, int line_number) {
     end = start;
 
     /* Macro name must start with letters */
-    if (!*end || !isalpha(*end)) {
-        printf("ERROR: (Line %d) Macro name should start only with letters: (%s) \n", line_number, end);
+    if (!*end || !IS_ALPHA_CHAR(*end)) {
+        report_diagnostic(diagnostics, DIAGNOSTIC_MACRO_NAME_START, line_number, end);
         return NULL;
     }
 
     /* Increase the end until we arrive to the space */
-    while (*end && *end != EMPTY_CHAR && *end != TAB_CHAR) {
+    while (*end && !IS_SPACE_CHAR(*end)) {
         /* Validate correct chars */
-        if (!isalnum(*end) && *end != UNDERSCORE_SYMBOL) {
-            printf("ERROR: (Line %d) Macro should contains only letters / numbers / underscore (%s)", line_number, end);
+        if (!IS_ALNUM_CHAR(*end) && *end != UNDERSCORE_SYMBOL) {
+            report_diagnostic(diagnostics, DIAGNOSTIC_MACRO_NAME_CHARS, line_number, end);
             return NULL;
         }
 
@@ -72,6 +72,42 @@ char *extract_macro_name(char **line, int line_number) {
 
 
 /* Assemblers */
+/**
+ * This function reads the next source line (like fgets, the line ends with \n unless it is too long or the last one)
+ * @param reader The source reader
+ * @param line The buffer for the line
+ * @param size The buffer size (the line has at most size - 1 chars)
+ * @return The line, or null if there are no more lines
+ */
+char *read_source_line(SOURCE_READER *reader, char *line, int size) {
+    /* The line length */
+    int length = 0;
+
+    if (reader->file != NULL) return fgets(line, size, reader->file);
+
+    if (reader->buffer >= reader->buffer_end) return NULL;
+
+    /* Copy until the end of the line (include the \n) */
+    while (length < size - 1 && reader->buffer < reader->buffer_end) {
+        line[length++] = *reader->buffer;
+        if (*reader->buffer++ == '\n') break;
+    }
+
+    line[length] = END_OF_STRING;
+
+    return line;
+}
+
+/**
+ * This function adds expanded line to the .am file content
+ * @param expanded_source The .am file content
+ * @param line The line (without \n)
+ */
+static void append_expanded_line(OUTPUT_BUFFER *expanded_source, const char *line) {
+    append_to_output_buffer(expanded_source, line, strlen(line));
+    append_to_output_buffer(expanded_source, "\n", 1);
+}
+
 /**
  * This function is the pre assembler
  * It only saves all the macros and when it seems it in the code it replaces it with the actual macro
@@ -85,19 +121,101 @@ char *extract_macro_name(char **line, int line_number) {
  * It will be replaced with:
  * prn AS
  * stop
- * @param filename The assembler file name
+ * @param filename The assembler file name (- reads the source from stdin)
+ * @param output_name The .am file name (without the extension)
+ * @param source The source which the batch io already read (null to read the file here)
+ * @param batch_io The batch io to write the .am file with (null to write it here)
  * @param assembler_tables All Assembler tables (include the macro itself)
  * @return The status code of the pre assembler action
  */
-STATUS_CODE pre_assembler(char *filename, ASSEMBLER_TABLES *assembler_tables) {
+STATUS_CODE pre_assembler(char *filename, char *output_name, BATCH_SOURCE *source, BATCH_IO *batch_io,
+                          ASSEMBLER_TABLES *assembler_tables) {
     /* Init file names */
     char *input_file_name_with_extension = add_suffix_to_string(filename, ASSEMBLY_FILE_EXTENSION);
-    char *output_file_name_with_extension = add_suffix_to_string(filename, PRE_ASSEMBLER_FILE_EXTENSION);
+    char *output_file_name_with_extension = add_suffix_to_string(output_name, PRE_ASSEMBLER_FILE_EXTENSION);
+
+    /* Open files (In check mode, and when the outputs go to stdout, we don't write the .am file) */
+    FILE *output_file = NULL;
+    int output_fd = -1;
+    boolean write_output_file = !assembler_tables->check_only && assembler_tables->output_mode == OUTPUT_FILES;
+    boolean output_file_opened = FALSE;
+
+    /* The .am file content */
+    OUTPUT_BUFFER expanded_source;
+
+    /* The source is read from stdin */
+    boolean is_stdin = strcmp(filename, STDIN_FILE_NAME) == 0;
+
+    /* The pre assembler status code */
+    STATUS_CODE status_code;
+
+    /* The source reader (the source file, or the source in memory) */
+    SOURCE_READER reader;
+    reader.file = NULL;
+    reader.buffer = NULL;
+    reader.buffer_end = NULL;
+
+    if (source == NULL) {
+        reader.file = is_stdin ? stdin : fopen(input_file_name_with_extension, "r");
+    } else if (source->found) {
+        reader.buffer = source->data;
+        reader.buffer_end = source->data + source->length;
+    }
+
+    init_output_buffer(&expanded_source);
 
-    /* Open files */
-    FILE *assembly_file = fopen(input_file_name_with_extension, "r");
-    FILE *output_file = fopen(output_file_name_with_extension, "w");
+    /* Failed to open the files */
+    if (reader.file == NULL && reader.buffer == NULL) {
+        report_diagnostic(assembler_tables->diagnostics, DIAGNOSTIC_SOURCE_FILE_NOT_FOUND, 0,
+                          input_file_name_with_extension);
+        status_code = ERROR;
+    } else {
+        if (write_output_file && batch_io != NULL) {
+            output_fd = open_batch_output(batch_io, output_file_name_with_extension);
+            output_file_opened = output_fd >= 0;
+        } else if (write_output_file) {
+            output_file = fopen(output_file_name_with_extension, "w");
+            output_file_opened = output_file != NULL;
+        }
 
+        if (write_output_file && !output_file_opened) {
+            report_diagnostic(assembler_tables->diagnostics, DIAGNOSTIC_OUTPUT_FILE_OPEN_FAILED, 0,
+                              output_file_name_with_extension);
+            status_code = ERROR;
+        } else {
+            status_code = pre_assemble_source(&reader, write_output_file ? &expanded_source : NULL,
+                                              assembler_tables);
+        }
+
+        /* Write the .am file (the batch io writes it in the background and closes it) */
+        if (output_fd >= 0) submit_batch_write(batch_io, output_fd, &expanded_source);
+        if (output_file != NULL) {
+            fwrite(expanded_source.data, 1, expanded_source.length, output_file);
+            fclose(output_file);
+        }
+
+        /* Close the source file (stdin stays open) */
+        if (reader.file != NULL && !is_stdin) fclose(reader.file);
+    }
+
+    free_output_buffer(&expanded_source);
+    free(input_file_name_with_extension);
+    free(output_file_name_with_extension);
+
+    return status_code;
+}
+
+/**
+ * This function is the pre assembler of source from any reader
+ * It saves the macros and expands the lines for the first assembler (see pre_assembler)
+ * If the tables already have lexed source (e.g. the same document after an edit) its lexed lines are used again
+ * @param reader The source reader
+ * @param expanded_source The buffer for the .am file content (the expanded lines, Can be null)
+ * @param assembler_tables All Assembler tables (include the macro itself)
+ * @return The status code of the pre assembler action
+ */
+STATUS_CODE pre_assemble_source(SOURCE_READER *reader, OUTPUT_BUFFER *expanded_source,
+                                ASSEMBLER_TABLES *assembler_tables) {
     /* One line can not be more than line max  */
     char line[LINE_MAX_LENGTH + 1];
 
@@ -113,9 +231,6 @@ STATUS_CODE pre_assembler(char *filename, ASSEMBLER_TABLES *assembler_tables) {
     /* Should we save current log in current macro */
     boolean inside_macro = FALSE;
 
-    /* Mcro command length */
-    int macro_len = strlen(MACRO_NAME);
-
     /* Macro tables initialization */
     MACRO *current_macro = NULL;
     MACRO *last_macro = NULL;
@@ -126,24 +241,30 @@ STATUS_CODE pre_assembler(char *filename, ASSEMBLER_TABLES *assembler_tables) {
     /* Pointer to the current char inside the line */
     char *current_line_ptr;
 
-    /* Failed to open the files */
-    if (assembly_file == NULL) {
-        printf("CRITICAL: Unable to find or open file %s\n", input_file_name_with_extension);
-        return ERROR;
-    }
-    if (output_file == NULL) {
-        printf("CRITICAL: Unable to open file %s\n", output_file_name_with_extension);
-        return ERROR;
+    /* The current line kind and the line after the lexer */
+    LINE_KIND line_kind;
+    LEXED_LINE *lexed_line;
+
+    /* The expanded source lines (for the first assembler), we can use again the lexed lines of the same source */
+    LEXED_SOURCE *lexed_source = assembler_tables->lexed_source;
+    if (lexed_source == NULL) {
+        lexed_source = create_lexed_source();
+        assembler_tables->lexed_source = lexed_source;
+    } else {
+        reuse_lexed_source(lexed_source);
     }
 
-    while (fgets(line, sizeof(line), assembly_file) != NULL) {
+    while (read_source_line(reader, line, sizeof(line)) != NULL) {
+        /* We already found enough errors in this file */
+        if (diagnostics_limit_reached(assembler_tables->diagnostics)) break;
+
         line_number++;
         /* Update the current char to point the the start */
         current_line_ptr = line;
 
         /* Validate the line is in correct length (-1 ignore \0) */
         if (strlen(line) > LINE_MAX_LENGTH - 1) {
-            printf("ERROR: (Line %d) line length should not be more than %d \n", line_number, LINE_MAX_LENGTH);
+            report_diagnostic(assembler_tables->diagnostics, DIAGNOSTIC_LINE_TOO_LONG, line_number, NULL);
             status_code = ERROR;
             continue;
         }
@@ -151,18 +272,16 @@ STATUS_CODE pre_assembler(char *filename, ASSEMBLER_TABLES *assembler_tables) {
         /* Validate the line ends with \0 */
         trim_newline(line);
 
-        /* Remove leading space (e.g. ' mcro') */
-        skip_empty_spaces(&current_line_ptr);
+        /* Find the line kind (It also updates the pointer to be after the mcro / mcroend command) */
+        line_kind = classify_line(&current_line_ptr);
 
-        if (strncmp(current_line_ptr, END_MACRO_NAME, strlen(END_MACRO_NAME)) == 0) {
-            /* Update the pointer to be after the mcroend command */
-            current_line_ptr += strlen(END_MACRO_NAME);
+        if (line_kind == LINE_MACRO_END) {
             /* After mcroend can be many spaces */
             skip_empty_spaces(&current_line_ptr);
 
             /* After mcroend should not be more letters */
             if (*current_line_ptr) {
-                printf("ERROR: (Line %d) Macro end should not contain spam letters\n", line_number);
+                report_diagnostic(assembler_tables->diagnostics, DIAGNOSTIC_MACRO_END_SPAM, line_number, NULL);
                 status_code = ERROR;
                 continue;
             }
@@ -171,22 +290,19 @@ STATUS_CODE pre_assembler(char *filename, ASSEMBLER_TABLES *assembler_tables) {
             inside_macro = FALSE;
         }
         /* Check if we have 'mcro ' */
-        else if (strncmp(current_line_ptr, MACRO_NAME, macro_len) == 0) {
-            /* Update the pointer to be after the mcro command */
-            current_line_ptr += macro_len;
-
+        else if (line_kind == LINE_MACRO_START) {
             /* After macro definition can be many spaces */
             skip_empty_spaces(&current_line_ptr);
 
             /* There is no any macro name */
             if (!*current_line_ptr) {
-                printf("ERROR (Line %d) You must define macro name \n", line_number);
+                report_diagnostic(assembler_tables->diagnostics, DIAGNOSTIC_MACRO_NAME_MISSING, line_number, NULL);
                 status_code = ERROR;
                 continue;
             }
 
             /* Extract the macro name */
-            macro_name = extract_macro_name(&current_line_ptr, line_number);
+            macro_name = extract_macro_name(&current_line_ptr, line_number, assembler_tables->diagnostics);
 
             if (macro_name == NULL) {
                 status_code = ERROR;
@@ -194,19 +310,22 @@ STATUS_CODE pre_assembler(char *filename, ASSEMBLER_TABLES *assembler_tables) {
             }
 
             if (find_macro_by_name(assembler_tables->macro, macro_name, strlen(macro_name)) != NULL) {
-                printf("ERROR: (Line: %d) found multi macros with same name (%s) \n", line_number, macro_name);
+                report_diagnostic(assembler_tables->diagnostics, DIAGNOSTIC_MACRO_DUPLICATE, line_number, macro_name);
+                free(macro_name);
                 status_code = ERROR;
                 continue;
             }
 
-            if (!validate_macro_name(macro_name, line_number)) {
+            if (!validate_macro_name(macro_name, line_number, assembler_tables->diagnostics)) {
+                free(macro_name);
                 status_code = ERROR;
                 continue;
             }
 
             skip_empty_spaces(&current_line_ptr);
             if (*current_line_ptr) {
-                printf("ERROR: (Line: %d) Macro should not contain spam letters\n", line_number);
+                report_diagnostic(assembler_tables->diagnostics, DIAGNOSTIC_MACRO_SPAM, line_number, NULL);
+                free(macro_name);
                 status_code = ERROR;
                 continue;
             }
@@ -226,13 +345,12 @@ STATUS_CODE pre_assembler(char *filename, ASSEMBLER_TABLES *assembler_tables) {
             inside_macro = TRUE;
             /* End of the macro */
         } else if (inside_macro) {
-            /* Added the current line to the macro tables */
+            /* Added the current line to the macro tables (It is lexed only once, here) */
             add_content_to_macro(current_macro, line);
         } else {
             /* Regular line check if we call for specific macro */
-            skip_empty_spaces(&current_line_ptr);
-
-            current_line_macro = find_macro_by_name(assembler_tables->macro, current_line_ptr, get_word_length_until_space(current_line_ptr));
+            current_line_macro = find_macro_by_name(assembler_tables->macro, current_line_ptr,
+                                                    get_word_length_until_space(current_line_ptr));
 
             /* Replace macro name #1# */
             if (current_line_macro != NULL) {
@@ -240,22 +358,21 @@ STATUS_CODE pre_assembler(char *filename, ASSEMBLER_TABLES *assembler_tables) {
 
                 /* Write the all the macro codes #1# */
                 while (content != NULL) {
-                    fprintf(output_file, "%s\n", content->content);
+                    add_lexed_line(lexed_source, content->line, (int) line_number, current_line_macro);
+                    if (expanded_source != NULL) append_expanded_line(expanded_source, content->line->text);
                     content = content->next;
                 }
 
                 continue;
             }
 
-            /* Otherwise write regular line */
-            fprintf(output_file, "%s\n", line);
+            /* Otherwise this is regular line (lines with the same text share one lexed line) */
+            lexed_line = get_cached_lexed_line(lexed_source, line);
+            add_lexed_line(lexed_source, lexed_line, (int) line_number, NULL);
+            if (expanded_source != NULL) append_expanded_line(expanded_source, line);
         }
     }
 
-    /* Close the files */
-    fclose(assembly_file);
-    fclose(output_file);
-
     return status_code;
 }
 
@@ -265,13 +382,14 @@ STATUS_CODE pre_assembler(char *filename, ASSEMBLER_TABLES *assembler_tables) {
  * for rxample it doesn't save word
  * @param macro_name
  * @param line_number
+ * @param diagnostics The diagnostics sink
  * @return Is the macro valid
  */
-boolean validate_macro_name(char *macro_name, int line_number) {
+boolean validate_macro_name(char *macro_name, int line_number, DIAGNOSTICS *diagnostics) {
     /* Check the name is not command name (e.g. mov) */
-    const COMMAND_INFO *command_info = get_command_info_by_name(macro_name);
+    const COMMAND_INFO *command_info = get_command_info_by_name(macro_name, strlen(macro_name));
     if (command_info != NULL) {
-        printf("ERROR: (Line %d) Macro name should not be a command name (%s) \n", line_number, macro_name);
+        report_diagnostic(diagnostics, DIAGNOSTIC_MACRO_NAME_IS_COMMAND, line_number, macro_name);
         return FALSE;
     }
 
@@ -283,7 +401,7 @@ boolean validate_macro_name(char *macro_name, int line_number) {
         strcmp(macro_name, DATA_INSTRUCTION_NAME) == 0 || strcmp(macro_name, MAT_INSTRUCTION_NAME) == 0 ||
         strcmp(macro_name, STRING_INSTRUCTION_NAME) == 0 || strcmp(macro_name, MACRO_NAME) == 0 ||
         strcmp(macro_name, MACRO_NAME) == 0) {
-        printf("ERROR: (Line %d) Macro name should not be an instruction name (%s) \n", line_number, macro_name);
+        report_diagnostic(diagnostics, DIAGNOSTIC_MACRO_NAME_IS_INSTRUCTION, line_number, macro_name);
         return FALSE;
     }
 
@@ -0,0 +1,688 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assembler.h"
+
+
+/* The parts of the profile report (each part folds the addresses by another key) */
+typedef enum {
+    PROFILE_LINES,
+    PROFILE_LABELS,
+    PROFILE_MACROS,
+    PROFILE_ADDRESSES
+} PROFILE_PART;
+
+/* The commands of one line / label / macro / address */
+typedef struct {
+    /* The first address of the row (its source is the row key) */
+    int address;
+    unsigned long commands;
+    unsigned long cycles;
+} PROFILE_ROW;
+
+/* The profile with the source of each address */
+typedef struct {
+    const EMULATOR_PROFILE *profile;
+    const LINE_TABLE *line_table;
+
+    /* The line table entry of each address (null if the address is not in the table) */
+    const LINE_TABLE_ENTRY *entries[EMULATOR_MEMORY_SIZE];
+
+    /* All the commands and cycles of the program */
+    unsigned long commands;
+    unsigned long cycles;
+} PROFILER;
+
+
+/**
+ * This function initializes empty line table
+ * @param line_table The line table
+ */
+void init_line_table(LINE_TABLE *line_table) {
+    line_table->entries = NULL;
+    line_table->count = 0;
+    line_table->capacity = 0;
+    init_output_buffer(&line_table->names);
+}
+
+/**
+ * This function returns the name in the line table names
+ * @param line_table The line table
+ * @param offset The name offset (or LINE_TABLE_NO_NAME)
+ * @return The name (null if there is no name)
+ */
+static const char *get_line_table_name(const LINE_TABLE *line_table, int offset) {
+    return offset == LINE_TABLE_NO_NAME ? NULL : line_table->names.data + offset;
+}
+
+/**
+ * This function adds name to the line table names
+ * The words of one line (and all the lines after a label) have the same names, so they share the last entry names
+ * @param line_table The line table
+ * @param name The name (null if there is no name)
+ * @param length The name length
+ * @return The name offset (LINE_TABLE_NO_NAME if there is no name)
+ */
+static int add_line_table_name(LINE_TABLE *line_table, const char *name, int length) {
+    const LINE_TABLE_ENTRY *last = line_table->count > 0 ? &line_table->entries[line_table->count - 1] : NULL;
+    const char *last_name;
+    int offset;
+
+    if (name == NULL) return LINE_TABLE_NO_NAME;
+
+    if (last != NULL) {
+        last_name = get_line_table_name(line_table, last->label);
+        if (last_name != NULL && strncmp(last_name, name, length) == 0 && last_name[length] == END_OF_STRING) {
+            return last->label;
+        }
+
+        last_name = get_line_table_name(line_table, last->macro);
+        if (last_name != NULL && strncmp(last_name, name, length) == 0 && last_name[length] == END_OF_STRING) {
+            return last->macro;
+        }
+    }
+
+    offset = line_table->names.length;
+    append_to_output_buffer(&line_table->names, name, length);
+    append_to_output_buffer(&line_table->names, "", 1);
+
+    return offset;
+}
+
+/**
+ * This function adds word to the end of the line table
+ * @param line_table The line table
+ * @param address The word address
+ * @param line_number The source line number
+ * @param label The label name (null if there is no label)
+ * @param label_length The label length
+ * @param macro The macro name (null if the line is not macro line)
+ * @param macro_length The macro length
+ */
+static void add_line_table_entry(LINE_TABLE *line_table, int address, int line_number, const char *label,
+                                 int label_length, const char *macro, int macro_length) {
+    LINE_TABLE_ENTRY *entry;
+
+    /* The names are added before the entry, so they are compared with the last entry */
+    int label_offset = add_line_table_name(line_table, label, label_length);
+    int macro_offset = add_line_table_name(line_table, macro, macro_length);
+
+    if (line_table->count == line_table->capacity) {
+        line_table->capacity = line_table->capacity > 0 ? line_table->capacity * 2 : LINE_TABLE_DEFAULT_CAPACITY;
+        line_table->entries = realloc(line_table->entries, sizeof(LINE_TABLE_ENTRY) * line_table->capacity);
+        if (line_table->entries == NULL) {
+            printf("CRITICAL: Failed to allocate memory for line table");
+            exit(1);
+        }
+    }
+
+    entry = &line_table->entries[line_table->count++];
+    entry->address = address;
+    entry->line_number = line_number;
+    entry->label = label_offset;
+    entry->macro = macro_offset;
+}
+
+/**
+ * This function compares two symbols by their locations (for qsort)
+ * @param first Pointer to the first symbol pointer
+ * @param second Pointer to the second symbol pointer
+ * @return Negative if the first symbol is before the second, positive if it is after it, otherwise 0
+ */
+static int compare_symbols_locations(const void *first, const void *second) {
+    const SYMBOL_TABLE *first_symbol = *(SYMBOL_TABLE *const *) first;
+    const SYMBOL_TABLE *second_symbol = *(SYMBOL_TABLE *const *) second;
+
+    return first_symbol->location - second_symbol->location;
+}
+
+/**
+ * This function builds the line table from the assembler tables (after successful assembly)
+ * @param assembler_tables The assembler tables
+ * @param line_table The line table to init
+ */
+void build_line_table(ASSEMBLER_TABLES *assembler_tables, LINE_TABLE *line_table) {
+    /* Init tables pointers */
+    COMMAND_BINARY_LINE *command_binary_line;
+    SYMBOL_TABLE *symbol;
+    LEXED_SOURCE *lexed_source = assembler_tables->lexed_source;
+
+    /* The code labels by their locations (the symbol table has the last symbol first) */
+    SYMBOL_TABLE **labels;
+    int labels_count = 0;
+
+    /* The next label after the current word */
+    int label_index = 0;
+
+    /* The word source */
+    const char *label;
+    const MACRO *macro;
+    int line_number;
+
+    for (symbol = assembler_tables->symbol_table; symbol != NULL; symbol = symbol->next) {
+        if (symbol->type == CODE) labels_count++;
+    }
+
+    labels = malloc(sizeof(SYMBOL_TABLE *) * (labels_count > 0 ? labels_count : 1));
+    if (labels == NULL) {
+        printf("CRITICAL: Failed to allocate memory for line table labels");
+        exit(1);
+    }
+
+    labels_count = 0;
+    for (symbol = assembler_tables->symbol_table; symbol != NULL; symbol = symbol->next) {
+        if (symbol->type == CODE) labels[labels_count++] = symbol;
+    }
+    qsort(labels, labels_count, sizeof(SYMBOL_TABLE *), compare_symbols_locations);
+
+    init_line_table(line_table);
+
+    /* The command words are in their addresses order */
+    for (command_binary_line = assembler_tables->command_binary_line; command_binary_line != NULL;
+         command_binary_line = command_binary_line->next) {
+        while (label_index < labels_count && labels[label_index]->location <= command_binary_line->address) {
+            label_index++;
+        }
+        label = label_index > 0 ? labels[label_index - 1]->name : NULL;
+
+        /* The word line is in the expanded source, so we find its line in the source and its macro */
+        line_number = command_binary_line->line_number;
+        macro = NULL;
+        if (lexed_source != NULL && line_number >= 1 && line_number <= lexed_source->count) {
+            macro = lexed_source->macros[line_number - 1];
+            line_number = lexed_source->source_line_numbers[line_number - 1];
+        }
+
+        add_line_table_entry(line_table, command_binary_line->address, line_number, label,
+                             label != NULL ? (int) strlen(label) : 0, macro != NULL ? macro->name : NULL,
+                             macro != NULL ? (int) strlen(macro->name) : 0);
+    }
+
+    free(labels);
+}
+
+/**
+ * This function appends the name to the output buffer (or LINE_TABLE_NO_NAME_TEXT if there is no name)
+ * @param buffer The output buffer
+ * @param name The name (null if there is no name)
+ */
+static void append_line_table_name(OUTPUT_BUFFER *buffer, const char *name) {
+    if (name == NULL) name = LINE_TABLE_NO_NAME_TEXT;
+    append_to_output_buffer(buffer, name, strlen(name));
+}
+
+/**
+ * This function writes the line table file content
+ * @param line_table The line table
+ * @param buffer The output buffer
+ */
+void build_line_table_text(const LINE_TABLE *line_table, OUTPUT_BUFFER *buffer) {
+    /* The address and line number */
+    char numbers[PROFILE_NUMBER_MAX_LENGTH];
+
+    /* For loop counter */
+    int i;
+
+    for (i = 0; i < line_table->count; i++) {
+        sprintf(numbers, "%d %d ", line_table->entries[i].address, line_table->entries[i].line_number);
+        append_to_output_buffer(buffer, numbers, strlen(numbers));
+        append_line_table_name(buffer, get_line_table_name(line_table, line_table->entries[i].label));
+        append_to_output_buffer(buffer, " ", 1);
+        append_line_table_name(buffer, get_line_table_name(line_table, line_table->entries[i].macro));
+        append_to_output_buffer(buffer, "\n", 1);
+    }
+}
+
+/**
+ * This function reads the next name of line table file line
+ * @param ptr Pointer to the line position (it is updated to be after the name)
+ * @param name The name to update (null if it is LINE_TABLE_NO_NAME_TEXT)
+ * @param length The name length to update
+ * @return The status code (ERROR if there is no name)
+ */
+static STATUS_CODE read_line_table_name(char **ptr, const char **name, int *length) {
+    skip_empty_spaces(ptr);
+
+    *name = *ptr;
+    *length = get_word_length_until_space(*ptr);
+    *ptr += *length;
+
+    if (*length == (int) strlen(LINE_TABLE_NO_NAME_TEXT) &&
+        strncmp(*name, LINE_TABLE_NO_NAME_TEXT, *length) == 0) {
+        *name = NULL;
+        *length = 0;
+    }
+
+    return *length > 0 || *name == NULL ? OK : ERROR;
+}
+
+/**
+ * This function reads one line of the line table file
+ * @param line The line (with its end of line)
+ * @param line_table The line table to add the word to
+ * @return The status code (ERROR if the line is broken)
+ */
+static STATUS_CODE read_line_table_line(char *line, LINE_TABLE *line_table) {
+    char *ptr;
+    long address, line_number;
+    const char *label, *macro;
+    int label_length, macro_length;
+
+    address = strtol(line, &ptr, 10);
+    if (ptr == line || address < 0) return ERROR;
+
+    line = ptr;
+    line_number = strtol(line, &ptr, 10);
+    if (ptr == line || line_number < 0) return ERROR;
+
+    if (read_line_table_name(&ptr, &label, &label_length) != OK ||
+        read_line_table_name(&ptr, &macro, &macro_length) != OK) {
+        return ERROR;
+    }
+
+    /* Nothing after the names */
+    skip_empty_spaces(&ptr);
+    if (*ptr != END_OF_STRING) return ERROR;
+
+    add_line_table_entry(line_table, (int) address, (int) line_number, label, label_length, macro, macro_length);
+    return OK;
+}
+
+/**
+ * This function loads the line table file (name.lin)
+ * @param name The outputs name (without extension)
+ * @param line_table The line table to init (it is empty if we can't load it)
+ * @return The status code (ERROR if the file doesn't exist or it is broken)
+ */
+STATUS_CODE load_line_table(char *name, LINE_TABLE *line_table) {
+    char *path = add_suffix_to_string(name, LINE_TABLE_FILE_EXTENSION);
+    FILE *file = fopen(path, "r");
+
+    /* The current line (+2 for the end of line and \0) */
+    char line[LINE_TABLE_LINE_MAX_LENGTH + 2];
+    STATUS_CODE status_code = OK;
+
+    init_line_table(line_table);
+    free(path);
+    if (file == NULL) return ERROR;
+
+    while (status_code == OK && fgets(line, sizeof(line), file) != NULL) {
+        /* Lines which don't fit the buffer are broken */
+        if (strchr(line, '\n') == NULL && !feof(file)) {
+            status_code = ERROR;
+        } else {
+            line[strcspn(line, "\r\n")] = END_OF_STRING;
+            status_code = read_line_table_line(line, line_table);
+        }
+    }
+    fclose(file);
+
+    if (status_code != OK) {
+        free_line_table(line_table);
+        init_line_table(line_table);
+    }
+
+    return status_code;
+}
+
+/**
+ * This function frees the line table entries and names
+ * @param line_table The line table
+ */
+void free_line_table(LINE_TABLE *line_table) {
+    free(line_table->entries);
+    free_output_buffer(&line_table->names);
+}
+
+/**
+ * This function initializes the profiler (the source of each address, and the program totals)
+ * @param profiler The profiler
+ * @param profile The profile
+ * @param line_table The line table
+ */
+static void init_profiler(PROFILER *profiler, const EMULATOR_PROFILE *profile, const LINE_TABLE *line_table) {
+    /* For loop counter */
+    int i;
+
+    profiler->profile = profile;
+    profiler->line_table = line_table;
+    profiler->commands = 0;
+    profiler->cycles = 0;
+
+    for (i = 0; i < EMULATOR_MEMORY_SIZE; i++) {
+        profiler->entries[i] = NULL;
+        profiler->commands += profile->counts[i];
+        profiler->cycles += profile->cycles[i];
+    }
+
+    for (i = 0; i < line_table->count; i++) {
+        if (line_table->entries[i].address < EMULATOR_MEMORY_SIZE) {
+            profiler->entries[line_table->entries[i].address] = &line_table->entries[i];
+        }
+    }
+}
+
+/**
+ * This function returns the label or the macro name of address
+ * @param profiler The profiler
+ * @param address The address
+ * @param part PROFILE_LABELS for the label, PROFILE_MACROS for the macro
+ * @return The name (null if the address has no label / macro)
+ */
+static const char *get_address_name(const PROFILER *profiler, int address, PROFILE_PART part) {
+    const LINE_TABLE_ENTRY *entry = profiler->entries[address];
+
+    if (entry == NULL) return NULL;
+    return get_line_table_name(profiler->line_table, part == PROFILE_LABELS ? entry->label : entry->macro);
+}
+
+/**
+ * This function checks if two addresses are in the same row of the report part
+ * @param profiler The profiler
+ * @param part The report part
+ * @param first The first address
+ * @param second The second address
+ * @return Are the addresses in the same row
+ */
+static boolean is_same_profile_row(const PROFILER *profiler, PROFILE_PART part, int first, int second) {
+    const LINE_TABLE_ENTRY *first_entry = profiler->entries[first], *second_entry = profiler->entries[second];
+
+    switch (part) {
+        case PROFILE_LINES:
+            /* The addresses which are not in the table have their own rows */
+            if (first_entry == NULL || second_entry == NULL) return first == second;
+            return first_entry->line_number == second_entry->line_number;
+        case PROFILE_LABELS:
+        case PROFILE_MACROS:
+            return strcmp(get_address_name(profiler, first, part), get_address_name(profiler, second, part)) == 0;
+        default:
+            return first == second;
+    }
+}
+
+/**
+ * This function compares two rows by their cycles, the most expensive first (for qsort)
+ * @param first Pointer to the first row
+ * @param second Pointer to the second row
+ * @return Negative if the first row is before the second, positive if it is after it, otherwise 0
+ */
+static int compare_profile_rows(const void *first, const void *second) {
+    const PROFILE_ROW *first_row = first, *second_row = second;
+
+    if (first_row->cycles != second_row->cycles) return first_row->cycles > second_row->cycles ? -1 : 1;
+    return first_row->address - second_row->address;
+}
+
+/**
+ * This function folds the addresses which ran to the rows of the report part (sorted by the cycles)
+ * @param profiler The profiler
+ * @param part The report part
+ * @param rows The rows to update (EMULATOR_MEMORY_SIZE rows)
+ * @return Number of rows
+ */
+static int fold_profile_rows(const PROFILER *profiler, PROFILE_PART part, PROFILE_ROW *rows) {
+    int address, row, count = 0;
+
+    for (address = 0; address < EMULATOR_MEMORY_SIZE; address++) {
+        if (profiler->profile->counts[address] == 0) continue;
+
+        /* Only the addresses with label / macro are in the labels / macros parts */
+        if ((part == PROFILE_LABELS || part == PROFILE_MACROS) && get_address_name(profiler, address, part) == NULL) {
+            continue;
+        }
+
+        for (row = 0; row < count && !is_same_profile_row(profiler, part, rows[row].address, address); row++);
+        if (row == count) {
+            rows[count].address = address;
+            rows[count].commands = 0;
+            rows[count].cycles = 0;
+            count++;
+        }
+
+        rows[row].commands += profiler->profile->counts[address];
+        rows[row].cycles += profiler->profile->cycles[address];
+    }
+
+    qsort(rows, count, sizeof(PROFILE_ROW), compare_profile_rows);
+    return count;
+}
+
+/**
+ * This function appends report column (the text and spaces until the column width)
+ * @param report The report
+ * @param text The column text (null for LINE_TABLE_NO_NAME_TEXT)
+ * @param width The column width (the last column has no spaces)
+ */
+static void append_profile_column(OUTPUT_BUFFER *report, const char *text, int width) {
+    int length;
+
+    if (text == NULL) text = LINE_TABLE_NO_NAME_TEXT;
+    length = strlen(text);
+    append_to_output_buffer(report, text, length);
+
+    for (; length < width; length++) append_to_output_buffer(report, " ", 1);
+}
+
+/**
+ * This function appends the source line column of address (the line, or the address if it is not in the table)
+ * @param profiler The profiler
+ * @param address The address
+ * @param width The column width
+ * @param report The report
+ */
+static void append_profile_line_column(const PROFILER *profiler, int address, int width, OUTPUT_BUFFER *report) {
+    char line[PROFILE_NUMBER_MAX_LENGTH];
+
+    if (profiler->entries[address] != NULL) {
+        sprintf(line, "%d", profiler->entries[address]->line_number);
+    } else {
+        sprintf(line, "@%d", address);
+    }
+
+    append_profile_column(report, line, width);
+}
+
+/**
+ * This function appends one part of the report (its title, and its rows)
+ * @param profiler The profiler
+ * @param part The report part
+ * @param report The report
+ */
+static void append_profile_part(const PROFILER *profiler, PROFILE_PART part, OUTPUT_BUFFER *report) {
+    PROFILE_ROW rows[EMULATOR_MEMORY_SIZE];
+    int count = fold_profile_rows(profiler, part, rows);
+
+    /* The numbers columns */
+    char numbers[PROFILE_NUMBER_MAX_LENGTH];
+    double percent;
+
+    /* For loop counter */
+    int i;
+
+    /* The title and the columns names */
+    sprintf(numbers, "%12s %7s %12s  ", "cycles", "%", "commands");
+    switch (part) {
+        case PROFILE_LINES:
+            append_profile_column(report, PROFILE_LINES_TITLE, 0);
+            append_profile_column(report, numbers, 0);
+            append_profile_column(report, "line", PROFILE_LINE_COLUMN_WIDTH);
+            append_profile_column(report, "label", PROFILE_NAME_COLUMN_WIDTH);
+            append_profile_column(report, "macro", 0);
+            break;
+        case PROFILE_LABELS:
+            append_profile_column(report, PROFILE_LABELS_TITLE, 0);
+            append_profile_column(report, numbers, 0);
+            append_profile_column(report, "label", 0);
+            break;
+        case PROFILE_MACROS:
+            append_profile_column(report, PROFILE_MACROS_TITLE, 0);
+            append_profile_column(report, numbers, 0);
+            append_profile_column(report, "macro", 0);
+            break;
+        default:
+            append_profile_column(report, PROFILE_ADDRESSES_TITLE, 0);
+            append_profile_column(report, numbers, 0);
+            append_profile_column(report, "address", PROFILE_LINE_COLUMN_WIDTH);
+            append_profile_column(report, "line", 0);
+            break;
+    }
+    append_to_output_buffer(report, "\n", 1);
+
+    for (i = 0; i < count; i++) {
+        percent = profiler->cycles > 0 ? 100.0 * rows[i].cycles / profiler->cycles : 0;
+        sprintf(numbers, "%12lu %6.2f%% %12lu  ", rows[i].cycles, percent, rows[i].commands);
+        append_to_output_buffer(report, numbers, strlen(numbers));
+
+        switch (part) {
+            case PROFILE_LINES:
+                append_profile_line_column(profiler, rows[i].address, PROFILE_LINE_COLUMN_WIDTH, report);
+                append_profile_column(report, get_address_name(profiler, rows[i].address, PROFILE_LABELS),
+                                      PROFILE_NAME_COLUMN_WIDTH);
+                append_profile_column(report, get_address_name(profiler, rows[i].address, PROFILE_MACROS), 0);
+                break;
+            case PROFILE_LABELS:
+            case PROFILE_MACROS:
+                append_profile_column(report, get_address_name(profiler, rows[i].address, part), 0);
+                break;
+            default:
+                sprintf(numbers, "%d", rows[i].address);
+                append_profile_column(report, numbers, PROFILE_LINE_COLUMN_WIDTH);
+                if (profiler->entries[rows[i].address] != NULL) {
+                    append_profile_line_column(profiler, rows[i].address, 0, report);
+                } else {
+                    append_profile_column(report, NULL, 0);
+                }
+                break;
+        }
+
+        append_to_output_buffer(report, "\n", 1);
+    }
+
+    append_to_output_buffer(report, "\n", 1);
+}
+
+/**
+ * This function writes the hotspots report of the profile
+ * Each part (lines, labels, macros and addresses) is sorted by the cycles (the most expensive first)
+ * @param name The program name
+ * @param profile The profile
+ * @param line_table The line table (empty table reports only the addresses)
+ * @param report The output buffer
+ */
+void build_profile_report(const char *name, const EMULATOR_PROFILE *profile, const LINE_TABLE *line_table,
+                          OUTPUT_BUFFER *report) {
+    PROFILER profiler;
+    char totals[PROFILE_NUMBER_MAX_LENGTH];
+
+    init_profiler(&profiler, profile, line_table);
+
+    append_to_output_buffer(report, PROFILE_REPORT_TITLE, strlen(PROFILE_REPORT_TITLE));
+    append_to_output_buffer(report, name, strlen(name));
+    sprintf(totals, ": %lu commands, %lu cycles\n\n", profiler.commands, profiler.cycles);
+    append_to_output_buffer(report, totals, strlen(totals));
+
+    /* Without the line table we know only the addresses */
+    if (line_table->count > 0) {
+        append_profile_part(&profiler, PROFILE_LINES, report);
+        append_profile_part(&profiler, PROFILE_LABELS, report);
+        append_profile_part(&profiler, PROFILE_MACROS, report);
+    }
+    append_profile_part(&profiler, PROFILE_ADDRESSES, report);
+}
+
+/**
+ * This function writes the folded stacks of the profile (program;label;macro;line cycles)
+ * @param name The program name (the root frame)
+ * @param profile The profile
+ * @param line_table The line table (without it the last frame is the address)
+ * @param stacks The output buffer
+ */
+void build_folded_stacks(const char *name, const EMULATOR_PROFILE *profile, const LINE_TABLE *line_table,
+                         OUTPUT_BUFFER *stacks) {
+    PROFILER profiler;
+    PROFILE_ROW rows[EMULATOR_MEMORY_SIZE];
+    const char *frame;
+    char numbers[PROFILE_NUMBER_MAX_LENGTH];
+
+    int count, i;
+
+    init_profiler(&profiler, profile, line_table);
+    count = fold_profile_rows(&profiler, PROFILE_LINES, rows);
+
+    for (i = 0; i < count; i++) {
+        append_to_output_buffer(stacks, name, strlen(name));
+
+        /* The label and the macro frames (if the line has them) */
+        frame = get_address_name(&profiler, rows[i].address, PROFILE_LABELS);
+        if (frame != NULL) {
+            append_to_output_buffer(stacks, PROFILE_FRAME_SEPARATOR, 1);
+            append_to_output_buffer(stacks, frame, strlen(frame));
+        }
+        frame = get_address_name(&profiler, rows[i].address, PROFILE_MACROS);
+        if (frame != NULL) {
+            append_to_output_buffer(stacks, PROFILE_FRAME_SEPARATOR, 1);
+            append_to_output_buffer(stacks, frame, strlen(frame));
+        }
+
+        /* The line frame is the source file and line (like name.as:12), or the address */
+        append_to_output_buffer(stacks, PROFILE_FRAME_SEPARATOR, 1);
+        if (profiler.entries[rows[i].address] != NULL) {
+            append_to_output_buffer(stacks, name, strlen(name));
+            append_to_output_buffer(stacks, ASSEMBLY_FILE_EXTENSION, strlen(ASSEMBLY_FILE_EXTENSION));
+            sprintf(numbers, ":%d %lu\n", profiler.entries[rows[i].address]->line_number, rows[i].cycles);
+        } else {
+            sprintf(numbers, "@%d %lu\n", rows[i].address, rows[i].cycles);
+        }
+        append_to_output_buffer(stacks, numbers, strlen(numbers));
+    }
+}
+
+/**
+ * This function writes output buffer to new file
+ * @param path The file path
+ * @param buffer The output buffer
+ * @return The status code (ERROR if we can't write the file)
+ */
+static STATUS_CODE write_profile_file(const char *path, const OUTPUT_BUFFER *buffer) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "CRITICAL: Unable to create file %s \n", path);
+        return ERROR;
+    }
+
+    /* The buffer has no text if the program didn't run any command */
+    if (buffer->length > 0) fwrite(buffer->data, 1, buffer->length, file);
+    fclose(file);
+
+    return OK;
+}
+
+/**
+ * This function writes the profile report (name.prof) and the folded stacks (name.folded)
+ * @param name The outputs name (without extension)
+ * @param profile The profile
+ * @param line_table The line table
+ * @return The status code (ERROR if we can't write the files)
+ */
+STATUS_CODE write_profile_files(char *name, const EMULATOR_PROFILE *profile, const LINE_TABLE *line_table) {
+    char *report_path = add_suffix_to_string(name, PROFILE_FILE_EXTENSION);
+    char *stacks_path = add_suffix_to_string(name, FOLDED_STACKS_FILE_EXTENSION);
+    OUTPUT_BUFFER report, stacks;
+    STATUS_CODE status_code;
+
+    init_output_buffer(&report);
+    init_output_buffer(&stacks);
+    build_profile_report(name, profile, line_table, &report);
+    build_folded_stacks(name, profile, line_table, &stacks);
+
+    status_code = write_profile_file(report_path, &report);
+    if (status_code == OK) status_code = write_profile_file(stacks_path, &stacks);
+
+    free_output_buffer(&report);
+    free_output_buffer(&stacks);
+    free(report_path);
+    free(stacks_path);
+
+    return status_code;
+}
@@ -1,4 +1,3 @@
-#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -54,14 +53,13 @@ STATUS_CODE second_assembler(ASSEMBLER_TABLES *assembler_tables) {
 
     /* Update the entry instructions with their address */
     entry_instruction = assembler_tables->entry_instruction;
-    while (entry_instruction != NULL) {
+    while (entry_instruction != NULL && !diagnostics_limit_reached(assembler_tables->diagnostics)) {
         /* Find entry symbol */
         entry_symbol = find_symbol_by_name(symbol_table, entry_instruction->name);
 
         if (entry_symbol == NULL) {
-            printf("ERROR: (Line %d) Failed to find symbol with name: %s \n", entry_instruction->line_number,
-                   entry_instruction->name
-            );
+            report_diagnostic(assembler_tables->diagnostics, DIAGNOSTIC_ENTRY_SYMBOL_NOT_FOUND,
+                              entry_instruction->line_number, entry_instruction->name);
             status_code = ERROR;
         } else {
             entry_instruction->address = entry_symbol->location;
@@ -71,22 +69,30 @@ STATUS_CODE second_assembler(ASSEMBLER_TABLES *assembler_tables) {
     }
 
     command_binary_line = assembler_tables->command_binary_line;
-    while (command_binary_line != NULL) {
+    while (command_binary_line != NULL && !diagnostics_limit_reached(assembler_tables->diagnostics)) {
         /* We want to check if we already insert the address, or the symbole
          * if it starts with 0/1 this is address
          * Otherwise, this is symbol we need to update it actual address
+         * (In check mode we don't build the addresses so they are null)
          */
-        if (*command_binary_line->machine_code != '0' && *command_binary_line->machine_code != '1') {
+        if (command_binary_line->machine_code != NULL && *command_binary_line->machine_code != '0' &&
+            *command_binary_line->machine_code != '1') {
             SYMBOL_TABLE *command_symbol = find_symbol_by_name(symbol_table, command_binary_line->machine_code);
 
             if (command_symbol == NULL) {
-                printf("ERROR: (Line %d) Failed to find symbol name (%s). \n", command_binary_line->line_number,
-                       command_binary_line->machine_code);
+                report_diagnostic(assembler_tables->diagnostics, DIAGNOSTIC_SYMBOL_NOT_FOUND,
+                                  command_binary_line->line_number, command_binary_line->machine_code);
                 status_code = ERROR;
                 command_binary_line = command_binary_line->next;
                 continue;
             }
 
+            /* In check mode we only validate the symbol exists */
+            if (assembler_tables->check_only) {
+                command_binary_line = command_binary_line->next;
+                continue;
+            }
+
             /* It this is external we also want to save the command address for external file */
             if (command_symbol->type == EXTERNAL) {
                 new_external_instruction = create_external_instruction(
@@ -106,11 +112,18 @@ STATUS_CODE second_assembler(ASSEMBLER_TABLES *assembler_tables) {
             } else {
                 /* ADDRESS_SIZE + \0 */
                 symbol_address = malloc(ADDRESS_SIZE + 1);
-                symbol_address[0] = END_OF_STRING;
+                if (symbol_address == NULL) {
+                    printf("CRITICAL: Failed to allocate symbol address.\n");
+                    exit(1);
+                }
                 /* Define the data address */
-                strcat(symbol_address, decimal_to_binary(command_symbol->location, SYMBOL_BITS_LENGTH));
+                write_binary(symbol_address, command_symbol->location, SYMBOL_BITS_LENGTH);
                 /* Define the ERA */
-                strcat(symbol_address, decimal_to_binary(DATA, ERA_BITS_SIZE));
+                write_binary(symbol_address + SYMBOL_BITS_LENGTH, DATA, ERA_BITS_SIZE);
+                symbol_address[ADDRESS_SIZE] = END_OF_STRING;
+
+                /* The symbol name is not needed anymore */
+                free(command_binary_line->machine_code);
                 command_binary_line->machine_code = symbol_address;
             }
         }
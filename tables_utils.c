@@ -33,6 +33,7 @@ MACRO *find_macro_by_name(MACRO *head, const char *name, int length) {
 
 /**
  * Add new content line to existing macro
+ * The line is lexed here, so every use of the macro shares the same lexed line
  * @param current_macro The macro to add the new line to
  * @param content The new line content
  */
@@ -44,9 +45,8 @@ void add_content_to_macro(MACRO *current_macro, char *content) {
         exit(1);
     }
 
-    /* Copy to new string (+1 for \0) */
-    new_content->content = malloc(strlen(content) + 1);
-    strcpy(new_content->content, content);
+    /* Lex the line (It also copies the line) */
+    new_content->line = create_lexed_line(content);
 
     /* Init default values */
     new_content->next = NULL;
@@ -78,8 +78,8 @@ void free_macros(MACRO *head) {
         macro_content = current_macro->content;
 
         while (macro_content != NULL) {
-            /* Free the content string and */
-            free(macro_content->content);
+            /* Free the content line and */
+            free_lexed_line(macro_content->line);
             prev_macro_content = macro_content;
             macro_content = macro_content->next;
             free(prev_macro_content);
@@ -284,13 +284,51 @@ INSTRUCTION_BINARY_LINE *create_instruction_binary_line(int address, char *machi
     new_instruction_binary_line->address = address;
     new_instruction_binary_line->machine_code = machine_code;
 
-    /* Init default values */
+    /* Init default values (single word) */
+    new_instruction_binary_line->words_count = 1;
+    new_instruction_binary_line->repeat_count = 1;
     new_instruction_binary_line->next = NULL;
 
     return new_instruction_binary_line;
 }
 
 
+/**
+ * This function creates new empty assembler tables for one source
+ * @param options The options of the assembly (max errors, check mode and jobs)
+ * @return The new assembler tables
+ */
+ASSEMBLER_TABLES *create_assembler_tables(const ASSEMBLER_OPTIONS *options) {
+    ASSEMBLER_TABLES *assembler_tables = malloc(sizeof(ASSEMBLER_TABLES));
+    if (assembler_tables == NULL) {
+        printf("CRITICAL: Failed to allocate assembler tables.\n");
+        exit(1);
+    }
+
+    /* Init all assembler tables */
+    assembler_tables->command_binary_line = NULL;
+    assembler_tables->instruction_binary_line = NULL;
+    assembler_tables->external_instruction = NULL;
+    assembler_tables->entry_instruction = NULL;
+    assembler_tables->symbol_table = NULL;
+    assembler_tables->macro = NULL;
+    assembler_tables->lexed_source = NULL;
+
+    /* Each source collects its own diagnostics */
+    assembler_tables->diagnostics = create_diagnostics();
+    assembler_tables->diagnostics->max_errors = options->max_errors;
+
+    /* Check mode doesn't write any file */
+    assembler_tables->check_only = options->check_only;
+    assembler_tables->jobs = options->jobs;
+    assembler_tables->output_mode = options->output_mode;
+    assembler_tables->write_if_changed = options->write_if_changed;
+    assembler_tables->binary_object = options->binary_object;
+    assembler_tables->line_table = options->line_table;
+
+    return assembler_tables;
+}
+
 /**
  * This functions frees all assembler tables
  * @param assembler_tables The assembler tables to free its address
@@ -311,9 +349,18 @@ void free_assembler_tables(ASSEMBLER_TABLES *assembler_tables) {
     EXTERNAL_INSTRUCTION *external_instruction;
     EXTERNAL_INSTRUCTION *prev_external_instruction;
 
+    SYMBOL_TABLE *symbol;
+    SYMBOL_TABLE *prev_symbol;
+
+    /* Free the expanded source lines (before the macros, they still point to the macros lines) */
+    if (assembler_tables->lexed_source != NULL) free_lexed_source(assembler_tables->lexed_source);
+
     /* Free Macros */
     free_macros(assembler_tables->macro);
 
+    /* Free the diagnostics sink */
+    if (assembler_tables->diagnostics != NULL) free_diagnostics(assembler_tables->diagnostics);
+
     /* Free commands */
     current_command = assembler_tables->command_binary_line;
     while (current_command != NULL) {
@@ -350,6 +397,15 @@ void free_assembler_tables(ASSEMBLER_TABLES *assembler_tables) {
         free(prev_external_instruction);
     }
 
+    /* Free symbols */
+    symbol = assembler_tables->symbol_table;
+    while (symbol != NULL) {
+        prev_symbol = symbol;
+        symbol = symbol->next;
+        free(prev_symbol->name);
+        free(prev_symbol);
+    }
+
     /* Free the table itself */
     free(assembler_tables);
 }
@@ -1,61 +1,84 @@
-#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "assembler.h"
 
 
 /**
- * This function coppy all chars from string until it arrive to none digit
+ * This function finds all chars from string until it arrive to none digit
  * It also updates the string params with the next address
- * @param str_ptr The pointer to string to copy from
- * @return The new number as int
+ * @param str_ptr The pointer to string to search in
+ * @return The number slice inside the string (empty slice if we don't find number)
  */
-char *copy_next_number(char **str_ptr) {
+TOKEN_SLICE copy_next_number(char **str_ptr) {
     /* When we finish with the function we update the orginal pointer */
     char *src = *str_ptr;
 
-    /* Pointer to final char */
-    char *number;
+    /* The number inside the string */
+    TOKEN_SLICE number;
 
     /* Hold the start address of the number */
-    char *start = src;
-
-    /* The new number length */
-    int number_len;
+    number.start = src;
 
     /* Number can start with +/- symbols */
     if (*src == POSITIVE_NUMBER_SYMBOL || *src == NEGATIVE_NUMBER_SYMBOL) src++;
 
     /* Loop over all the digits and go to next char */
-    while (isdigit(*src)) src++;
+    while (IS_DIGIT_CHAR(*src)) src++;
 
     /* Calculate number length (include the +/- symbol) */
-    number_len = src - start;
+    number.length = src - number.start;
 
     /* We don't find any number, or we find only +/- symbols */
-    if (number_len == 0 || (number_len == 1 && (*start == NEGATIVE_NUMBER_SYMBOL || *src == NEGATIVE_NUMBER_SYMBOL))) {
-        return NULL;
+    if (number.length == 0 ||
+        (number.length == 1 && (*number.start == NEGATIVE_NUMBER_SYMBOL || *src == NEGATIVE_NUMBER_SYMBOL))) {
+        number.length = 0;
+        return number;
     }
 
-    /* We add 1 for \0 symbol */
-    number = malloc(number_len + 1);
-    if (number == NULL) {
-        printf("CRITICAL: Failed to allocate memory for new string");
-        exit(1);
-    }
-
-    /* Update the number with the new value */
-    strncpy(number, start, number_len);
-    number[number_len] = '\0';
-
     /* Update the original param with the new address */
     *str_ptr = src;
 
     return number;
 }
 
+/**
+ * This function converts number slice (from copy_next_number) to int, and checks it fits in one word
+ * It stops as soon as the number is out of range, so long numbers can't overflow
+ * @param number The number slice (optional +/- and digits)
+ * @param out_number The int value to update (only if it is in range)
+ * @return The status code (ERROR if the number is out of range)
+ */
+STATUS_CODE parse_number(TOKEN_SLICE number, int *out_number) {
+    /* For loop counter */
+    int i = 0;
+
+    /* The number without its sign */
+    int value = 0;
+
+    /* Is this negative number */
+    boolean is_negative = number.start[0] == NEGATIVE_NUMBER_SYMBOL;
+
+    /* Skip the sign */
+    if (is_negative || number.start[0] == POSITIVE_NUMBER_SYMBOL) i++;
+
+    for (; i < number.length; i++) {
+        value = value * 10 + (number.start[i] - '0');
+
+        /* More digits only make it bigger, so we can stop here */
+        if (value > -MIN_NEGATIVE_NUMBER_VALUE) return ERROR;
+    }
+
+    if (is_negative) value = -value;
+    if (value > MAX_POSITIVE_NUMBER_VALUE) return ERROR;
+
+    *out_number = value;
+
+    return OK;
+}
+
 /**
  * This function get pointer to string, and skip all spaces and tabs
  * It updates the str with the new pointer position
@@ -65,63 +88,53 @@ void skip_empty_spaces(char **str) {
     char *str_ptr = *str;
 
     /* Go to next char, if it is space */
-    while (*str_ptr == EMPTY_CHAR || *str_ptr == TAB_CHAR) str_ptr++;
+    while (IS_SPACE_CHAR(*str_ptr)) str_ptr++;
 
     *str = str_ptr;
 }
 
 /**
  * This function extract the current symbol from the string
- * If the symbol name is invalid, it will return null
+ * If the symbol name is invalid, it will return empty slice
  * @param string_ptr Pointer to the string which contains the symbol
  * @param line_number The line number of the symbol
- * @return The symbol string
+ * @param diagnostics The diagnostics sink
+ * @return The symbol slice inside the string
  */
-char *get_current_symbol(char **string_ptr, int line_number) {
+TOKEN_SLICE get_current_symbol(char **string_ptr, int line_number, DIAGNOSTICS *diagnostics) {
     /* In the end we will update the pointer with the new address */
     char *str = *string_ptr;
 
-    /* Pointer to final symbol */
-    char *symbol;
-
-    /* Count the symbol size (Validate is is not too long) */
-    int symbol_size = 0;
+    /* The final symbol (Count the symbol size, validate is is not too long) */
+    TOKEN_SLICE symbol;
+    symbol.start = str;
+    symbol.length = 0;
 
     if (!*str) {
-        printf("ERROR: (Line %d) Empty symbol name was received \n", line_number);
-        return NULL;
+        report_diagnostic(diagnostics, DIAGNOSTIC_SYMBOL_EMPTY, line_number, NULL);
+        return symbol;
     }
 
     /* Check first char value */
-    if (!isalpha(*str)) {
-        printf("ERROR: (Line %d) Symbol must start with alphameric char (%s) \n", line_number, str);
-        return NULL;
+    if (!IS_ALPHA_CHAR(*str)) {
+        report_diagnostic(diagnostics, DIAGNOSTIC_SYMBOL_START, line_number, str);
+        return symbol;
     }
 
 
     /* Go until the end of the symbol */
-    while (isalnum(*str)) {
+    while (IS_ALNUM_CHAR(*str)) {
         str++;
-        symbol_size++;
+        symbol.length++;
 
         /* Check Symbole length */
-        if (symbol_size > MAX_SYMBOL_LENGTH) {
-            printf("ERROR: (Line %d) Symbol length should not be more than %d \n", line_number, MAX_SYMBOL_LENGTH);
-            return NULL;
+        if (symbol.length > MAX_SYMBOL_LENGTH) {
+            report_diagnostic(diagnostics, DIAGNOSTIC_SYMBOL_TOO_LONG, line_number, NULL);
+            symbol.length = 0;
+            return symbol;
         }
     }
 
-    /* +1 for \0 */
-    symbol = malloc(symbol_size + 1);
-    if (symbol == NULL) {
-        printf("CRITICAL: Failed to allocate memory for symbol name");
-        exit(1);
-    }
-
-    /* Create new string with the symbol name */
-    strncpy(symbol, *string_ptr, symbol_size);
-    symbol[symbol_size] = END_OF_STRING;
-
     /* Update the pointer with the new address */
     *string_ptr = str;
 
@@ -151,6 +164,52 @@ char *add_suffix_to_string(char *base, char *suffix) {
     return result;
 }
 
+/**
+ * Init empty output buffer
+ * @param buffer The output buffer
+ */
+void init_output_buffer(OUTPUT_BUFFER *buffer) {
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+}
+
+/**
+ * Append text to the end of the output buffer (the buffer grows if it needs)
+ * @param buffer The output buffer
+ * @param text The text to append (doesn't have to end with \0)
+ * @param length The text length
+ */
+void append_to_output_buffer(OUTPUT_BUFFER *buffer, const char *text, int length) {
+    /* The new capacity (+1 for \0) */
+    int capacity = buffer->capacity > 0 ? buffer->capacity : OUTPUT_BUFFER_DEFAULT_CAPACITY;
+
+    while (buffer->length + length + 1 > capacity) capacity *= 2;
+
+    if (capacity != buffer->capacity) {
+        buffer->data = realloc(buffer->data, capacity);
+        if (buffer->data == NULL) {
+            printf("CRITICAL: Failed to allocate memory for output buffer");
+            exit(1);
+        }
+        buffer->capacity = capacity;
+    }
+
+    memcpy(buffer->data + buffer->length, text, length);
+    buffer->length += length;
+    buffer->data[buffer->length] = END_OF_STRING;
+}
+
+/**
+ * This function frees the output buffer text
+ * The buffer itself stays empty and can be used again
+ * @param buffer The output buffer
+ */
+void free_output_buffer(OUTPUT_BUFFER *buffer) {
+    free(buffer->data);
+    init_output_buffer(buffer);
+}
+
 /**
  * Array contains all command indo
  */
@@ -291,16 +350,195 @@ const COMMAND_INFO commands[] = {
  */
 const int NUM_COMMANDS = sizeof(commands) / sizeof(commands[0]);
 
+/**
+ * Bitmask of the allowed operands types for each command number and operand order
+ * It is built from the commands array (in init_commands_tables)
+ */
+unsigned int allowed_operands_masks[NUMBER_OF_COMMANDS][2];
+
+/**
+ * The first word of each command number, source operand type and destination operand type
+ * It is built from the commands array (in init_commands_tables)
+ */
+char command_first_words[NUMBER_OF_COMMANDS][OPERAND_TYPES_COUNT][OPERAND_TYPES_COUNT][ADDRESS_SIZE + 1];
+
+/**
+ * The command of each first word (invalid first words have null command)
+ * It is built from the commands array (in init_commands_tables)
+ */
+COMMAND_DECODE command_decodes[WORDS_COUNT];
+
+/**
+ * Makes sure the commands tables are built only once (even if many threads assembly at the same time)
+ */
+static pthread_once_t commands_tables_once = PTHREAD_ONCE_INIT;
+
+/**
+ * This function returns the number of words of command operand
+ * @param operand_type The operand type (UNDEFINED if the command doesn't have this operand)
+ * @return The number of words
+ */
+static int get_operand_words_count(OPERAND_TYPE operand_type) {
+    if (operand_type == UNDEFINED) return 0;
+
+    /* The mat symbol word and the registries word */
+    return operand_type == MAT ? 2 : 1;
+}
+
+/**
+ * Build the commands decodes of all the first words from the commands array
+ * Each valid first word has command number, allowed operands types (a command without source operand has 0 in the
+ * source type bits, and without operands has 0 in both) and the default ERA
+ */
+static void build_commands_decodes(void) {
+    /* For loop counters */
+    int i, word;
+
+    /* The first word parts */
+    int command_number, source_operand_type, des_operand_type, era;
+
+    /* The allowed operands types of the command */
+    unsigned int *allowed_masks;
+
+    COMMAND_DECODE *decode;
+
+    for (word = 0; word < WORDS_COUNT; word++) {
+        command_number = word >> (ADDRESS_SIZE - COMMAND_NUMBER_BITS_SIZE);
+        source_operand_type = (word >> (ERA_BITS_SIZE + OPERAND_TYPE_BINARY_SIZE)) & (OPERAND_TYPES_COUNT - 1);
+        des_operand_type = (word >> ERA_BITS_SIZE) & (OPERAND_TYPES_COUNT - 1);
+        era = word & ((1 << ERA_BITS_SIZE) - 1);
+
+        decode = &command_decodes[word];
+        decode->command_info = NULL;
+
+        for (i = 0; i < NUM_COMMANDS && commands[i].command_number != command_number; i++);
+        if (i == NUM_COMMANDS || era != COMMAND_ERA_DEFAULT_VALUE) continue;
+
+        allowed_masks = allowed_operands_masks[command_number];
+        decode->source_operand_type = commands[i].num_of_operands == 2 ? source_operand_type : UNDEFINED;
+        decode->des_operand_type = commands[i].num_of_operands >= 1 ? des_operand_type : UNDEFINED;
+
+        /* The unused operands types are 0, and the used ones must be allowed */
+        if ((decode->source_operand_type == UNDEFINED && source_operand_type != 0) ||
+            (decode->des_operand_type == UNDEFINED && des_operand_type != 0) ||
+            (decode->source_operand_type != UNDEFINED &&
+             !(allowed_masks[SOURCE_OPERAND_ORDER] & OPERAND_TYPE_BIT(source_operand_type))) ||
+            (decode->des_operand_type != UNDEFINED &&
+             !(allowed_masks[DES_OPERAND_ORDER] & OPERAND_TYPE_BIT(des_operand_type)))) {
+            continue;
+        }
+
+        decode->command_info = &commands[i];
+
+        /* Two registries share one word */
+        decode->words_count = 1 + (decode->source_operand_type == REGISTRY && decode->des_operand_type == REGISTRY
+                                       ? 1
+                                       : get_operand_words_count(decode->source_operand_type) +
+                                         get_operand_words_count(decode->des_operand_type));
+    }
+}
+
+/**
+ * Build the allowed operands bitmasks, the commands first words and the commands decodes from the commands array
+ */
+static void build_commands_tables(void) {
+    /* For loop counters */
+    int i, j, operand_order;
+    int source_operand_type, des_operand_type;
+
+    /* The current command number */
+    int command_number;
+
+    /* The current first word */
+    char *first_word;
+
+    for (i = 0; i < NUM_COMMANDS; i++) {
+        command_number = commands[i].command_number;
+
+        for (operand_order = SOURCE_OPERAND_ORDER; operand_order <= DES_OPERAND_ORDER; operand_order++) {
+            allowed_operands_masks[command_number][operand_order] = 0;
+            for (j = 0; j < commands[i].allowed_operand_number[operand_order]; j++) {
+                allowed_operands_masks[command_number][operand_order] |=
+                    OPERAND_TYPE_BIT(commands[i].allowed_operands[operand_order][j]);
+            }
+        }
+
+        /* Command number, source type, destination type and the ERA */
+        for (source_operand_type = 0; source_operand_type < OPERAND_TYPES_COUNT; source_operand_type++) {
+            for (des_operand_type = 0; des_operand_type < OPERAND_TYPES_COUNT; des_operand_type++) {
+                first_word = command_first_words[command_number][source_operand_type][des_operand_type];
+
+                write_binary(first_word, command_number, COMMAND_NUMBER_BITS_SIZE);
+                first_word += COMMAND_NUMBER_BITS_SIZE;
+                write_binary(first_word, source_operand_type, OPERAND_TYPE_BINARY_SIZE);
+                first_word += OPERAND_TYPE_BINARY_SIZE;
+                write_binary(first_word, des_operand_type, OPERAND_TYPE_BINARY_SIZE);
+                first_word += OPERAND_TYPE_BINARY_SIZE;
+                write_binary(first_word, COMMAND_ERA_DEFAULT_VALUE, ERA_BITS_SIZE);
+                first_word[ERA_BITS_SIZE] = END_OF_STRING;
+            }
+        }
+    }
+
+    /* The decodes use the allowed operands bitmasks */
+    build_commands_decodes();
+}
+
+/**
+ * Build the allowed operands bitmasks, the commands first words and the commands decodes from the commands array
+ * It should be called before we assembly any file (the tables are built only in the first call)
+ */
+void init_commands_tables(void) {
+    pthread_once(&commands_tables_once, build_commands_tables);
+}
+
+/* Short names for the chars classes table */
+#define CS CHAR_CLASS_SPACE
+#define CD CHAR_CLASS_DIGIT
+#define CA CHAR_CLASS_ALPHA
+#define CN CHAR_CLASS_SIGN
+#define CE CHAR_CLASS_END_OF_LINE
+
+/**
+ * Array contains the class of each char (The index is the char as unsigned char)
+ * It doesn't depend on the locale, and we check any class with one lookup
+ */
+const unsigned char char_classes[CHAR_CLASSES_SIZE] = {
+    /* 0x00 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, CS, CE, 0, 0, CE, 0, 0,
+    /* 0x10 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /* 0x20 */ CS, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, CN, 0, CN, 0, 0,
+    /* 0x30 */ CD, CD, CD, CD, CD, CD, CD, CD, CD, CD, 0, 0, 0, 0, 0, 0,
+    /* 0x40 */ 0, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA,
+    /* 0x50 */ CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, 0, 0, 0, 0, 0,
+    /* 0x60 */ 0, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA,
+    /* 0x70 */ CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, CA, 0, 0, 0, 0, 0,
+    /* 0x80 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /* 0x90 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /* 0xA0 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /* 0xB0 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /* 0xC0 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /* 0xD0 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /* 0xE0 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /* 0xF0 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+#undef CS
+#undef CD
+#undef CA
+#undef CN
+#undef CE
+
 /**
  * Find the command details
  * If it doesn't find command with this name, it will return null
  * @param name The command name
+ * @param length The name length (the name doesn't have to end with \0)
  * @return The command info
  */
-const COMMAND_INFO *get_command_info_by_name(const char *name) {
+const COMMAND_INFO *get_command_info_by_name(const char *name, int length) {
     int i;
     for (i = 0; i < NUM_COMMANDS; i++) {
-        if (strcmp(commands[i].name, name) == 0) {
+        if (strncmp(commands[i].name, name, length) == 0 && commands[i].name[length] == END_OF_STRING) {
             /* Return the command info isnide this index */
             return &commands[i];
         }
@@ -319,7 +557,7 @@ void trim_newline(char *str) {
     size_t len = strlen(str);
 
     /* Go until we don't have any more ends of line symbols */
-    while (len > 0 && (str[len - 1] == END_OF_LINE || str[len - 1] == WINDOWS_END_OF_LINE)) {
+    while (len > 0 && IS_CHAR_CLASS(str[len - 1], CHAR_CLASS_END_OF_LINE)) {
         /* Update the end of string to current position (remove the end of line) */
         str[len - 1] = END_OF_STRING;
         len--;
@@ -327,13 +565,13 @@ void trim_newline(char *str) {
 }
 
 /**
- * This function get decimal number and convert this to binary
- * We request the length, so if the binary length is grether we add leading zeros
+ * This function writes the decimal number as binary into existing buffer (without \0)
+ * It is used to write many words one after another (e.g. all the .data numbers)
+ * @param binary The buffer to write to (with at least length chars)
  * @param decimal The decimal number to convert to binary
  * @param length The binary length
- * @return The new binary
  */
-char *decimal_to_binary(int decimal, int length) {
+void write_binary(char *binary, int decimal, int length) {
     /* Loop counter */
     int i;
 
@@ -343,15 +581,6 @@ char *decimal_to_binary(int decimal, int length) {
     /* Applying the bitmask */
     unsigned int value = (unsigned int) decimal & mask;
 
-    /* We add +1 for \0 */
-    char *binary = malloc(length + 1);
-    if (binary == NULL) {
-        printf("ERROR: Failed to allocate binary representation.\n");
-        exit(1);
-    }
-
-    binary[length] = END_OF_STRING;
-
     /* Create the binary string */
     for (i = length - 1; i >= 0; i--) {
         /* If the bit is zero it will write 0 otherwise 1 because it is the next char after zero*/
@@ -360,6 +589,25 @@ char *decimal_to_binary(int decimal, int length) {
         /* Go to next bit */
         value >>= 1;
     }
+}
+
+/**
+ * This function get decimal number and convert this to binary
+ * We request the length, so if the binary length is grether we add leading zeros
+ * @param decimal The decimal number to convert to binary
+ * @param length The binary length
+ * @return The new binary
+ */
+char *decimal_to_binary(int decimal, int length) {
+    /* We add +1 for \0 */
+    char *binary = malloc(length + 1);
+    if (binary == NULL) {
+        printf("ERROR: Failed to allocate binary representation.\n");
+        exit(1);
+    }
+
+    write_binary(binary, decimal, length);
+    binary[length] = END_OF_STRING;
 
     return binary;
 }
@@ -419,131 +667,451 @@ char *decimal_to_base4(int value) {
 }
 
 /**
- * This function gets even binary number length
- * and return its base number
- * @param binary_str The binary string (in even length)
- * @return The base4 number
+ * This function writes even binary number length as base4 into existing buffer (with \0)
+ * @param base4 The buffer to write to (with at least length / 2 + 1 chars)
+ * @param binary_str The binary string (in even length, doesn't have to end with \0)
+ * @param binary_length The binary length
  */
-char *binary_to_base4(char *binary_str) {
-    /* The binary number length */
-    int binary_length;
-
-    /* The final base4 number */
-    char *result;
-
+void write_binary_as_base4(char *base4, const char *binary_str, int binary_length) {
     /* For loop counter */
     int i, j = 0;
 
     /* The current binary number */
     int current_binary_value;
 
-    binary_length = strlen(binary_str);
-
-    /* Half of the binary (from base2 to base4 we divide by two) */
-    result = malloc(binary_length / 2 + 1);
-    if (result == NULL) {
-        printf("CRITICAL: Failed to allocate binary representation.\n");
-        exit(1);
-    }
-
     /* Loop over the binary and each two bits replace with 4base */
     for (i = 0; i < binary_length; i += 2) {
         /* The first binary value is *2 and the second is *1 */
         current_binary_value = (binary_str[i] - '0') * 2 + (binary_str[i + 1] - '0');
-        result[j++] = BASE_4_CHARS[current_binary_value];
+        base4[j++] = BASE_4_CHARS[current_binary_value];
     }
 
     /* Close the base4 string*/
-    result[j] = END_OF_STRING;
+    base4[j] = END_OF_STRING;
+}
+
+/**
+ * This function gets even binary number length
+ * and return its base number
+ * @param binary_str The binary string (in even length)
+ * @return The base4 number
+ */
+char *binary_to_base4(char *binary_str) {
+    /* The binary number length */
+    int binary_length = strlen(binary_str);
+
+    /* Half of the binary (from base2 to base4 we divide by two) */
+    char *result = malloc(binary_length / 2 + 1);
+    if (result == NULL) {
+        printf("CRITICAL: Failed to allocate binary representation.\n");
+        exit(1);
+    }
+
+    write_binary_as_base4(result, binary_str, binary_length);
 
     return result;
 }
 
 
 /**
- * This function writes all assembler files
- * Include object, external and entry
- * @param filename The filename of the assembly file
- * @param assembler_tables The assembler tables
+ * This function appends positive decimal number as base4 to the output buffer
+ * It writes the same base4 as decimal_to_base4 (without allocating it)
+ * @param buffer The output buffer
+ * @param value The decimal number
  */
-void write_assembler_files(char *filename, ASSEMBLER_TABLES *assembler_tables) {
-    /* Define all files name */
-    char *object_file_name_with_extension = add_suffix_to_string(filename, OBJECT_FILE_EXTENSION);
-    char *entry_file_name_with_extension = add_suffix_to_string(filename, ENTRY_FILE_EXTENSION);
-    char *external_file_name_with_extension = add_suffix_to_string(filename, EXTERNAL_FILE_EXTENSION);
+void append_base4_number(OUTPUT_BUFFER *buffer, int value) {
+    /* The base4 chars from the end (each base4 char holds 2 bits) */
+    char base4[sizeof(int) * 4];
+    int start = sizeof(base4);
+
+    /* Handle with zero value */
+    if (value == 0) {
+        append_to_output_buffer(buffer, "a", 1);
+        return;
+    }
+
+    while (value > 0) {
+        base4[--start] = BASE_4_CHARS[value % 4];
+        value /= 4;
+    }
+
+    append_to_output_buffer(buffer, base4 + start, sizeof(base4) - start);
+}
 
+/**
+ * This function builds the content of all assembler files in memory
+ * Include object, external and entry (entry and external stay empty if there are no entries / externals)
+ * @param assembler_tables The assembler tables
+ * @param object The output buffer for the object file
+ * @param entries The output buffer for the entry file
+ * @param externals The output buffer for the external file
+ */
+void build_assembler_images(ASSEMBLER_TABLES *assembler_tables, OUTPUT_BUFFER *object, OUTPUT_BUFFER *entries,
+                            OUTPUT_BUFFER *externals) {
     /* Init tables pointers */
     COMMAND_BINARY_LINE *command_binary_line = assembler_tables->command_binary_line;
     INSTRUCTION_BINARY_LINE *instruction_binary_line = assembler_tables->instruction_binary_line;
     ENTRY_INSTRUCTION *entry_instruction = assembler_tables->entry_instruction;
     EXTERNAL_INSTRUCTION *external_instruction = assembler_tables->external_instruction;
 
-    /* Output files */
-    FILE *entry_file;
-    FILE *external_file;
-    FILE *object_file = fopen(object_file_name_with_extension, "w");
-    if (object_file == NULL) {
-        perror("CRITICAL: Failed to create object file!");
-        exit(1);
-    }
+    /* The current word in base4 (+1 for \0) */
+    char machine_code[ADDRESS_SIZE / 2 + 1];
+
+    /* The current instruction word address */
+    int instruction_address;
+
+    /* For loop counters */
+    int i, j;
+
+    /* The object header is the commands and the instructions lengths */
+    append_to_output_buffer(object, "\t", 1);
+    append_base4_number(object, assembler_tables->ic - IC_COUNTER_DEFAULT_VALUE);
+    append_to_output_buffer(object, " ", 1);
+    append_base4_number(object, assembler_tables->dc - DC_COUNTER_DEFAULT_VALUE);
+    append_to_output_buffer(object, "\n", 1);
 
-    fprintf(object_file, "\t%s %s\n",
-            decimal_to_base4(assembler_tables->ic - IC_COUNTER_DEFAULT_VALUE),
-            decimal_to_base4(assembler_tables->dc - DC_COUNTER_DEFAULT_VALUE)
-    );
-    /* Write commands file */
+    /* Write commands */
     while (command_binary_line != NULL) {
-        fprintf(object_file, "%s\t%s\n",
-                decimal_to_base4(command_binary_line->address),
-                binary_to_base4(command_binary_line->machine_code)
-        );
+        write_binary_as_base4(machine_code, command_binary_line->machine_code, ADDRESS_SIZE);
+        append_base4_number(object, command_binary_line->address);
+        append_to_output_buffer(object, "\t", 1);
+        append_to_output_buffer(object, machine_code, ADDRESS_SIZE / 2);
+        append_to_output_buffer(object, "\n", 1);
         command_binary_line = command_binary_line->next;
     }
-    /* Added the instruction section */
+
+    /* Added the instruction section (each node words are expanded to word per address) */
     while (instruction_binary_line != NULL) {
-        fprintf(object_file, "%s\t%s\n",
-                decimal_to_base4(instruction_binary_line->address),
-                binary_to_base4(instruction_binary_line->machine_code)
-        );
+        instruction_address = instruction_binary_line->address;
+        for (i = 0; i < instruction_binary_line->repeat_count; i++) {
+            for (j = 0; j < instruction_binary_line->words_count; j++) {
+                write_binary_as_base4(machine_code, instruction_binary_line->machine_code + j * ADDRESS_SIZE,
+                                      ADDRESS_SIZE);
+                append_base4_number(object, instruction_address++);
+                append_to_output_buffer(object, "\t", 1);
+                append_to_output_buffer(object, machine_code, ADDRESS_SIZE / 2);
+                append_to_output_buffer(object, "\n", 1);
+            }
+        }
         instruction_binary_line = instruction_binary_line->next;
     }
-    fclose(object_file);
 
-    /* Write entry file only if we define entries */
-    if (entry_instruction != NULL) {
-        entry_file = fopen(entry_file_name_with_extension, "w");
-        if (entry_file == NULL) {
-            perror("CRITICAL: Failed to create entry file!");
-            exit(1);
-        }
+    /* Write entries */
+    while (entry_instruction != NULL) {
+        append_to_output_buffer(entries, entry_instruction->name, strlen(entry_instruction->name));
+        append_to_output_buffer(entries, "\t", 1);
+        append_base4_number(entries, entry_instruction->address);
+        append_to_output_buffer(entries, "\n", 1);
+        entry_instruction = entry_instruction->next;
+    }
 
-        while (entry_instruction != NULL) {
-            fprintf(entry_file, "%s\t%s\n",
-                    entry_instruction->name,
-                    decimal_to_base4(entry_instruction->address)
-            );
-            entry_instruction = entry_instruction->next;
-        }
-        fclose(entry_file);
+    /* Write externals */
+    while (external_instruction != NULL) {
+        append_to_output_buffer(externals, external_instruction->name, strlen(external_instruction->name));
+        append_to_output_buffer(externals, "\t", 1);
+        append_base4_number(externals, external_instruction->address);
+        append_to_output_buffer(externals, "\n", 1);
+        external_instruction = external_instruction->next;
     }
+}
 
-    /* Write externals only if it was define */
-    if (external_instruction != NULL) {
-        external_file = fopen(external_file_name_with_extension, "w");
-        if (external_file == NULL) {
-            perror("CRITICAL: Failed to create external file!");
+/**
+ * This function checks if the output file already has exactly this content
+ * @param file_name The file name
+ * @param buffer The new content
+ * @return Is the file content the same (FALSE if the file doesn't exist)
+ */
+static boolean output_file_unchanged(char *file_name, OUTPUT_BUFFER *buffer) {
+    /* The current part of the file */
+    char part[OUTPUT_COMPARE_BUFFER_SIZE];
+    int part_length;
+
+    /* How much of the file we already compared */
+    long offset = 0;
+    boolean unchanged;
+
+    FILE *file = fopen(file_name, "rb");
+    if (file == NULL) return FALSE;
+
+    /* The file size is checked first, so different size doesn't read the file at all */
+    unchanged = fseek(file, 0, SEEK_END) == 0 && ftell(file) == buffer->length;
+    if (unchanged) rewind(file);
+
+    while (unchanged && (part_length = fread(part, 1, sizeof(part), file)) > 0) {
+        unchanged = offset + part_length <= buffer->length &&
+                    memcmp(part, buffer->data + offset, part_length) == 0;
+        offset += part_length;
+    }
+
+    fclose(file);
+
+    return unchanged && offset == buffer->length;
+}
+
+/**
+ * This function writes output buffer to new file
+ * @param file_name The file name
+ * @param buffer The output buffer
+ * @param error_message The message if we fail to create the file
+ * @param assembler_tables The assembler tables (write if changed mode)
+ * @param batch_io The batch io to write the file with (null to write it here)
+ */
+static void write_output_buffer_file(char *file_name, OUTPUT_BUFFER *buffer, char *error_message,
+                                     ASSEMBLER_TABLES *assembler_tables, BATCH_IO *batch_io) {
+    FILE *file;
+    int fd;
+
+    /* Keep the file (and its modification time) if the content is the same */
+    if (assembler_tables->write_if_changed && output_file_unchanged(file_name, buffer)) return;
+
+    /* The batch io writes the file in the background */
+    if (batch_io != NULL) {
+        fd = open_batch_output(batch_io, file_name);
+        if (fd < 0) {
+            perror(error_message);
             exit(1);
         }
 
-        while (external_instruction != NULL) {
-            fprintf(external_file, "%s\t%s\n",
-                    external_instruction->name,
-                    decimal_to_base4(external_instruction->address)
-            );
-            external_instruction = external_instruction->next;
+        submit_batch_write(batch_io, fd, buffer);
+        return;
+    }
+
+    file = fopen(file_name, "w");
+    if (file == NULL) {
+        perror(error_message);
+        exit(1);
+    }
+
+    fwrite(buffer->data, 1, buffer->length, file);
+    fclose(file);
+}
+
+/**
+ * This function builds the binary object of the assembler tables
+ * @param assembler_tables The assembler tables
+ * @param buffer The output buffer for the binary object
+ */
+static void build_assembler_binary_object(ASSEMBLER_TABLES *assembler_tables, OUTPUT_BUFFER *buffer) {
+    OBJECT_IMAGE image;
+
+    build_object_image(assembler_tables, &image);
+    build_binary_object(&image, buffer);
+    free_object_image(&image);
+}
+
+/**
+ * This function builds the line table file content of the assembler tables
+ * @param assembler_tables The assembler tables
+ * @param buffer The output buffer for the line table
+ */
+static void build_assembler_line_table(ASSEMBLER_TABLES *assembler_tables, OUTPUT_BUFFER *buffer) {
+    LINE_TABLE line_table;
+
+    build_line_table(assembler_tables, &line_table);
+    build_line_table_text(&line_table, buffer);
+    free_line_table(&line_table);
+}
+
+/**
+ * This function writes the line table file (with --line-table)
+ * @param filename The filename of the assembly file
+ * @param assembler_tables The assembler tables
+ * @param batch_io The batch io to write the file with (null to write it here)
+ */
+static void write_line_table_file(char *filename, ASSEMBLER_TABLES *assembler_tables, BATCH_IO *batch_io) {
+    char *line_table_file_name_with_extension = add_suffix_to_string(filename, LINE_TABLE_FILE_EXTENSION);
+    OUTPUT_BUFFER line_table;
+
+    init_output_buffer(&line_table);
+    build_assembler_line_table(assembler_tables, &line_table);
+    write_output_buffer_file(line_table_file_name_with_extension, &line_table,
+                             "CRITICAL: Failed to create line table file!", assembler_tables, batch_io);
+
+    free_output_buffer(&line_table);
+    free(line_table_file_name_with_extension);
+}
+
+/**
+ * This function writes all assembler files
+ * Include object, external and entry (and removes the old entry and external files if there are none)
+ * In binary object mode it writes only the binary object (.bo) file
+ * Each mode removes the outputs of the other mode left by earlier assembly
+ * The line table (.lin) is written in both modes (with --line-table)
+ * @param filename The filename of the assembly file
+ * @param assembler_tables The assembler tables
+ * @param batch_io The batch io to write the files with (null to write them here)
+ */
+void write_assembler_files(char *filename, ASSEMBLER_TABLES *assembler_tables, BATCH_IO *batch_io) {
+    /* Define all files name */
+    char *object_file_name_with_extension = add_suffix_to_string(filename, OBJECT_FILE_EXTENSION);
+    char *entry_file_name_with_extension = add_suffix_to_string(filename, ENTRY_FILE_EXTENSION);
+    char *external_file_name_with_extension = add_suffix_to_string(filename, EXTERNAL_FILE_EXTENSION);
+    char *binary_object_file_name_with_extension = add_suffix_to_string(filename, BINARY_OBJECT_FILE_EXTENSION);
+
+    /* The files content */
+    OUTPUT_BUFFER object, entries, externals;
+    init_output_buffer(&object);
+    init_output_buffer(&entries);
+    init_output_buffer(&externals);
+
+    if (assembler_tables->line_table) write_line_table_file(filename, assembler_tables, batch_io);
+
+    if (assembler_tables->binary_object) {
+        build_assembler_binary_object(assembler_tables, &object);
+        write_output_buffer_file(binary_object_file_name_with_extension, &object,
+                                 "CRITICAL: Failed to create binary object file!", assembler_tables, batch_io);
+
+        /* Remove the text outputs of earlier assembly (they belong to other build of the source) */
+        remove(object_file_name_with_extension);
+        remove(entry_file_name_with_extension);
+        remove(external_file_name_with_extension);
+
+        free_output_buffer(&object);
+        free(object_file_name_with_extension);
+        free(entry_file_name_with_extension);
+        free(external_file_name_with_extension);
+        free(binary_object_file_name_with_extension);
+        return;
+    }
+
+    /* Remove the binary object of earlier assembly (it belongs to other build of the source) */
+    remove(binary_object_file_name_with_extension);
+
+    build_assembler_images(assembler_tables, &object, &entries, &externals);
+
+    write_output_buffer_file(object_file_name_with_extension, &object, "CRITICAL: Failed to create object file!",
+                             assembler_tables, batch_io);
+
+    /* Write entry file only if we define entries (otherwise remove the entry file of earlier assembly) */
+    if (assembler_tables->entry_instruction != NULL) {
+        write_output_buffer_file(entry_file_name_with_extension, &entries, "CRITICAL: Failed to create entry file!",
+                                 assembler_tables, batch_io);
+    } else {
+        remove(entry_file_name_with_extension);
+    }
+
+    /* Write externals only if it was define (otherwise remove the external file of earlier assembly) */
+    if (assembler_tables->external_instruction != NULL) {
+        write_output_buffer_file(external_file_name_with_extension, &externals,
+                                 "CRITICAL: Failed to create external file!", assembler_tables, batch_io);
+    } else {
+        remove(external_file_name_with_extension);
+    }
+
+    free_output_buffer(&object);
+    free_output_buffer(&entries);
+    free_output_buffer(&externals);
+    free(object_file_name_with_extension);
+    free(entry_file_name_with_extension);
+    free(external_file_name_with_extension);
+    free(binary_object_file_name_with_extension);
+}
+
+
+/**
+ * This function writes output buffer to a stream after a bundle frame header
+ * @param name The name of the outputs
+ * @param extension The output file extension
+ * @param buffer The output buffer
+ * @param output The output stream
+ */
+static void write_bundle_frame(char *name, char *extension, OUTPUT_BUFFER *buffer, FILE *output) {
+    fprintf(output, BUNDLE_FRAME_FORMAT, name, extension, buffer->length);
+    fwrite(buffer->data, 1, buffer->length, output);
+}
+
+/**
+ * This function writes all assembler outputs to a stream (e.g. stdout)
+ * In bundle mode each output starts with a frame header (name, extension and length), like:
+ * input.ob 42
+ * Otherwise only the object is written (the line table is written only in bundle mode)
+ * @param name The name of the outputs (the assembly file name)
+ * @param assembler_tables The assembler tables
+ * @param bundle Should we write all the outputs with frame headers
+ * @param output The output stream
+ */
+void write_assembler_stream(char *name, ASSEMBLER_TABLES *assembler_tables, boolean bundle, FILE *output) {
+    /* The outputs content */
+    OUTPUT_BUFFER object, entries, externals, line_table;
+    init_output_buffer(&object);
+    init_output_buffer(&entries);
+    init_output_buffer(&externals);
+    init_output_buffer(&line_table);
+
+    /* The stdin source has no name */
+    if (bundle && strcmp(name, STDIN_FILE_NAME) == 0) name = STDIN_OUTPUT_NAME;
+
+    if (assembler_tables->binary_object) {
+        /* The binary object has all the object outputs */
+        build_assembler_binary_object(assembler_tables, &object);
+
+        if (!bundle) {
+            fwrite(object.data, 1, object.length, output);
+        } else {
+            write_bundle_frame(name, BINARY_OBJECT_FILE_EXTENSION, &object, output);
+        }
+    } else {
+        build_assembler_images(assembler_tables, &object, &entries, &externals);
+
+        if (!bundle) {
+            fwrite(object.data, 1, object.length, output);
+        } else {
+            /* Like the files, entry and external are written only if we have entries / externals */
+            write_bundle_frame(name, OBJECT_FILE_EXTENSION, &object, output);
+            if (assembler_tables->entry_instruction != NULL) {
+                write_bundle_frame(name, ENTRY_FILE_EXTENSION, &entries, output);
+            }
+            if (assembler_tables->external_instruction != NULL) {
+                write_bundle_frame(name, EXTERNAL_FILE_EXTENSION, &externals, output);
+            }
         }
-        fclose(external_file);
     }
+
+    /* The line table is the last frame */
+    if (bundle && assembler_tables->line_table) {
+        build_assembler_line_table(assembler_tables, &line_table);
+        write_bundle_frame(name, LINE_TABLE_FILE_EXTENSION, &line_table, output);
+    }
+
+    fflush(output);
+
+    free_output_buffer(&object);
+    free_output_buffer(&entries);
+    free_output_buffer(&externals);
+    free_output_buffer(&line_table);
+}
+
+
+/**
+ * This function adds all assembler outputs of one source to the archive
+ * @param name The name of the outputs (the assembly file name)
+ * @param assembler_tables The assembler tables (null if the source failed, so the entry has no members)
+ * @param archive The archive writer
+ */
+void write_assembler_archive_entry(char *name, ASSEMBLER_TABLES *assembler_tables, ARCHIVE_WRITER *archive) {
+    /* The outputs content (in the archive members order) */
+    OUTPUT_BUFFER members[ARCHIVE_MEMBERS_COUNT];
+
+    /* The stdin source has no name */
+    if (strcmp(name, STDIN_FILE_NAME) == 0) name = STDIN_OUTPUT_NAME;
+
+    if (assembler_tables == NULL) {
+        add_archive_entry(archive, name, NULL);
+        return;
+    }
+
+    init_output_buffer(&members[ARCHIVE_MEMBER_OBJECT]);
+    init_output_buffer(&members[ARCHIVE_MEMBER_ENTRIES]);
+    init_output_buffer(&members[ARCHIVE_MEMBER_EXTERNALS]);
+
+    build_assembler_images(assembler_tables, &members[ARCHIVE_MEMBER_OBJECT], &members[ARCHIVE_MEMBER_ENTRIES],
+                           &members[ARCHIVE_MEMBER_EXTERNALS]);
+
+    add_archive_entry(archive, name, members);
+
+    free_output_buffer(&members[ARCHIVE_MEMBER_OBJECT]);
+    free_output_buffer(&members[ARCHIVE_MEMBER_ENTRIES]);
+    free_output_buffer(&members[ARCHIVE_MEMBER_EXTERNALS]);
 }
 
 
@@ -557,7 +1125,7 @@ int get_word_length_until_space(char *str) {
     int len = 0;
 
     /* Go until the next space */
-    while (str[len] && str[len] != EMPTY_CHAR && str[len] != TAB_CHAR) {
+    while (str[len] && !IS_SPACE_CHAR(str[len])) {
         len++;
     }
 
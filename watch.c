@@ -0,0 +1,283 @@
+/* The watcher uses Linux and POSIX calls (inotify, poll, read) */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+#include "assembler.h"
+
+
+struct WATCHER {
+    /* The watched sources */
+    ASSEMBLER_INPUT *inputs;
+    int inputs_count;
+
+    /* The inotify file descriptor */
+    int fd;
+
+    /* The source file of each input (with the .as extension), and its name inside its directory */
+    char **paths;
+    char **names;
+
+    /* The watch of each source directory (editors often replace the file, so we watch its directory) */
+    int *watches;
+
+    /* The sources which changed and we didn't check yet */
+    boolean *changed;
+
+    /* The content of each source in its last assembly */
+    BATCH_SOURCE *sources;
+};
+
+
+/**
+ * This function reads the whole source file into memory
+ * @param path The source file (with extension)
+ * @param source The source to update (the old content is freed)
+ */
+static void read_watched_source(char *path, BATCH_SOURCE *source) {
+    long length;
+
+    FILE *file = fopen(path, "rb");
+
+    free(source->data);
+    source->data = NULL;
+    source->length = 0;
+    source->found = FALSE;
+
+    if (file == NULL) return;
+
+    if (fseek(file, 0, SEEK_END) != 0 || (length = ftell(file)) < 0) {
+        fclose(file);
+        return;
+    }
+    rewind(file);
+
+    /* +1 for \0 */
+    source->data = malloc(length + 1);
+    if (source->data == NULL) {
+        printf("CRITICAL: Failed to allocate memory for source file");
+        exit(1);
+    }
+
+    /* The file can become shorter while we read it */
+    source->length = fread(source->data, 1, length, file);
+    source->data[source->length] = END_OF_STRING;
+    source->found = TRUE;
+
+    fclose(file);
+}
+
+/**
+ * This function creates watcher for the sources, and reads their current content
+ * If the system can't watch the files it exits the program
+ * @param inputs The sources to watch
+ * @param inputs_count The number of sources
+ * @return The new watcher
+ */
+WATCHER *create_watcher(ASSEMBLER_INPUT *inputs, int inputs_count) {
+#ifdef __linux__
+    /* For loop counter */
+    int i;
+
+    /* The end of the source directory inside the path, and the char we replace there with \0 */
+    char *directory_end;
+    char directory_end_char;
+
+    WATCHER *watcher = malloc(sizeof(WATCHER));
+    if (watcher == NULL) {
+        printf("CRITICAL: Failed to allocate watcher.\n");
+        exit(1);
+    }
+
+    watcher->inputs = inputs;
+    watcher->inputs_count = inputs_count;
+    watcher->paths = malloc(sizeof(char *) * inputs_count);
+    watcher->names = malloc(sizeof(char *) * inputs_count);
+    watcher->watches = malloc(sizeof(int) * inputs_count);
+    watcher->changed = malloc(sizeof(boolean) * inputs_count);
+    watcher->sources = malloc(sizeof(BATCH_SOURCE) * inputs_count);
+    if (watcher->paths == NULL || watcher->names == NULL || watcher->watches == NULL || watcher->changed == NULL ||
+        watcher->sources == NULL) {
+        printf("CRITICAL: Failed to allocate watcher sources.\n");
+        exit(1);
+    }
+
+    watcher->fd = inotify_init();
+    if (watcher->fd < 0) {
+        perror("CRITICAL: Failed to watch the sources!");
+        exit(1);
+    }
+
+    for (i = 0; i < inputs_count; i++) {
+        watcher->paths[i] = add_suffix_to_string(inputs[i].filename, ASSEMBLY_FILE_EXTENSION);
+        watcher->names[i] = strrchr(watcher->paths[i], DIRECTORY_SEPARATOR);
+        watcher->names[i] = watcher->names[i] == NULL ? watcher->paths[i] : watcher->names[i] + 1;
+
+        /* The same directory has the same watch (file without directory is in the current directory) */
+        if (watcher->names[i] == watcher->paths[i]) {
+            watcher->watches[i] = inotify_add_watch(watcher->fd, WATCH_CURRENT_DIRECTORY, WATCH_EVENTS);
+        } else {
+            /* Cut the path after its directory for a moment (the root directory keeps its separator) */
+            directory_end = watcher->names[i] - 1 == watcher->paths[i] ? watcher->names[i] : watcher->names[i] - 1;
+            directory_end_char = *directory_end;
+            *directory_end = END_OF_STRING;
+            watcher->watches[i] = inotify_add_watch(watcher->fd, watcher->paths[i], WATCH_EVENTS);
+            *directory_end = directory_end_char;
+        }
+
+        if (watcher->watches[i] < 0) {
+            fprintf(stderr, "CRITICAL: Failed to watch the directory of %s \n", watcher->paths[i]);
+            exit(1);
+        }
+
+        watcher->changed[i] = FALSE;
+        watcher->sources[i].data = NULL;
+        read_watched_source(watcher->paths[i], &watcher->sources[i]);
+    }
+
+    return watcher;
+#else
+    (void) inputs;
+    (void) inputs_count;
+
+    fprintf(stderr, "CRITICAL: %s is not supported on this system \n", WATCH_OPTION);
+    exit(1);
+#endif
+}
+
+/**
+ * This function gets the content of the source in its last assembly
+ * @param watcher The watcher
+ * @param index The input index
+ * @return The source
+ */
+BATCH_SOURCE *get_watched_source(WATCHER *watcher, int index) {
+    return &watcher->sources[index];
+}
+
+#ifdef __linux__
+/**
+ * This function waits for changes of the watched directories, and marks the sources which changed
+ * After the first change it collects the other changes of the same save (for WATCH_SETTLE_MILLISECONDS)
+ * @param watcher The watcher
+ * @return The status code (ERROR if we can't read the changes)
+ */
+static STATUS_CODE read_watch_events(WATCHER *watcher) {
+    /* The events (long for the events alignment) */
+    long events[WATCH_EVENTS_BUFFER_SIZE / sizeof(long)];
+    struct inotify_event *event;
+    char *event_ptr;
+    int length;
+
+    /* For loop counter */
+    int i;
+
+    /* Wait for the first change without timeout */
+    int timeout = -1;
+    int ready;
+
+    struct pollfd poll_fd;
+    poll_fd.fd = watcher->fd;
+    poll_fd.events = POLLIN;
+
+    while ((ready = poll(&poll_fd, 1, timeout)) != 0) {
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready < 0) return ERROR;
+
+        length = read(watcher->fd, events, sizeof(events));
+        if (length <= 0) return ERROR;
+
+        for (event_ptr = (char *) events; event_ptr < (char *) events + length;
+             event_ptr += sizeof(struct inotify_event) + event->len) {
+            event = (struct inotify_event *) event_ptr;
+
+            for (i = 0; i < watcher->inputs_count; i++) {
+                /* We lost events, so check all the sources */
+                if (event->mask & IN_Q_OVERFLOW) watcher->changed[i] = TRUE;
+
+                if (event->len > 0 && event->wd == watcher->watches[i] && strcmp(event->name, watcher->names[i]) == 0) {
+                    watcher->changed[i] = TRUE;
+                }
+            }
+        }
+
+        timeout = WATCH_SETTLE_MILLISECONDS;
+    }
+
+    return OK;
+}
+#endif
+
+/**
+ * This function waits until one of the sources changes
+ * Source which was saved without changes (the same content as in its last assembly) is ignored
+ * @param watcher The watcher
+ * @return The index of the changed source (its new content is in get_watched_source), or -1 if we failed to wait
+ */
+int wait_watched_source(WATCHER *watcher) {
+    /* For loop counter */
+    int i;
+
+    /* The content of the source in its last assembly */
+    BATCH_SOURCE last_source;
+
+    while (TRUE) {
+        for (i = 0; i < watcher->inputs_count; i++) {
+            if (!watcher->changed[i]) continue;
+            watcher->changed[i] = FALSE;
+
+            last_source = watcher->sources[i];
+            watcher->sources[i].data = NULL;
+            read_watched_source(watcher->paths[i], &watcher->sources[i]);
+
+            if (last_source.found != watcher->sources[i].found ||
+                last_source.length != watcher->sources[i].length ||
+                (last_source.found && memcmp(last_source.data, watcher->sources[i].data, last_source.length) != 0)) {
+                free(last_source.data);
+                return i;
+            }
+
+            free(last_source.data);
+        }
+
+#ifdef __linux__
+        if (read_watch_events(watcher) != OK) return -1;
+#else
+        return -1;
+#endif
+    }
+}
+
+/**
+ * This function stops watching the sources, and frees the watcher
+ * @param watcher The watcher
+ */
+void close_watcher(WATCHER *watcher) {
+    /* For loop counter */
+    int i;
+
+    for (i = 0; i < watcher->inputs_count; i++) {
+        free(watcher->paths[i]);
+        free(watcher->sources[i].data);
+    }
+
+#ifdef __linux__
+    close(watcher->fd);
+#endif
+
+    free(watcher->paths);
+    free(watcher->names);
+    free(watcher->watches);
+    free(watcher->changed);
+    free(watcher->sources);
+    free(watcher);
+}